@@ -7,6 +7,11 @@
 #include "moxygen/MoQClient.h"
 
 #include <moxygen/util/QuicConnector.h>
+#include <moxygen/util/TimedBaton.h>
+
+#include <folly/ScopeGuard.h>
+#include <folly/futures/ThreadWheelTimekeeper.h>
+#include <folly/portability/Sockets.h>
 
 #include <proxygen/httpserver/samples/hq/InsecureVerifierDangerousDoNotUseInProduction.h>
 #include <proxygen/lib/http/HQConnector.h>
@@ -28,8 +33,11 @@ proxygen::HTTPMessage getWebTransportConnectRequest(const proxygen::URL& url) {
 folly::coro::Task<proxygen::HQUpstreamSession*> connectH3WithWebtransport(
     folly::EventBase* evb,
     const proxygen::URL& url,
+    folly::SocketAddress connectAddr,
     std::chrono::milliseconds connect_timeout,
-    std::chrono::milliseconds transaction_timeout) {
+    std::chrono::milliseconds transaction_timeout,
+    std::shared_ptr<quic::QuicPskCache> pskCache,
+    const moxygen::TransportConfig& transportConfig) {
   // Establish an H3 connection
   class ConnectCallback : public proxygen::HQConnector::Callback {
    public:
@@ -58,6 +66,11 @@ folly::coro::Task<proxygen::HQUpstreamSession*> connectH3WithWebtransport(
   quic::TransportSettings ts;
   ts.datagramConfig.enabled = true;
   // ts.idleTimeout = std::chrono::seconds(10);
+  transportConfig.apply(ts);
+  if (pskCache) {
+    ts.attemptEarlyData = true;
+    hqConnector.setQuicPskCache(std::move(pskCache));
+  }
   hqConnector.setTransportSettings(ts);
   hqConnector.setSupportedQuicVersions({quic::QuicVersion::QUIC_V1});
   auto fizzContext = std::make_shared<fizz::client::FizzClientContext>();
@@ -71,7 +84,7 @@ folly::coro::Task<proxygen::HQUpstreamSession*> connectH3WithWebtransport(
   hqConnector.connect(
       evb,
       folly::none,
-      folly::SocketAddress(url.getHost(), url.getPort(), true), // blocking DNS,
+      connectAddr,
       std::move(fizzContext),
       std::make_shared<
           proxygen::InsecureVerifierDangerousDoNotUseInProduction>(),
@@ -86,6 +99,99 @@ folly::coro::Task<proxygen::HQUpstreamSession*> connectH3WithWebtransport(
   }
   co_return session.value();
 }
+
+// Blocking DNS, like the single address connect
+std::vector<folly::SocketAddress> resolveAddresses(
+    const proxygen::URL& url,
+    size_t maxAddresses) {
+  struct addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  struct addrinfo* results = nullptr;
+  auto port = folly::to<std::string>(url.getPort());
+  auto rc = getaddrinfo(url.getHost().c_str(), port.c_str(), &hints, &results);
+  if (rc != 0) {
+    XLOG(ERR) << "Failed to resolve " << url.getHost() << ": "
+              << gai_strerror(rc);
+    return {};
+  }
+  SCOPE_EXIT {
+    freeaddrinfo(results);
+  };
+  std::vector<folly::SocketAddress> v6;
+  std::vector<folly::SocketAddress> v4;
+  for (auto ai = results; ai; ai = ai->ai_next) {
+    folly::SocketAddress addr;
+    addr.setFromSockaddr(ai->ai_addr, ai->ai_addrlen);
+    (addr.getFamily() == AF_INET6 ? v6 : v4).push_back(addr);
+  }
+  // Alternate families, IPv6 first
+  std::vector<folly::SocketAddress> addresses;
+  for (size_t i = 0; addresses.size() < maxAddresses &&
+       (i < v6.size() || i < v4.size());
+       i++) {
+    if (i < v6.size()) {
+      addresses.push_back(v6[i]);
+    }
+    if (i < v4.size() && addresses.size() < maxAddresses) {
+      addresses.push_back(v4[i]);
+    }
+  }
+  return addresses;
+}
+
+struct RaceState {
+  // Wakes connectRacing when an attempt finishes
+  void signal() {
+    if (!signalled) {
+      signalled = true;
+      progress.signal();
+    }
+  }
+  void resetProgress() {
+    signalled = false;
+    progress.reset();
+  }
+
+  std::unique_ptr<moxygen::MoQClient> winner;
+  folly::exception_wrapper lastError;
+  folly::CancellationSource cancelSource;
+  moxygen::TimedBaton progress;
+  bool signalled{false};
+  size_t running{0};
+};
+
+folly::coro::Task<void> raceAttempt(
+    std::shared_ptr<RaceState> state,
+    std::unique_ptr<moxygen::MoQClient> client,
+    std::chrono::milliseconds connect_timeout,
+    std::chrono::milliseconds transaction_timeout,
+    std::shared_ptr<moxygen::Publisher> publishHandler,
+    std::shared_ptr<moxygen::Subscriber> subscribeHandler,
+    std::function<folly::coro::Task<void>(moxygen::MoQClient&)> setupSession) {
+  auto res = co_await co_awaitTry(
+      setupSession ? setupSession(*client)
+                   : client->setupMoQSession(
+                         connect_timeout,
+                         transaction_timeout,
+                         std::move(publishHandler),
+                         std::move(subscribeHandler)));
+  state->running--;
+  if (!res.hasException() && client->moqSession_ && !state->winner &&
+      !state->cancelSource.isCancellationRequested()) {
+    state->winner = std::move(client);
+  } else {
+    if (client->moqSession_) {
+      // Lost the race
+      client->moqSession_->close(moxygen::SessionCloseErrorCode::NO_ERROR);
+    }
+    if (res.hasException()) {
+      XLOG(DBG1) << "Connect attempt failed: " << res.exception().what();
+      state->lastError = std::move(res.exception());
+    }
+  }
+  state->signal();
+}
 } // namespace
 
 namespace moxygen {
@@ -96,16 +202,27 @@ folly::coro::Task<void> MoQClient::setupMoQSession(
     std::shared_ptr<Subscriber> subscribeHandler) noexcept {
   proxygen::WebTransport* wt = nullptr;
   folly::Optional<std::string> pathParam;
+  TransportMetricsProvider metricsProvider;
+  auto connectAddr = peerAddress_
+      ? *peerAddress_
+      : folly::SocketAddress(
+            url_.getHost(), url_.getPort(), true); // blocking DNS
   if (transportType_ == TransportType::QUIC) {
+    quic::TransportSettings transportSettings;
+    transportConfig_.apply(transportSettings);
     // Establish QUIC connection
     auto quicClient = co_await QuicConnector::connectQuic(
         evb_,
-        folly::SocketAddress(
-            url_.getHost(), url_.getPort(), true), // blocking DNS,
+        connectAddr,
         connect_timeout,
         std::make_shared<
             proxygen::InsecureVerifierDangerousDoNotUseInProduction>(),
-        "moq-00");
+        "moq-00",
+        pskCache_,
+        url_.getHost(),
+        transportSettings);
+
+    metricsProvider = makeQuicMetricsProvider(quicClient);
 
     // Make WebTransport object
     quicWebTransport_ =
@@ -116,7 +233,13 @@ folly::coro::Task<void> MoQClient::setupMoQSession(
   } else {
     // Establish H3 connection
     auto session = co_await connectH3WithWebtransport(
-        evb_, url_, connect_timeout, transaction_timeout);
+        evb_,
+        url_,
+        connectAddr,
+        connect_timeout,
+        transaction_timeout,
+        pskCache_,
+        transportConfig_);
 
     // Establish WebTransport session
     auto txn = session->newTransaction(&httpHandler_);
@@ -129,16 +252,112 @@ folly::coro::Task<void> MoQClient::setupMoQSession(
     }
     session->drain();
     wt = wtTry.value();
+    metricsProvider = [this]() -> folly::Optional<TransportMetrics> {
+      if (!httpHandler_.txn_) {
+        return folly::none;
+      }
+      return makeHTTPMetricsProvider(httpHandler_.txn_)();
+    };
+  }
+
+  auto token = co_await folly::coro::co_current_cancellation_token;
+  if (token.isCancellationRequested()) {
+    // Connected after losing a race, don't bother with setup
+    wt->closeSession(folly::none);
+    co_yield folly::coro::co_error(folly::OperationCancelled());
   }
 
   //  Create MoQSession and Setup MoQSession parameters
   moqSession_ = std::make_shared<MoQSession>(wt, evb_);
+  moqSession_->setTransportMetricsProvider(std::move(metricsProvider));
   moqSession_->setPublishHandler(std::move(publishHandler));
   moqSession_->setSubscribeHandler(std::move(subscribeHandler));
   moqSession_->start();
   co_await moqSession_->setup(getClientSetup(pathParam));
 }
 
+folly::coro::Task<std::unique_ptr<MoQClient>> MoQClient::connectRacing(
+    folly::EventBase* evb,
+    proxygen::URL url,
+    RaceOptions options,
+    std::chrono::milliseconds connect_timeout,
+    std::chrono::milliseconds transaction_timeout,
+    std::shared_ptr<Publisher> publishHandler,
+    std::shared_ptr<Subscriber> subscribeHandler,
+    std::shared_ptr<quic::QuicPskCache> pskCache) {
+  std::vector<folly::Optional<folly::SocketAddress>> addresses(
+      options.addresses.begin(), options.addresses.end());
+  if (addresses.empty()) {
+    for (auto& addr : resolveAddresses(url, options.maxAddresses)) {
+      addresses.emplace_back(std::move(addr));
+    }
+  }
+  if (addresses.empty()) {
+    // Let the connect report the resolution failure
+    addresses.emplace_back(folly::none);
+  }
+
+  auto state = std::make_shared<RaceState>();
+  // Stops the losing attempts however the race ends, including when the
+  // caller cancels
+  auto g = folly::makeGuard(
+      [state] { state->cancelSource.requestCancellation(); });
+  auto callerToken = co_await folly::coro::co_current_cancellation_token;
+  folly::EventBaseThreadTimekeeper tk(*evb);
+  for (const auto& addr : addresses) {
+    for (auto transport : options.transports) {
+      if (state->winner) {
+        break;
+      }
+      if (state->running > 0) {
+        // Give the running attempts a head start, unless one finishes
+        co_await co_awaitTry(
+            state->progress.wait(options.attemptDelay, &tk));
+        state->resetProgress();
+        if (callerToken.isCancellationRequested()) {
+          co_yield folly::coro::co_error(folly::OperationCancelled());
+        }
+        if (state->winner) {
+          break;
+        }
+      }
+      auto client = std::make_unique<MoQClient>(evb, url, transport);
+      client->setPskCache(pskCache);
+      client->setTransportConfig(options.transportConfig);
+      if (addr) {
+        client->setPeerAddress(*addr);
+      }
+      XLOG(DBG1) << "Starting connect attempt transport="
+                 << folly::to_underlying(transport) << " addr="
+                 << (addr ? addr->describe() : url.getHost());
+      state->running++;
+      folly::coro::co_withCancellation(
+          state->cancelSource.getToken(),
+          raceAttempt(
+              state,
+              std::move(client),
+              connect_timeout,
+              transaction_timeout,
+              publishHandler,
+              subscribeHandler,
+              options.setupSession))
+          .scheduleOn(evb)
+          .start();
+    }
+  }
+  while (!state->winner && state->running > 0) {
+    co_await state->progress.wait();
+    state->resetProgress();
+  }
+  if (!state->winner) {
+    if (!state->lastError) {
+      state->lastError = std::runtime_error("No connect attempts");
+    }
+    co_yield folly::coro::co_error(std::move(state->lastError));
+  }
+  co_return std::move(state->winner);
+}
+
 ClientSetup MoQClient::getClientSetup(
     const folly::Optional<std::string>& path) {
   // Setup MoQSession parameters
@@ -189,6 +408,7 @@ void MoQClient::HTTPHandler::onError(
 
 void MoQClient::onSessionEnd(folly::Optional<uint32_t> err) {
   if (moqSession_) {
+    moqSession_->setTransportMetricsProvider(nullptr);
     moqSession_->onSessionEnd(err);
     XLOG(DBG1) << "resetting moqSession_";
     moqSession_.reset();
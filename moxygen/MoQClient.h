@@ -7,11 +7,18 @@
 #pragma once
 
 #include "moxygen/MoQSession.h"
+#include "moxygen/util/TransportProfile.h"
 
+#include <folly/SocketAddress.h>
 #include <folly/coro/Promise.h>
 #include <proxygen/lib/http/session/HTTPTransaction.h>
 #include <proxygen/lib/http/webtransport/QuicWebTransport.h>
 #include <proxygen/lib/utils/URL.h>
+#include <functional>
+
+namespace quic {
+class QuicPskCache;
+} // namespace quic
 
 namespace moxygen {
 
@@ -30,6 +37,59 @@ class MoQClient : public proxygen::WebTransportHandler {
     return evb_;
   }
 
+  // Resumption tickets from this client's connections are stored in pskCache,
+  // and later connections to the same host use them for 0-RTT.  Share one
+  // cache across MoQClient instances to resume after a reconnect.
+  void setPskCache(std::shared_ptr<quic::QuicPskCache> pskCache) {
+    pskCache_ = std::move(pskCache);
+  }
+
+  // QUIC settings for the connection, whichever the transport type
+  void setTransportConfig(TransportConfig transportConfig) {
+    transportConfig_ = std::move(transportConfig);
+  }
+
+  // Connect to addr instead of resolving the URL host, which is still used
+  // for SNI and the WebTransport request
+  void setPeerAddress(folly::SocketAddress addr) {
+    peerAddress_ = std::move(addr);
+  }
+
+  struct RaceOptions {
+    // Tried in this order on each address
+    std::vector<TransportType> transports{
+        TransportType::QUIC,
+        TransportType::H3_WEBTRANSPORT};
+    // Addresses to try in order.  When empty the URL host is resolved and
+    // up to maxAddresses of its addresses are tried, alternating IPv6 and
+    // IPv4.
+    std::vector<folly::SocketAddress> addresses;
+    size_t maxAddresses{2};
+    // Delay before starting the next attempt.  The next one starts at once
+    // when an attempt fails.
+    std::chrono::milliseconds attemptDelay{std::chrono::milliseconds(250)};
+    // Used by every attempt
+    TransportConfig transportConfig;
+    // Replaces setupMoQSession for each attempt, for tests.  It must set
+    // moqSession_ on success.
+    std::function<folly::coro::Task<void>(MoQClient&)> setupSession;
+  };
+
+  // Happy eyeballs connect: starts an attempt for every address and
+  // transport, staggered by attemptDelay, and returns the client whose MoQ
+  // session finished setup first.  The other attempts are cancelled and any
+  // session they set up is closed.  Throws the last error if every attempt
+  // fails.
+  static folly::coro::Task<std::unique_ptr<MoQClient>> connectRacing(
+      folly::EventBase* evb,
+      proxygen::URL url,
+      RaceOptions options,
+      std::chrono::milliseconds connect_timeout,
+      std::chrono::milliseconds transaction_timeout,
+      std::shared_ptr<Publisher> publishHandler,
+      std::shared_ptr<Subscriber> subscribeHandler,
+      std::shared_ptr<quic::QuicPskCache> pskCache = nullptr);
+
   class HTTPHandler : public proxygen::HTTPTransactionHandler {
    public:
     explicit HTTPHandler(MoQClient& client) : client_(client) {}
@@ -37,7 +97,9 @@ class MoQClient : public proxygen::WebTransportHandler {
     void setTransaction(proxygen::HTTPTransaction* txn) noexcept override {
       txn_ = txn;
     }
-    void detachTransaction() noexcept override {}
+    void detachTransaction() noexcept override {
+      txn_ = nullptr;
+    }
     void onHeadersComplete(
         std::unique_ptr<proxygen::HTTPMessage> resp) noexcept override;
 
@@ -95,6 +157,9 @@ class MoQClient : public proxygen::WebTransportHandler {
   HTTPHandler httpHandler_{*this};
   TransportType transportType_;
   std::shared_ptr<proxygen::QuicWebTransport> quicWebTransport_;
+  std::shared_ptr<quic::QuicPskCache> pskCache_;
+  folly::Optional<folly::SocketAddress> peerAddress_;
+  TransportConfig transportConfig_;
 };
 
 } // namespace moxygen
@@ -5,6 +5,7 @@
  */
 
 #include "moxygen/MoQCodec.h"
+#include "moxygen/util/MoQTracepoints.h"
 
 #include <folly/logging/xlog.h>
 
@@ -74,6 +75,10 @@ void MoQControlCodec::onIngress(std::unique_ptr<folly::IOBuf> data, bool eom) {
           }
           break;
         }
+        MOQ_TRACEPOINT(
+            control_frame,
+            folly::to_underlying(curFrameType_),
+            curFrameLength_);
         parseState_ = ParseState::FRAME_HEADER_TYPE;
         remainingLength -= curFrameLength_;
         break;
@@ -168,6 +173,11 @@ void MoQObjectStreamCodec::onIngress(
         auto trackAlias =
             std::get_if<TrackAlias>(&curObjectHeader_.trackIdentifier);
         XCHECK(trackAlias);
+        MOQ_TRACEPOINT(
+            subgroup_rx_open,
+            trackAlias->value,
+            curObjectHeader_.group,
+            curObjectHeader_.subgroup);
         if (callback_) {
           callback_->onSubgroup(
               *trackAlias,
@@ -180,21 +190,13 @@ void MoQObjectStreamCodec::onIngress(
         [[fallthrough]];
       }
       case ParseState::MULTI_OBJECT_HEADER: {
-        auto newCursor = cursor;
-        folly::Expected<ObjectHeader, ErrorCode> res;
-        if (streamType_ == StreamType::FETCH_HEADER) {
-          res = parseFetchObjectHeader(newCursor, curObjectHeader_);
-        } else {
-          DCHECK(streamType_ == StreamType::SUBGROUP_HEADER);
-          res = parseSubgroupObjectHeader(newCursor, curObjectHeader_);
-        }
+        // Consumes each completed field, even on underflow
+        auto res = parseObjectHeader(cursor);
         if (res.hasError()) {
           XLOG(DBG6) << __func__ << " " << uint32_t(res.error());
           connError_ = res.error();
           break;
         }
-        curObjectHeader_ = res.value();
-        cursor = newCursor;
         if (curObjectHeader_.status == ObjectStatus::NORMAL) {
           XLOG(DBG2) << "Parsing object with length, need="
                      << *curObjectHeader_.length
@@ -291,6 +293,16 @@ void MoQObjectStreamCodec::onIngress(
   if (!endOfStream && !cursor.isAtEnd()) {
     remainingLength = cursor.totalLength(); // must be less than 1 message
   }
+  if (endOfStream && !connError_ &&
+      streamType_ == StreamType::SUBGROUP_HEADER) {
+    auto trackAlias =
+        std::get_if<TrackAlias>(&curObjectHeader_.trackIdentifier);
+    MOQ_TRACEPOINT(
+        subgroup_rx_close,
+        trackAlias ? trackAlias->value : 0,
+        curObjectHeader_.group,
+        curObjectHeader_.subgroup);
+  }
   if (endOfStream && parseState_ != ParseState::STREAM_FIN_DELIVERED &&
       !connError_ && callback_) {
     callback_->onEndOfStream();
@@ -613,4 +625,158 @@ folly::Expected<folly::Unit, ErrorCode> MoQControlCodec::parseFrame(
   return folly::unit;
 }
 
+folly::Expected<folly::Unit, ErrorCode>
+MoQObjectStreamCodec::parseObjectHeader(folly::io::Cursor& cursor) {
+  // Only advances cursor past a varint once all of its bytes are available
+  auto readVarint = [&cursor]() -> folly::Optional<uint64_t> {
+    auto newCursor = cursor;
+    auto res = quic::decodeQuicInteger(newCursor);
+    if (!res) {
+      return folly::none;
+    }
+    cursor = newCursor;
+    return res->first;
+  };
+  auto underflow = folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+
+  while (true) {
+    switch (headerField_) {
+      case HeaderField::START: {
+        curObjectHeader_.extensions.clear();
+        curObjectHeader_.length.reset();
+        if (streamType_ == StreamType::FETCH_HEADER) {
+          headerField_ = HeaderField::GROUP;
+        } else {
+          DCHECK(streamType_ == StreamType::SUBGROUP_HEADER);
+          headerField_ = HeaderField::OBJECT_ID;
+        }
+        break;
+      }
+      case HeaderField::GROUP: {
+        auto group = readVarint();
+        if (!group) {
+          return underflow;
+        }
+        curObjectHeader_.group = *group;
+        headerField_ = HeaderField::SUBGROUP;
+        break;
+      }
+      case HeaderField::SUBGROUP: {
+        auto subgroup = readVarint();
+        if (!subgroup) {
+          return underflow;
+        }
+        curObjectHeader_.subgroup = *subgroup;
+        headerField_ = HeaderField::OBJECT_ID;
+        break;
+      }
+      case HeaderField::OBJECT_ID: {
+        auto id = readVarint();
+        if (!id) {
+          return underflow;
+        }
+        curObjectHeader_.id = *id;
+        headerField_ = streamType_ == StreamType::FETCH_HEADER
+            ? HeaderField::PRIORITY
+            : HeaderField::EXT_COUNT;
+        break;
+      }
+      case HeaderField::PRIORITY: {
+        if (!cursor.canAdvance(1)) {
+          return underflow;
+        }
+        curObjectHeader_.priority = cursor.readBE<uint8_t>();
+        headerField_ = HeaderField::EXT_COUNT;
+        break;
+      }
+      case HeaderField::EXT_COUNT: {
+        auto numExt = readVarint();
+        if (!numExt) {
+          return underflow;
+        }
+        if (*numExt > kMaxExtensions) {
+          XLOG(ERR) << "numExt > kMaxExtensions =" << *numExt;
+          return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
+        }
+        extRemaining_ = *numExt;
+        curObjectHeader_.extensions.reserve(extRemaining_);
+        headerField_ =
+            extRemaining_ > 0 ? HeaderField::EXT_TYPE : HeaderField::LENGTH;
+        break;
+      }
+      case HeaderField::EXT_TYPE: {
+        auto type = readVarint();
+        if (!type) {
+          return underflow;
+        }
+        curExtension_ = Extension();
+        curExtension_.type = *type;
+        headerField_ = (curExtension_.type & 0x1) ? HeaderField::EXT_LENGTH
+                                                  : HeaderField::EXT_VALUE;
+        break;
+      }
+      case HeaderField::EXT_LENGTH: {
+        auto extLen = readVarint();
+        if (!extLen) {
+          return underflow;
+        }
+        if (*extLen > kMaxExtensionLength) {
+          XLOG(ERR) << "extLen > kMaxExtensionLength =" << *extLen;
+          return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
+        }
+        curExtensionLength_ = *extLen;
+        headerField_ = HeaderField::EXT_VALUE;
+        break;
+      }
+      case HeaderField::EXT_VALUE: {
+        if (curExtension_.type & 0x1) {
+          if (!cursor.canAdvance(curExtensionLength_)) {
+            return underflow;
+          }
+          curExtension_.arrayValue.resize(curExtensionLength_);
+          cursor.pull(curExtension_.arrayValue.data(), curExtensionLength_);
+        } else {
+          auto value = readVarint();
+          if (!value) {
+            return underflow;
+          }
+          curExtension_.intValue = *value;
+        }
+        curObjectHeader_.extensions.emplace_back(std::move(curExtension_));
+        extRemaining_--;
+        headerField_ =
+            extRemaining_ > 0 ? HeaderField::EXT_TYPE : HeaderField::LENGTH;
+        break;
+      }
+      case HeaderField::LENGTH: {
+        auto length = readVarint();
+        if (!length) {
+          return underflow;
+        }
+        curObjectHeader_.length = *length;
+        if (*length > 0) {
+          curObjectHeader_.status = ObjectStatus::NORMAL;
+          headerField_ = HeaderField::START;
+          return folly::unit;
+        }
+        headerField_ = HeaderField::STATUS;
+        break;
+      }
+      case HeaderField::STATUS: {
+        auto status = readVarint();
+        if (!status) {
+          return underflow;
+        }
+        if (*status > folly::to_underlying(ObjectStatus::END_OF_TRACK)) {
+          XLOG(ERR) << "status > END_OF_TRACK =" << *status;
+          return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
+        }
+        curObjectHeader_.status = ObjectStatus(*status);
+        headerField_ = HeaderField::START;
+        return folly::unit;
+      }
+    }
+  }
+}
+
 } // namespace moxygen
@@ -189,6 +189,30 @@ class MoQObjectStreamCodec : public MoQCodec {
   };
   ParseState parseState_{ParseState::STREAM_HEADER_TYPE};
   StreamType streamType_{StreamType::SUBGROUP_HEADER};
+
+  // Object headers are decoded one field at a time into curObjectHeader_.
+  // Completed fields are consumed from ingress, so a header split across
+  // reads resumes at the first missing field rather than starting over.
+  enum class HeaderField {
+    START,
+    GROUP,
+    SUBGROUP,
+    OBJECT_ID,
+    PRIORITY,
+    EXT_COUNT,
+    EXT_TYPE,
+    EXT_LENGTH,
+    EXT_VALUE,
+    LENGTH,
+    STATUS,
+  };
+  folly::Expected<folly::Unit, ErrorCode> parseObjectHeader(
+      folly::io::Cursor& cursor);
+  HeaderField headerField_{HeaderField::START};
+  uint64_t extRemaining_{0};
+  Extension curExtension_;
+  uint64_t curExtensionLength_{0};
+
   ObjectCallback* callback_;
 };
 
@@ -5,14 +5,10 @@
  */
 
 #include "moxygen/MoQFramer.h"
+#include "moxygen/MoQFramerSchema.h"
 #include <folly/lang/Bits.h>
 #include <folly/logging/xlog.h>
 
-namespace {
-constexpr uint64_t kMaxExtensions = 16;
-constexpr uint64_t kMaxExtensionLength = 1024;
-} // namespace
-
 namespace moxygen {
 
 folly::Expected<std::string, ErrorCode> parseFixedString(
@@ -435,7 +431,7 @@ folly::Expected<ObjectHeader, ErrorCode> parseSubgroupObjectHeader(
 
 folly::Expected<folly::Unit, ErrorCode> parseTrackRequestParams(
     folly::io::Cursor& cursor,
-    size_t length,
+    size_t& length,
     size_t numParams,
     std::vector<TrackRequestParameter>& params) {
   for (auto i = 0u; i < numParams; i++) {
@@ -473,164 +469,19 @@ folly::Expected<folly::Unit, ErrorCode> parseTrackRequestParams(
 folly::Expected<SubscribeRequest, ErrorCode> parseSubscribeRequest(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  SubscribeRequest subscribeRequest;
-  auto subscribeID = quic::decodeQuicInteger(cursor, length);
-  if (!subscribeID) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= subscribeID->second;
-  subscribeRequest.subscribeID = subscribeID->first;
-  auto trackAlias = quic::decodeQuicInteger(cursor, length);
-  if (!trackAlias) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= trackAlias->second;
-  subscribeRequest.trackAlias = trackAlias->first;
-  auto res = parseFullTrackName(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  subscribeRequest.fullTrackName = std::move(res.value());
-  if (length < 2) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  subscribeRequest.priority = cursor.readBE<uint8_t>();
-  auto order = cursor.readBE<uint8_t>();
-  if (order > folly::to_underlying(GroupOrder::NewestFirst)) {
-    XLOG(ERR) << "order > NewestFirst =" << order;
-    return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
-  }
-  length -= 2;
-  subscribeRequest.groupOrder = static_cast<GroupOrder>(order);
-  auto locType = quic::decodeQuicInteger(cursor, length);
-  if (!locType) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  if (locType->first > folly::to_underlying(LocationType::AbsoluteRange)) {
-    XLOG(ERR) << "locType > AbsoluteRange =" << locType->first;
-    return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
-  }
-  length -= locType->second;
-  subscribeRequest.locType = LocationType(locType->first);
-  if (subscribeRequest.locType == LocationType::AbsoluteStart ||
-      subscribeRequest.locType == LocationType::AbsoluteRange) {
-    auto location = parseAbsoluteLocation(cursor, length);
-    if (!location) {
-      return folly::makeUnexpected(location.error());
-    }
-    subscribeRequest.start = *location;
-  }
-  if (subscribeRequest.locType == LocationType::AbsoluteRange) {
-    auto endGroup = quic::decodeQuicInteger(cursor, length);
-    if (!endGroup) {
-      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-    }
-    subscribeRequest.endGroup = endGroup->first;
-    length -= endGroup->second;
-  }
-  auto numParams = quic::decodeQuicInteger(cursor, length);
-  if (!numParams) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= numParams->second;
-  auto res2 = parseTrackRequestParams(
-      cursor, length, numParams->first, subscribeRequest.params);
-  if (!res2) {
-    return folly::makeUnexpected(res2.error());
-  }
-  return subscribeRequest;
+  return schema::SubscribeRequestMessage::parse(cursor, length);
 }
 
 folly::Expected<SubscribeUpdate, ErrorCode> parseSubscribeUpdate(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  SubscribeUpdate subscribeUpdate;
-  auto subscribeID = quic::decodeQuicInteger(cursor, length);
-  if (!subscribeID) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  subscribeUpdate.subscribeID = subscribeID->first;
-  length -= subscribeID->second;
-  auto start = parseAbsoluteLocation(cursor, length);
-  if (!start) {
-    return folly::makeUnexpected(start.error());
-  }
-  subscribeUpdate.start = start.value();
-
-  auto endGroup = quic::decodeQuicInteger(cursor, length);
-  if (!endGroup) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  subscribeUpdate.endGroup = endGroup->first;
-  length -= endGroup->second;
-
-  if (length < 2) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  subscribeUpdate.priority = cursor.readBE<uint8_t>();
-  length--;
-  auto numParams = quic::decodeQuicInteger(cursor, length);
-  if (!numParams) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= numParams->second;
-
-  auto res2 = parseTrackRequestParams(
-      cursor, length, numParams->first, subscribeUpdate.params);
-  if (!res2) {
-    return folly::makeUnexpected(res2.error());
-  }
-  return subscribeUpdate;
+  return schema::SubscribeUpdateMessage::parse(cursor, length);
 }
 
 folly::Expected<SubscribeOk, ErrorCode> parseSubscribeOk(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  SubscribeOk subscribeOk;
-  auto subscribeID = quic::decodeQuicInteger(cursor, length);
-  if (!subscribeID) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= subscribeID->second;
-  subscribeOk.subscribeID = subscribeID->first;
-
-  auto expires = quic::decodeQuicInteger(cursor, length);
-  if (!expires) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= expires->second;
-  subscribeOk.expires = std::chrono::milliseconds(expires->first);
-  if (length < 2) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  auto order = cursor.readBE<uint8_t>();
-  if (order == 0 || order > folly::to_underlying(GroupOrder::NewestFirst)) {
-    XLOG(ERR) << "order > NewestFirst or order==0 =" << order;
-    return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
-  }
-  length -= sizeof(uint8_t);
-  subscribeOk.groupOrder = static_cast<GroupOrder>(order);
-  auto contentExists = cursor.readBE<uint8_t>();
-  length -= sizeof(uint8_t);
-  if (contentExists) {
-    auto res = parseAbsoluteLocation(cursor, length);
-    if (!res) {
-      return folly::makeUnexpected(res.error());
-    }
-    subscribeOk.latest = *res;
-  }
-  auto numParams = quic::decodeQuicInteger(cursor, length);
-  if (!numParams) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= numParams->second;
-  auto res2 = parseTrackRequestParams(
-      cursor, length, numParams->first, subscribeOk.params);
-  if (!res2) {
-    return folly::makeUnexpected(res2.error());
-  }
-
-  return subscribeOk;
+  return schema::SubscribeOkMessage::parse(cursor, length);
 }
 
 folly::Expected<SubscribeError, ErrorCode> parseSubscribeError(
@@ -672,171 +523,49 @@ folly::Expected<SubscribeError, ErrorCode> parseSubscribeError(
 folly::Expected<Unsubscribe, ErrorCode> parseUnsubscribe(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  Unsubscribe unsubscribe;
-  auto subscribeID = quic::decodeQuicInteger(cursor, length);
-  if (!subscribeID) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= subscribeID->second;
-  unsubscribe.subscribeID = subscribeID->first;
-
-  return unsubscribe;
+  return schema::UnsubscribeMessage::parse(cursor, length);
 }
 
 folly::Expected<SubscribeDone, ErrorCode> parseSubscribeDone(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  SubscribeDone subscribeDone;
-  auto subscribeID = quic::decodeQuicInteger(cursor, length);
-  if (!subscribeID) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= subscribeID->second;
-  subscribeDone.subscribeID = subscribeID->first;
-
-  auto statusCode = quic::decodeQuicInteger(cursor, length);
-  if (!statusCode) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= statusCode->second;
-  subscribeDone.statusCode = SubscribeDoneStatusCode(statusCode->first);
-
-  auto streamCount = quic::decodeQuicInteger(cursor, length);
-  if (!streamCount) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= streamCount->second;
-  subscribeDone.streamCount = streamCount->first;
-
-  auto reas = parseFixedString(cursor, length);
-  if (!reas) {
-    return folly::makeUnexpected(reas.error());
-  }
-  subscribeDone.reasonPhrase = std::move(reas.value());
-
-  if (length == 0) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  auto contentExists = cursor.readBE<uint8_t>();
-  length -= sizeof(uint8_t);
-  if (contentExists) {
-    auto res = parseAbsoluteLocation(cursor, length);
-    if (!res) {
-      return folly::makeUnexpected(res.error());
-    }
-    subscribeDone.finalObject = *res;
-  }
-
-  return subscribeDone;
+  return schema::SubscribeDoneMessage::parse(cursor, length);
 }
 
 folly::Expected<Announce, ErrorCode> parseAnnounce(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  Announce announce;
-  auto res = parseFixedTuple(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  announce.trackNamespace = TrackNamespace(std::move(res.value()));
-  auto numParams = quic::decodeQuicInteger(cursor, length);
-  if (!numParams) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= numParams->second;
-  auto res2 = parseTrackRequestParams(
-      cursor, length, numParams->first, announce.params);
-  if (!res2) {
-    return folly::makeUnexpected(res2.error());
-  }
-  return announce;
+  return schema::AnnounceMessage::parse(cursor, length);
 }
 
 folly::Expected<AnnounceOk, ErrorCode> parseAnnounceOk(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  AnnounceOk announceOk;
-  auto res = parseFixedTuple(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  announceOk.trackNamespace = TrackNamespace(std::move(res.value()));
-  return announceOk;
+  return schema::AnnounceOkMessage::parse(cursor, length);
 }
 
 folly::Expected<AnnounceError, ErrorCode> parseAnnounceError(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  AnnounceError announceError;
-  auto res = parseFixedTuple(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  announceError.trackNamespace = TrackNamespace(std::move(res.value()));
-
-  auto errorCode = quic::decodeQuicInteger(cursor, length);
-  if (!errorCode) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= errorCode->second;
-  announceError.errorCode = AnnounceErrorCode(errorCode->first);
-
-  auto res2 = parseFixedString(cursor, length);
-  if (!res2) {
-    return folly::makeUnexpected(res2.error());
-  }
-  announceError.reasonPhrase = std::move(res2.value());
-
-  return announceError;
+  return schema::AnnounceErrorMessage::parse(cursor, length);
 }
 
 folly::Expected<Unannounce, ErrorCode> parseUnannounce(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  Unannounce unannounce;
-  auto res = parseFixedTuple(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  unannounce.trackNamespace = TrackNamespace(std::move(res.value()));
-  return unannounce;
+  return schema::UnannounceMessage::parse(cursor, length);
 }
 
 folly::Expected<AnnounceCancel, ErrorCode> parseAnnounceCancel(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  AnnounceCancel announceCancel;
-  auto res = parseFixedTuple(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  announceCancel.trackNamespace = TrackNamespace(std::move(res.value()));
-
-  auto errorCode = quic::decodeQuicInteger(cursor, length);
-  if (!errorCode) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  announceCancel.errorCode = AnnounceErrorCode(errorCode->first);
-  length -= errorCode->second;
-
-  auto res2 = parseFixedString(cursor, length);
-  if (!res2) {
-    return folly::makeUnexpected(res2.error());
-  }
-  announceCancel.reasonPhrase = std::move(res2.value());
-  return announceCancel;
+  return schema::AnnounceCancelMessage::parse(cursor, length);
 }
 
 folly::Expected<TrackStatusRequest, ErrorCode> parseTrackStatusRequest(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  TrackStatusRequest trackStatusRequest;
-  auto res = parseFullTrackName(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  trackStatusRequest.fullTrackName = std::move(res.value());
-  return trackStatusRequest;
+  return schema::TrackStatusRequestMessage::parse(cursor, length);
 }
 
 folly::Expected<TrackStatus, ErrorCode> parseTrackStatus(
@@ -869,248 +598,68 @@ folly::Expected<TrackStatus, ErrorCode> parseTrackStatus(
 folly::Expected<Goaway, ErrorCode> parseGoaway(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  Goaway goaway;
-  auto res = parseFixedString(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  goaway.newSessionUri = std::move(res.value());
-  return goaway;
+  return schema::GoawayMessage::parse(cursor, length);
 }
 
 folly::Expected<MaxSubscribeId, ErrorCode> parseMaxSubscribeId(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  MaxSubscribeId maxSubscribeId;
-  auto subscribeID = quic::decodeQuicInteger(cursor, length);
-  if (!subscribeID) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= subscribeID->second;
-  maxSubscribeId.subscribeID = subscribeID->first;
-  return maxSubscribeId;
+  return schema::MaxSubscribeIdMessage::parse(cursor, length);
 }
 
 folly::Expected<SubscribesBlocked, ErrorCode> parseSubscribesBlocked(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  SubscribesBlocked subscribesBlocked;
-  auto res = quic::decodeQuicInteger(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  subscribesBlocked.maxSubscribeID = res->first;
-  length -= res->second;
-  return subscribesBlocked;
+  return schema::SubscribesBlockedMessage::parse(cursor, length);
 }
 
 folly::Expected<Fetch, ErrorCode> parseFetch(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  Fetch fetch;
-  auto res = quic::decodeQuicInteger(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  fetch.subscribeID = res->first;
-  length -= res->second;
-
-  if (length < 3) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-
-  fetch.priority = cursor.readBE<uint8_t>();
-  auto order = cursor.readBE<uint8_t>();
-  if (order > folly::to_underlying(GroupOrder::NewestFirst)) {
-    XLOG(ERR) << "order > NewestFirst =" << order;
-    return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
-  }
-  fetch.groupOrder = static_cast<GroupOrder>(order);
-  length -= 2 * sizeof(uint8_t);
-
-  auto fetchType = quic::decodeQuicInteger(cursor, length);
-  if (!fetchType) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  if (fetchType->first == 0 ||
-      fetchType->first > folly::to_underlying(FetchType::JOINING)) {
-    XLOG(ERR) << "fetchType = 0 or fetchType > JONING =" << fetchType->first;
-    return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
-  }
-  length -= fetchType->second;
-
-  if (FetchType(fetchType->first) == FetchType::STANDALONE) {
-    auto ftn = parseFullTrackName(cursor, length);
-    if (!ftn) {
-      return folly::makeUnexpected(ftn.error());
-    }
-
-    auto start = parseAbsoluteLocation(cursor, length);
-    if (!start) {
-      return folly::makeUnexpected(start.error());
-    }
-
-    auto end = parseAbsoluteLocation(cursor, length);
-    if (!end) {
-      return folly::makeUnexpected(end.error());
-    }
-    fetch.fullTrackName = std::move(ftn.value());
-    fetch.args = StandaloneFetch(start.value(), end.value());
-  } else {
-    // JOINING
-    auto jsid = quic::decodeQuicInteger(cursor, length);
-    if (!jsid) {
-      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-    }
-    length -= jsid->second;
-
-    auto pgo = quic::decodeQuicInteger(cursor, length);
-    if (!pgo) {
-      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-    }
-    length -= pgo->second;
-    // Note fetch.fullTrackName is empty at this point, the session fills it in
-    fetch.args = JoiningFetch(SubscribeID(jsid->first), pgo->first);
-  }
-  auto numParams = quic::decodeQuicInteger(cursor, length);
-  if (!numParams) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= numParams->second;
-  auto res5 =
-      parseTrackRequestParams(cursor, length, numParams->first, fetch.params);
-  if (!res5) {
-    return folly::makeUnexpected(res5.error());
-  }
-  return fetch;
+  return schema::FetchMessage::parse(cursor, length);
 }
 
 folly::Expected<FetchCancel, ErrorCode> parseFetchCancel(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  FetchCancel fetchCancel;
-  auto res = quic::decodeQuicInteger(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  fetchCancel.subscribeID = res->first;
-  return fetchCancel;
+  return schema::FetchCancelMessage::parse(cursor, length);
 }
 
 folly::Expected<FetchOk, ErrorCode> parseFetchOk(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  FetchOk fetchOk;
-  auto res = quic::decodeQuicInteger(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  fetchOk.subscribeID = res->first;
-  length -= res->second;
-
-  // Check for next two bytes
-  if (length < 2) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  auto order = cursor.readBE<uint8_t>();
-  if (order > folly::to_underlying(GroupOrder::NewestFirst)) {
-    XLOG(ERR) << "order = 0 or order > NewestFirst =" << order;
-    return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
-  }
-  fetchOk.groupOrder = static_cast<GroupOrder>(order);
-  fetchOk.endOfTrack = cursor.readBE<uint8_t>();
-  length -= 2 * sizeof(uint8_t);
-
-  auto res2 = parseAbsoluteLocation(cursor, length);
-  if (!res2) {
-    return folly::makeUnexpected(res2.error());
-  }
-  fetchOk.latestGroupAndObject = std::move(res2.value());
-
-  auto numParams = quic::decodeQuicInteger(cursor, length);
-  if (!numParams) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  length -= numParams->second;
-  auto res3 =
-      parseTrackRequestParams(cursor, length, numParams->first, fetchOk.params);
-  if (!res3) {
-    return folly::makeUnexpected(res3.error());
-  }
-
-  return fetchOk;
+  return schema::FetchOkMessage::parse(cursor, length);
 }
 
 folly::Expected<FetchError, ErrorCode> parseFetchError(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  FetchError fetchError;
-  auto res = quic::decodeQuicInteger(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  fetchError.subscribeID = res->first;
-  length -= res->second;
-
-  auto res2 = quic::decodeQuicInteger(cursor, length);
-  if (!res2) {
-    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
-  }
-  fetchError.errorCode = FetchErrorCode(res2->first);
-  length -= res2->second;
-
-  auto res3 = parseFixedString(cursor, length);
-  if (!res3) {
-    return folly::makeUnexpected(res3.error());
-  }
-  fetchError.reasonPhrase = std::move(res3.value());
-
-  return fetchError;
+  return schema::FetchErrorMessage::parse(cursor, length);
 }
 
 folly::Expected<SubscribeAnnounces, ErrorCode> parseSubscribeAnnounces(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  auto res = parseAnnounce(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  return SubscribeAnnounces(
-      {std::move(res->trackNamespace), std::move(res->params)});
+  return schema::SubscribeAnnouncesMessage::parse(cursor, length);
 }
 
 folly::Expected<SubscribeAnnouncesOk, ErrorCode> parseSubscribeAnnouncesOk(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  auto res = parseAnnounceOk(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  return SubscribeAnnouncesOk({std::move(res->trackNamespace)});
+  return schema::SubscribeAnnouncesOkMessage::parse(cursor, length);
 }
 
 folly::Expected<SubscribeAnnouncesError, ErrorCode>
 parseSubscribeAnnouncesError(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  auto res = parseAnnounceError(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  return SubscribeAnnouncesError(
-      {std::move(res->trackNamespace),
-       SubscribeAnnouncesErrorCode(folly::to_underlying(res->errorCode)),
-       std::move(res->reasonPhrase)});
+  return schema::SubscribeAnnouncesErrorMessage::parse(cursor, length);
 }
 
 folly::Expected<UnsubscribeAnnounces, ErrorCode> parseUnsubscribeAnnounces(
     folly::io::Cursor& cursor,
     size_t length) noexcept {
-  auto res = parseAnnounceOk(cursor, length);
-  if (!res) {
-    return folly::makeUnexpected(res.error());
-  }
-  return UnsubscribeAnnounces({std::move(res->trackNamespace)});
+  return schema::UnsubscribeAnnouncesMessage::parse(cursor, length);
 }
 
 //// Egress ////
@@ -1199,31 +748,6 @@ void writeFullTrackName(
   writeFixedString(writeBuf, fullTrackName.trackName, size, error);
 }
 
-void writeTrackRequestParams(
-    folly::IOBufQueue& writeBuf,
-    const std::vector<TrackRequestParameter>& params,
-    size_t& size,
-    bool& error) noexcept {
-  writeVarint(writeBuf, params.size(), size, error);
-  for (auto& param : params) {
-    writeVarint(writeBuf, param.key, size, error);
-    switch (param.key) {
-      case folly::to_underlying(TrackRequestParamKey::AUTHORIZATION):
-        writeFixedString(writeBuf, param.asString, size, error);
-        break;
-      case folly::to_underlying(TrackRequestParamKey::DELIVERY_TIMEOUT):
-      case folly::to_underlying(TrackRequestParamKey::MAX_CACHE_DURATION):
-        auto res = quic::getQuicIntegerSize(param.asUint64);
-        if (!res) {
-          error = true;
-          return;
-        }
-        writeVarint(writeBuf, res.value(), size, error);
-        writeVarint(writeBuf, param.asUint64, size, error);
-        break;
-    }
-  }
-}
 
 WriteResult writeClientSetup(
     folly::IOBufQueue& writeBuf,
@@ -1440,79 +964,19 @@ WriteResult writeStreamObject(
 WriteResult writeSubscribeRequest(
     folly::IOBufQueue& writeBuf,
     const SubscribeRequest& subscribeRequest) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::SUBSCRIBE, error);
-  writeVarint(writeBuf, subscribeRequest.subscribeID.value, size, error);
-  writeVarint(writeBuf, subscribeRequest.trackAlias.value, size, error);
-  writeFullTrackName(writeBuf, subscribeRequest.fullTrackName, size, error);
-  writeBuf.append(&subscribeRequest.priority, 1);
-  size += 1;
-  uint8_t order = folly::to_underlying(subscribeRequest.groupOrder);
-  writeBuf.append(&order, 1);
-  size += 1;
-  writeVarint(
-      writeBuf, folly::to_underlying(subscribeRequest.locType), size, error);
-  if (subscribeRequest.locType == LocationType::AbsoluteStart ||
-      subscribeRequest.locType == LocationType::AbsoluteRange) {
-    writeVarint(writeBuf, subscribeRequest.start->group, size, error);
-    writeVarint(writeBuf, subscribeRequest.start->object, size, error);
-  }
-  if (subscribeRequest.locType == LocationType::AbsoluteRange) {
-    writeVarint(writeBuf, subscribeRequest.endGroup, size, error);
-  }
-  writeTrackRequestParams(writeBuf, subscribeRequest.params, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::SubscribeRequestMessage::write(writeBuf, subscribeRequest);
 }
 
 WriteResult writeSubscribeUpdate(
     folly::IOBufQueue& writeBuf,
     const SubscribeUpdate& update) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::SUBSCRIBE_UPDATE, error);
-  writeVarint(writeBuf, update.subscribeID.value, size, error);
-  writeVarint(writeBuf, update.start.group, size, error);
-  writeVarint(writeBuf, update.start.object, size, error);
-  writeVarint(writeBuf, update.endGroup, size, error);
-  writeBuf.append(&update.priority, 1);
-  size += 1;
-  writeTrackRequestParams(writeBuf, update.params, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::SubscribeUpdateMessage::write(writeBuf, update);
 }
 
 WriteResult writeSubscribeOk(
     folly::IOBufQueue& writeBuf,
     const SubscribeOk& subscribeOk) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::SUBSCRIBE_OK, error);
-  writeVarint(writeBuf, subscribeOk.subscribeID.value, size, error);
-  writeVarint(writeBuf, subscribeOk.expires.count(), size, error);
-  auto order = folly::to_underlying(subscribeOk.groupOrder);
-  writeBuf.append(&order, 1);
-  size += 1;
-  uint8_t contentExists = (subscribeOk.latest) ? 1 : 0;
-  writeBuf.append(&contentExists, 1);
-  size += 1;
-  if (subscribeOk.latest) {
-    writeVarint(writeBuf, subscribeOk.latest->group, size, error);
-    writeVarint(writeBuf, subscribeOk.latest->object, size, error);
-  }
-  writeTrackRequestParams(writeBuf, subscribeOk.params, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::SubscribeOkMessage::write(writeBuf, subscribeOk);
 }
 
 WriteResult writeSubscribeError(
@@ -1536,161 +1000,61 @@ WriteResult writeSubscribeError(
 WriteResult writeMaxSubscribeId(
     folly::IOBufQueue& writeBuf,
     const MaxSubscribeId& maxSubscribeId) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::MAX_SUBSCRIBE_ID, error);
-  writeVarint(writeBuf, maxSubscribeId.subscribeID.value, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::MaxSubscribeIdMessage::write(writeBuf, maxSubscribeId);
 }
 
 WriteResult writeSubscribesBlocked(
     folly::IOBufQueue& writeBuf,
     const SubscribesBlocked& subscribesBlocked) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr =
-      writeFrameHeader(writeBuf, FrameType::SUBSCRIBES_BLOCKED, error);
-  writeVarint(writeBuf, subscribesBlocked.maxSubscribeID.value, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::SubscribesBlockedMessage::write(writeBuf, subscribesBlocked);
 }
 
 WriteResult writeUnsubscribe(
     folly::IOBufQueue& writeBuf,
     const Unsubscribe& unsubscribe) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::UNSUBSCRIBE, error);
-  writeVarint(writeBuf, unsubscribe.subscribeID.value, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::UnsubscribeMessage::write(writeBuf, unsubscribe);
 }
 
 WriteResult writeSubscribeDone(
     folly::IOBufQueue& writeBuf,
     const SubscribeDone& subscribeDone) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::SUBSCRIBE_DONE, error);
-  writeVarint(writeBuf, subscribeDone.subscribeID.value, size, error);
-  writeVarint(
-      writeBuf, folly::to_underlying(subscribeDone.statusCode), size, error);
-  writeVarint(writeBuf, subscribeDone.streamCount, size, error);
-  writeFixedString(writeBuf, subscribeDone.reasonPhrase, size, error);
-  if (subscribeDone.finalObject) {
-    writeVarint(writeBuf, 1, size, error);
-    writeVarint(writeBuf, subscribeDone.finalObject->group, size, error);
-    writeVarint(writeBuf, subscribeDone.finalObject->object, size, error);
-  } else {
-    writeVarint(writeBuf, 0, size, error);
-  }
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::SubscribeDoneMessage::write(writeBuf, subscribeDone);
 }
 
 WriteResult writeAnnounce(
     folly::IOBufQueue& writeBuf,
     const Announce& announce) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::ANNOUNCE, error);
-  writeTrackNamespace(writeBuf, announce.trackNamespace, size, error);
-  writeTrackRequestParams(writeBuf, announce.params, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::AnnounceMessage::write(writeBuf, announce);
 }
 
 WriteResult writeAnnounceOk(
     folly::IOBufQueue& writeBuf,
     const AnnounceOk& announceOk) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::ANNOUNCE_OK, error);
-  writeTrackNamespace(writeBuf, announceOk.trackNamespace, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::AnnounceOkMessage::write(writeBuf, announceOk);
 }
 
 WriteResult writeAnnounceError(
     folly::IOBufQueue& writeBuf,
     const AnnounceError& announceError) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::ANNOUNCE_ERROR, error);
-  writeTrackNamespace(writeBuf, announceError.trackNamespace, size, error);
-  writeVarint(
-      writeBuf, folly::to_underlying(announceError.errorCode), size, error);
-  writeFixedString(writeBuf, announceError.reasonPhrase, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::AnnounceErrorMessage::write(writeBuf, announceError);
 }
 
 WriteResult writeUnannounce(
     folly::IOBufQueue& writeBuf,
     const Unannounce& unannounce) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::UNANNOUNCE, error);
-  writeTrackNamespace(writeBuf, unannounce.trackNamespace, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::UnannounceMessage::write(writeBuf, unannounce);
 }
 
 WriteResult writeAnnounceCancel(
     folly::IOBufQueue& writeBuf,
     const AnnounceCancel& announceCancel) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::ANNOUNCE_CANCEL, error);
-  writeTrackNamespace(writeBuf, announceCancel.trackNamespace, size, error);
-  writeVarint(
-      writeBuf, folly::to_underlying(announceCancel.errorCode), size, error);
-  writeFixedString(writeBuf, announceCancel.reasonPhrase, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::AnnounceCancelMessage::write(writeBuf, announceCancel);
 }
 
 WriteResult writeTrackStatusRequest(
     folly::IOBufQueue& writeBuf,
     const TrackStatusRequest& trackStatusRequest) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr =
-      writeFrameHeader(writeBuf, FrameType::TRACK_STATUS_REQUEST, error);
-  writeFullTrackName(writeBuf, trackStatusRequest.fullTrackName, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::TrackStatusRequestMessage::write(writeBuf, trackStatusRequest);
 }
 
 WriteResult writeTrackStatus(
@@ -1720,178 +1084,58 @@ WriteResult writeTrackStatus(
 WriteResult writeGoaway(
     folly::IOBufQueue& writeBuf,
     const Goaway& goaway) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::GOAWAY, error);
-  writeFixedString(writeBuf, goaway.newSessionUri, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::GoawayMessage::write(writeBuf, goaway);
 }
 
 WriteResult writeSubscribeAnnounces(
     folly::IOBufQueue& writeBuf,
     const SubscribeAnnounces& subscribeAnnounces) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr =
-      writeFrameHeader(writeBuf, FrameType::SUBSCRIBE_ANNOUNCES, error);
-  writeTrackNamespace(
-      writeBuf, subscribeAnnounces.trackNamespacePrefix, size, error);
-  writeTrackRequestParams(writeBuf, subscribeAnnounces.params, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::SubscribeAnnouncesMessage::write(writeBuf, subscribeAnnounces);
 }
 
 WriteResult writeSubscribeAnnouncesOk(
     folly::IOBufQueue& writeBuf,
     const SubscribeAnnouncesOk& subscribeAnnouncesOk) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr =
-      writeFrameHeader(writeBuf, FrameType::SUBSCRIBE_ANNOUNCES_OK, error);
-  writeTrackNamespace(
-      writeBuf, subscribeAnnouncesOk.trackNamespacePrefix, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::SubscribeAnnouncesOkMessage::write(
+      writeBuf, subscribeAnnouncesOk);
 }
 
 WriteResult writeSubscribeAnnouncesError(
     folly::IOBufQueue& writeBuf,
     const SubscribeAnnouncesError& subscribeAnnouncesError) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr =
-      writeFrameHeader(writeBuf, FrameType::SUBSCRIBE_ANNOUNCES_ERROR, error);
-  writeTrackNamespace(
-      writeBuf, subscribeAnnouncesError.trackNamespacePrefix, size, error);
-  writeVarint(
-      writeBuf,
-      folly::to_underlying(subscribeAnnouncesError.errorCode),
-      size,
-      error);
-  writeFixedString(writeBuf, subscribeAnnouncesError.reasonPhrase, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::SubscribeAnnouncesErrorMessage::write(
+      writeBuf, subscribeAnnouncesError);
 }
 
 WriteResult writeUnsubscribeAnnounces(
     folly::IOBufQueue& writeBuf,
     const UnsubscribeAnnounces& unsubscribeAnnounces) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr =
-      writeFrameHeader(writeBuf, FrameType::UNSUBSCRIBE_ANNOUNCES, error);
-  writeTrackNamespace(
-      writeBuf, unsubscribeAnnounces.trackNamespacePrefix, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::UnsubscribeAnnouncesMessage::write(
+      writeBuf, unsubscribeAnnounces);
 }
 
 WriteResult writeFetch(
     folly::IOBufQueue& writeBuf,
     const Fetch& fetch) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::FETCH, error);
-  writeVarint(writeBuf, fetch.subscribeID.value, size, error);
-
-  writeBuf.append(&fetch.priority, 1);
-  size += 1;
-  auto order = folly::to_underlying(fetch.groupOrder);
-  writeBuf.append(&order, 1);
-  size += 1;
-
-  auto [standalone, joining] = fetchType(fetch);
-  if (standalone) {
-    writeVarint(
-        writeBuf, folly::to_underlying(FetchType::STANDALONE), size, error);
-    writeFullTrackName(writeBuf, fetch.fullTrackName, size, error);
-    writeVarint(writeBuf, standalone->start.group, size, error);
-    writeVarint(writeBuf, standalone->start.object, size, error);
-    writeVarint(writeBuf, standalone->end.group, size, error);
-    writeVarint(writeBuf, standalone->end.object, size, error);
-  } else {
-    CHECK(joining);
-    writeVarint(
-        writeBuf, folly::to_underlying(FetchType::JOINING), size, error);
-    writeVarint(writeBuf, joining->joiningSubscribeID.value, size, error);
-    writeVarint(writeBuf, joining->precedingGroupOffset, size, error);
-  }
-  writeTrackRequestParams(writeBuf, fetch.params, size, error);
-
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::FetchMessage::write(writeBuf, fetch);
 }
 
 WriteResult writeFetchCancel(
     folly::IOBufQueue& writeBuf,
     const FetchCancel& fetchCancel) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::FETCH_CANCEL, error);
-  writeVarint(writeBuf, fetchCancel.subscribeID.value, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::FetchCancelMessage::write(writeBuf, fetchCancel);
 }
 
 WriteResult writeFetchOk(
     folly::IOBufQueue& writeBuf,
     const FetchOk& fetchOk) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::FETCH_OK, error);
-  writeVarint(writeBuf, fetchOk.subscribeID.value, size, error);
-  auto order = folly::to_underlying(fetchOk.groupOrder);
-  writeBuf.append(&order, 1);
-  size += 1;
-  writeBuf.append(&fetchOk.endOfTrack, 1);
-  size += 1;
-  writeVarint(writeBuf, fetchOk.latestGroupAndObject.group, size, error);
-  writeVarint(writeBuf, fetchOk.latestGroupAndObject.object, size, error);
-  writeTrackRequestParams(writeBuf, fetchOk.params, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::FetchOkMessage::write(writeBuf, fetchOk);
 }
 
 WriteResult writeFetchError(
     folly::IOBufQueue& writeBuf,
     const FetchError& fetchError) noexcept {
-  size_t size = 0;
-  bool error = false;
-  auto sizePtr = writeFrameHeader(writeBuf, FrameType::FETCH_ERROR, error);
-  writeVarint(writeBuf, fetchError.subscribeID.value, size, error);
-  writeVarint(
-      writeBuf, folly::to_underlying(fetchError.errorCode), size, error);
-  writeFixedString(writeBuf, fetchError.reasonPhrase, size, error);
-  writeSize(sizePtr, size, error);
-  if (error) {
-    return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
-  }
-  return size;
+  return schema::FetchErrorMessage::write(writeBuf, fetchError);
 }
 
 namespace {
@@ -185,6 +185,9 @@ constexpr uint64_t kVersionDraft08_exp = 0xff080001; // Draft 8 no ROLE
 constexpr uint64_t kVersionDraft08 = 0xff000008; // Draft 8 no ROLE
 constexpr uint64_t kVersionDraftCurrent = kVersionDraft08;
 
+constexpr uint64_t kMaxExtensions = 16;
+constexpr uint64_t kMaxExtensionLength = 1024;
+
 struct ClientSetup {
   std::vector<uint64_t> supportedVersions;
   std::vector<SetupParameter> params;
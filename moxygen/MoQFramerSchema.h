@@ -0,0 +1,753 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQFramer.h"
+
+#include <folly/lang/Bits.h>
+
+namespace moxygen {
+
+folly::Expected<std::string, ErrorCode> parseFixedString(
+    folly::io::Cursor& cursor,
+    size_t& length);
+
+folly::Expected<std::vector<std::string>, ErrorCode> parseFixedTuple(
+    folly::io::Cursor& cursor,
+    size_t& length);
+
+folly::Expected<FullTrackName, ErrorCode> parseFullTrackName(
+    folly::io::Cursor& cursor,
+    size_t& length);
+
+folly::Expected<AbsoluteLocation, ErrorCode> parseAbsoluteLocation(
+    folly::io::Cursor& cursor,
+    size_t& length);
+
+folly::Expected<folly::Unit, ErrorCode> parseTrackRequestParams(
+    folly::io::Cursor& cursor,
+    size_t& length,
+    size_t numParams,
+    std::vector<TrackRequestParameter>& params);
+
+// Declarative control message codecs.
+//
+// A control message is described once as a list of fields, eg:
+//
+//   using FetchErrorMessage = ControlMessage<
+//       FetchError, FrameType::FETCH_ERROR,
+//       Varint<&FetchError::subscribeID>,
+//       Varint<&FetchError::errorCode>,
+//       String<&FetchError::reasonPhrase>>;
+//
+// and the exact payload size, the encoder and the bounds-checked decoder are
+// generated from it. Encoding validates every field once while sizing, then
+// writes the whole frame in a single pass into contiguous, preallocated
+// space without any per-field error checks.
+namespace schema {
+
+constexpr size_t kMaxControlMessageSize = (1 << 14) - 1;
+constexpr uint64_t kMaxVarint = 0x3fffffffffffffff;
+
+// Returns 0 for values that cannot be encoded as a QUIC varint
+constexpr size_t varintSize(uint64_t value) {
+  if (value <= 0x3f) {
+    return 1;
+  } else if (value <= 0x3fff) {
+    return 2;
+  } else if (value <= 0x3fffffff) {
+    return 4;
+  } else if (value <= kMaxVarint) {
+    return 8;
+  }
+  return 0;
+}
+
+// Caller must have validated value with varintSize
+inline uint8_t* encodeVarint(uint8_t* out, uint64_t value) {
+  switch (varintSize(value)) {
+    case 1:
+      *out = uint8_t(value);
+      return out + 1;
+    case 2: {
+      auto be = folly::Endian::big(uint16_t(0x4000 | value));
+      memcpy(out, &be, sizeof(be));
+      return out + sizeof(be);
+    }
+    case 4: {
+      auto be = folly::Endian::big(uint32_t(0x80000000 | value));
+      memcpy(out, &be, sizeof(be));
+      return out + sizeof(be);
+    }
+    default: {
+      auto be = folly::Endian::big(uint64_t(0xc000000000000000 | value));
+      memcpy(out, &be, sizeof(be));
+      return out + sizeof(be);
+    }
+  }
+}
+
+inline uint8_t* encodeString(uint8_t* out, const std::string& str) {
+  out = encodeVarint(out, str.size());
+  memcpy(out, str.data(), str.size());
+  return out + str.size();
+}
+
+inline uint64_t toVarint(uint64_t value) {
+  return value;
+}
+
+inline uint64_t toVarint(SubscribeID id) {
+  return id.value;
+}
+
+inline uint64_t toVarint(TrackAlias alias) {
+  return alias.value;
+}
+
+inline uint64_t toVarint(std::chrono::milliseconds duration) {
+  return duration.count();
+}
+
+template <class E>
+  requires std::is_enum_v<E>
+uint64_t toVarint(E value) {
+  return folly::to_underlying(value);
+}
+
+// Accumulates the payload size and whether every field is encodable
+struct Sizer {
+  size_t size{0};
+  bool valid{true};
+
+  void varint(uint64_t value) {
+    auto n = varintSize(value);
+    valid &= n > 0;
+    size += n;
+  }
+
+  void string(const std::string& str) {
+    varint(str.size());
+    size += str.size();
+  }
+
+  void trackNamespace(const TrackNamespace& trackNamespace) {
+    varint(trackNamespace.trackNamespace.size());
+    for (auto& part : trackNamespace.trackNamespace) {
+      string(part);
+    }
+  }
+
+  void location(const AbsoluteLocation& location) {
+    varint(location.group);
+    varint(location.object);
+  }
+};
+
+inline uint8_t* encodeTrackNamespace(
+    uint8_t* out,
+    const TrackNamespace& trackNamespace) {
+  out = encodeVarint(out, trackNamespace.trackNamespace.size());
+  for (auto& part : trackNamespace.trackNamespace) {
+    out = encodeString(out, part);
+  }
+  return out;
+}
+
+inline uint8_t* encodeLocation(uint8_t* out, const AbsoluteLocation& location) {
+  out = encodeVarint(out, location.group);
+  return encodeVarint(out, location.object);
+}
+
+using ParseResult = folly::Expected<folly::Unit, ErrorCode>;
+
+// Integer, ID, duration or enum encoded as a varint.  Parsed values outside
+// [Min, Max] are invalid.
+template <auto Member, uint64_t Min = 0, uint64_t Max = kMaxVarint>
+struct Varint {
+  template <class Msg>
+  static void size(const Msg& msg, Sizer& sizer) {
+    sizer.varint(toVarint(msg.*Member));
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    return encodeVarint(out, toVarint(msg.*Member));
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    auto value = quic::decodeQuicInteger(cursor, length);
+    if (!value) {
+      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+    }
+    if (value->first < Min || value->first > Max) {
+      XLOG(ERR) << "Field out of range value=" << value->first;
+      return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
+    }
+    length -= value->second;
+    using T = std::remove_cvref_t<decltype(msg.*Member)>;
+    msg.*Member = T(value->first);
+    return folly::unit;
+  }
+};
+
+// uint8_t or uint8_t enum written as a single byte.  Parsed values outside
+// [Min, Max] are invalid.
+template <auto Member, uint8_t Min = 0, uint8_t Max = 0xff>
+struct Byte {
+  template <class Msg>
+  static void size(const Msg&, Sizer& sizer) {
+    sizer.size += 1;
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    *out = uint8_t(toVarint(msg.*Member));
+    return out + 1;
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    if (length < 1) {
+      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+    }
+    auto value = cursor.readBE<uint8_t>();
+    if (value < Min || value > Max) {
+      XLOG(ERR) << "Field out of range value=" << uint32_t(value);
+      return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
+    }
+    length--;
+    using T = std::remove_cvref_t<decltype(msg.*Member)>;
+    msg.*Member = T(value);
+    return folly::unit;
+  }
+};
+
+inline const AbsoluteLocation* locationPtr(const AbsoluteLocation& location) {
+  return &location;
+}
+
+inline const AbsoluteLocation* locationPtr(
+    const folly::Optional<AbsoluteLocation>& location) {
+  return location.get_pointer();
+}
+
+// Group and object varints.  An Optional member must be set when written.
+template <auto Member>
+struct Location {
+  template <class Msg>
+  static void size(const Msg& msg, Sizer& sizer) {
+    auto location = locationPtr(msg.*Member);
+    if (!location) {
+      sizer.valid = false;
+      return;
+    }
+    sizer.location(*location);
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    return encodeLocation(out, *locationPtr(msg.*Member));
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    auto res = parseAbsoluteLocation(cursor, length);
+    if (!res) {
+      return folly::makeUnexpected(res.error());
+    }
+    msg.*Member = res.value();
+    return folly::unit;
+  }
+};
+
+// Content exists byte, followed by the location if there is one
+template <auto Member>
+struct OptionalLocation {
+  template <class Msg>
+  static void size(const Msg& msg, Sizer& sizer) {
+    sizer.size += 1;
+    if (msg.*Member) {
+      sizer.location(*(msg.*Member));
+    }
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    *out++ = (msg.*Member) ? 1 : 0;
+    if (msg.*Member) {
+      out = encodeLocation(out, *(msg.*Member));
+    }
+    return out;
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    if (length < 1) {
+      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+    }
+    auto contentExists = cursor.readBE<uint8_t>();
+    length--;
+    if (contentExists) {
+      return Location<Member>::parse(msg, cursor, length);
+    }
+    return folly::unit;
+  }
+};
+
+// Track request parameters: a count, then each key and value.  Every key
+// but AUTHORIZATION carries a length prefixed varint.
+template <auto Member>
+struct Params {
+  static bool isString(const TrackRequestParameter& param) {
+    return param.key ==
+        folly::to_underlying(TrackRequestParamKey::AUTHORIZATION);
+  }
+
+  template <class Msg>
+  static void size(const Msg& msg, Sizer& sizer) {
+    sizer.varint((msg.*Member).size());
+    for (auto& param : msg.*Member) {
+      sizer.varint(param.key);
+      if (isString(param)) {
+        sizer.string(param.asString);
+      } else {
+        sizer.varint(varintSize(param.asUint64));
+        sizer.varint(param.asUint64);
+      }
+    }
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    out = encodeVarint(out, (msg.*Member).size());
+    for (auto& param : msg.*Member) {
+      out = encodeVarint(out, param.key);
+      if (isString(param)) {
+        out = encodeString(out, param.asString);
+      } else {
+        out = encodeVarint(out, varintSize(param.asUint64));
+        out = encodeVarint(out, param.asUint64);
+      }
+    }
+    return out;
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    auto numParams = quic::decodeQuicInteger(cursor, length);
+    if (!numParams) {
+      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+    }
+    length -= numParams->second;
+    return parseTrackRequestParams(
+        cursor, length, numParams->first, msg.*Member);
+  }
+};
+
+// Field that is only present when Pred(msg) holds.  While parsing, Pred sees
+// the fields before this one.
+template <auto Pred, class Field>
+struct If {
+  template <class Msg>
+  static void size(const Msg& msg, Sizer& sizer) {
+    if (Pred(msg)) {
+      Field::size(msg, sizer);
+    }
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    return Pred(msg) ? Field::write(msg, out) : out;
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    if (Pred(msg)) {
+      return Field::parse(msg, cursor, length);
+    }
+    return folly::unit;
+  }
+};
+
+// FETCH type, then the track name and range of a standalone fetch, or the
+// subscription a joining fetch joins
+struct FetchArgs {
+  static void size(const Fetch& fetch, Sizer& sizer) {
+    auto [standalone, joining] = fetchType(fetch);
+    if (standalone) {
+      sizer.varint(folly::to_underlying(FetchType::STANDALONE));
+      sizer.trackNamespace(fetch.fullTrackName.trackNamespace);
+      sizer.string(fetch.fullTrackName.trackName);
+      sizer.location(standalone->start);
+      sizer.location(standalone->end);
+    } else {
+      sizer.varint(folly::to_underlying(FetchType::JOINING));
+      sizer.varint(joining->joiningSubscribeID.value);
+      sizer.varint(joining->precedingGroupOffset);
+    }
+  }
+
+  static uint8_t* write(const Fetch& fetch, uint8_t* out) {
+    auto [standalone, joining] = fetchType(fetch);
+    if (standalone) {
+      out = encodeVarint(out, folly::to_underlying(FetchType::STANDALONE));
+      out = encodeTrackNamespace(out, fetch.fullTrackName.trackNamespace);
+      out = encodeString(out, fetch.fullTrackName.trackName);
+      out = encodeLocation(out, standalone->start);
+      return encodeLocation(out, standalone->end);
+    }
+    out = encodeVarint(out, folly::to_underlying(FetchType::JOINING));
+    out = encodeVarint(out, joining->joiningSubscribeID.value);
+    return encodeVarint(out, joining->precedingGroupOffset);
+  }
+
+  static ParseResult
+  parse(Fetch& fetch, folly::io::Cursor& cursor, size_t& length) {
+    auto type = quic::decodeQuicInteger(cursor, length);
+    if (!type) {
+      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+    }
+    if (type->first == 0 ||
+        type->first > folly::to_underlying(FetchType::JOINING)) {
+      XLOG(ERR) << "fetchType = 0 or fetchType > JOINING =" << type->first;
+      return folly::makeUnexpected(ErrorCode::INVALID_MESSAGE);
+    }
+    length -= type->second;
+    if (FetchType(type->first) == FetchType::STANDALONE) {
+      auto ftn = parseFullTrackName(cursor, length);
+      if (!ftn) {
+        return folly::makeUnexpected(ftn.error());
+      }
+      auto start = parseAbsoluteLocation(cursor, length);
+      if (!start) {
+        return folly::makeUnexpected(start.error());
+      }
+      auto end = parseAbsoluteLocation(cursor, length);
+      if (!end) {
+        return folly::makeUnexpected(end.error());
+      }
+      fetch.fullTrackName = std::move(ftn.value());
+      fetch.args = StandaloneFetch(start.value(), end.value());
+      return folly::unit;
+    }
+    auto jsid = quic::decodeQuicInteger(cursor, length);
+    if (!jsid) {
+      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+    }
+    length -= jsid->second;
+    auto pgo = quic::decodeQuicInteger(cursor, length);
+    if (!pgo) {
+      return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+    }
+    length -= pgo->second;
+    // fetch.fullTrackName stays empty, the session fills it in
+    fetch.args = JoiningFetch(SubscribeID(jsid->first), pgo->first);
+    return folly::unit;
+  }
+};
+
+// Length prefixed string
+template <auto Member>
+struct String {
+  template <class Msg>
+  static void size(const Msg& msg, Sizer& sizer) {
+    sizer.string(msg.*Member);
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    return encodeString(out, msg.*Member);
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    auto res = parseFixedString(cursor, length);
+    if (!res) {
+      return folly::makeUnexpected(res.error());
+    }
+    msg.*Member = std::move(res.value());
+    return folly::unit;
+  }
+};
+
+// TrackNamespace tuple
+template <auto Member>
+struct Namespace {
+  template <class Msg>
+  static void size(const Msg& msg, Sizer& sizer) {
+    sizer.trackNamespace(msg.*Member);
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    return encodeTrackNamespace(out, msg.*Member);
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    auto res = parseFixedTuple(cursor, length);
+    if (!res) {
+      return folly::makeUnexpected(res.error());
+    }
+    msg.*Member = TrackNamespace(std::move(res.value()));
+    return folly::unit;
+  }
+};
+
+// TrackNamespace tuple followed by the track name
+template <auto Member>
+struct FullName {
+  template <class Msg>
+  static void size(const Msg& msg, Sizer& sizer) {
+    sizer.trackNamespace((msg.*Member).trackNamespace);
+    sizer.string((msg.*Member).trackName);
+  }
+
+  template <class Msg>
+  static uint8_t* write(const Msg& msg, uint8_t* out) {
+    out = encodeTrackNamespace(out, (msg.*Member).trackNamespace);
+    return encodeString(out, (msg.*Member).trackName);
+  }
+
+  template <class Msg>
+  static ParseResult
+  parse(Msg& msg, folly::io::Cursor& cursor, size_t& length) {
+    auto res = parseFullTrackName(cursor, length);
+    if (!res) {
+      return folly::makeUnexpected(res.error());
+    }
+    msg.*Member = std::move(res.value());
+    return folly::unit;
+  }
+};
+
+template <class Msg, FrameType Type, class... Fields>
+struct ControlMessage {
+  static constexpr uint64_t kFrameType = folly::to_underlying(Type);
+
+  // Exact payload size (excluding type and length), or none if a field
+  // cannot be encoded
+  static folly::Optional<size_t> payloadSize(const Msg& msg) {
+    Sizer sizer;
+    (Fields::size(msg, sizer), ...);
+    if (!sizer.valid) {
+      return folly::none;
+    }
+    return sizer.size;
+  }
+
+  static WriteResult write(
+      folly::IOBufQueue& writeBuf,
+      const Msg& msg) noexcept {
+    auto size = payloadSize(msg);
+    if (!size || *size > kMaxControlMessageSize) {
+      XLOG(ERR) << "Unencodable control message type=" << Type
+                << " sz=" << size.value_or(0);
+      return folly::makeUnexpected(quic::TransportErrorCode::INTERNAL_ERROR);
+    }
+    auto total = varintSize(kFrameType) + 2 + *size;
+    auto space = writeBuf.preallocate(total, std::max<size_t>(total, 256));
+    auto start = static_cast<uint8_t*>(space.first);
+    auto out = encodeVarint(start, kFrameType);
+    auto lengthBE = folly::Endian::big(uint16_t(0x4000 | *size));
+    memcpy(out, &lengthBE, sizeof(lengthBE));
+    out += sizeof(lengthBE);
+    ((out = Fields::write(msg, out)), ...);
+    XDCHECK_EQ(size_t(out - start), total);
+    writeBuf.postallocate(total);
+    return *size;
+  }
+
+  static folly::Expected<Msg, ErrorCode> parse(
+      folly::io::Cursor& cursor,
+      size_t length) noexcept {
+    Msg msg;
+    ParseResult res = folly::unit;
+    ((res = Fields::parse(msg, cursor, length)).hasValue() && ...);
+    if (res.hasError()) {
+      return folly::makeUnexpected(res.error());
+    }
+    return msg;
+  }
+};
+
+inline bool hasStart(const SubscribeRequest& subscribeRequest) {
+  return subscribeRequest.locType == LocationType::AbsoluteStart ||
+      subscribeRequest.locType == LocationType::AbsoluteRange;
+}
+
+inline bool hasEndGroup(const SubscribeRequest& subscribeRequest) {
+  return subscribeRequest.locType == LocationType::AbsoluteRange;
+}
+
+constexpr uint8_t kMaxGroupOrder =
+    folly::to_underlying(GroupOrder::NewestFirst);
+
+using SubscribeRequestMessage = ControlMessage<
+    SubscribeRequest,
+    FrameType::SUBSCRIBE,
+    Varint<&SubscribeRequest::subscribeID>,
+    Varint<&SubscribeRequest::trackAlias>,
+    FullName<&SubscribeRequest::fullTrackName>,
+    Byte<&SubscribeRequest::priority>,
+    Byte<&SubscribeRequest::groupOrder, 0, kMaxGroupOrder>,
+    Varint<
+        &SubscribeRequest::locType,
+        0,
+        folly::to_underlying(LocationType::AbsoluteRange)>,
+    If<&hasStart, Location<&SubscribeRequest::start>>,
+    If<&hasEndGroup, Varint<&SubscribeRequest::endGroup>>,
+    Params<&SubscribeRequest::params>>;
+
+using SubscribeUpdateMessage = ControlMessage<
+    SubscribeUpdate,
+    FrameType::SUBSCRIBE_UPDATE,
+    Varint<&SubscribeUpdate::subscribeID>,
+    Location<&SubscribeUpdate::start>,
+    Varint<&SubscribeUpdate::endGroup>,
+    Byte<&SubscribeUpdate::priority>,
+    Params<&SubscribeUpdate::params>>;
+
+// Default is not a valid SUBSCRIBE_OK group order
+using SubscribeOkMessage = ControlMessage<
+    SubscribeOk,
+    FrameType::SUBSCRIBE_OK,
+    Varint<&SubscribeOk::subscribeID>,
+    Varint<&SubscribeOk::expires>,
+    Byte<&SubscribeOk::groupOrder, 1, kMaxGroupOrder>,
+    OptionalLocation<&SubscribeOk::latest>,
+    Params<&SubscribeOk::params>>;
+
+using SubscribeDoneMessage = ControlMessage<
+    SubscribeDone,
+    FrameType::SUBSCRIBE_DONE,
+    Varint<&SubscribeDone::subscribeID>,
+    Varint<&SubscribeDone::statusCode>,
+    Varint<&SubscribeDone::streamCount>,
+    String<&SubscribeDone::reasonPhrase>,
+    OptionalLocation<&SubscribeDone::finalObject>>;
+
+using AnnounceMessage = ControlMessage<
+    Announce,
+    FrameType::ANNOUNCE,
+    Namespace<&Announce::trackNamespace>,
+    Params<&Announce::params>>;
+
+using SubscribeAnnouncesMessage = ControlMessage<
+    SubscribeAnnounces,
+    FrameType::SUBSCRIBE_ANNOUNCES,
+    Namespace<&SubscribeAnnounces::trackNamespacePrefix>,
+    Params<&SubscribeAnnounces::params>>;
+
+using FetchMessage = ControlMessage<
+    Fetch,
+    FrameType::FETCH,
+    Varint<&Fetch::subscribeID>,
+    Byte<&Fetch::priority>,
+    Byte<&Fetch::groupOrder, 0, kMaxGroupOrder>,
+    FetchArgs,
+    Params<&Fetch::params>>;
+
+using FetchOkMessage = ControlMessage<
+    FetchOk,
+    FrameType::FETCH_OK,
+    Varint<&FetchOk::subscribeID>,
+    Byte<&FetchOk::groupOrder, 0, kMaxGroupOrder>,
+    Byte<&FetchOk::endOfTrack>,
+    Location<&FetchOk::latestGroupAndObject>,
+    Params<&FetchOk::params>>;
+
+using UnsubscribeMessage = ControlMessage<
+    Unsubscribe,
+    FrameType::UNSUBSCRIBE,
+    Varint<&Unsubscribe::subscribeID>>;
+
+using MaxSubscribeIdMessage = ControlMessage<
+    MaxSubscribeId,
+    FrameType::MAX_SUBSCRIBE_ID,
+    Varint<&MaxSubscribeId::subscribeID>>;
+
+using SubscribesBlockedMessage = ControlMessage<
+    SubscribesBlocked,
+    FrameType::SUBSCRIBES_BLOCKED,
+    Varint<&SubscribesBlocked::maxSubscribeID>>;
+
+using AnnounceOkMessage = ControlMessage<
+    AnnounceOk,
+    FrameType::ANNOUNCE_OK,
+    Namespace<&AnnounceOk::trackNamespace>>;
+
+using AnnounceErrorMessage = ControlMessage<
+    AnnounceError,
+    FrameType::ANNOUNCE_ERROR,
+    Namespace<&AnnounceError::trackNamespace>,
+    Varint<&AnnounceError::errorCode>,
+    String<&AnnounceError::reasonPhrase>>;
+
+using UnannounceMessage = ControlMessage<
+    Unannounce,
+    FrameType::UNANNOUNCE,
+    Namespace<&Unannounce::trackNamespace>>;
+
+using AnnounceCancelMessage = ControlMessage<
+    AnnounceCancel,
+    FrameType::ANNOUNCE_CANCEL,
+    Namespace<&AnnounceCancel::trackNamespace>,
+    Varint<&AnnounceCancel::errorCode>,
+    String<&AnnounceCancel::reasonPhrase>>;
+
+using TrackStatusRequestMessage = ControlMessage<
+    TrackStatusRequest,
+    FrameType::TRACK_STATUS_REQUEST,
+    FullName<&TrackStatusRequest::fullTrackName>>;
+
+using GoawayMessage = ControlMessage<
+    Goaway,
+    FrameType::GOAWAY,
+    String<&Goaway::newSessionUri>>;
+
+using SubscribeAnnouncesOkMessage = ControlMessage<
+    SubscribeAnnouncesOk,
+    FrameType::SUBSCRIBE_ANNOUNCES_OK,
+    Namespace<&SubscribeAnnouncesOk::trackNamespacePrefix>>;
+
+using SubscribeAnnouncesErrorMessage = ControlMessage<
+    SubscribeAnnouncesError,
+    FrameType::SUBSCRIBE_ANNOUNCES_ERROR,
+    Namespace<&SubscribeAnnouncesError::trackNamespacePrefix>,
+    Varint<&SubscribeAnnouncesError::errorCode>,
+    String<&SubscribeAnnouncesError::reasonPhrase>>;
+
+using UnsubscribeAnnouncesMessage = ControlMessage<
+    UnsubscribeAnnounces,
+    FrameType::UNSUBSCRIBE_ANNOUNCES,
+    Namespace<&UnsubscribeAnnounces::trackNamespacePrefix>>;
+
+using FetchCancelMessage = ControlMessage<
+    FetchCancel,
+    FrameType::FETCH_CANCEL,
+    Varint<&FetchCancel::subscribeID>>;
+
+using FetchErrorMessage = ControlMessage<
+    FetchError,
+    FrameType::FETCH_ERROR,
+    Varint<&FetchError::subscribeID>,
+    Varint<&FetchError::errorCode>,
+    String<&FetchError::reasonPhrase>>;
+
+} // namespace schema
+} // namespace moxygen
@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/MoQResilientClient.h"
+
+#include <folly/ScopeGuard.h>
+#include <folly/coro/Collect.h>
+#include <folly/coro/Sleep.h>
+#include <folly/logging/xlog.h>
+#include <quic/fizz/client/handshake/QuicPskCache.h>
+
+namespace {
+using namespace moxygen;
+
+uint64_t payloadLength(const Payload& payload) {
+  return payload ? payload->computeChainDataLength() : 0;
+}
+
+// Drops objects the track consumer has already delivered.  downstream is null
+// when the whole group precedes the resume point.
+class ResumableSubgroupConsumer : public SubgroupConsumer {
+ public:
+  ResumableSubgroupConsumer(
+      std::shared_ptr<ResumableTrackConsumer> track,
+      uint64_t group,
+      std::shared_ptr<SubgroupConsumer> downstream)
+      : track_(std::move(track)),
+        group_(group),
+        downstream_(std::move(downstream)) {}
+
+  folly::Expected<folly::Unit, MoQPublishError> object(
+      uint64_t objectID,
+      Payload payload,
+      Extensions extensions,
+      bool finSubgroup) override {
+    if (!downstream_ || track_->isDuplicate({group_, objectID})) {
+      return finSubgroup ? endOfSubgroup() : folly::unit;
+    }
+    auto res = downstream_->object(
+        objectID, std::move(payload), std::move(extensions), finSubgroup);
+    if (res) {
+      track_->onDelivered({group_, objectID});
+    }
+    return res;
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> objectNotExists(
+      uint64_t objectID,
+      Extensions extensions,
+      bool finSubgroup) override {
+    if (!downstream_ || track_->isDuplicate({group_, objectID})) {
+      return finSubgroup ? endOfSubgroup() : folly::unit;
+    }
+    auto res = downstream_->objectNotExists(
+        objectID, std::move(extensions), finSubgroup);
+    if (res) {
+      track_->onDelivered({group_, objectID});
+    }
+    return res;
+  }
+
+  void checkpoint() override {
+    if (downstream_) {
+      downstream_->checkpoint();
+    }
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> beginObject(
+      uint64_t objectID,
+      uint64_t length,
+      Payload initialPayload,
+      Extensions extensions) override {
+    curObjectID_ = objectID;
+    if (!downstream_ || track_->isDuplicate({group_, objectID})) {
+      skipRemaining_ = length - payloadLength(initialPayload);
+      skipping_ = skipRemaining_ > 0;
+      return folly::unit;
+    }
+    return downstream_->beginObject(
+        objectID, length, std::move(initialPayload), std::move(extensions));
+  }
+
+  folly::Expected<ObjectPublishStatus, MoQPublishError> objectPayload(
+      Payload payload,
+      bool finSubgroup) override {
+    if (skipping_) {
+      skipRemaining_ -= std::min(skipRemaining_, payloadLength(payload));
+      skipping_ = skipRemaining_ > 0;
+      if (finSubgroup) {
+        auto res = endOfSubgroup();
+        if (!res) {
+          return folly::makeUnexpected(res.error());
+        }
+      }
+      return skipping_ ? ObjectPublishStatus::IN_PROGRESS
+                       : ObjectPublishStatus::DONE;
+    }
+    auto res = downstream_->objectPayload(std::move(payload), finSubgroup);
+    if (res && *res == ObjectPublishStatus::DONE) {
+      track_->onDelivered({group_, curObjectID_});
+    }
+    return res;
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> endOfGroup(
+      uint64_t endOfGroupObjectID,
+      Extensions extensions) override {
+    if (!downstream_ || track_->isDuplicate({group_, endOfGroupObjectID})) {
+      return endOfSubgroup();
+    }
+    track_->onDelivered({group_, endOfGroupObjectID});
+    return downstream_->endOfGroup(endOfGroupObjectID, std::move(extensions));
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> endOfTrackAndGroup(
+      uint64_t endOfTrackObjectID,
+      Extensions extensions) override {
+    if (!downstream_ || track_->isDuplicate({group_, endOfTrackObjectID})) {
+      return endOfSubgroup();
+    }
+    track_->onDelivered({group_, endOfTrackObjectID});
+    return downstream_->endOfTrackAndGroup(
+        endOfTrackObjectID, std::move(extensions));
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> endOfSubgroup() override {
+    if (!downstream_) {
+      return folly::unit;
+    }
+    return downstream_->endOfSubgroup();
+  }
+
+  void reset(ResetStreamErrorCode error) override {
+    if (downstream_) {
+      downstream_->reset(error);
+    }
+  }
+
+ private:
+  std::shared_ptr<ResumableTrackConsumer> track_;
+  uint64_t group_;
+  std::shared_ptr<SubgroupConsumer> downstream_;
+  uint64_t curObjectID_{0};
+  uint64_t skipRemaining_{0};
+  bool skipping_{false};
+};
+
+} // namespace
+
+namespace moxygen {
+
+folly::Optional<AbsoluteLocation> ResumableTrackConsumer::resume() {
+  if (largest_) {
+    resumeFrom_ = AbsoluteLocation{largest_->group, largest_->object + 1};
+  }
+  return resumeFrom_;
+}
+
+folly::Expected<std::shared_ptr<SubgroupConsumer>, MoQPublishError>
+ResumableTrackConsumer::beginSubgroup(
+    uint64_t groupID,
+    uint64_t subgroupID,
+    Priority priority) {
+  std::shared_ptr<SubgroupConsumer> downstream;
+  if (!resumeFrom_ || groupID >= resumeFrom_->group) {
+    auto res = downstream_->beginSubgroup(groupID, subgroupID, priority);
+    if (!res) {
+      return res;
+    }
+    downstream = std::move(res.value());
+  }
+  return std::make_shared<ResumableSubgroupConsumer>(
+      shared_from_this(), groupID, std::move(downstream));
+}
+
+folly::Expected<folly::Unit, MoQPublishError>
+ResumableTrackConsumer::objectStream(
+    const ObjectHeader& header,
+    Payload payload) {
+  if (isDuplicate({header.group, header.id})) {
+    return folly::unit;
+  }
+  auto res = downstream_->objectStream(header, std::move(payload));
+  if (res) {
+    onDelivered({header.group, header.id});
+  }
+  return res;
+}
+
+folly::Expected<folly::Unit, MoQPublishError> ResumableTrackConsumer::datagram(
+    const ObjectHeader& header,
+    Payload payload) {
+  if (isDuplicate({header.group, header.id})) {
+    return folly::unit;
+  }
+  auto res = downstream_->datagram(header, std::move(payload));
+  if (res) {
+    onDelivered({header.group, header.id});
+  }
+  return res;
+}
+
+folly::Expected<folly::Unit, MoQPublishError>
+ResumableTrackConsumer::groupNotExists(
+    uint64_t groupID,
+    uint64_t subgroup,
+    Priority pri,
+    Extensions extensions) {
+  if (resumeFrom_ && groupID < resumeFrom_->group) {
+    return folly::unit;
+  }
+  return downstream_->groupNotExists(
+      groupID, subgroup, pri, std::move(extensions));
+}
+
+folly::Expected<folly::Unit, MoQPublishError>
+ResumableTrackConsumer::subscribeDone(SubscribeDone subDone) {
+  if (resumable_ &&
+      subDone.statusCode == SubscribeDoneStatusCode::SESSION_CLOSED) {
+    XLOG(DBG1) << "Holding subscription for resume, largest="
+               << (largest_ ? largest_->group : 0) << ","
+               << (largest_ ? largest_->object : 0);
+    return folly::unit;
+  }
+  done_ = true;
+  return downstream_->subscribeDone(std::move(subDone));
+}
+
+// Handle returned to the application.  It outlives the per-session handles
+// and forwards to whichever one is current.
+class MoQResilientClient::Subscription : public Publisher::SubscriptionHandle {
+ public:
+  Subscription(
+      std::weak_ptr<MoQResilientClient> client,
+      SubscribeRequest request,
+      std::shared_ptr<ResumableTrackConsumer> consumer,
+      std::shared_ptr<Publisher::SubscriptionHandle> handle)
+      : Publisher::SubscriptionHandle(handle->subscribeOk()),
+        client_(std::move(client)),
+        request_(std::move(request)),
+        consumer_(std::move(consumer)),
+        handle_(std::move(handle)) {}
+
+  void unsubscribe() override {
+    consumer_->setResumable(false);
+    if (auto client = client_.lock()) {
+      client->removeSubscription(this);
+    }
+    if (handle_) {
+      handle_->unsubscribe();
+      handle_.reset();
+    }
+  }
+
+  void subscribeUpdate(SubscribeUpdate subUpdate) override {
+    // Resubscribes carry the updated range and priority
+    request_.endGroup = subUpdate.endGroup;
+    request_.priority = subUpdate.priority;
+    if (handle_) {
+      subUpdate.subscribeID = handle_->subscribeOk().subscribeID;
+      handle_->subscribeUpdate(std::move(subUpdate));
+    }
+  }
+
+  // The request for the next session, starting after the last delivered
+  // object
+  SubscribeRequest resumeRequest() {
+    auto request = request_;
+    auto start = consumer_->resume();
+    if (start) {
+      if (request.locType != LocationType::AbsoluteRange) {
+        request.locType = LocationType::AbsoluteStart;
+      }
+      request.start = start;
+    }
+    return request;
+  }
+
+  void setHandle(std::shared_ptr<Publisher::SubscriptionHandle> handle) {
+    setSubscribeOk(handle->subscribeOk());
+    handle_ = std::move(handle);
+  }
+
+  const std::shared_ptr<ResumableTrackConsumer>& consumer() const {
+    return consumer_;
+  }
+
+ private:
+  std::weak_ptr<MoQResilientClient> client_;
+  SubscribeRequest request_;
+  std::shared_ptr<ResumableTrackConsumer> consumer_;
+  std::shared_ptr<Publisher::SubscriptionHandle> handle_;
+};
+
+MoQResilientClient::MoQResilientClient(
+    folly::EventBase* evb,
+    proxygen::URL url,
+    MoQClient::TransportType ttype,
+    Options options)
+    : evb_(evb),
+      url_(std::move(url)),
+      transportType_(ttype),
+      options_(options),
+      pskCache_(std::make_shared<quic::BasicQuicPskCache>()) {}
+
+MoQResilientClient::~MoQResilientClient() {
+  closed_ = true;
+  sessionEndCallback_.reset();
+}
+
+folly::coro::Task<void> MoQResilientClient::connect(
+    std::shared_ptr<Publisher> publishHandler,
+    std::shared_ptr<Subscriber> subscribeHandler) {
+  publishHandler_ = std::move(publishHandler);
+  subscribeHandler_ = std::move(subscribeHandler);
+  co_await connectOnce();
+}
+
+folly::coro::Task<void> MoQResilientClient::connectOnce() {
+  if (options_.race) {
+    auto client = co_await MoQClient::connectRacing(
+        evb_,
+        url_,
+        *options_.race,
+        options_.connectTimeout,
+        options_.transactionTimeout,
+        publishHandler_,
+        subscribeHandler_,
+        pskCache_);
+    if (!client->moqSession_) {
+      co_yield folly::coro::co_error(
+          std::runtime_error("Session ended during setup"));
+    }
+    sessionEndCallback_.reset();
+    client_ = std::move(client);
+    watchSession();
+    co_return;
+  }
+  auto client = std::make_unique<MoQClient>(evb_, url_, transportType_);
+  client->setPskCache(pskCache_);
+  client->setTransportConfig(options_.transportConfig);
+  auto res = co_await co_awaitTry(client->setupMoQSession(
+      options_.connectTimeout,
+      options_.transactionTimeout,
+      publishHandler_,
+      subscribeHandler_));
+  if (res.hasException() || !client->moqSession_) {
+    if (client->moqSession_) {
+      client->moqSession_->close(SessionCloseErrorCode::INTERNAL_ERROR);
+    }
+    if (res.hasException()) {
+      co_yield folly::coro::co_error(std::move(res.exception()));
+    }
+    co_yield folly::coro::co_error(
+        std::runtime_error("Session ended during setup"));
+  }
+  sessionEndCallback_.reset();
+  client_ = std::move(client);
+  watchSession();
+}
+
+void MoQResilientClient::watchSession() {
+  // The session requests cancellation however it ends: peer close, transport
+  // error or a local protocol error
+  sessionEndCallback_ = std::make_unique<folly::CancellationCallback>(
+      client_->moqSession_->getCancelToken(), [this] { onSessionEnd(); });
+}
+
+void MoQResilientClient::onSessionEnd() {
+  if (closed_ || reconnecting_) {
+    return;
+  }
+  XLOG(INFO) << "Session ended, reconnecting to " << url_.getUrl();
+  reconnecting_ = true;
+  reconnect().scheduleOn(evb_).start();
+}
+
+folly::coro::Task<void> MoQResilientClient::reconnect() {
+  auto self = shared_from_this();
+  auto g = folly::makeGuard([this] { reconnecting_ = false; });
+  auto backoff = options_.minBackoff;
+  for (uint32_t attempt = 1; !closed_; attempt++) {
+    auto res = co_await co_awaitTry(connectOnce());
+    if (closed_) {
+      break;
+    }
+    if (!res.hasException()) {
+      reconnects_++;
+      XLOG(INFO) << "Reconnected after attempts=" << attempt
+                 << ", resubscribing tracks=" << subscriptions_.size();
+      std::erase_if(subscriptions_, [](const auto& sub) {
+        return sub->consumer()->done();
+      });
+      std::vector<folly::coro::Task<void>> resubscribes;
+      for (auto& sub : subscriptions_) {
+        resubscribes.push_back(resubscribe(sub));
+      }
+      co_await folly::coro::collectAllRange(std::move(resubscribes));
+      co_return;
+    }
+    XLOG(ERR) << "Reconnect attempt=" << attempt
+              << " failed: " << folly::exceptionStr(res.exception());
+    if (options_.maxReconnectAttempts > 0 &&
+        attempt >= options_.maxReconnectAttempts) {
+      break;
+    }
+    co_await folly::coro::sleep(backoff);
+    backoff = std::min(backoff * 2, options_.maxBackoff);
+  }
+  // Giving up, end every subscription
+  auto subscriptions = std::move(subscriptions_);
+  for (auto& sub : subscriptions) {
+    sub->consumer()->setResumable(false);
+    sub->consumer()->subscribeDone(
+        {sub->subscribeOk().subscribeID,
+         SubscribeDoneStatusCode::SESSION_CLOSED,
+         0,
+         "reconnect failed",
+         folly::none});
+  }
+}
+
+folly::coro::Task<void> MoQResilientClient::resubscribe(
+    std::shared_ptr<Subscription> sub) {
+  auto request = sub->resumeRequest();
+  auto session = getSession();
+  if (!session) {
+    co_return;
+  }
+  auto res = co_await session->subscribe(request, sub->consumer());
+  if (res) {
+    sub->setHandle(std::move(res.value()));
+    co_return;
+  }
+  XLOG(ERR) << "Resubscribe failed ftn=" << request.fullTrackName
+            << " code=" << folly::to_underlying(res.error().errorCode)
+            << " reason=" << res.error().reasonPhrase;
+  removeSubscription(sub.get());
+  sub->consumer()->setResumable(false);
+  sub->consumer()->subscribeDone(
+      {sub->subscribeOk().subscribeID,
+       SubscribeDoneStatusCode::INTERNAL_ERROR,
+       0,
+       res.error().reasonPhrase,
+       folly::none});
+}
+
+folly::coro::Task<Publisher::SubscribeResult> MoQResilientClient::subscribe(
+    SubscribeRequest sub,
+    std::shared_ptr<TrackConsumer> consumer) {
+  auto session = getSession();
+  if (!session) {
+    co_return folly::makeUnexpected(SubscribeError{
+        sub.subscribeID,
+        SubscribeErrorCode::INTERNAL_ERROR,
+        "Not connected",
+        folly::none});
+  }
+  auto resumable =
+      std::make_shared<ResumableTrackConsumer>(std::move(consumer));
+  auto res = co_await session->subscribe(sub, resumable);
+  if (!res) {
+    co_return folly::makeUnexpected(res.error());
+  }
+  auto subscription = std::make_shared<Subscription>(
+      weak_from_this(),
+      std::move(sub),
+      std::move(resumable),
+      std::move(res.value()));
+  subscriptions_.push_back(subscription);
+  co_return subscription;
+}
+
+void MoQResilientClient::removeSubscription(const Subscription* sub) {
+  std::erase_if(
+      subscriptions_, [sub](const auto& s) { return s.get() == sub; });
+}
+
+void MoQResilientClient::close() {
+  closed_ = true;
+  for (auto& sub : subscriptions_) {
+    sub->consumer()->setResumable(false);
+  }
+  subscriptions_.clear();
+  sessionEndCallback_.reset();
+  if (auto session = getSession()) {
+    session->close(SessionCloseErrorCode::NO_ERROR);
+  }
+}
+
+} // namespace moxygen
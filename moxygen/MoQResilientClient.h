@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQClient.h"
+
+#include <folly/CancellationToken.h>
+
+namespace moxygen {
+
+// TrackConsumer that survives the session carrying it.
+//
+// Records the largest object delivered downstream.  After resume() the
+// subscription is re-issued from the following object, and anything the new
+// subscription repeats below that point is dropped before reaching the
+// downstream consumer.  SUBSCRIBE_DONE with SESSION_CLOSED is swallowed while
+// the subscription is resumable.
+class ResumableTrackConsumer
+    : public TrackConsumer,
+      public std::enable_shared_from_this<ResumableTrackConsumer> {
+ public:
+  explicit ResumableTrackConsumer(std::shared_ptr<TrackConsumer> downstream)
+      : downstream_(std::move(downstream)) {}
+
+  // Returns where a new subscription should start, or none if nothing has
+  // been delivered yet.  Objects before this point are dropped from now on.
+  folly::Optional<AbsoluteLocation> resume();
+
+  // Stop swallowing SESSION_CLOSED, ie: the subscription is being torn down
+  void setResumable(bool resumable) {
+    resumable_ = resumable;
+  }
+
+  // True once a SUBSCRIBE_DONE was delivered downstream
+  bool done() const {
+    return done_;
+  }
+
+  const folly::Optional<AbsoluteLocation>& largestDelivered() const {
+    return largest_;
+  }
+
+  folly::Expected<std::shared_ptr<SubgroupConsumer>, MoQPublishError>
+  beginSubgroup(uint64_t groupID, uint64_t subgroupID, Priority priority)
+      override;
+
+  folly::Expected<folly::SemiFuture<folly::Unit>, MoQPublishError>
+  awaitStreamCredit() override {
+    return downstream_->awaitStreamCredit();
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> objectStream(
+      const ObjectHeader& header,
+      Payload payload) override;
+
+  folly::Expected<folly::Unit, MoQPublishError> datagram(
+      const ObjectHeader& header,
+      Payload payload) override;
+
+  folly::Expected<folly::Unit, MoQPublishError> groupNotExists(
+      uint64_t groupID,
+      uint64_t subgroup,
+      Priority pri,
+      Extensions extensions) override;
+
+  folly::Expected<folly::Unit, MoQPublishError> subscribeDone(
+      SubscribeDone subDone) override;
+
+  bool isDuplicate(AbsoluteLocation location) const {
+    return resumeFrom_ && location < *resumeFrom_;
+  }
+
+  void onDelivered(AbsoluteLocation location) {
+    if (!largest_ || *largest_ < location) {
+      largest_ = location;
+    }
+  }
+
+ private:
+  std::shared_ptr<TrackConsumer> downstream_;
+  folly::Optional<AbsoluteLocation> largest_;
+  folly::Optional<AbsoluteLocation> resumeFrom_;
+  bool resumable_{true};
+  bool done_{false};
+};
+
+// MoQClient wrapper that reconnects when the session ends.
+//
+// The QUIC resumption ticket from each connection is cached, so reconnects
+// send CLIENT_SETUP as 0-RTT.  Subscriptions made through subscribe() are
+// re-issued on the new session from just after the last delivered object,
+// all in parallel, and the TrackConsumer never sees a duplicate object.
+// Must be owned by a shared_ptr.
+class MoQResilientClient
+    : public std::enable_shared_from_this<MoQResilientClient> {
+ public:
+  struct Options {
+    std::chrono::milliseconds connectTimeout{std::chrono::seconds(5)};
+    std::chrono::milliseconds transactionTimeout{std::chrono::seconds(60)};
+    std::chrono::milliseconds minBackoff{std::chrono::milliseconds(100)};
+    std::chrono::milliseconds maxBackoff{std::chrono::seconds(10)};
+    // 0 retries forever
+    uint32_t maxReconnectAttempts{0};
+    // When set every connect races these transports and addresses with
+    // MoQClient::connectRacing, and ttype is ignored
+    folly::Optional<MoQClient::RaceOptions> race;
+    // For every connection, when not racing
+    TransportConfig transportConfig;
+  };
+
+  MoQResilientClient(
+      folly::EventBase* evb,
+      proxygen::URL url,
+      MoQClient::TransportType ttype =
+          MoQClient::TransportType::H3_WEBTRANSPORT,
+      Options options = Options());
+
+  ~MoQResilientClient();
+
+  // Initial connection, throws on failure like MoQClient::setupMoQSession.
+  // The handlers are reinstalled on every reconnected session.
+  folly::coro::Task<void> connect(
+      std::shared_ptr<Publisher> publishHandler,
+      std::shared_ptr<Subscriber> subscribeHandler);
+
+  // Subscribes on the current session and keeps the subscription alive
+  // across reconnects until it is unsubscribed or the publisher ends it.
+  folly::coro::Task<Publisher::SubscribeResult> subscribe(
+      SubscribeRequest sub,
+      std::shared_ptr<TrackConsumer> consumer);
+
+  // Stops reconnecting and closes the current session
+  void close();
+
+  std::shared_ptr<MoQSession> getSession() const {
+    return client_ ? client_->moqSession_ : nullptr;
+  }
+
+  uint64_t reconnectCount() const {
+    return reconnects_;
+  }
+
+ private:
+  class Subscription;
+
+  folly::coro::Task<void> connectOnce();
+  void watchSession();
+  void onSessionEnd();
+  folly::coro::Task<void> reconnect();
+  folly::coro::Task<void> resubscribe(std::shared_ptr<Subscription> sub);
+  void removeSubscription(const Subscription* sub);
+
+  folly::EventBase* evb_;
+  proxygen::URL url_;
+  MoQClient::TransportType transportType_;
+  Options options_;
+  std::shared_ptr<quic::QuicPskCache> pskCache_;
+  std::unique_ptr<MoQClient> client_;
+  std::unique_ptr<folly::CancellationCallback> sessionEndCallback_;
+  std::shared_ptr<Publisher> publishHandler_;
+  std::shared_ptr<Subscriber> subscribeHandler_;
+  std::vector<std::shared_ptr<Subscription>> subscriptions_;
+  bool reconnecting_{false};
+  bool closed_{false};
+  uint64_t reconnects_{0};
+};
+
+} // namespace moxygen
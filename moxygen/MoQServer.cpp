@@ -16,7 +16,8 @@ MoQServer::MoQServer(
     uint16_t port,
     std::string cert,
     std::string key,
-    std::string endpoint)
+    std::string endpoint,
+    const TransportConfig& transportConfig)
     : endpoint_(endpoint) {
   params_.localAddress.emplace();
   params_.localAddress->setFromLocalPort(port);
@@ -25,6 +26,7 @@ MoQServer::MoQServer(
   params_.keyFilePath = key;
   params_.txnTimeout = std::chrono::seconds(60);
   params_.supportedAlpns = {"h3", "moq-00"};
+  transportConfig.apply(params_.transportSettings);
   auto factory = std::make_unique<HQServerTransportFactory>(
       params_, [this](HTTPMessage*) { return new Handler(*this); }, nullptr);
   factory->addAlpnHandler(
@@ -41,6 +43,7 @@ MoQServer::MoQServer(
 void MoQServer::createMoQQuicSession(
     std::shared_ptr<quic::QuicSocket> quicSocket) {
   auto qevb = quicSocket->getEventBase();
+  std::weak_ptr<quic::QuicSocket> weakSock = quicSocket;
   auto quicWebTransport =
       std::make_shared<proxygen::QuicWebTransport>(std::move(quicSocket));
   auto qWtPtr = quicWebTransport.get();
@@ -51,6 +54,8 @@ void MoQServer::createMoQQuicSession(
               ->getBackingEventBase();
   }
   auto moqSession = std::make_shared<MoQSession>(wt, *this, evb);
+  moqSession->setTransportMetricsProvider(
+      makeQuicMetricsProvider(std::move(weakSock)));
   qWtPtr->setHandler(moqSession.get());
   // the handleClientSession coro this session moqSession
   handleClientSession(std::move(moqSession)).scheduleOn(evb).start();
@@ -112,6 +117,7 @@ void MoQServer::Handler::onHeadersComplete(
   }
   auto evb = folly::EventBaseManager::get()->getEventBase();
   clientSession_ = std::make_shared<MoQSession>(wt, server_, evb);
+  clientSession_->setTransportMetricsProvider(makeHTTPMetricsProvider(txn_));
 
   server_.handleClientSession(clientSession_).scheduleOn(evb).start();
 }
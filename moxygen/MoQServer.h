@@ -12,6 +12,8 @@
 #include <folly/io/async/EventBaseManager.h>
 
 #include "moxygen/MoQSession.h"
+#include "moxygen/util/MemoryAccounting.h"
+#include "moxygen/util/TransportProfile.h"
 
 namespace moxygen {
 
@@ -21,7 +23,9 @@ class MoQServer : public MoQSession::ServerSetupCallback {
       uint16_t port,
       std::string cert,
       std::string key,
-      std::string endpoint);
+      std::string endpoint,
+      // Applied to every accepted QUIC connection
+      const TransportConfig& transportConfig = TransportConfig());
   MoQServer(const MoQServer&) = delete;
   MoQServer(MoQServer&&) = delete;
   MoQServer& operator=(const MoQServer&) = delete;
@@ -36,6 +40,18 @@ class MoQServer : public MoQSession::ServerSetupCallback {
     return hqServer_->getWorkerEvbs();
   }
 
+  // Monitors loop lag on every worker EventBase and reports to callback
+  void setLoopStatsCallback(
+      std::shared_ptr<MoQLoopStatsCallback> callback,
+      LoopLagMonitor::Config config = LoopLagMonitor::Config()) {
+    LoopLagMonitor::install(getWorkerEvbs(), config, std::move(callback));
+  }
+
+  // Gives every worker EventBase its own jemalloc arena
+  void bindWorkerArenas() {
+    MemoryAccounting::bindWorkerArenas(getWorkerEvbs());
+  }
+
  private:
   folly::coro::Task<void> handleClientSession(
       std::shared_ptr<MoQSession> clientSession);
@@ -48,6 +64,9 @@ class MoQServer : public MoQSession::ServerSetupCallback {
       txn_ = txn;
     }
     void detachTransaction() noexcept override {
+      if (clientSession_) {
+        clientSession_->setTransportMetricsProvider(nullptr);
+      }
       txn_ = nullptr;
       delete this;
     }
@@ -86,6 +105,7 @@ class MoQServer : public MoQSession::ServerSetupCallback {
    private:
     void onSessionEnd(folly::Optional<uint32_t> err) {
       if (clientSession_) {
+        clientSession_->setTransportMetricsProvider(nullptr);
         clientSession_->onSessionEnd(err);
         clientSession_.reset();
       }
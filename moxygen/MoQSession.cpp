@@ -5,6 +5,8 @@
  */
 
 #include "moxygen/MoQSession.h"
+#include "moxygen/util/MemoryAccounting.h"
+#include "moxygen/util/MoQTracepoints.h"
 #include <folly/coro/Collect.h>
 #include <folly/coro/FutureUtil.h>
 #include <folly/futures/ThreadWheelTimekeeper.h>
@@ -15,6 +17,16 @@
 namespace {
 using namespace moxygen;
 constexpr std::chrono::seconds kSetupTimeout(5);
+// Subgroups waiting for stream credit, per session, and the bytes each may
+// buffer before it is dropped
+constexpr size_t kMaxPendingSubgroups = 32;
+constexpr size_t kMaxPendingSubgroupBytes = 1024 * 1024;
+
+moxygen::MoQPublishError pendingSubgroupDropped() {
+  return moxygen::MoQPublishError(
+      moxygen::MoQPublishError::TOO_FAR_BEHIND,
+      "Subgroup dropped waiting for stream credit");
+}
 
 constexpr uint32_t IdMask = 0x1FFFFF;
 uint32_t groupPriorityBits(GroupOrder groupOrder, uint64_t group) {
@@ -26,6 +38,11 @@ uint32_t groupPriorityBits(GroupOrder groupOrder, uint64_t group) {
                                                : (IdMask - truncGroup);
 }
 
+// Track alias or subscribe ID, for tracepoints
+uint64_t traceId(const TrackIdentifier& trackIdentifier) {
+  return std::visit([](auto id) { return id.value; }, trackIdentifier);
+}
+
 uint32_t subgroupPriorityBits(uint32_t subgroupID) {
   return static_cast<uint32_t>(subgroupID) & IdMask;
 }
@@ -208,6 +225,15 @@ class StreamPublisherImpl : public SubgroupConsumer, public FetchConsumer {
       const Extensions& extensions,
       bool finStream);
 
+  // A subgroup created without a stream buffers its writes until the
+  // session opens one with openPending, or gives up with dropPending.  Once
+  // dropped, writes fail with TOO_FAR_BEHIND.
+  void setPendingKey(MoQSession::PendingSubgroupKey key) {
+    pendingKey_ = key;
+  }
+  void openPending(proxygen::WebTransport::StreamWriteHandle* writeHandle);
+  void dropPending();
+
  private:
   bool setGroupAndSubgroup(uint64_t groupID, uint64_t subgroupID) {
     if (groupID < header_.group) {
@@ -238,7 +264,7 @@ class StreamPublisherImpl : public SubgroupConsumer, public FetchConsumer {
       bool finStream);
   folly::Expected<folly::Unit, MoQPublishError> writeToStream(bool finStream);
 
-  void onStreamComplete();
+  void onStreamComplete(bool reset);
 
   MoQSession::PublisherImpl* publisher_{nullptr};
   folly::Optional<folly::CancellationCallback> cancelCallback_;
@@ -247,6 +273,10 @@ class StreamPublisherImpl : public SubgroupConsumer, public FetchConsumer {
   ObjectHeader header_;
   folly::Optional<uint64_t> currentLengthRemaining_;
   folly::IOBufQueue writeBuf_{folly::IOBufQueue::cacheChainLength()};
+  folly::Optional<MoQSession::PendingSubgroupKey> pendingKey_;
+  bool pendingFin_{false};
+  // Pending subgroup dropped by the session or for buffering too much
+  bool dropped_{false};
 };
 
 // StreamPublisherImpl
@@ -273,10 +303,13 @@ StreamPublisherImpl::StreamPublisherImpl(
     : StreamPublisherImpl(publisher) {
   streamType_ = StreamType::SUBGROUP_HEADER;
   header_.trackIdentifier = alias;
-  setWriteHandle(writeHandle);
+  if (writeHandle) {
+    setWriteHandle(writeHandle);
+  }
   setGroupAndSubgroup(groupID, subgroupID);
   writeBuf_.move(); // clear FETCH_HEADER
   (void)writeSubgroupHeader(writeBuf_, header_);
+  MOQ_TRACEPOINT(subgroup_open, alias.value, groupID, subgroupID);
 }
 
 // Private methods
@@ -297,11 +330,52 @@ void StreamPublisherImpl::setWriteHandle(
   });
   if (publisher_) {
     publisher_->onStreamCreated();
+    publisher_->onRequestPhase(RequestPhase::FIRST_OBJECT);
+  }
+}
+
+void StreamPublisherImpl::openPending(
+    proxygen::WebTransport::StreamWriteHandle* writeHandle) {
+  XCHECK(pendingKey_);
+  pendingKey_.reset();
+  setWriteHandle(writeHandle);
+  if (!writeBuf_.empty() || pendingFin_) {
+    (void)writeToStream(pendingFin_);
+  }
+}
+
+void StreamPublisherImpl::dropPending() {
+  XLOG(DBG1) << "Dropping pending subgroup=" << header_ << " sgp=" << this;
+  if (publisher_) {
+    if (pendingKey_) {
+      publisher_->cancelPendingSubgroup(*pendingKey_);
+    }
+    publisher_->onPendingSubgroupDropped();
   }
+  pendingKey_.reset();
+  dropped_ = true;
+  writeBuf_.move();
+  onStreamComplete(/*reset=*/true);
 }
 
-void StreamPublisherImpl::onStreamComplete() {
+void StreamPublisherImpl::onStreamComplete(bool reset) {
   XCHECK_EQ(writeHandle_, nullptr);
+  if (streamType_ == StreamType::SUBGROUP_HEADER) {
+    MOQ_TRACEPOINT(
+        subgroup_close,
+        traceId(header_.trackIdentifier),
+        header_.group,
+        header_.subgroup,
+        header_.id,
+        reset);
+  } else {
+    MOQ_TRACEPOINT(
+        fetch_served,
+        traceId(header_.trackIdentifier),
+        header_.group,
+        header_.id,
+        reset);
+  }
   auto publisher = publisher_;
   publisher_ = nullptr;
   if (publisher) {
@@ -345,6 +419,19 @@ StreamPublisherImpl::writeCurrentObject(
 
 folly::Expected<folly::Unit, MoQPublishError>
 StreamPublisherImpl::writeToStream(bool finStream) {
+  if (dropped_) {
+    writeBuf_.move();
+    return folly::makeUnexpected(pendingSubgroupDropped());
+  }
+  if (pendingKey_) {
+    // Still waiting for stream credit, hold the data until the stream opens
+    pendingFin_ = finStream;
+    if (writeBuf_.chainLength() > kMaxPendingSubgroupBytes) {
+      dropPending();
+      return folly::makeUnexpected(pendingSubgroupDropped());
+    }
+    return folly::unit;
+  }
   auto writeHandle = writeHandle_;
   if (finStream) {
     writeHandle_ = nullptr;
@@ -353,7 +440,7 @@ StreamPublisherImpl::writeToStream(bool finStream) {
       writeHandle->writeStreamData(writeBuf_.move(), finStream, nullptr);
   if (writeRes.hasValue()) {
     if (finStream) {
-      onStreamComplete();
+      onStreamComplete(/*reset=*/false);
     }
     return folly::unit;
   }
@@ -508,13 +595,26 @@ StreamPublisherImpl::endOfSubgroup() {
     return folly::makeUnexpected(MoQPublishError(
         MoQPublishError::API_ERROR, "Previous object incomplete"));
   }
-  if (!writeBuf_.empty()) {
+  if (!writeBuf_.empty() && !pendingKey_) {
     XLOG(WARN) << "No objects published on subgroup=" << header_;
   }
   return writeToStream(/*finStream=*/true);
 }
 
 void StreamPublisherImpl::reset(ResetStreamErrorCode error) {
+  if (dropped_) {
+    return;
+  }
+  if (pendingKey_) {
+    // Never opened, nothing to reset on the wire
+    if (publisher_) {
+      publisher_->cancelPendingSubgroup(*pendingKey_);
+    }
+    pendingKey_.reset();
+    writeBuf_.move();
+    onStreamComplete(/*reset=*/true);
+    return;
+  }
   if (!writeBuf_.empty()) {
     // TODO: stream header is pending, reliable reset?
     XLOG(WARN) << "Stream header pending on subgroup=" << header_;
@@ -527,15 +627,27 @@ void StreamPublisherImpl::reset(ResetStreamErrorCode error) {
     // Can happen on STOP_SENDING or prior to first fetch write
     XLOG(ERR) << "reset with no write handle: sgp=" << this;
   }
-  onStreamComplete();
+  onStreamComplete(/*reset=*/true);
 }
 
 folly::Expected<folly::SemiFuture<folly::Unit>, MoQPublishError>
 StreamPublisherImpl::awaitReadyToConsume() {
+  if (dropped_) {
+    return folly::makeUnexpected(pendingSubgroupDropped());
+  }
+  if (pendingKey_) {
+    // Writes are buffered until the stream opens
+    return folly::makeSemiFuture();
+  }
   if (!writeHandle_) {
     return folly::makeUnexpected(
         MoQPublishError(MoQPublishError::CANCELLED, "Fetch cancelled"));
   }
+  MOQ_TRACEPOINT(
+      write_blocked,
+      traceId(header_.trackIdentifier),
+      header_.group,
+      header_.subgroup);
   auto writableFuture = writeHandle_->awaitWritable();
   if (!writableFuture) {
     return folly::makeUnexpected(
@@ -546,7 +658,10 @@ StreamPublisherImpl::awaitReadyToConsume() {
 
 folly::Expected<folly::Unit, MoQPublishError>
 StreamPublisherImpl::ensureWriteHandle() {
-  if (writeHandle_) {
+  if (dropped_) {
+    return folly::makeUnexpected(pendingSubgroupDropped());
+  }
+  if (writeHandle_ || pendingKey_) {
     return folly::unit;
   }
   if (!publisher_) {
@@ -566,6 +681,8 @@ StreamPublisherImpl::ensureWriteHandle() {
   if (!stream) {
     // failed to create a stream
     XLOG(ERR) << "Failed to create uni stream tp=" << this;
+    MOQ_TRACEPOINT(
+        stream_blocked, publisher_->subscribeID().value, header_.group);
     return folly::makeUnexpected(MoQPublishError(
         MoQPublishError::BLOCKED, "Failed to create uni stream."));
   }
@@ -599,6 +716,7 @@ class MoQSession::TrackPublisherImpl : public MoQSession::PublisherImpl,
       GroupOrder groupOrder)
       : PublisherImpl(
             session,
+            FrameType::SUBSCRIBE,
             std::move(fullTrackName),
             subscribeID,
             subPriority,
@@ -685,6 +803,7 @@ class MoQSession::FetchPublisherImpl : public MoQSession::PublisherImpl {
       GroupOrder groupOrder)
       : PublisherImpl(
             session,
+            FrameType::FETCH,
             std::move(fullTrackName),
             subscribeID,
             subPriority,
@@ -745,22 +864,26 @@ MoQSession::TrackPublisherImpl::beginSubgroup(
     return folly::makeUnexpected(MoQPublishError(
         MoQPublishError::API_ERROR, "Publish after subscribeDone"));
   }
+  auto streamPriority = getStreamPriority(
+      groupID, subgroupID, subPriority_, pubPriority, groupOrder_);
   auto stream = wt->createUniStream();
   if (!stream) {
-    // failed to create a stream
+    // Out of stream credit.  Buffer the subgroup and let the session open
+    // it, highest priority first, as credit arrives.
     // TODO: can it fail for non-stream credit reasons? Session closing should
     // be handled above.
-    XLOG(ERR) << "Failed to create uni stream tp=" << this;
-    return folly::makeUnexpected(MoQPublishError(
-        MoQPublishError::BLOCKED, "Failed to create uni stream."));
+    XLOG(DBG1) << "Uni stream blocked, queueing subgroup tp=" << this;
+    MOQ_TRACEPOINT(stream_blocked, subscribeID().value, groupID);
+    auto subgroupPublisher = std::make_shared<StreamPublisherImpl>(
+        this, nullptr, trackAlias_, groupID, subgroupID);
+    subgroupPublisher->setPendingKey(
+        session_->queuePendingSubgroup(streamPriority, subgroupPublisher));
+    subgroups_[{groupID, subgroupID}] = subgroupPublisher;
+    return subgroupPublisher;
   }
   XLOG(DBG4) << "New stream created, id: " << stream.value()->getID()
              << " tp=" << this;
-  stream.value()->setPriority(
-      1,
-      getStreamPriority(
-          groupID, subgroupID, subPriority_, pubPriority, groupOrder_),
-      false);
+  stream.value()->setPriority(1, streamPriority, false);
   auto subgroupPublisher = std::make_shared<StreamPublisherImpl>(
       this, *stream, trackAlias_, groupID, subgroupID);
   // TODO: these are currently unused, but the intent might be to reset
@@ -879,6 +1002,7 @@ MoQSession::TrackPublisherImpl::datagram(
     return folly::makeUnexpected(
         MoQPublishError(MoQPublishError::WRITE_ERROR, "sendDatagram failed"));
   }
+  onRequestPhase(RequestPhase::FIRST_OBJECT);
   return folly::unit;
 }
 
@@ -920,10 +1044,33 @@ class MoQSession::TrackReceiveStateBase {
     return cancelSource_.getToken();
   }
 
+  // Fires if the peer does not respond to the request in time
+  RequestTimeout& requestTimeout() {
+    return requestTimeout_;
+  }
+
+  std::chrono::microseconds sinceRequest() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - requestTime_);
+  }
+
+  // Time since the request was sent, on the first object only
+  folly::Optional<std::chrono::microseconds> onFirstObject() {
+    if (firstObjectReceived_) {
+      return folly::none;
+    }
+    firstObjectReceived_ = true;
+    return sinceRequest();
+  }
+
  protected:
   FullTrackName fullTrackName_;
   SubscribeID subscribeID_;
   folly::CancellationSource cancelSource_;
+  RequestTimeout requestTimeout_;
+  std::chrono::steady_clock::time_point requestTime_{
+      std::chrono::steady_clock::now()};
+  bool firstObjectReceived_{false};
 };
 
 class MoQSession::SubscribeTrackReceiveState
@@ -961,11 +1108,13 @@ class MoQSession::SubscribeTrackReceiveState
   }
 
   void subscribeOK(SubscribeOk subscribeOK) {
+    requestTimeout_.cancelTimeout();
     promise_.setValue(std::move(subscribeOK));
   }
 
   void subscribeError(SubscribeError subErr) {
     XLOG(DBG1) << __func__ << " trackReceiveState=" << this;
+    requestTimeout_.cancelTimeout();
     if (!promise_.isFulfilled()) {
       subErr.subscribeID = subscribeID_;
       promise_.setValue(folly::makeUnexpected(std::move(subErr)));
@@ -986,6 +1135,7 @@ class MoQSession::SubscribeTrackReceiveState
     streamCount_++;
     if (pendingSubscribeDone_ &&
         streamCount_ >= pendingSubscribeDone_->streamCount) {
+      subscribeDoneTimeout_.cancelTimeout();
       if (callback_) {
         callback_->subscribeDone(std::move(*pendingSubscribeDone_));
         pendingSubscribeDone_.reset();
@@ -1004,8 +1154,8 @@ class MoQSession::SubscribeTrackReceiveState
         XLOG(DBG1) << "Waiting for streams in flight, have=" << streamCount_
                    << " need=" << subDone.streamCount
                    << " trackReceiveState=" << this;
+        // The session arms subscribeDoneTimeout_ to bound the wait
         pendingSubscribeDone_ = std::move(subDone);
-        // TODO: timeout
         return false;
       } else {
         callback_->subscribeDone(std::move(subDone));
@@ -1014,10 +1164,23 @@ class MoQSession::SubscribeTrackReceiveState
     return true;
   }
 
+  RequestTimeout& subscribeDoneTimeout() {
+    return subscribeDoneTimeout_;
+  }
+
+  // Deliver a SUBSCRIBE_DONE that was waiting on streams that never arrived
+  void deliverPendingSubscribeDone() {
+    if (pendingSubscribeDone_ && callback_) {
+      callback_->subscribeDone(std::move(*pendingSubscribeDone_));
+    }
+    pendingSubscribeDone_.reset();
+  }
+
  private:
   std::shared_ptr<TrackConsumer> callback_;
   folly::coro::Promise<SubscribeResult> promise_;
   folly::Optional<SubscribeDone> pendingSubscribeDone_;
+  RequestTimeout subscribeDoneTimeout_;
   uint64_t streamCount_{0};
 };
 
@@ -1058,10 +1221,12 @@ class MoQSession::FetchTrackReceiveState
 
   void fetchOK(FetchOk ok) {
     XLOG(DBG1) << __func__ << " trackReceiveState=" << this;
+    requestTimeout_.cancelTimeout();
     promise_.setValue(std::move(ok));
   }
 
   void fetchError(FetchError fetchErr) {
+    requestTimeout_.cancelTimeout();
     if (!promise_.isFulfilled()) {
       fetchErr.subscribeID = subscribeID_;
       promise_.setValue(folly::makeUnexpected(std::move(fetchErr)));
@@ -1147,6 +1312,7 @@ void MoQSession::cleanup() {
     pubTrack.second->reset(ResetStreamErrorCode::SESSION_CLOSED);
   }
   pubTracks_.clear();
+  pendingSubgroups_.clear();
   for (auto& subTrack : subTracks_) {
     subTrack.second->subscribeError(
         {/*TrackReceiveState fills in subId*/ 0,
@@ -1179,6 +1345,9 @@ void MoQSession::cleanup() {
          "session closed"})));
   }
   pendingSubscribeAnnounces_.clear();
+  if (requestTimer_) {
+    requestTimer_->cancelAll();
+  }
   if (!cancellationSource_.isCancellationRequested()) {
     XLOG(DBG1) << "requestCancellation from cleanup sess=" << this;
     cancellationSource_.requestCancellation();
@@ -1396,7 +1565,13 @@ folly::coro::Task<void> MoQSession::controlReadLoop(
       break;
     } else {
       if (streamData->data || streamData->fin) {
+        if (captureWriter_) {
+          captureWriter_->onControlData(
+              streamId, streamData->data.get(), streamData->fin);
+        }
         try {
+          MOQ_LOOP_SCOPE(CONTROL_PARSE);
+          MOQ_MEM_SCOPE(CONTROL);
           codec.onIngress(std::move(streamData->data), streamData->fin);
         } catch (const std::exception& ex) {
           XLOG(FATAL) << "exception thrown from onIngress ex="
@@ -1490,6 +1665,7 @@ class ObjectStreamCallback : public MoQObjectStreamCodec::ObjectCallback {
     if (!callback) {
       return;
     }
+    session_->onFirstObjectReceived(*subscribeState_, FrameType::SUBSCRIBE);
     auto res = callback->beginSubgroup(group, subgroup, priority);
     if (res.hasValue()) {
       subgroupCallback_ = *res;
@@ -1509,6 +1685,7 @@ class ObjectStreamCallback : public MoQObjectStreamCodec::ObjectCallback {
     }
     token_ =
         folly::CancellationToken::merge(token_, fetchState_->getCancelToken());
+    session_->onFirstObjectReceived(*fetchState_, FrameType::FETCH);
   }
 
   void onObjectBegin(
@@ -1743,8 +1920,14 @@ folly::coro::Task<void> MoQSession::unidirectionalReadLoop(
     } else {
       if (streamData->data || streamData->fin) {
         fin = streamData->fin;
+        if (captureWriter_) {
+          captureWriter_->onStreamData(
+              id, streamData->data.get(), streamData->fin);
+        }
         folly::Optional<MoQPublishError> err;
         try {
+          MOQ_LOOP_SCOPE(DATA_PARSE);
+          MOQ_MEM_SCOPE(CODEC);
           codec.onIngress(std::move(streamData->data), streamData->fin);
           err = dcb.error();
         } catch (const std::exception& ex) {
@@ -1972,6 +2155,13 @@ void MoQSession::onSubscribeDone(SubscribeDone subscribeDone) {
     auto state = trackReceiveStateIt->second;
     if (state->subscribeDone(std::move(subscribeDone))) {
       subTracks_.erase(trackReceiveStateIt);
+    } else {
+      state->subscribeDoneTimeout().setCallback(
+          [this, alias = trackAliasIt->second] {
+            onSubscribeDoneStreamsTimeout(alias);
+          });
+      scheduleRequestTimeout(
+          state->subscribeDoneTimeout(), requestTimeouts_.subscribeDoneStreams);
     }
   } else {
     XLOG(DFATAL) << "trackAliasIt but no trackReceiveStateIt for id="
@@ -2426,6 +2616,11 @@ folly::coro::Task<Publisher::TrackStatusResult> MoQSession::trackStatus(
   auto contract = folly::coro::makePromiseContract<TrackStatus>();
   trackStatuses_.emplace(
       trackStatusRequest.fullTrackName, std::move(contract.first));
+  RequestTimeout timeout(
+      [this, fullTrackName = trackStatusRequest.fullTrackName]() mutable {
+        onTrackStatusTimeout(std::move(fullTrackName));
+      });
+  scheduleRequestTimeout(timeout, requestTimeouts_.trackStatus);
   co_return co_await std::move(contract.second);
 }
 
@@ -2497,8 +2692,12 @@ folly::coro::Task<Subscriber::AnnounceResult> MoQSession::announce(
   auto contract = folly::coro::makePromiseContract<
       folly::Expected<AnnounceOk, AnnounceError>>();
   publisherAnnounces_[trackNamespace] = std::move(announceCallback);
+  RequestTimeout timeout([this, trackNamespace]() mutable {
+    onAnnounceTimeout(std::move(trackNamespace));
+  });
   pendingAnnounce_.emplace(
       std::move(trackNamespace), std::move(contract.first));
+  scheduleRequestTimeout(timeout, requestTimeouts_.announce);
   auto announceResult = co_await std::move(contract.second);
   if (announceResult.hasError()) {
     co_return folly::makeUnexpected(announceResult.error());
@@ -2588,8 +2787,12 @@ MoQSession::subscribeAnnounces(SubscribeAnnounces sa) {
   controlWriteEvent_.signal();
   auto contract = folly::coro::makePromiseContract<
       folly::Expected<SubscribeAnnouncesOk, SubscribeAnnouncesError>>();
+  RequestTimeout timeout([this, trackNamespace]() mutable {
+    onSubscribeAnnouncesTimeout(std::move(trackNamespace));
+  });
   pendingSubscribeAnnounces_.emplace(
       std::move(trackNamespace), std::move(contract.first));
+  scheduleRequestTimeout(timeout, requestTimeouts_.subscribeAnnounces);
   auto subAnnResult = co_await std::move(contract.second);
   if (subAnnResult.hasError()) {
     co_return folly::makeUnexpected(subAnnResult.error());
@@ -2712,7 +2915,12 @@ folly::coro::Task<Publisher::SubscribeResult> MoQSession::subscribe(
   XCHECK(subTrack.second) << "Track alias already in use alias=" << trackAlias
                           << " sess=" << this;
 
-  auto subscribeResult = co_await trackReceiveState->subscribeFuture();
+  auto subscribeFuture = trackReceiveState->subscribeFuture();
+  trackReceiveState->requestTimeout().setCallback(
+      [this, subID] { onSubscribeTimeout(subID); });
+  scheduleRequestTimeout(
+      trackReceiveState->requestTimeout(), requestTimeouts_.subscribe);
+  auto subscribeResult = co_await std::move(subscribeFuture);
   XLOG(DBG1) << "Subscribe ready trackReceiveState=" << trackReceiveState
              << " subscribeID=" << subID;
   if (subscribeResult.hasError()) {
@@ -2723,6 +2931,13 @@ folly::coro::Task<Publisher::SubscribeResult> MoQSession::subscribe(
     co_return folly::makeUnexpected(subscribeResult.error());
   } else {
     MOQ_SUBSCRIBER_STATS(subscriberStatsCallback_, onSubscribeSuccess);
+    MOQ_SUBSCRIBER_STATS(
+        subscriberStatsCallback_,
+        onRequestLatency,
+        FrameType::SUBSCRIBE,
+        RequestPhase::RESPONSE,
+        trackReceiveState->sinceRequest(),
+        /*forwarded=*/false);
     co_return std::make_shared<ReceiverSubscriptionHandle>(
         std::move(subscribeResult.value()), alias, shared_from_this());
   }
@@ -2755,6 +2970,7 @@ std::shared_ptr<TrackConsumer> MoQSession::subscribeOk(
     return nullptr;
   }
   controlWriteEvent_.signal();
+  trackPublisher->onRequestPhase(RequestPhase::RESPONSE);
   return std::static_pointer_cast<TrackConsumer>(trackPublisher);
 }
 
@@ -2861,12 +3077,319 @@ void MoQSession::sendMaxSubscribeID(bool signalWriteLoop) {
   }
 }
 
+void MoQSession::scheduleRequestTimeout(
+    RequestTimeout& timeout,
+    std::chrono::milliseconds duration) {
+  if (duration.count() == 0 || !evb_) {
+    return;
+  }
+  if (!requestTimer_) {
+    requestTimer_ = folly::HHWheelTimer::newTimer(evb_);
+  }
+  requestTimer_->scheduleTimeout(&timeout, duration);
+}
+
+void MoQSession::setTransportMetricsProvider(
+    TransportMetricsProvider provider) {
+  if (provider) {
+    metricsSampler_.emplace(std::move(provider));
+  } else {
+    metricsSampler_.reset();
+  }
+}
+
+folly::Optional<TransportMetrics> MoQSession::getTransportMetrics() {
+  if (!metricsSampler_) {
+    return folly::none;
+  }
+  return metricsSampler_->sample();
+}
+
+void MoQSession::setTransportMetricsCallback(
+    std::chrono::milliseconds interval,
+    folly::Function<void(const TransportMetrics&)> callback) {
+  metricsTimeout_.cancelTimeout();
+  metricsInterval_ = interval;
+  metricsCallback_ = std::move(callback);
+  scheduleTransportMetricsReport();
+}
+
+void MoQSession::scheduleTransportMetricsReport() {
+  if (!metricsCallback_ || metricsInterval_.count() == 0 ||
+      cancellationSource_.isCancellationRequested()) {
+    return;
+  }
+  metricsTimeout_.setCallback([this] {
+    auto self = shared_from_this();
+    if (auto metrics = getTransportMetrics()) {
+      metricsCallback_(*metrics);
+    }
+    scheduleTransportMetricsReport();
+  });
+  scheduleRequestTimeout(metricsTimeout_, metricsInterval_);
+}
+
+void MoQSession::onSubscribeTimeout(SubscribeID subscribeID) {
+  XLOG(ERR) << __func__ << " id=" << subscribeID << " sess=" << this;
+  MOQ_SUBSCRIBER_STATS(
+      subscriberStatsCallback_, onRequestTimeout, FrameType::SUBSCRIBE);
+  auto trackAliasIt = subIdToTrackAlias_.find(subscribeID);
+  if (trackAliasIt == subIdToTrackAlias_.end()) {
+    return;
+  }
+  auto trackReceiveStateIt = subTracks_.find(trackAliasIt->second);
+  if (trackReceiveStateIt != subTracks_.end()) {
+    auto state = trackReceiveStateIt->second;
+    subTracks_.erase(trackReceiveStateIt);
+    state->subscribeError(
+        {subscribeID,
+         SubscribeErrorCode::TIMEOUT,
+         "subscribe timed out",
+         folly::none});
+  }
+  subIdToTrackAlias_.erase(trackAliasIt);
+  // The peer may still be processing the SUBSCRIBE, let it release the state
+  auto res = writeUnsubscribe(controlWriteBuf_, {subscribeID});
+  if (!res) {
+    XLOG(ERR) << "writeUnsubscribe failed sess=" << this;
+  } else {
+    controlWriteEvent_.signal();
+  }
+  checkForCloseOnDrain();
+}
+
+void MoQSession::onSubscribeDoneStreamsTimeout(TrackAlias alias) {
+  auto trackReceiveStateIt = subTracks_.find(alias);
+  if (trackReceiveStateIt == subTracks_.end()) {
+    return;
+  }
+  XLOG(ERR) << __func__ << " alias=" << alias << " sess=" << this;
+  MOQ_SUBSCRIBER_STATS(
+      subscriberStatsCallback_, onRequestTimeout, FrameType::SUBSCRIBE_DONE);
+  auto state = trackReceiveStateIt->second;
+  subTracks_.erase(trackReceiveStateIt);
+  state->deliverPendingSubscribeDone();
+  // Streams still open for this subscription are abandoned
+  state->cancel();
+  checkForCloseOnDrain();
+}
+
+void MoQSession::onFetchTimeout(SubscribeID subscribeID) {
+  XLOG(ERR) << __func__ << " id=" << subscribeID << " sess=" << this;
+  MOQ_SUBSCRIBER_STATS(
+      subscriberStatsCallback_, onRequestTimeout, FrameType::FETCH);
+  auto fetchIt = fetches_.find(subscribeID);
+  if (fetchIt == fetches_.end()) {
+    return;
+  }
+  auto state = fetchIt->second;
+  fetches_.erase(fetchIt);
+  state->fetchError({subscribeID, FetchErrorCode::TIMEOUT, "fetch timed out"});
+  auto res = writeFetchCancel(controlWriteBuf_, {subscribeID});
+  if (!res) {
+    XLOG(ERR) << "writeFetchCancel failed sess=" << this;
+  } else {
+    controlWriteEvent_.signal();
+  }
+  checkForCloseOnDrain();
+}
+
+void MoQSession::onAnnounceTimeout(TrackNamespace trackNamespace) {
+  auto annIt = pendingAnnounce_.find(trackNamespace);
+  if (annIt == pendingAnnounce_.end()) {
+    return;
+  }
+  XLOG(ERR) << __func__ << " ns=" << trackNamespace << " sess=" << this;
+  MOQ_PUBLISHER_STATS(
+      publisherStatsCallback_, onRequestTimeout, FrameType::ANNOUNCE);
+  auto promise = std::move(annIt->second);
+  pendingAnnounce_.erase(annIt);
+  publisherAnnounces_.erase(trackNamespace);
+  auto res = writeUnannounce(controlWriteBuf_, {trackNamespace});
+  if (!res) {
+    XLOG(ERR) << "writeUnannounce failed sess=" << this;
+  } else {
+    controlWriteEvent_.signal();
+  }
+  promise.setValue(folly::makeUnexpected(AnnounceError(
+      {std::move(trackNamespace),
+       AnnounceErrorCode::TIMEOUT,
+       "announce timed out"})));
+}
+
+void MoQSession::onSubscribeAnnouncesTimeout(
+    TrackNamespace trackNamespacePrefix) {
+  auto saIt = pendingSubscribeAnnounces_.find(trackNamespacePrefix);
+  if (saIt == pendingSubscribeAnnounces_.end()) {
+    return;
+  }
+  XLOG(ERR) << __func__ << " prefix=" << trackNamespacePrefix
+            << " sess=" << this;
+  MOQ_SUBSCRIBER_STATS(
+      subscriberStatsCallback_,
+      onRequestTimeout,
+      FrameType::SUBSCRIBE_ANNOUNCES);
+  auto promise = std::move(saIt->second);
+  pendingSubscribeAnnounces_.erase(saIt);
+  unsubscribeAnnounces({trackNamespacePrefix});
+  promise.setValue(folly::makeUnexpected(SubscribeAnnouncesError(
+      {std::move(trackNamespacePrefix),
+       SubscribeAnnouncesErrorCode::TIMEOUT,
+       "subscribeAnnounces timed out"})));
+}
+
+void MoQSession::onTrackStatusTimeout(FullTrackName fullTrackName) {
+  auto trackStatusIt = trackStatuses_.find(fullTrackName);
+  if (trackStatusIt == trackStatuses_.end()) {
+    return;
+  }
+  XLOG(ERR) << __func__ << " ftn=" << fullTrackName << " sess=" << this;
+  MOQ_SUBSCRIBER_STATS(
+      subscriberStatsCallback_,
+      onRequestTimeout,
+      FrameType::TRACK_STATUS_REQUEST);
+  auto promise = std::move(trackStatusIt->second);
+  trackStatuses_.erase(trackStatusIt);
+  promise.setValue(TrackStatus{
+      std::move(fullTrackName), TrackStatusCode::UNKNOWN, folly::none});
+}
+
+void MoQSession::PublisherImpl::onRequestPhase(RequestPhase phase) {
+  uint8_t bit = 1 << folly::to_underlying(phase);
+  if (!session_ || (reportedPhases_ & bit)) {
+    return;
+  }
+  reportedPhases_ |= bit;
+  MOQ_PUBLISHER_STATS(
+      session_->publisherStatsCallback_,
+      onRequestLatency,
+      requestType_,
+      phase,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - requestTime_),
+      forwarded_);
+}
+
+void MoQSession::PublisherImpl::cancelPendingSubgroup(
+    PendingSubgroupKey key) {
+  if (session_) {
+    session_->pendingSubgroups_.erase(key);
+  }
+}
+
+void MoQSession::PublisherImpl::onPendingSubgroupDropped() {
+  if (session_) {
+    MOQ_PUBLISHER_STATS(
+        session_->publisherStatsCallback_, onPendingSubgroupDropped);
+  }
+}
+
 void MoQSession::PublisherImpl::fetchComplete() {
   auto session = session_;
   session_ = nullptr;
   session->fetchComplete(subscribeID_);
 }
 
+void MoQSession::markRequestForwarded(SubscribeID subscribeID) {
+  auto it = pubTracks_.find(subscribeID);
+  if (it != pubTracks_.end()) {
+    it->second->setForwarded();
+  }
+}
+
+void MoQSession::onFirstObjectReceived(
+    TrackReceiveStateBase& state,
+    FrameType requestType) {
+  auto latency = state.onFirstObject();
+  if (latency) {
+    MOQ_SUBSCRIBER_STATS(
+        subscriberStatsCallback_,
+        onRequestLatency,
+        requestType,
+        RequestPhase::FIRST_OBJECT,
+        *latency,
+        /*forwarded=*/false);
+  }
+}
+
+MoQSession::PendingSubgroupKey MoQSession::queuePendingSubgroup(
+    uint64_t streamPriority,
+    std::weak_ptr<SubgroupConsumer> subgroup) {
+  if (pendingSubgroups_.size() >= kMaxPendingSubgroups) {
+    // Drop the subgroup that has waited longest, newer data is worth more
+    auto stalest = pendingSubgroups_.begin();
+    for (auto it = pendingSubgroups_.begin(); it != pendingSubgroups_.end();
+         ++it) {
+      if (it->first.second < stalest->first.second) {
+        stalest = it;
+      }
+    }
+    auto victim = stalest->second.lock();
+    pendingSubgroups_.erase(stalest);
+    if (victim) {
+      std::static_pointer_cast<StreamPublisherImpl>(victim)->dropPending();
+    }
+  }
+  MOQ_PUBLISHER_STATS(publisherStatsCallback_, onSubgroupQueued);
+  PendingSubgroupKey key{streamPriority, nextPendingSubgroupSeq_++};
+  pendingSubgroups_.emplace(key, std::move(subgroup));
+  if (!openingPendingSubgroups_) {
+    openingPendingSubgroups_ = true;
+    co_withCancellation(cancellationSource_.getToken(), openPendingSubgroups())
+        .scheduleOn(evb_)
+        .start();
+  }
+  return key;
+}
+
+void MoQSession::dropPendingSubgroups() {
+  // dropPending erases from the queue, so take it first
+  auto pending = std::move(pendingSubgroups_);
+  pendingSubgroups_.clear();
+  for (auto& entry : pending) {
+    if (auto subgroup = entry.second.lock()) {
+      std::static_pointer_cast<StreamPublisherImpl>(subgroup)->dropPending();
+    }
+  }
+}
+
+folly::coro::Task<void> MoQSession::openPendingSubgroups() {
+  auto self = shared_from_this();
+  auto g = folly::makeGuard([this] { openingPendingSubgroups_ = false; });
+  auto token = co_await folly::coro::co_current_cancellation_token;
+  while (!pendingSubgroups_.empty() && wt_ &&
+         !token.isCancellationRequested()) {
+    auto stream = wt_->createUniStream();
+    if (!stream) {
+      auto credit = co_await folly::coro::co_awaitTry(
+          folly::coro::co_withCancellation(
+              token,
+              folly::coro::toTaskInterruptOnCancel(
+                  wt_->awaitUniStreamCredit().via(evb_))));
+      if (credit.hasException() && !token.isCancellationRequested()) {
+        XLOG(ERR) << "awaitUniStreamCredit failed, dropping pending subgroups"
+                  << " err=" << credit.exception().what() << " sess=" << this;
+        dropPendingSubgroups();
+        co_return;
+      }
+      continue;
+    }
+    auto it = pendingSubgroups_.begin();
+    auto subgroup = it->second.lock();
+    auto streamPriority = it->first.first;
+    pendingSubgroups_.erase(it);
+    if (!subgroup) {
+      stream.value()->resetStream(uint32_t(ResetStreamErrorCode::CANCELLED));
+      continue;
+    }
+    XLOG(DBG4) << "Opened pending subgroup, id: " << stream.value()->getID()
+               << " sess=" << this;
+    stream.value()->setPriority(1, streamPriority, false);
+    std::static_pointer_cast<StreamPublisherImpl>(subgroup)->openPending(
+        *stream);
+  }
+}
+
 void MoQSession::fetchComplete(SubscribeID subscribeID) {
   XLOG(DBG1) << __func__ << " sess=" << this;
   auto it = pubTracks_.find(subscribeID);
@@ -2988,7 +3511,12 @@ folly::coro::Task<Publisher::FetchResult> MoQSession::fetch(
   auto fetchTrack = fetches_.try_emplace(subID, trackReceiveState);
   XCHECK(fetchTrack.second)
       << "SubscribeID already in use id=" << subID << " sess=" << this;
-  auto fetchResult = co_await trackReceiveState->fetchFuture();
+  auto fetchFuture = trackReceiveState->fetchFuture();
+  trackReceiveState->requestTimeout().setCallback(
+      [this, subID] { onFetchTimeout(subID); });
+  scheduleRequestTimeout(
+      trackReceiveState->requestTimeout(), requestTimeouts_.fetch);
+  auto fetchResult = co_await std::move(fetchFuture);
   XLOG(DBG1) << __func__
              << " fetchReady trackReceiveState=" << trackReceiveState;
   if (fetchResult.hasError()) {
@@ -2998,6 +3526,13 @@ folly::coro::Task<Publisher::FetchResult> MoQSession::fetch(
     co_return folly::makeUnexpected(fetchResult.error());
   } else {
     MOQ_SUBSCRIBER_STATS(subscriberStatsCallback_, onFetchSuccess);
+    MOQ_SUBSCRIBER_STATS(
+        subscriberStatsCallback_,
+        onRequestLatency,
+        FrameType::FETCH,
+        RequestPhase::RESPONSE,
+        trackReceiveState->sinceRequest(),
+        /*forwarded=*/false);
     co_return std::make_shared<ReceiverFetchHandle>(
         std::move(fetchResult.value()), shared_from_this());
   }
@@ -3012,6 +3547,11 @@ void MoQSession::fetchOk(const FetchOk& fetchOk) {
     return;
   }
   controlWriteEvent_.signal();
+  // The fetch may already be complete
+  auto it = pubTracks_.find(fetchOk.subscribeID);
+  if (it != pubTracks_.end()) {
+    it->second->onRequestPhase(RequestPhase::RESPONSE);
+  }
 }
 
 void MoQSession::fetchError(const FetchError& fetchErr) {
@@ -3110,6 +3650,11 @@ void MoQSession::onNewBidiStream(proxygen::WebTransport::BidiStreamHandle bh) {
 
 void MoQSession::onDatagram(std::unique_ptr<folly::IOBuf> datagram) {
   XLOG(DBG1) << __func__ << " sess=" << this;
+  if (captureWriter_) {
+    captureWriter_->onDatagram(datagram.get());
+  }
+  MOQ_LOOP_SCOPE(DATA_PARSE);
+  MOQ_MEM_SCOPE(CODEC);
   folly::IOBufQueue readBuf{folly::IOBufQueue::cacheChainLength()};
   readBuf.append(std::move(datagram));
   size_t remainingLength = readBuf.chainLength();
@@ -3140,6 +3685,7 @@ void MoQSession::onDatagram(std::unique_ptr<folly::IOBuf> datagram) {
   XCHECK(alias);
   auto state = getSubscribeTrackReceiveState(*alias).get();
   if (state) {
+    onFirstObjectReceived(*state, FrameType::SUBSCRIBE);
     auto callback = state->getSubscribeCallback();
     if (callback) {
       callback->datagram(std::move(*res), readBuf.move());
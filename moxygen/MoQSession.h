@@ -15,14 +15,19 @@
 #include <folly/coro/Promise.h>
 #include <folly/coro/Task.h>
 #include <folly/coro/UnboundedQueue.h>
+#include <folly/io/async/HHWheelTimer.h>
 #include <folly/logging/xlog.h>
 #include <moxygen/MoQConsumers.h>
 #include <moxygen/Publisher.h>
 #include <moxygen/Subscriber.h>
 #include <moxygen/stats/MoQStats.h>
+#include "moxygen/util/DenseIdMap.h"
+#include "moxygen/util/MoQCapture.h"
 #include "moxygen/util/TimedBaton.h"
+#include "moxygen/util/TransportMetrics.h"
 
 #include <boost/variant.hpp>
+#include <map>
 
 namespace moxygen {
 
@@ -109,6 +114,22 @@ class MoQSession : public MoQControlCodec::ControlCallback,
     return maxSubscribeID_;
   }
 
+  // Deadlines for requests awaiting a response from the peer.  A zero
+  // duration disables the timeout for that request type.
+  struct RequestTimeouts {
+    std::chrono::milliseconds subscribe{std::chrono::seconds(10)};
+    std::chrono::milliseconds fetch{std::chrono::seconds(10)};
+    std::chrono::milliseconds announce{std::chrono::seconds(10)};
+    std::chrono::milliseconds subscribeAnnounces{std::chrono::seconds(10)};
+    std::chrono::milliseconds trackStatus{std::chrono::seconds(10)};
+    // How long to wait for streams still in flight after SUBSCRIBE_DONE
+    std::chrono::milliseconds subscribeDoneStreams{std::chrono::seconds(5)};
+  };
+
+  void setRequestTimeouts(RequestTimeouts requestTimeouts) {
+    requestTimeouts_ = requestTimeouts;
+  }
+
   static GroupOrder resolveGroupOrder(
       GroupOrder pubOrder,
       GroupOrder subOrder) {
@@ -156,15 +177,44 @@ class MoQSession : public MoQControlCodec::ControlCallback,
     subscriberStatsCallback_ = subscriberStatsCallback;
   }
 
+  // Marks a SUBSCRIBE or FETCH received on this session as served from
+  // upstream, so its latency stats are split from locally served requests
+  void markRequestForwarded(SubscribeID subscribeID);
+
+  // Installed by the session owner, which knows the transport type
+  void setTransportMetricsProvider(TransportMetricsProvider provider);
+
+  // Congestion window, RTT and delivery rate of the underlying transport, or
+  // none if unavailable
+  folly::Optional<TransportMetrics> getTransportMetrics();
+
+  // Reports transport metrics every interval until the session closes.  A
+  // zero interval stops the reports.
+  void setTransportMetricsCallback(
+      std::chrono::milliseconds interval,
+      folly::Function<void(const TransportMetrics&)> callback);
+
+  // Record all ingress control, stream and datagram bytes.  Install before
+  // start() to capture the setup exchange.
+  void setCaptureWriter(std::shared_ptr<MoQCaptureWriter> captureWriter) {
+    captureWriter_ = std::move(captureWriter);
+  }
+
+  // Subgroups waiting for stream credit, ordered by stream priority then
+  // arrival
+  using PendingSubgroupKey = std::pair<uint64_t, uint64_t>;
+
   class PublisherImpl {
    public:
     PublisherImpl(
         MoQSession* session,
+        FrameType requestType,
         FullTrackName ftn,
         SubscribeID subscribeID,
         Priority subPriority,
         GroupOrder groupOrder)
         : session_(session),
+          requestType_(requestType),
           fullTrackName_(std::move(ftn)),
           subscribeID_(subscribeID),
           subPriority_(subPriority),
@@ -193,6 +243,18 @@ class MoQSession : public MoQControlCodec::ControlCallback,
 
     virtual void onStreamComplete(const ObjectHeader& finalHeader) = 0;
 
+    // Removes a subgroup waiting for stream credit from the session queue
+    void cancelPendingSubgroup(PendingSubgroupKey key);
+    // Counts a subgroup that was dropped while waiting for stream credit
+    void onPendingSubgroupDropped();
+
+    void setForwarded() {
+      forwarded_ = true;
+    }
+
+    // Reports the time since the request arrived, once per phase
+    void onRequestPhase(RequestPhase phase);
+
     folly::Expected<folly::Unit, MoQPublishError> subscribeDone(
         SubscribeDone subDone);
 
@@ -207,10 +269,15 @@ class MoQSession : public MoQControlCodec::ControlCallback,
 
    protected:
     MoQSession* session_{nullptr};
+    FrameType requestType_;
     FullTrackName fullTrackName_;
     SubscribeID subscribeID_;
     uint8_t subPriority_;
     GroupOrder groupOrder_;
+    std::chrono::steady_clock::time_point requestTime_{
+        std::chrono::steady_clock::now()};
+    bool forwarded_{false};
+    uint8_t reportedPhases_{0};
   };
 
   void onNewUniStream(proxygen::WebTransport::StreamReadHandle* rh) override;
@@ -233,6 +300,10 @@ class MoQSession : public MoQControlCodec::ControlCallback,
       TrackAlias trackAlias);
   std::shared_ptr<FetchTrackReceiveState> getFetchTrackReceiveState(
       SubscribeID subscribeID);
+  // Reports the latency to the first object of a SUBSCRIBE or FETCH
+  void onFirstObjectReceived(
+      TrackReceiveStateBase& state,
+      FrameType requestType);
 
  private:
   static const folly::RequestToken& sessionRequestToken();
@@ -245,6 +316,39 @@ class MoQSession : public MoQControlCodec::ControlCallback,
 
   void cleanup();
 
+  class RequestTimeout : public folly::HHWheelTimer::Callback {
+   public:
+    RequestTimeout() = default;
+    explicit RequestTimeout(folly::Function<void()> onExpired)
+        : onExpired_(std::move(onExpired)) {}
+
+    void setCallback(folly::Function<void()> onExpired) {
+      onExpired_ = std::move(onExpired);
+    }
+
+    void timeoutExpired() noexcept override {
+      // The handler may destroy this object
+      auto onExpired = std::move(onExpired_);
+      if (onExpired) {
+        onExpired();
+      }
+    }
+
+   private:
+    folly::Function<void()> onExpired_;
+  };
+
+  void scheduleRequestTimeout(
+      RequestTimeout& timeout,
+      std::chrono::milliseconds duration);
+  void onSubscribeTimeout(SubscribeID subscribeID);
+  void onSubscribeDoneStreamsTimeout(TrackAlias alias);
+  void onFetchTimeout(SubscribeID subscribeID);
+  void onAnnounceTimeout(TrackNamespace trackNamespace);
+  void onSubscribeAnnouncesTimeout(TrackNamespace trackNamespacePrefix);
+  void onTrackStatusTimeout(FullTrackName fullTrackName);
+  void scheduleTransportMetricsReport();
+
   folly::coro::Task<void> controlWriteLoop(
       proxygen::WebTransport::StreamWriteHandle* writeHandle);
   folly::coro::Task<void> controlReadLoop(
@@ -256,6 +360,16 @@ class MoQSession : public MoQControlCodec::ControlCallback,
   class TrackPublisherImpl;
   class FetchPublisherImpl;
 
+  // Queues a subgroup that could not open a stream, dropping the stalest
+  // pending subgroup when the queue is full
+  PendingSubgroupKey queuePendingSubgroup(
+      uint64_t streamPriority,
+      std::weak_ptr<SubgroupConsumer> subgroup);
+  // Opens pending subgroups in priority order as stream credit arrives
+  folly::coro::Task<void> openPendingSubgroups();
+  // Drops every pending subgroup, when stream credit can no longer arrive
+  void dropPendingSubgroups();
+
   folly::coro::Task<void> handleTrackStatus(TrackStatusRequest trackStatusReq);
   void writeTrackStatus(const TrackStatus& trackStatus);
 
@@ -344,19 +458,19 @@ class MoQSession : public MoQControlCodec::ControlCallback,
   folly::IOBufQueue controlWriteBuf_{folly::IOBufQueue::cacheChainLength()};
   moxygen::TimedBaton controlWriteEvent_;
 
-  // Track Alias -> Receive State
-  folly::F14FastMap<
+  // Track Alias -> Receive State.  Aliases and subscribe IDs are allocated
+  // sequentially, so these are dense ID-indexed windows.
+  DenseIdMap<
       TrackAlias,
       std::shared_ptr<SubscribeTrackReceiveState>,
       TrackAlias::hash>
       subTracks_;
-  folly::F14FastMap<
+  DenseIdMap<
       SubscribeID,
       std::shared_ptr<FetchTrackReceiveState>,
       SubscribeID::hash>
       fetches_;
-  folly::F14FastMap<SubscribeID, TrackAlias, SubscribeID::hash>
-      subIdToTrackAlias_;
+  DenseIdMap<SubscribeID, TrackAlias, SubscribeID::hash> subIdToTrackAlias_;
 
   // Publisher State
   // Track Namespace -> Promise<AnnounceOK>
@@ -381,9 +495,12 @@ class MoQSession : public MoQControlCodec::ControlCallback,
       trackStatuses_;
 
   // Subscriber ID -> metadata about a publish track
-  folly::
-      F14FastMap<SubscribeID, std::shared_ptr<PublisherImpl>, SubscribeID::hash>
-          pubTracks_;
+  DenseIdMap<SubscribeID, std::shared_ptr<PublisherImpl>, SubscribeID::hash>
+      pubTracks_;
+  std::map<PendingSubgroupKey, std::weak_ptr<SubgroupConsumer>>
+      pendingSubgroups_;
+  uint64_t nextPendingSubgroupSeq_{0};
+  bool openingPendingSubgroups_{false};
 
   class SubscriberAnnounceCallback;
   class PublisherAnnounceHandle;
@@ -428,5 +545,16 @@ class MoQSession : public MoQControlCodec::ControlCallback,
 
   std::shared_ptr<MoQPublisherStatsCallback> publisherStatsCallback_{nullptr};
   std::shared_ptr<MoQSubscriberStatsCallback> subscriberStatsCallback_{nullptr};
+
+  std::shared_ptr<MoQCaptureWriter> captureWriter_;
+
+  RequestTimeouts requestTimeouts_;
+  // Created on first use, shared by all pending requests on this session
+  folly::HHWheelTimer::UniquePtr requestTimer_;
+
+  folly::Optional<TransportMetricsSampler> metricsSampler_;
+  std::chrono::milliseconds metricsInterval_{0};
+  folly::Function<void(const TransportMetrics&)> metricsCallback_;
+  RequestTimeout metricsTimeout_;
 };
 } // namespace moxygen
@@ -15,6 +15,72 @@ class ObjectReceiverCallback {
   virtual void onEndOfStream() = 0;
   virtual void onError(ResetStreamErrorCode) = 0;
   virtual void onSubscribeDone(SubscribeDone done) = 0;
+  // Invoked when catch-up mode abandons a stale subgroup.  liveGroup is the
+  // newest group the receiver has seen.
+  virtual void onSubgroupSkipped(
+      uint64_t /*groupID*/,
+      uint64_t /*subgroupID*/,
+      uint64_t /*liveGroup*/) {}
+};
+
+// Opt-in policy for live subscribers that would rather drop stale data than
+// accumulate latency.  A subgroup is considered stale once its group trails
+// the newest opened group by more than maxGroupLag, or (if configured) once
+// the timestamp extension of its objects trails the newest timestamp seen by
+// more than maxTimestampLag.  Stale subgroups return CANCELLED, which causes
+// the session to send STOP_SENDING on the stream.
+struct CatchUpPolicy {
+  uint64_t maxGroupLag{1};
+  folly::Optional<uint64_t> timestampExtensionType;
+  uint64_t maxTimestampLag{0};
+};
+
+class CatchUpState {
+ public:
+  explicit CatchUpState(CatchUpPolicy policy) : policy_(std::move(policy)) {}
+
+  void onGroup(uint64_t groupID) {
+    if (!newestGroup_ || groupID > *newestGroup_) {
+      newestGroup_ = groupID;
+    }
+  }
+
+  // Returns the timestamp extension of an object, if present, and records it
+  // as the newest timestamp seen.
+  folly::Optional<uint64_t> onExtensions(const Extensions& extensions) {
+    if (!policy_.timestampExtensionType) {
+      return folly::none;
+    }
+    for (const auto& ext : extensions) {
+      if (ext.type == *policy_.timestampExtensionType) {
+        if (!newestTimestamp_ || ext.intValue > *newestTimestamp_) {
+          newestTimestamp_ = ext.intValue;
+        }
+        return ext.intValue;
+      }
+    }
+    return folly::none;
+  }
+
+  bool isStale(
+      uint64_t groupID,
+      folly::Optional<uint64_t> timestamp = folly::none) const {
+    if (newestGroup_ && *newestGroup_ > groupID &&
+        *newestGroup_ - groupID > policy_.maxGroupLag) {
+      return true;
+    }
+    return timestamp && newestTimestamp_ &&
+        *newestTimestamp_ - *timestamp > policy_.maxTimestampLag;
+  }
+
+  uint64_t newestGroup() const {
+    return newestGroup_.value_or(0);
+  }
+
+ private:
+  CatchUpPolicy policy_;
+  folly::Optional<uint64_t> newestGroup_;
+  folly::Optional<uint64_t> newestTimestamp_;
 };
 
 class ObjectSubgroupReceiver : public SubgroupConsumer {
@@ -22,16 +88,41 @@ class ObjectSubgroupReceiver : public SubgroupConsumer {
   StreamType streamType_;
   ObjectHeader header_;
   folly::IOBufQueue payload_{folly::IOBufQueue::cacheChainLength()};
+  std::shared_ptr<CatchUpState> catchUp_;
+  folly::Optional<uint64_t> lastTimestamp_;
+  bool skipped_{false};
+
+  folly::Expected<folly::Unit, MoQPublishError> checkCatchUp() {
+    if (!catchUp_) {
+      return folly::unit;
+    }
+    if (!skipped_ && catchUp_->isStale(header_.group, lastTimestamp_)) {
+      skipped_ = true;
+      payload_.move();
+      XLOG(DBG1) << "Skipping stale subgroup group=" << header_.group
+                 << " subgroup=" << header_.subgroup
+                 << " live=" << catchUp_->newestGroup();
+      callback_->onSubgroupSkipped(
+          header_.group, header_.subgroup, catchUp_->newestGroup());
+    }
+    if (skipped_) {
+      return folly::makeUnexpected(
+          MoQPublishError(MoQPublishError::CANCELLED, "Stale subgroup"));
+    }
+    return folly::unit;
+  }
 
  public:
   explicit ObjectSubgroupReceiver(
       ObjectReceiverCallback* callback,
       uint64_t groupID = 0,
       uint64_t subgroupID = 0,
-      uint8_t priority = 0)
+      uint8_t priority = 0,
+      std::shared_ptr<CatchUpState> catchUp = nullptr)
       : callback_(callback),
         streamType_(StreamType::SUBGROUP_HEADER),
-        header_(TrackAlias(0), groupID, subgroupID, 0, priority) {}
+        header_(TrackAlias(0), groupID, subgroupID, 0, priority),
+        catchUp_(std::move(catchUp)) {}
 
   void setFetchGroupAndSubgroup(uint64_t groupID, uint64_t subgroupID) {
     streamType_ = StreamType::FETCH_HEADER;
@@ -41,6 +132,13 @@ class ObjectSubgroupReceiver : public SubgroupConsumer {
 
   folly::Expected<folly::Unit, MoQPublishError>
   object(uint64_t objectID, Payload payload, Extensions ext, bool) override {
+    if (catchUp_) {
+      lastTimestamp_ = catchUp_->onExtensions(ext);
+    }
+    auto res = checkCatchUp();
+    if (!res) {
+      return res;
+    }
     header_.id = objectID;
     header_.status = ObjectStatus::NORMAL;
     header_.extensions = std::move(ext);
@@ -59,6 +157,10 @@ class ObjectSubgroupReceiver : public SubgroupConsumer {
       uint64_t objectID,
       Extensions ext,
       bool /*finSubgroup*/) override {
+    auto res = checkCatchUp();
+    if (!res) {
+      return res;
+    }
     header_.id = objectID;
     header_.status = ObjectStatus::OBJECT_NOT_EXIST;
     header_.extensions = std::move(ext);
@@ -71,6 +173,13 @@ class ObjectSubgroupReceiver : public SubgroupConsumer {
       uint64_t length,
       Payload initialPayload,
       Extensions ext) override {
+    if (catchUp_) {
+      lastTimestamp_ = catchUp_->onExtensions(ext);
+    }
+    auto res = checkCatchUp();
+    if (!res) {
+      return res;
+    }
     header_.id = objectID;
     header_.length = length;
     header_.status = ObjectStatus::NORMAL;
@@ -83,6 +192,10 @@ class ObjectSubgroupReceiver : public SubgroupConsumer {
       Payload payload,
       bool /*finSubgroup*/) override {
     // TODO: add common component for state verification
+    auto res = checkCatchUp();
+    if (!res) {
+      return folly::makeUnexpected(std::move(res.error()));
+    }
     payload_.append(std::move(payload));
     if (payload_.chainLength() == header_.length) {
       auto fcState = callback_->onObject(header_, payload_.move());
@@ -128,6 +241,7 @@ class ObjectSubgroupReceiver : public SubgroupConsumer {
 class ObjectReceiver : public TrackConsumer, public FetchConsumer {
   ObjectReceiverCallback* callback_{nullptr};
   folly::Optional<ObjectSubgroupReceiver> fetchPublisher_;
+  std::shared_ptr<CatchUpState> catchUp_;
 
  public:
   enum Type { SUBSCRIBE, FETCH };
@@ -138,11 +252,30 @@ class ObjectReceiver : public TrackConsumer, public FetchConsumer {
     }
   }
 
+  // Enable catch-up-to-live for SUBSCRIBE receivers.  Must be called before
+  // the first subgroup arrives.
+  void setCatchUpPolicy(CatchUpPolicy policy) {
+    XCHECK(!fetchPublisher_) << "Catch-up mode is not supported for FETCH";
+    catchUp_ = std::make_shared<CatchUpState>(std::move(policy));
+  }
+
   folly::Expected<std::shared_ptr<SubgroupConsumer>, MoQPublishError>
   beginSubgroup(uint64_t groupID, uint64_t subgroupID, Priority priority)
       override {
+    if (catchUp_) {
+      catchUp_->onGroup(groupID);
+      if (catchUp_->isStale(groupID)) {
+        XLOG(DBG1) << "Rejecting stale subgroup group=" << groupID
+                   << " subgroup=" << subgroupID
+                   << " live=" << catchUp_->newestGroup();
+        callback_->onSubgroupSkipped(
+            groupID, subgroupID, catchUp_->newestGroup());
+        return folly::makeUnexpected(
+            MoQPublishError(MoQPublishError::CANCELLED, "Stale subgroup"));
+      }
+    }
     return std::make_shared<ObjectSubgroupReceiver>(
-        callback_, groupID, subgroupID, priority);
+        callback_, groupID, subgroupID, priority, catchUp_);
   }
 
   folly::Expected<folly::SemiFuture<folly::Unit>, MoQPublishError>
@@ -0,0 +1,605 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/cmaf/CmafMuxer.h"
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/logging/xlog.h>
+
+namespace {
+using Buf = std::unique_ptr<folly::IOBuf>;
+
+constexpr uint32_t kVideoTrackHandler = 0x76696465; // 'vide'
+constexpr uint32_t kAudioTrackHandler = 0x736f756e; // 'soun'
+constexpr uint32_t kSyncSampleFlags = 0x02000000;
+constexpr uint32_t kNonSyncSampleFlags = 0x01010000;
+constexpr uint16_t kLanguageUndetermined = 0x55c4;
+// trun flags: data-offset, sample duration, size, flags and composition offset
+constexpr uint32_t kTrunFlags = 0x000001 | 0x000100 | 0x000200 | 0x000400 |
+    0x000800;
+constexpr uint32_t kTfhdDefaultBaseIsMoof = 0x020000;
+
+constexpr size_t kMfhdSize = 16;
+constexpr size_t kTfhdSize = 16;
+constexpr size_t kTfdtSize = 20;
+constexpr size_t kTrunHeaderSize = 20;
+constexpr size_t kTrunEntrySize = 16;
+
+// Accumulates the body of a box
+class BoxBody {
+ public:
+  BoxBody() = default;
+  BoxBody(const BoxBody&) = delete;
+  BoxBody& operator=(const BoxBody&) = delete;
+
+  template <class T>
+  BoxBody& be(T value) {
+    appender_.writeBE<T>(value);
+    return *this;
+  }
+
+  BoxBody& zeros(size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      appender_.writeBE<uint8_t>(0);
+    }
+    return *this;
+  }
+
+  BoxBody& fourcc(const char* code) {
+    appender_.push(reinterpret_cast<const uint8_t*>(code), 4);
+    return *this;
+  }
+
+  BoxBody& append(Buf buf) {
+    queue_.append(std::move(buf));
+    return *this;
+  }
+
+  Buf move() {
+    return queue_.move();
+  }
+
+ private:
+  folly::IOBufQueue queue_{folly::IOBufQueue::cacheChainLength()};
+  folly::io::QueueAppender appender_{&queue_, 128};
+};
+
+Buf box(const char* type, Buf body) {
+  auto length = body ? body->computeChainDataLength() : 0;
+  BoxBody header;
+  header.be<uint32_t>(8 + length).fourcc(type).append(std::move(body));
+  return header.move();
+}
+
+Buf fullBox(const char* type, uint8_t version, uint32_t flags, Buf body) {
+  BoxBody header;
+  header.be<uint32_t>((uint32_t(version) << 24) | (flags & 0xffffff))
+      .append(std::move(body));
+  return box(type, header.move());
+}
+
+template <class... Bufs>
+Buf concat(Bufs... bufs) {
+  folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+  (queue.append(std::move(bufs)), ...);
+  return queue.move();
+}
+
+// unity matrix used by mvhd and tkhd
+void writeMatrix(BoxBody& body) {
+  body.be<uint32_t>(0x00010000).be<uint32_t>(0).be<uint32_t>(0);
+  body.be<uint32_t>(0).be<uint32_t>(0x00010000).be<uint32_t>(0);
+  body.be<uint32_t>(0).be<uint32_t>(0).be<uint32_t>(0x40000000);
+}
+
+Buf emptySampleTables() {
+  BoxBody stts;
+  stts.be<uint32_t>(0);
+  BoxBody stsc;
+  stsc.be<uint32_t>(0);
+  BoxBody stsz;
+  stsz.be<uint32_t>(0).be<uint32_t>(0);
+  BoxBody stco;
+  stco.be<uint32_t>(0);
+  return concat(
+      fullBox("stts", 0, 0, stts.move()),
+      fullBox("stsc", 0, 0, stsc.move()),
+      fullBox("stsz", 0, 0, stsz.move()),
+      fullBox("stco", 0, 0, stco.move()));
+}
+
+Buf dataInformation() {
+  BoxBody dref;
+  dref.be<uint32_t>(1).append(fullBox("url ", 0, 1, nullptr));
+  return box("dinf", fullBox("dref", 0, 0, dref.move()));
+}
+
+Buf trak(
+    uint32_t trackId,
+    uint64_t timescale,
+    uint32_t handler,
+    uint32_t width,
+    uint32_t height,
+    Buf mediaHeader,
+    Buf sampleEntry) {
+  bool isAudio = handler == kAudioTrackHandler;
+  BoxBody tkhd;
+  tkhd.be<uint32_t>(0).be<uint32_t>(0); // creation/modification time
+  tkhd.be<uint32_t>(trackId).be<uint32_t>(0).be<uint32_t>(0); // duration
+  tkhd.zeros(8).be<uint16_t>(0).be<uint16_t>(isAudio ? 1 : 0);
+  tkhd.be<uint16_t>(isAudio ? 0x0100 : 0).be<uint16_t>(0);
+  writeMatrix(tkhd);
+  tkhd.be<uint32_t>(width << 16).be<uint32_t>(height << 16);
+
+  BoxBody mdhd;
+  mdhd.be<uint32_t>(0).be<uint32_t>(0).be<uint32_t>(timescale);
+  mdhd.be<uint32_t>(0).be<uint16_t>(kLanguageUndetermined).be<uint16_t>(0);
+
+  BoxBody hdlr;
+  hdlr.be<uint32_t>(0).be<uint32_t>(handler).zeros(12);
+  hdlr.fourcc(isAudio ? "soun" : "vide").be<uint8_t>(0);
+
+  BoxBody stsd;
+  stsd.be<uint32_t>(1).append(std::move(sampleEntry));
+
+  auto stbl = box(
+      "stbl", concat(fullBox("stsd", 0, 0, stsd.move()), emptySampleTables()));
+  auto minf = box(
+      "minf",
+      concat(std::move(mediaHeader), dataInformation(), std::move(stbl)));
+  auto mdia = box(
+      "mdia",
+      concat(
+          fullBox("mdhd", 0, 0, mdhd.move()),
+          fullBox("hdlr", 0, 0, hdlr.move()),
+          std::move(minf)));
+  return box(
+      "trak", concat(fullBox("tkhd", 0, 3, tkhd.move()), std::move(mdia)));
+}
+
+// Exp-Golomb reader over an SPS RBSP
+class ExpGolombReader {
+ public:
+  explicit ExpGolombReader(Buf rbsp) : reader_(std::move(rbsp)) {}
+
+  uint64_t bits(uint8_t n) {
+    return reader_.getNextBits(n);
+  }
+
+  uint64_t ue() {
+    uint8_t leadingZeros = 0;
+    while (bits(1) == 0) {
+      if (++leadingZeros > 31) {
+        throw std::runtime_error("Invalid exp-golomb code");
+      }
+    }
+    return (1ull << leadingZeros) - 1 + bits(leadingZeros);
+  }
+
+  int64_t se() {
+    auto v = ue();
+    return (v & 1) ? int64_t((v + 1) / 2) : -int64_t(v / 2);
+  }
+
+ private:
+  moxygen::flv::BitReader reader_;
+};
+
+void skipScalingList(ExpGolombReader& reader, size_t size) {
+  int64_t lastScale = 8;
+  int64_t nextScale = 8;
+  for (size_t j = 0; j < size; j++) {
+    if (nextScale != 0) {
+      nextScale = (lastScale + reader.se() + 256) % 256;
+    }
+    lastScale = nextScale == 0 ? lastScale : nextScale;
+  }
+}
+
+bool hasChromaFormat(uint64_t profileIdc) {
+  switch (profileIdc) {
+    case 100:
+    case 110:
+    case 122:
+    case 244:
+    case 44:
+    case 83:
+    case 86:
+    case 118:
+    case 128:
+    case 138:
+    case 139:
+    case 134:
+    case 135:
+      return true;
+    default:
+      return false;
+  }
+}
+} // namespace
+
+namespace moxygen::cmaf {
+
+CmafMuxer::CmafMuxer(Config config, SegmentCallback callback)
+    : config_(config), callback_(std::move(callback)) {
+  uint32_t nextTrackId = 1;
+  if (config_.hasVideo) {
+    video_.id = nextTrackId++;
+  }
+  if (config_.hasAudio) {
+    audio_.id = nextTrackId++;
+  }
+}
+
+void CmafMuxer::add(MoQMi::MoqMiTag tag) {
+  if (tag.index() == MoQMi::MoqMITagTypeIndex::MOQMI_TAG_INDEX_VIDEO_H264_AVC) {
+    addVideo(std::move(
+        std::get<MoQMi::MoqMITagTypeIndex::MOQMI_TAG_INDEX_VIDEO_H264_AVC>(
+            tag)));
+  } else if (
+      tag.index() == MoQMi::MoqMITagTypeIndex::MOQMI_TAG_INDEX_AUDIO_AAC_LC) {
+    addAudio(std::move(
+        std::get<MoQMi::MoqMITagTypeIndex::MOQMI_TAG_INDEX_AUDIO_AAC_LC>(tag)));
+  }
+}
+
+void CmafMuxer::addVideo(std::unique_ptr<MoQMi::VideoH264AVCCWCPData> video) {
+  if (!config_.hasVideo || !video || !video->data) {
+    return;
+  }
+  if (video->metadata && !avcDecoderConfig_) {
+    auto dimensions = parseAvcDimensions(*video->metadata);
+    if (!dimensions) {
+      XLOG(ERR) << "Unable to parse SPS from AVC decoder config";
+    }
+    videoDimensions_ = dimensions.value_or(VideoDimensions());
+    avcDecoderConfig_ = std::move(video->metadata);
+  }
+  bool isIdr = video->isIdr();
+  if (isIdr) {
+    // New GOP (and MoQ group): close the previous segment
+    if (maybeSendInit()) {
+      flush();
+    } else {
+      dropPending();
+    }
+  } else if (video_.samples.empty()) {
+    XLOG(DBG1) << "Discarding non-IDR frame before first IDR";
+    return;
+  }
+  auto dts = video->dts;
+  auto pts = video->pts;
+  addSample(
+      video_,
+      std::move(video->data),
+      dts,
+      pts,
+      video->timescale,
+      video->duration,
+      isIdr);
+}
+
+void CmafMuxer::addAudio(std::unique_ptr<MoQMi::AudioAACMP4LCWCPData> audio) {
+  if (!config_.hasAudio || !audio || !audio->data) {
+    return;
+  }
+  if (!audioSpecificConfig_) {
+    sampleFreq_ = audio->sampleFreq;
+    numChannels_ = audio->numChannels;
+    audioSpecificConfig_ = audio->getAscHeader();
+    audio_.timescale = audio->timescale;
+  }
+  if (config_.hasVideo && video_.samples.empty()) {
+    // Segments start at a video IDR, audio before it cannot be placed
+    return;
+  }
+  auto pts = audio->pts;
+  addSample(
+      audio_,
+      std::move(audio->data),
+      pts,
+      pts,
+      audio->timescale,
+      audio->duration,
+      true);
+  if (!config_.hasVideo && audio_.timescale > 0) {
+    auto span = audio_.samples.back().dts - audio_.samples.front().dts;
+    if (span * 1000 / audio_.timescale >=
+            uint64_t(config_.audioOnlyFragment.count()) &&
+        maybeSendInit()) {
+      flush();
+    }
+  }
+}
+
+void CmafMuxer::addSample(
+    Track& track,
+    std::unique_ptr<folly::IOBuf> data,
+    uint64_t dts,
+    uint64_t pts,
+    uint64_t timescale,
+    uint64_t duration,
+    bool sync) {
+  if (track.timescale == 0) {
+    track.timescale = timescale;
+  }
+  if (!origin_) {
+    // Audio is only added once a video IDR is, unless there is no video
+    origin_ = dts;
+    originTimescale_ = track.timescale;
+  }
+  auto origin = *origin_ * track.timescale / originTimescale_;
+  if (dts < origin) {
+    XLOG(WARN) << "Dropping sample that precedes the stream start, dts=" << dts;
+    return;
+  }
+  track.samples.push_back(Sample{
+      std::move(data),
+      dts - origin,
+      int64_t(pts) - int64_t(dts),
+      duration,
+      sync});
+}
+
+bool CmafMuxer::maybeSendInit() {
+  if (initSent_) {
+    return true;
+  }
+  if ((config_.hasVideo && (!avcDecoderConfig_ || video_.timescale == 0)) ||
+      (config_.hasAudio && (!audioSpecificConfig_ || audio_.timescale == 0))) {
+    return false;
+  }
+  initSent_ = true;
+  callback_(makeInitSegment(), true);
+  return true;
+}
+
+void CmafMuxer::dropPending() {
+  if (!video_.samples.empty() || !audio_.samples.empty()) {
+    XLOG(DBG1) << "Dropping samples received before track configuration";
+  }
+  video_.samples.clear();
+  audio_.samples.clear();
+  // Nothing was sent relative to it
+  origin_.reset();
+}
+
+void CmafMuxer::flush() {
+  if (video_.samples.empty() && audio_.samples.empty()) {
+    return;
+  }
+  if (!maybeSendInit()) {
+    return;
+  }
+  callback_(makeMediaSegment(), false);
+}
+
+std::unique_ptr<folly::IOBuf> CmafMuxer::makeInitSegment() const {
+  BoxBody ftyp;
+  ftyp.fourcc("iso6").be<uint32_t>(0);
+  ftyp.fourcc("iso6").fourcc("cmfc").fourcc("mp41");
+
+  BoxBody mvhd;
+  mvhd.be<uint32_t>(0).be<uint32_t>(0).be<uint32_t>(1000).be<uint32_t>(0);
+  mvhd.be<uint32_t>(0x00010000).be<uint16_t>(0x0100).zeros(10);
+  writeMatrix(mvhd);
+  mvhd.zeros(24).be<uint32_t>(std::max(video_.id, audio_.id) + 1);
+
+  folly::IOBufQueue traks{folly::IOBufQueue::cacheChainLength()};
+  BoxBody trexs;
+  if (config_.hasVideo) {
+    BoxBody avc1;
+    avc1.zeros(6).be<uint16_t>(1).zeros(16);
+    avc1.be<uint16_t>(videoDimensions_.width);
+    avc1.be<uint16_t>(videoDimensions_.height);
+    avc1.be<uint32_t>(0x00480000).be<uint32_t>(0x00480000).be<uint32_t>(0);
+    avc1.be<uint16_t>(1).zeros(32).be<uint16_t>(0x0018).be<int16_t>(-1);
+    avc1.append(box("avcC", avcDecoderConfig_->clone()));
+    BoxBody vmhd;
+    vmhd.zeros(8);
+    traks.append(trak(
+        video_.id,
+        video_.timescale,
+        kVideoTrackHandler,
+        videoDimensions_.width,
+        videoDimensions_.height,
+        fullBox("vmhd", 0, 1, vmhd.move()),
+        box("avc1", avc1.move())));
+  }
+  if (config_.hasAudio) {
+    auto ascLength = audioSpecificConfig_->computeChainDataLength();
+    // ES_Descriptor containing DecoderConfigDescriptor (AAC, audio stream)
+    // with the AudioSpecificConfig, followed by SLConfigDescriptor
+    BoxBody esds;
+    esds.be<uint8_t>(0x03).be<uint8_t>(23 + ascLength);
+    esds.be<uint16_t>(audio_.id).be<uint8_t>(0);
+    esds.be<uint8_t>(0x04).be<uint8_t>(15 + ascLength);
+    esds.be<uint8_t>(0x40).be<uint8_t>(0x15).zeros(3);
+    esds.be<uint32_t>(0).be<uint32_t>(0);
+    esds.be<uint8_t>(0x05).be<uint8_t>(ascLength);
+    esds.append(audioSpecificConfig_->clone());
+    BoxBody slConfig;
+    slConfig.be<uint8_t>(0x06).be<uint8_t>(1).be<uint8_t>(0x02);
+    esds.append(slConfig.move());
+
+    BoxBody mp4a;
+    mp4a.zeros(6).be<uint16_t>(1).zeros(8);
+    mp4a.be<uint16_t>(numChannels_).be<uint16_t>(16).zeros(4);
+    mp4a.be<uint32_t>(uint32_t(sampleFreq_) << 16);
+    mp4a.append(fullBox("esds", 0, 0, esds.move()));
+    BoxBody smhd;
+    smhd.zeros(4);
+    traks.append(trak(
+        audio_.id,
+        audio_.timescale,
+        kAudioTrackHandler,
+        0,
+        0,
+        fullBox("smhd", 0, 0, smhd.move()),
+        box("mp4a", mp4a.move())));
+  }
+  for (auto trackId : {video_.id, audio_.id}) {
+    if (trackId == 0) {
+      continue;
+    }
+    BoxBody trex;
+    trex.be<uint32_t>(trackId).be<uint32_t>(1).zeros(12);
+    trexs.append(fullBox("trex", 0, 0, trex.move()));
+  }
+
+  auto moov = box(
+      "moov",
+      concat(
+          fullBox("mvhd", 0, 0, mvhd.move()),
+          traks.move(),
+          box("mvex", trexs.move())));
+  return concat(box("ftyp", ftyp.move()), std::move(moov));
+}
+
+std::unique_ptr<folly::IOBuf> CmafMuxer::makeMediaSegment() {
+  std::vector<Track*> tracks;
+  for (auto track : {&video_, &audio_}) {
+    if (!track->samples.empty()) {
+      tracks.push_back(track);
+    }
+  }
+  size_t moofSize = 8 + kMfhdSize;
+  for (auto track : tracks) {
+    moofSize += 8 + kTfhdSize + kTfdtSize + kTrunHeaderSize +
+        kTrunEntrySize * track->samples.size();
+  }
+
+  BoxBody mfhd;
+  mfhd.be<uint32_t>(++sequenceNumber_);
+  folly::IOBufQueue trafs{folly::IOBufQueue::cacheChainLength()};
+  folly::IOBufQueue mdat{folly::IOBufQueue::cacheChainLength()};
+  size_t dataOffset = moofSize + 8;
+  for (auto track : tracks) {
+    auto& samples = track->samples;
+    BoxBody tfhd;
+    tfhd.be<uint32_t>(track->id);
+    BoxBody tfdt;
+    tfdt.be<uint64_t>(samples.front().dts);
+    BoxBody trun;
+    trun.be<uint32_t>(samples.size()).be<uint32_t>(dataOffset);
+    for (size_t i = 0; i < samples.size(); i++) {
+      auto& sample = samples[i];
+      // Prefer the decode timestamp delta, falling back to the signalled
+      // duration for the last sample of the fragment
+      uint64_t duration = i + 1 < samples.size()
+          ? samples[i + 1].dts - sample.dts
+          : (sample.duration > 0 ? sample.duration : track->lastDuration);
+      track->lastDuration = duration;
+      auto size = sample.data->computeChainDataLength();
+      trun.be<uint32_t>(duration).be<uint32_t>(size);
+      trun.be<uint32_t>(sample.sync ? kSyncSampleFlags : kNonSyncSampleFlags);
+      trun.be<int32_t>(sample.compositionOffset);
+      dataOffset += size;
+      mdat.append(std::move(sample.data));
+    }
+    trafs.append(box(
+        "traf",
+        concat(
+            fullBox("tfhd", 0, kTfhdDefaultBaseIsMoof, tfhd.move()),
+            fullBox("tfdt", 1, 0, tfdt.move()),
+            fullBox("trun", 1, kTrunFlags, trun.move()))));
+    samples.clear();
+  }
+  auto moof =
+      box("moof", concat(fullBox("mfhd", 0, 0, mfhd.move()), trafs.move()));
+  XDCHECK_EQ(moof->computeChainDataLength(), moofSize);
+  return concat(std::move(moof), box("mdat", mdat.move()));
+}
+
+folly::Optional<CmafMuxer::VideoDimensions> CmafMuxer::parseAvcDimensions(
+    const folly::IOBuf& avcDecoderConfig) {
+  try {
+    folly::io::Cursor cursor(&avcDecoderConfig);
+    cursor.skip(5); // version, profile, compatibility, level, length size
+    if ((cursor.read<uint8_t>() & 0x1f) == 0) {
+      return folly::none;
+    }
+    auto spsLength = cursor.readBE<uint16_t>();
+    // Skip the NAL header and strip emulation prevention bytes
+    cursor.skip(1);
+    auto rbsp = folly::IOBuf::create(spsLength);
+    size_t zeros = 0;
+    for (size_t i = 1; i < spsLength; i++) {
+      auto byte = cursor.read<uint8_t>();
+      if (zeros >= 2 && byte == 0x03) {
+        zeros = 0;
+        continue;
+      }
+      zeros = byte == 0 ? zeros + 1 : 0;
+      rbsp->writableTail()[0] = byte;
+      rbsp->append(1);
+    }
+
+    ExpGolombReader reader(std::move(rbsp));
+    auto profileIdc = reader.bits(8);
+    reader.bits(16); // constraint flags, level
+    reader.ue(); // seq_parameter_set_id
+    uint64_t chromaFormatIdc = 1;
+    if (hasChromaFormat(profileIdc)) {
+      chromaFormatIdc = reader.ue();
+      if (chromaFormatIdc == 3) {
+        reader.bits(1); // separate_colour_plane_flag
+      }
+      reader.ue(); // bit_depth_luma_minus8
+      reader.ue(); // bit_depth_chroma_minus8
+      reader.bits(1); // qpprime_y_zero_transform_bypass_flag
+      if (reader.bits(1)) {
+        for (size_t i = 0; i < (chromaFormatIdc != 3 ? 8 : 12); i++) {
+          if (reader.bits(1)) {
+            skipScalingList(reader, i < 6 ? 16 : 64);
+          }
+        }
+      }
+    }
+    reader.ue(); // log2_max_frame_num_minus4
+    auto picOrderCntType = reader.ue();
+    if (picOrderCntType == 0) {
+      reader.ue(); // log2_max_pic_order_cnt_lsb_minus4
+    } else if (picOrderCntType == 1) {
+      reader.bits(1); // delta_pic_order_always_zero_flag
+      reader.se(); // offset_for_non_ref_pic
+      reader.se(); // offset_for_top_to_bottom_field
+      auto numRefFramesInCycle = reader.ue();
+      for (uint64_t i = 0; i < numRefFramesInCycle; i++) {
+        reader.se();
+      }
+    }
+    reader.ue(); // max_num_ref_frames
+    reader.bits(1); // gaps_in_frame_num_value_allowed_flag
+    auto widthInMbs = reader.ue() + 1;
+    auto heightInMapUnits = reader.ue() + 1;
+    auto frameMbsOnly = reader.bits(1);
+    if (!frameMbsOnly) {
+      reader.bits(1); // mb_adaptive_frame_field_flag
+    }
+    reader.bits(1); // direct_8x8_inference_flag
+    uint64_t cropLeft = 0, cropRight = 0, cropTop = 0, cropBottom = 0;
+    if (reader.bits(1)) {
+      cropLeft = reader.ue();
+      cropRight = reader.ue();
+      cropTop = reader.ue();
+      cropBottom = reader.ue();
+    }
+    uint64_t cropUnitX = chromaFormatIdc == 0 || chromaFormatIdc == 3 ? 1 : 2;
+    uint64_t cropUnitY = (chromaFormatIdc == 1 ? 2 : 1) * (2 - frameMbsOnly);
+    VideoDimensions dimensions;
+    dimensions.width = widthInMbs * 16 - (cropLeft + cropRight) * cropUnitX;
+    dimensions.height = (2 - frameMbsOnly) * heightInMapUnits * 16 -
+        (cropTop + cropBottom) * cropUnitY;
+    return dimensions;
+  } catch (const std::exception& ex) {
+    XLOG(ERR) << "Invalid SPS: " << ex.what();
+    return folly::none;
+  }
+}
+
+} // namespace moxygen::cmaf
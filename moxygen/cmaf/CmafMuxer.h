@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/Optional.h>
+#include <folly/io/IOBuf.h>
+#include <chrono>
+#include <vector>
+#include "moxygen/moq_mi/MoQMi.h"
+
+namespace moxygen::cmaf {
+
+// Streaming fragmented MP4 (CMAF) muxer for MoQMi H264 AVCC video and AAC-LC
+// audio payloads.
+//
+// Emits one init segment (ftyp + moov) as soon as the configuration of every
+// enabled track is known, then one media segment (moof + mdat) per video
+// group of pictures. MoQMi publishers start a MoQ group on every IDR, so
+// segments line up with MoQ groups. Sample payloads are chained into the mdat
+// without copying.
+class CmafMuxer {
+ public:
+  struct Config {
+    bool hasVideo{true};
+    bool hasAudio{true};
+    // Fragment length when there is no video track to align to
+    std::chrono::milliseconds audioOnlyFragment{1000};
+  };
+
+  using SegmentCallback =
+      folly::Function<void(std::unique_ptr<folly::IOBuf> segment, bool init)>;
+
+  CmafMuxer(Config config, SegmentCallback callback);
+
+  void addVideo(std::unique_ptr<MoQMi::VideoH264AVCCWCPData> video);
+  void addAudio(std::unique_ptr<MoQMi::AudioAACMP4LCWCPData> audio);
+  void add(MoQMi::MoqMiTag tag);
+
+  // Emits pending samples as a media segment, ie: at end of stream
+  void flush();
+
+  struct VideoDimensions {
+    uint32_t width{0};
+    uint32_t height{0};
+  };
+  // Reads the coded size from the first SPS of an AVCDecoderConfigurationRecord
+  static folly::Optional<VideoDimensions> parseAvcDimensions(
+      const folly::IOBuf& avcDecoderConfig);
+
+ private:
+  struct Sample {
+    std::unique_ptr<folly::IOBuf> data;
+    uint64_t dts{0};
+    int64_t compositionOffset{0};
+    uint64_t duration{0};
+    bool sync{true};
+  };
+
+  struct Track {
+    uint32_t id{0};
+    uint64_t timescale{0};
+    uint64_t lastDuration{0};
+    std::vector<Sample> samples;
+  };
+
+  void addSample(
+      Track& track,
+      std::unique_ptr<folly::IOBuf> data,
+      uint64_t dts,
+      uint64_t pts,
+      uint64_t timescale,
+      uint64_t duration,
+      bool sync);
+  bool maybeSendInit();
+  void dropPending();
+  std::unique_ptr<folly::IOBuf> makeInitSegment() const;
+  std::unique_ptr<folly::IOBuf> makeMediaSegment();
+
+  Config config_;
+  SegmentCallback callback_;
+  Track video_;
+  Track audio_;
+  bool initSent_{false};
+  // Decode times of every track count from the first video IDR, or from the
+  // first audio sample without video, so that their tfdts line up
+  folly::Optional<uint64_t> origin_;
+  uint64_t originTimescale_{0};
+  uint32_t sequenceNumber_{0};
+
+  std::unique_ptr<folly::IOBuf> avcDecoderConfig_;
+  VideoDimensions videoDimensions_;
+  std::unique_ptr<folly::IOBuf> audioSpecificConfig_;
+  uint64_t sampleFreq_{0};
+  uint64_t numChannels_{0};
+};
+
+} // namespace moxygen::cmaf
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/cmaf/CmafMuxer.h"
+
+#include <folly/io/Cursor.h>
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+using namespace moxygen::cmaf;
+
+namespace {
+
+// Baseline profile SPS, 640x480
+const uint8_t kSpsBaseline[] =
+    {0x67, 0x42, 0xc0, 0x1e, 0xda, 0x02, 0x80, 0xf6, 0x40};
+// High profile SPS, 1920x1088 cropped to 1920x1080
+const uint8_t kSpsHigh[] =
+    {0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0x40};
+
+std::unique_ptr<folly::IOBuf> makeAvcc(const uint8_t* sps, size_t spsLength) {
+  auto avcc = folly::IOBuf::create(64);
+  folly::io::Appender appender(avcc.get(), 64);
+  appender.writeBE<uint8_t>(1);
+  appender.push(sps + 1, 3); // profile, compatibility, level
+  appender.writeBE<uint8_t>(0xff);
+  appender.writeBE<uint8_t>(0xe1);
+  appender.writeBE<uint16_t>(spsLength);
+  appender.push(sps, spsLength);
+  appender.writeBE<uint8_t>(1);
+  const uint8_t pps[] = {0x68, 0xce, 0x3c, 0x80};
+  appender.writeBE<uint16_t>(sizeof(pps));
+  appender.push(pps, sizeof(pps));
+  return avcc;
+}
+
+std::unique_ptr<MoQMi::VideoH264AVCCWCPData> makeVideo(
+    uint64_t seqId,
+    uint64_t dts,
+    bool idr) {
+  const uint8_t nalu[] = {0x00, 0x00, 0x00, 0x01, uint8_t(idr ? 0x05 : 0x01)};
+  return std::make_unique<MoQMi::VideoH264AVCCWCPData>(
+      seqId,
+      dts,
+      1000,
+      33,
+      0,
+      folly::IOBuf::copyBuffer(nalu, sizeof(nalu)),
+      idr ? makeAvcc(kSpsBaseline, sizeof(kSpsBaseline)) : nullptr,
+      dts);
+}
+
+std::unique_ptr<MoQMi::AudioAACMP4LCWCPData>
+makeAudio(uint64_t seqId, uint64_t pts, uint64_t timescale = 1000) {
+  return std::make_unique<MoQMi::AudioAACMP4LCWCPData>(
+      seqId,
+      pts,
+      timescale,
+      23 * timescale / 1000,
+      0,
+      folly::IOBuf::copyBuffer("aac"),
+      48000,
+      2);
+}
+
+// Top level box types in order
+std::vector<std::string> boxTypes(const std::string& segment) {
+  std::vector<std::string> types;
+  size_t pos = 0;
+  while (pos + 8 <= segment.size()) {
+    auto header = folly::IOBuf::wrapBuffer(segment.data() + pos, 8);
+    folly::io::Cursor cursor(header.get());
+    auto size = cursor.readBE<uint32_t>();
+    types.push_back(cursor.readFixedString(4));
+    if (size < 8) {
+      break;
+    }
+    pos += size;
+  }
+  return types;
+}
+
+uint32_t readU32(const std::string& segment, size_t pos) {
+  auto buf = folly::IOBuf::wrapBuffer(segment.data() + pos, 4);
+  return folly::io::Cursor(buf.get()).readBE<uint32_t>();
+}
+
+uint64_t readU64(const std::string& segment, size_t pos) {
+  auto buf = folly::IOBuf::wrapBuffer(segment.data() + pos, 8);
+  return folly::io::Cursor(buf.get()).readBE<uint64_t>();
+}
+
+struct Collector {
+  std::vector<std::pair<std::string, bool>> segments;
+
+  CmafMuxer::SegmentCallback callback() {
+    return [this](std::unique_ptr<folly::IOBuf> segment, bool init) {
+      segments.emplace_back(segment->moveToFbString().toStdString(), init);
+    };
+  }
+};
+
+} // namespace
+
+TEST(CmafMuxer, ParseAvcDimensions) {
+  auto dims = CmafMuxer::parseAvcDimensions(
+      *makeAvcc(kSpsBaseline, sizeof(kSpsBaseline)));
+  ASSERT_TRUE(dims.has_value());
+  EXPECT_EQ(dims->width, 640);
+  EXPECT_EQ(dims->height, 480);
+
+  dims = CmafMuxer::parseAvcDimensions(*makeAvcc(kSpsHigh, sizeof(kSpsHigh)));
+  ASSERT_TRUE(dims.has_value());
+  EXPECT_EQ(dims->width, 1920);
+  EXPECT_EQ(dims->height, 1080);
+
+  EXPECT_FALSE(CmafMuxer::parseAvcDimensions(*folly::IOBuf::copyBuffer("x")));
+}
+
+TEST(CmafMuxer, SegmentsAlignToGroups) {
+  Collector collector;
+  CmafMuxer muxer({}, collector.callback());
+
+  // Audio before the first IDR cannot be placed
+  muxer.addAudio(makeAudio(0, 0));
+  muxer.addVideo(makeVideo(0, 0, true));
+  muxer.addAudio(makeAudio(1, 10));
+  muxer.addVideo(makeVideo(1, 33, false));
+  muxer.addAudio(makeAudio(2, 33));
+  muxer.addVideo(makeVideo(2, 66, false));
+  EXPECT_TRUE(collector.segments.empty());
+
+  // Next group
+  muxer.addVideo(makeVideo(3, 100, true));
+  ASSERT_EQ(collector.segments.size(), 2);
+  EXPECT_TRUE(collector.segments[0].second);
+  EXPECT_EQ(
+      boxTypes(collector.segments[0].first),
+      (std::vector<std::string>{"ftyp", "moov"}));
+  EXPECT_NE(collector.segments[0].first.find("avcC"), std::string::npos);
+  EXPECT_NE(collector.segments[0].first.find("esds"), std::string::npos);
+
+  const auto& media = collector.segments[1].first;
+  EXPECT_FALSE(collector.segments[1].second);
+  EXPECT_EQ(boxTypes(media), (std::vector<std::string>{"moof", "mdat"}));
+  auto moofSize = readU32(media, 0);
+  // 3 video samples (5 bytes) then 2 audio samples (3 bytes)
+  EXPECT_EQ(readU32(media, moofSize), 8 + 3 * 5 + 2 * 3);
+
+  auto trun = media.find("trun");
+  ASSERT_NE(trun, std::string::npos);
+  EXPECT_EQ(readU32(media, trun + 8), 3); // sample count
+  auto dataOffset = readU32(media, trun + 12);
+  EXPECT_EQ(dataOffset, moofSize + 8);
+  EXPECT_EQ(media[dataOffset + 4], 0x05); // IDR NALU
+  EXPECT_EQ(readU32(media, trun + 16), 33); // first sample duration
+
+  auto audioTrun = media.find("trun", trun + 4);
+  ASSERT_NE(audioTrun, std::string::npos);
+  EXPECT_EQ(readU32(media, audioTrun + 8), 2);
+  EXPECT_EQ(
+      media.substr(readU32(media, audioTrun + 12), 6), std::string("aacaac"));
+
+  // Audio starts 10ms after the IDR
+  auto tfdt = media.find("tfdt");
+  ASSERT_NE(tfdt, std::string::npos);
+  EXPECT_EQ(readU64(media, tfdt + 8), 0);
+  auto audioTfdt = media.find("tfdt", tfdt + 4);
+  ASSERT_NE(audioTfdt, std::string::npos);
+  EXPECT_EQ(readU64(media, audioTfdt + 8), 10);
+
+  muxer.flush();
+  ASSERT_EQ(collector.segments.size(), 3);
+  const auto& last = collector.segments[2].first;
+  tfdt = last.find("tfdt");
+  ASSERT_NE(tfdt, std::string::npos);
+  EXPECT_EQ(readU64(last, tfdt + 8), 100);
+}
+
+TEST(CmafMuxer, TracksShareVideoOrigin) {
+  Collector collector;
+  CmafMuxer muxer({}, collector.callback());
+  // Video in ms from 1s, audio at 48kHz from 1.01s
+  muxer.addVideo(makeVideo(0, 1000, true));
+  muxer.addAudio(makeAudio(0, 48480, 48000));
+  muxer.addAudio(makeAudio(1, 49584, 48000));
+  muxer.addVideo(makeVideo(1, 1033, false));
+  muxer.flush();
+  ASSERT_EQ(collector.segments.size(), 2);
+
+  const auto& media = collector.segments[1].first;
+  auto tfdt = media.find("tfdt");
+  ASSERT_NE(tfdt, std::string::npos);
+  EXPECT_EQ(readU64(media, tfdt + 8), 0);
+  auto audioTfdt = media.find("tfdt", tfdt + 4);
+  ASSERT_NE(audioTfdt, std::string::npos);
+  // 10ms in the audio timescale
+  EXPECT_EQ(readU64(media, audioTfdt + 8), 480);
+}
+
+TEST(CmafMuxer, AudioOnlyFragments) {
+  Collector collector;
+  CmafMuxer muxer(
+      {.hasVideo = false,
+       .hasAudio = true,
+       .audioOnlyFragment = std::chrono::milliseconds(100)},
+      collector.callback());
+  for (uint64_t i = 0; i < 10; i++) {
+    muxer.addAudio(makeAudio(i, i * 23));
+  }
+  // The fragment closes once it spans 100ms, the rest stays pending
+  ASSERT_EQ(collector.segments.size(), 2);
+  EXPECT_TRUE(collector.segments[0].second);
+  EXPECT_EQ(boxTypes(collector.segments[0].first).back(), "moov");
+  auto trun = collector.segments[1].first.find("trun");
+  EXPECT_EQ(readU32(collector.segments[1].first, trun + 8), 6);
+}
@@ -78,20 +78,28 @@ class FlvSequentialReader {
   };
 
   explicit FlvSequentialReader(const std::string& file_path)
-      : reader_(file_path),
+      : reader_(std::make_unique<FlvReader>(file_path)),
         file_path_(file_path),
         videoFrameId_(0),
         audioFrameId_(0) {
     XLOG(INFO) << __func__;
   }
+  // No file, tags are pushed with processTag (ex: from FlvStreamParser)
+  FlvSequentialReader() : videoFrameId_(0), audioFrameId_(0) {
+    XLOG(INFO) << __func__;
+  }
   ~FlvSequentialReader() {
     XLOG(INFO) << __func__;
   }
 
   std::unique_ptr<MediaItem> getNextItem();
 
+  // Converts one tag, nullptr if the tag produces no item (sequence
+  // headers, script data, unsupported frames).  Throws on errors.
+  std::unique_ptr<MediaItem> processTag(FlvTag tag);
+
  private:
-  FlvReader reader_;
+  std::unique_ptr<FlvReader> reader_;
   std::string file_path_;
 
   std::unique_ptr<folly::IOBuf> avcDecoderRecord_;
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/flv_parser/FlvStreamParser.h"
+#include <folly/io/Cursor.h>
+#include <folly/logging/xlog.h>
+
+namespace {
+uint32_t read3Bytes(folly::io::Cursor& cursor) {
+  uint32_t high = cursor.read<uint8_t>();
+  return high << 16 | cursor.readBE<uint16_t>();
+}
+} // namespace
+
+namespace moxygen::flv {
+
+bool FlvStreamParser::parse(std::unique_ptr<folly::IOBuf> data) {
+  if (state_ != State::HEADER && state_ != State::TAGS) {
+    return !failed();
+  }
+  buf_.append(std::move(data));
+  parseBuffered();
+  return !failed();
+}
+
+void FlvStreamParser::endOfInput() {
+  if (state_ == State::TAGS &&
+      (buf_.empty() || buf_.chainLength() == kPrevTagSizeBytes)) {
+    // Clean end, only the last previous tag size left
+    state_ = State::DONE;
+    buf_.reset();
+    callback_.onTag(FlvReadCmd::FLV_EOF);
+  } else if (state_ == State::HEADER || state_ == State::TAGS) {
+    fail(fmt::format(
+        "Input ended inside a tag, {} bytes pending", buf_.chainLength()));
+  }
+}
+
+void FlvStreamParser::getReadBuffer(void** bufReturn, size_t* lenReturn) {
+  auto res = buf_.preallocate(kMinReadSize, kReadSize);
+  *bufReturn = res.first;
+  *lenReturn = res.second;
+}
+
+void FlvStreamParser::readDataAvailable(size_t len) noexcept {
+  buf_.postallocate(len);
+  parseBuffered();
+}
+
+void FlvStreamParser::readBufferAvailable(
+    std::unique_ptr<folly::IOBuf> readBuf) noexcept {
+  parse(std::move(readBuf));
+}
+
+void FlvStreamParser::readEOF() noexcept {
+  endOfInput();
+}
+
+void FlvStreamParser::readErr(const folly::AsyncSocketException& ex) noexcept {
+  fail(fmt::format("Read error: {}", ex.what()));
+}
+
+void FlvStreamParser::parseBuffered() {
+  try {
+    if (state_ == State::HEADER && !parseHeader()) {
+      return;
+    }
+    while (state_ == State::TAGS && buf_.chainLength() >= kTagHeaderSize) {
+      folly::io::Cursor cursor(buf_.front());
+      // Previous tag size + tag type
+      cursor.skip(5);
+      auto tagSize = read3Bytes(cursor);
+      if (buf_.chainLength() < kTagHeaderSize + tagSize) {
+        // Partial tag, wait for more data
+        return;
+      }
+      callback_.onTag(parseTag(buf_.split(kTagHeaderSize + tagSize)));
+    }
+  } catch (const std::exception& ex) {
+    fail(ex.what());
+  }
+}
+
+bool FlvStreamParser::parseHeader() {
+  if (buf_.chainLength() < kHeaderSize) {
+    return false;
+  }
+  folly::io::Cursor cursor(buf_.front());
+  if (cursor.readFixedString(3) != "FLV") {
+    throw std::runtime_error("Missing FLV signature");
+  }
+  // Version + flags
+  cursor.skip(2);
+  auto dataOffset = cursor.readBE<uint32_t>();
+  if (dataOffset < kHeaderSize) {
+    throw std::runtime_error(
+        fmt::format("Invalid FLV header size {}", dataOffset));
+  }
+  if (buf_.chainLength() < dataOffset) {
+    return false;
+  }
+  buf_.trimStart(dataOffset);
+  state_ = State::TAGS;
+  return true;
+}
+
+FlvTag FlvStreamParser::parseTag(std::unique_ptr<folly::IOBuf> tagBuf) {
+  folly::io::Cursor cursor(tagBuf.get());
+  // Prev tag size
+  cursor.skip(kPrevTagSizeBytes);
+
+  FlvTagBase tag;
+  tag.type = cursor.read<uint8_t>();
+
+  // Tag data size
+  tag.size = read3Bytes(cursor);
+
+  // Timestamp
+  auto ltimestamp = read3Bytes(cursor);
+  uint32_t htimestamp = cursor.read<uint8_t>();
+  tag.timestamp = htimestamp << 24 | ltimestamp;
+
+  // Stream id
+  tag.streamId = read3Bytes(cursor);
+
+  if (tag.type == 0x08) {
+    // Audio tag
+    auto audioTag = std::make_unique<FlvAudioTag>(tag);
+
+    auto tmp = cursor.read<uint8_t>();
+    audioTag->soundFormat = (tmp >> 4) & 0x0f;
+    audioTag->soundRate = (tmp >> 2) & 0x3;
+    audioTag->soundSize = (tmp >> 1) & 0x1;
+    audioTag->soundType = tmp & 0x1;
+    if (audioTag->soundFormat != 10 || audioTag->soundRate != 3 ||
+        audioTag->soundSize != 1 || audioTag->soundType != 1) {
+      throw std::runtime_error(fmt::format(
+          "Unsupported audio format, only AAC is supported. soundFormat {}, soundRate {}, soundSize {}, soundType {} (byte: {})",
+          audioTag->soundFormat,
+          audioTag->soundRate,
+          audioTag->soundSize,
+          audioTag->soundType,
+          tmp));
+    }
+
+    audioTag->aacPacketType = cursor.read<uint8_t>();
+    if (audioTag->aacPacketType > 1) {
+      throw std::runtime_error(fmt::format(
+          "Unsupported AAC packet type. packetType {}",
+          audioTag->aacPacketType));
+    }
+
+    // Data shares the read buffer
+    if (tag.size > 2) {
+      cursor.clone(audioTag->data, tag.size - 2);
+    }
+    return audioTag;
+  }
+
+  if (tag.type == 0x09) {
+    // Video tag
+    auto videoTag = std::make_unique<FlvVideoTag>(tag);
+
+    auto tmp = cursor.read<uint8_t>();
+    videoTag->frameType = (tmp >> 4) & 0x0f;
+    videoTag->codecId = tmp & 0x0f;
+    if (videoTag->codecId != 0x07) {
+      throw std::runtime_error(fmt::format(
+          "Unsupported video codec. Only h264 supported. CodecId {}",
+          videoTag->codecId));
+    }
+    videoTag->avcPacketType = cursor.read<uint8_t>();
+    if (videoTag->avcPacketType > 2) {
+      throw std::runtime_error(fmt::format(
+          "Unsupported AVC packet type. packetType {}",
+          videoTag->avcPacketType));
+    }
+    videoTag->compositionTime = read3Bytes(cursor);
+
+    if (tag.size > 5) {
+      cursor.clone(videoTag->data, tag.size - 5);
+    }
+    return videoTag;
+  }
+
+  if (tag.type == 0x12) {
+    // Script tag
+    auto scriptTag = std::make_unique<FlvScriptTag>(tag);
+    if (tag.size > 0) {
+      cursor.clone(scriptTag->data, tag.size);
+    }
+    return scriptTag;
+  }
+
+  XLOG(DBG1) << "Skipping unknown tag type " << (uint32_t)tag.type;
+  return FlvReadCmd::FLV_UNKNOWN_TAG;
+}
+
+void FlvStreamParser::fail(const std::string& error) {
+  if (state_ == State::ERROR || state_ == State::DONE) {
+    return;
+  }
+  XLOG(ERR) << "FLV stream error: " << error;
+  state_ = State::ERROR;
+  buf_.reset();
+  callback_.onError(error);
+}
+
+} // namespace moxygen::flv
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/io/IOBufQueue.h>
+#include <folly/io/async/AsyncTransport.h>
+#include "moxygen/flv_parser/FlvCommon.h"
+
+namespace moxygen::flv {
+
+// Push mode FLV demuxer.  Unlike FlvReader it never blocks: it is fed
+// chunks of any size (directly with parse, or as the ReadCallback of an
+// AsyncPipeReader / AsyncSocket), keeps partial tags buffered between
+// chunks and emits each complete tag through the callback.
+class FlvStreamParser : public folly::AsyncReader::ReadCallback {
+ public:
+  class Callback {
+   public:
+    virtual ~Callback() = default;
+
+    // A complete tag, FLV_EOF once the input ends on a tag boundary
+    virtual void onTag(FlvTag tag) = 0;
+    // Malformed or truncated input, or a read error.  No more callbacks.
+    virtual void onError(const std::string& error) = 0;
+  };
+
+  explicit FlvStreamParser(Callback& callback) : callback_(callback) {}
+
+  // Returns false once the parser has failed
+  bool parse(std::unique_ptr<folly::IOBuf> data);
+  void endOfInput();
+
+  bool failed() const {
+    return state_ == State::ERROR;
+  }
+
+  // folly::AsyncReader::ReadCallback
+  void getReadBuffer(void** bufReturn, size_t* lenReturn) override;
+  void readDataAvailable(size_t len) noexcept override;
+  bool isBufferMovable() noexcept override {
+    return true;
+  }
+  void readBufferAvailable(
+      std::unique_ptr<folly::IOBuf> readBuf) noexcept override;
+  void readEOF() noexcept override;
+  void readErr(const folly::AsyncSocketException& ex) noexcept override;
+
+ private:
+  static constexpr size_t kHeaderSize = 9;
+  static constexpr size_t kPrevTagSizeBytes = 4;
+  // Previous tag size + tag header
+  static constexpr size_t kTagHeaderSize = kPrevTagSizeBytes + 11;
+  static constexpr size_t kMinReadSize = 1460;
+  static constexpr size_t kReadSize = 16 * 1024;
+
+  enum class State { HEADER, TAGS, DONE, ERROR };
+
+  void parseBuffered();
+  bool parseHeader();
+  FlvTag parseTag(std::unique_ptr<folly::IOBuf> tagBuf);
+  void fail(const std::string& error);
+
+  Callback& callback_;
+  State state_{State::HEADER};
+  folly::IOBufQueue buf_{folly::IOBufQueue::cacheChainLength()};
+};
+
+} // namespace moxygen::flv
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/flv_parser/FlvStreamParser.h"
+#include "moxygen/flv_parser/FlvReader.h"
+#include "moxygen/flv_parser/FlvSequentialReader.h"
+#include "moxygen/flv_parser/test/FlvTestUtils.h"
+
+#include <folly/FileUtil.h>
+#include <folly/logging/xlog.h>
+#include <folly/portability/GTest.h>
+
+using namespace moxygen::flv;
+using namespace moxygen::test;
+
+namespace {
+const std::string kTestDir = getContainingDirectory(XLOG_FILENAME).str();
+const std::string kFlvOkTestFilePath = "resources/testOK1s.flv";
+
+class TagCollector : public FlvStreamParser::Callback {
+ public:
+  void onTag(FlvTag tag) override {
+    tags.push_back(std::move(tag));
+  }
+  void onError(const std::string& err) override {
+    error = err;
+  }
+
+  std::vector<FlvTag> tags;
+  folly::Optional<std::string> error;
+};
+
+std::string readTestFile() {
+  std::string data;
+  EXPECT_TRUE(
+      folly::readFile((kTestDir + "/" + kFlvOkTestFilePath).c_str(), data));
+  return data;
+}
+
+void feed(FlvStreamParser& parser, const std::string& data, size_t chunk) {
+  for (size_t off = 0; off < data.size(); off += chunk) {
+    parser.parse(folly::IOBuf::copyBuffer(
+        data.data() + off, std::min(chunk, data.size() - off)));
+  }
+}
+} // namespace
+
+TEST(FlvStreamParserTest, MatchesFlvReader) {
+  auto data = readTestFile();
+  TagCollector collector;
+  FlvStreamParser parser(collector);
+  // Odd sized chunks so tags straddle them
+  feed(parser, data, 7);
+  parser.endOfInput();
+  EXPECT_FALSE(collector.error.has_value());
+
+  FlvReader flvr(kTestDir + "/" + kFlvOkTestFilePath);
+  for (auto& tag : collector.tags) {
+    auto expected = flvr.readNextTag();
+    ASSERT_EQ(tag.index(), expected.index());
+    switch (tag.index()) {
+      case FlvTagTypeIndex::FLV_TAG_INDEX_VIDEO:
+        EXPECT_TRUE(
+            *std::get<FlvTagTypeIndex::FLV_TAG_INDEX_VIDEO>(tag) ==
+            *std::get<FlvTagTypeIndex::FLV_TAG_INDEX_VIDEO>(expected));
+        break;
+      case FlvTagTypeIndex::FLV_TAG_INDEX_AUDIO:
+        EXPECT_TRUE(
+            *std::get<FlvTagTypeIndex::FLV_TAG_INDEX_AUDIO>(tag) ==
+            *std::get<FlvTagTypeIndex::FLV_TAG_INDEX_AUDIO>(expected));
+        break;
+      case FlvTagTypeIndex::FLV_TAG_INDEX_READCMD:
+        EXPECT_EQ(std::get<FlvReadCmd>(tag), std::get<FlvReadCmd>(expected));
+        break;
+      default:
+        break;
+    }
+  }
+  ASSERT_FALSE(collector.tags.empty());
+  EXPECT_EQ(std::get<FlvReadCmd>(collector.tags.back()), FlvReadCmd::FLV_EOF);
+}
+
+TEST(FlvStreamParserTest, MediaItems) {
+  auto data = readTestFile();
+  TagCollector collector;
+  FlvStreamParser parser(collector);
+  feed(parser, data, 1000);
+  parser.endOfInput();
+
+  FlvSequentialReader flvsr;
+  uint32_t numVideoItems = 0;
+  uint32_t numAudioItems = 0;
+  for (auto& tag : collector.tags) {
+    auto item = flvsr.processTag(std::move(tag));
+    if (!item || item->isEOF) {
+      continue;
+    }
+    if (item->type == FlvSequentialReader::MediaType::VIDEO) {
+      numVideoItems++;
+    } else if (item->type == FlvSequentialReader::MediaType::AUDIO) {
+      EXPECT_EQ(item->sampleFreq, 48000);
+      numAudioItems++;
+    }
+  }
+  EXPECT_EQ(numVideoItems, 30);
+  EXPECT_EQ(numAudioItems, 49);
+}
+
+TEST(FlvStreamParserTest, TruncatedInput) {
+  auto data = readTestFile();
+  TagCollector collector;
+  FlvStreamParser parser(collector);
+  feed(parser, data.substr(0, data.size() / 2), 4096);
+  EXPECT_FALSE(collector.error.has_value());
+  parser.endOfInput();
+  EXPECT_TRUE(collector.error.has_value());
+  EXPECT_TRUE(parser.failed());
+}
+
+TEST(FlvStreamParserTest, BadSignature) {
+  TagCollector collector;
+  FlvStreamParser parser(collector);
+  EXPECT_FALSE(parser.parse(
+      folly::IOBuf::copyBuffer(std::string("MP4\x01\x05\0\0\0\x09", 9))));
+  EXPECT_TRUE(collector.error.has_value());
+  EXPECT_TRUE(collector.tags.empty());
+}
@@ -0,0 +1,521 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQSession.h"
+#include "moxygen/util/MemoryAccounting.h"
+
+#include <folly/container/F14Map.h>
+#include <algorithm>
+
+namespace moxygen {
+
+// Serves a virtual ABR track from a set of rendition tracks.
+//
+// The relay subscribes to every rendition and feeds each one into the
+// consumer returned by renditionConsumer().  Each downstream subscriber gets
+// one rendition per group, chosen from its session's transport metrics when
+// the group first arrives from any rendition.  Only renditions that have not
+// started the group yet can be chosen, and the subscriber takes the group
+// once the chosen rendition starts it, so it never gets a partial group.
+// Renditions must therefore use the same group numbers, with groups starting
+// at switchable points (eg: keyframes).
+//
+// ABR subscriptions always follow the live edge, subscribe ranges are ignored.
+class MoQAbrForwarder : public std::enable_shared_from_this<MoQAbrForwarder> {
+ public:
+  struct Rendition {
+    FullTrackName fullTrackName;
+    // Bits/s needed to deliver this rendition
+    uint64_t bitrate{0};
+  };
+
+  struct Config {
+    // Fraction of the estimated throughput a rendition may use
+    double headroom{0.8};
+  };
+
+  // Renditions are ordered by bitrate, index 0 is the lowest
+  MoQAbrForwarder(
+      FullTrackName ftn,
+      std::vector<Rendition> renditions,
+      Config config = Config())
+      : fullTrackName_(std::move(ftn)),
+        renditions_(std::move(renditions)),
+        config_(config),
+        renditionDone_(renditions_.size(), false),
+        renditionGroup_(renditions_.size()) {
+    std::sort(
+        renditions_.begin(),
+        renditions_.end(),
+        [](const Rendition& a, const Rendition& b) {
+          return a.bitrate < b.bitrate;
+        });
+  }
+
+  const FullTrackName& fullTrackName() const {
+    return fullTrackName_;
+  }
+
+  const std::vector<Rendition>& renditions() const {
+    return renditions_;
+  }
+
+  class Callback {
+   public:
+    virtual ~Callback() = default;
+    virtual void onEmpty(MoQAbrForwarder*) = 0;
+  };
+
+  void setCallback(std::shared_ptr<Callback> callback) {
+    callback_ = std::move(callback);
+  }
+
+  struct Subscriber : public Publisher::SubscriptionHandle {
+    Subscriber(
+        MoQAbrForwarder& f,
+        SubscribeOk ok,
+        std::shared_ptr<MoQSession> s,
+        SubscribeID sid,
+        std::shared_ptr<TrackConsumer> tc)
+        : SubscriptionHandle(std::move(ok)),
+          session(std::move(s)),
+          subscribeID(sid),
+          trackConsumer(std::move(tc)),
+          forwarder(f) {}
+
+    void subscribeUpdate(SubscribeUpdate) override {
+      XLOG(DBG1) << "Ignoring SUBSCRIBE_UPDATE for ABR track";
+    }
+
+    void unsubscribe() override {
+      forwarder.removeSession(session);
+    }
+
+    std::shared_ptr<MoQSession> session;
+    SubscribeID subscribeID;
+    std::shared_ptr<TrackConsumer> trackConsumer;
+    // Rendition selected for group
+    size_t rendition{0};
+    folly::Optional<uint64_t> group;
+    // The next group, until the rendition chosen for it starts it
+    struct PendingGroup {
+      uint64_t group;
+      size_t rendition;
+    };
+    folly::Optional<PendingGroup> pending;
+    uint64_t switches{0};
+    // Open subgroups, by the rendition subgroup feeding them
+    folly::F14FastMap<const void*, std::shared_ptr<SubgroupConsumer>>
+        subgroups;
+    MoQAbrForwarder& forwarder;
+  };
+
+  std::shared_ptr<Subscriber> addSubscriber(
+      std::shared_ptr<MoQSession> session,
+      const SubscribeRequest& subReq,
+      std::shared_ptr<TrackConsumer> consumer,
+      GroupOrder pubGroupOrder,
+      folly::Optional<AbsoluteLocation> latest) {
+    auto sessionPtr = session.get();
+    auto subscriber = std::make_shared<Subscriber>(
+        *this,
+        SubscribeOk{
+            subReq.subscribeID,
+            std::chrono::milliseconds(0),
+            MoQSession::resolveGroupOrder(pubGroupOrder, subReq.groupOrder),
+            latest,
+            {}},
+        std::move(session),
+        subReq.subscribeID,
+        std::move(consumer));
+    subscribers_.emplace(sessionPtr, subscriber);
+    return subscriber;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return subscribers_.empty();
+  }
+
+  void removeSession(
+      const std::shared_ptr<MoQSession>& session,
+      folly::Optional<SubscribeDone> subDone = folly::none) {
+    auto subIt = subscribers_.find(session.get());
+    if (subIt == subscribers_.end()) {
+      return;
+    }
+    // The callback may release the last reference to this
+    auto self = shared_from_this();
+    auto subscriber = std::move(subIt->second);
+    subscribers_.erase(subIt);
+    for (auto& subgroup : subscriber->subgroups) {
+      subgroup.second->reset(ResetStreamErrorCode::CANCELLED);
+    }
+    subscriber->subgroups.clear();
+    if (subDone) {
+      subDone->subscribeID = subscriber->subscribeID;
+      subscriber->trackConsumer->subscribeDone(*subDone);
+    }
+    if (subscribers_.empty() && callback_) {
+      callback_->onEmpty(this);
+    }
+  }
+
+  // Highest rendition that fits the subscriber's estimated throughput and
+  // has not started group yet.  Once the subscriber is playing it steps up
+  // at most one rendition at a time.
+  size_t selectRendition(const Subscriber& sub, uint64_t group) const {
+    auto current = sub.rendition;
+    folly::Optional<TransportMetrics> metrics;
+    if (sub.session) {
+      metrics = sub.session->getTransportMetrics();
+    }
+    size_t best = current;
+    if (metrics) {
+      // deliveryRate only measures what was sent, cwnd/srtt is what the
+      // congestion controller would allow
+      uint64_t estimate = metrics->deliveryRate;
+      if (metrics->srtt.count() > 0) {
+        estimate = std::max<uint64_t>(
+            estimate,
+            metrics->congestionWindow * 8 * 1000000 / metrics->srtt.count());
+      }
+      auto budget = uint64_t(estimate * config_.headroom);
+      best = 0;
+      for (size_t i = 0; i < renditions_.size(); i++) {
+        if (renditions_[i].bitrate <= budget) {
+          best = i;
+        }
+      }
+      if (sub.group && best > current && !renditionDone_[current]) {
+        best = current + 1;
+      }
+    }
+    // Skip renditions that have ended or are already in the group,
+    // preferring lower ones
+    auto available = [&](size_t i) {
+      return !renditionDone_[i] &&
+          (!renditionGroup_[i] || *renditionGroup_[i] < group);
+    };
+    for (size_t i = best + 1; i-- > 0;) {
+      if (available(i)) {
+        return i;
+      }
+    }
+    for (size_t i = best + 1; i < renditions_.size(); i++) {
+      if (available(i)) {
+        return i;
+      }
+    }
+    return best;
+  }
+
+  std::shared_ptr<TrackConsumer> renditionConsumer(size_t index) {
+    return std::make_shared<RenditionConsumer>(shared_from_this(), index);
+  }
+
+ private:
+  static Payload maybeClone(const Payload& payload) {
+    return payload ? payload->clone() : nullptr;
+  }
+
+  void forEachSubscriber(
+      const std::function<void(const std::shared_ptr<Subscriber>&)>& fn) {
+    MOQ_LOOP_SCOPE(FORWARD);
+    MOQ_MEM_SCOPE(FORWARDER);
+    for (auto subscriberIt = subscribers_.begin();
+         subscriberIt != subscribers_.end();) {
+      auto sub = subscriberIt->second;
+      subscriberIt++;
+      fn(sub);
+    }
+  }
+
+  // Whether sub takes group from rendition, which is starting it.  The
+  // rendition for a group is chosen the first time the group is seen, and
+  // the subscriber moves to the group when that rendition starts it.
+  bool selects(Subscriber& sub, size_t rendition, uint64_t group) {
+    if (sub.group && group <= *sub.group) {
+      return *sub.group == group && sub.rendition == rendition;
+    }
+    if (!sub.pending || group > sub.pending->group) {
+      sub.pending = Subscriber::PendingGroup{
+          group, selectRendition(sub, group)};
+    }
+    if (group != sub.pending->group || rendition != sub.pending->rendition) {
+      return false;
+    }
+    if (sub.group && rendition != sub.rendition) {
+      XLOG(DBG1) << "ABR switch " << fullTrackName_ << " sess="
+                 << sub.session.get() << " group=" << group << " "
+                 << renditions_[sub.rendition].fullTrackName << " -> "
+                 << renditions_[rendition].fullTrackName;
+      sub.switches++;
+    }
+    sub.rendition = rendition;
+    sub.group = group;
+    sub.pending.reset();
+    return true;
+  }
+
+  // Called once rendition has offered group to every subscriber
+  void onRenditionGroup(size_t rendition, uint64_t group) {
+    auto& latest = renditionGroup_[rendition];
+    if (!latest || group > *latest) {
+      latest = group;
+    }
+  }
+
+  void removeSession(const Subscriber& sub, const MoQPublishError& err) {
+    removeSession(
+        sub.session,
+        SubscribeDone{
+            sub.subscribeID,
+            SubscribeDoneStatusCode::INTERNAL_ERROR,
+            0, // filled in by session
+            err.what(),
+            folly::none});
+  }
+
+  void onRenditionDone(size_t index, SubscribeDone subDone) {
+    renditionDone_[index] = true;
+    if (std::all_of(renditionDone_.begin(), renditionDone_.end(), [](bool d) {
+          return d;
+        })) {
+      forEachSubscriber([&](const std::shared_ptr<Subscriber>& sub) {
+        removeSession(sub->session, subDone);
+      });
+    }
+  }
+
+  class RenditionSubgroup : public SubgroupConsumer {
+   public:
+    explicit RenditionSubgroup(std::shared_ptr<MoQAbrForwarder> forwarder)
+        : forwarder_(std::move(forwarder)) {}
+
+    folly::Expected<folly::Unit, MoQPublishError> object(
+        uint64_t objectID,
+        Payload payload,
+        Extensions extensions,
+        bool finSubgroup) override {
+      forEach(
+          [&](SubgroupConsumer& consumer) {
+            return consumer.object(
+                objectID, maybeClone(payload), extensions, finSubgroup);
+          },
+          finSubgroup);
+      return folly::unit;
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> objectNotExists(
+        uint64_t objectID,
+        Extensions extensions,
+        bool finSubgroup) override {
+      forEach(
+          [&](SubgroupConsumer& consumer) {
+            return consumer.objectNotExists(objectID, extensions, finSubgroup);
+          },
+          finSubgroup);
+      return folly::unit;
+    }
+
+    void checkpoint() override {
+      forwarder_->forEachSubscriber([&](const std::shared_ptr<Subscriber>& s) {
+        auto it = s->subgroups.find(this);
+        if (it != s->subgroups.end()) {
+          it->second->checkpoint();
+        }
+      });
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> beginObject(
+        uint64_t objectID,
+        uint64_t length,
+        Payload initialPayload,
+        Extensions extensions) override {
+      forEach(
+          [&](SubgroupConsumer& consumer) {
+            return consumer.beginObject(
+                objectID, length, maybeClone(initialPayload), extensions);
+          },
+          false);
+      return folly::unit;
+    }
+
+    folly::Expected<ObjectPublishStatus, MoQPublishError> objectPayload(
+        Payload payload,
+        bool finSubgroup) override {
+      auto status = ObjectPublishStatus::IN_PROGRESS;
+      forEach(
+          [&](SubgroupConsumer& consumer) {
+            auto res = consumer.objectPayload(maybeClone(payload), finSubgroup);
+            if (res.hasValue()) {
+              status = res.value();
+            }
+            return res;
+          },
+          finSubgroup);
+      return status;
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> endOfGroup(
+        uint64_t endOfGroupObjectID,
+        Extensions extensions) override {
+      forEach(
+          [&](SubgroupConsumer& consumer) {
+            return consumer.endOfGroup(endOfGroupObjectID, extensions);
+          },
+          true);
+      return folly::unit;
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> endOfTrackAndGroup(
+        uint64_t endOfTrackObjectID,
+        Extensions extensions) override {
+      forEach(
+          [&](SubgroupConsumer& consumer) {
+            return consumer.endOfTrackAndGroup(endOfTrackObjectID, extensions);
+          },
+          true);
+      return folly::unit;
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> endOfSubgroup() override {
+      forEach(
+          [&](SubgroupConsumer& consumer) { return consumer.endOfSubgroup(); },
+          true);
+      return folly::unit;
+    }
+
+    void reset(ResetStreamErrorCode error) override {
+      forwarder_->forEachSubscriber([&](const std::shared_ptr<Subscriber>& s) {
+        auto it = s->subgroups.find(this);
+        if (it != s->subgroups.end()) {
+          auto consumer = std::move(it->second);
+          s->subgroups.erase(it);
+          consumer->reset(error);
+        }
+      });
+    }
+
+   private:
+    template <class Fn>
+    void forEach(Fn&& fn, bool done) {
+      forwarder_->forEachSubscriber([&](const std::shared_ptr<Subscriber>& s) {
+        auto it = s->subgroups.find(this);
+        if (it == s->subgroups.end()) {
+          return;
+        }
+        auto consumer = it->second;
+        if (done) {
+          s->subgroups.erase(it);
+        }
+        auto res = fn(*consumer);
+        if (res.hasError()) {
+          forwarder_->removeSession(*s, res.error());
+        }
+      });
+    }
+
+    std::shared_ptr<MoQAbrForwarder> forwarder_;
+  };
+
+  class RenditionConsumer : public TrackConsumer {
+   public:
+    RenditionConsumer(std::shared_ptr<MoQAbrForwarder> forwarder, size_t index)
+        : forwarder_(std::move(forwarder)), index_(index) {}
+
+    folly::Expected<std::shared_ptr<SubgroupConsumer>, MoQPublishError>
+    beginSubgroup(uint64_t groupID, uint64_t subgroupID, Priority priority)
+        override {
+      auto subgroup = std::make_shared<RenditionSubgroup>(forwarder_);
+      forwarder_->forEachSubscriber([&](const std::shared_ptr<Subscriber>& s) {
+        if (!forwarder_->selects(*s, index_, groupID)) {
+          return;
+        }
+        auto res =
+            s->trackConsumer->beginSubgroup(groupID, subgroupID, priority);
+        if (res.hasError()) {
+          forwarder_->removeSession(*s, res.error());
+        } else {
+          s->subgroups[subgroup.get()] = std::move(res.value());
+        }
+      });
+      forwarder_->onRenditionGroup(index_, groupID);
+      return subgroup;
+    }
+
+    folly::Expected<folly::SemiFuture<folly::Unit>, MoQPublishError>
+    awaitStreamCredit() override {
+      return folly::makeSemiFuture();
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> objectStream(
+        const ObjectHeader& header,
+        Payload payload) override {
+      forEachSelecting(header.group, [&](TrackConsumer& consumer) {
+        return consumer.objectStream(header, maybeClone(payload));
+      });
+      return folly::unit;
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> datagram(
+        const ObjectHeader& header,
+        Payload payload) override {
+      forEachSelecting(header.group, [&](TrackConsumer& consumer) {
+        return consumer.datagram(header, maybeClone(payload));
+      });
+      return folly::unit;
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> groupNotExists(
+        uint64_t groupID,
+        uint64_t subgroup,
+        Priority pri,
+        Extensions extensions) override {
+      forEachSelecting(groupID, [&](TrackConsumer& consumer) {
+        return consumer.groupNotExists(groupID, subgroup, pri, extensions);
+      });
+      return folly::unit;
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> subscribeDone(
+        SubscribeDone subDone) override {
+      forwarder_->onRenditionDone(index_, std::move(subDone));
+      return folly::unit;
+    }
+
+   private:
+    template <class Fn>
+    void forEachSelecting(uint64_t group, Fn&& fn) {
+      forwarder_->forEachSubscriber([&](const std::shared_ptr<Subscriber>& s) {
+        if (!forwarder_->selects(*s, index_, group)) {
+          return;
+        }
+        auto res = fn(*s->trackConsumer);
+        if (res.hasError()) {
+          forwarder_->removeSession(*s, res.error());
+        }
+      });
+      forwarder_->onRenditionGroup(index_, group);
+    }
+
+    std::shared_ptr<MoQAbrForwarder> forwarder_;
+    size_t index_;
+  };
+
+  FullTrackName fullTrackName_;
+  std::vector<Rendition> renditions_;
+  Config config_;
+  std::vector<bool> renditionDone_;
+  // Latest group each rendition has started
+  std::vector<folly::Optional<uint64_t>> renditionGroup_;
+  folly::F14FastMap<MoQSession*, std::shared_ptr<Subscriber>> subscribers_;
+  std::shared_ptr<Callback> callback_;
+};
+
+} // namespace moxygen
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/Publisher.h"
+#include "moxygen/relay/MoQCacheWriter.h"
+
+#include <folly/CancellationToken.h>
+#include <folly/container/F14Map.h>
+#include <folly/coro/Sleep.h>
+#include <folly/coro/Task.h>
+#include <folly/io/async/EventBase.h>
+
+namespace moxygen {
+
+// Feeds a track to a consumer from the ShmObjectCache, in place of an
+// upstream subscription, while another relay process holds the track's
+// lease and writes it.  Starting after the latest object, it polls the
+// cache for the objects that follow.  Each poll also tries to take the
+// lease: getting it means the writer went away, so the follower ends its
+// open subgroups, calls onLease and stops, and the caller subscribes
+// upstream in its place.
+class MoQCacheFollower
+    : public Publisher::SubscriptionHandle,
+      public std::enable_shared_from_this<MoQCacheFollower> {
+ public:
+  static constexpr std::chrono::milliseconds kPollInterval{10};
+
+  MoQCacheFollower(
+      SubscribeOk ok,
+      FullTrackName ftn,
+      std::shared_ptr<ShmObjectCache> cache,
+      std::shared_ptr<TrackConsumer> consumer,
+      Priority priority)
+      : Publisher::SubscriptionHandle(std::move(ok)),
+        fullTrackName_(std::move(ftn)),
+        cache_(std::move(cache)),
+        consumer_(std::move(consumer)),
+        priority_(priority) {
+    if (auto& latest = subscribeOk().latest) {
+      next_ = AbsoluteLocation{latest->group, latest->object + 1};
+    }
+  }
+
+  // The last of the leading run of cached objects in the latest group the
+  // writer recorded
+  static folly::Optional<AbsoluteLocation> latest(
+      const ShmObjectCache& cache,
+      const FullTrackName& ftn) {
+    auto group = cache.latestGroup(ftn);
+    if (!group) {
+      return folly::none;
+    }
+    folly::Optional<AbsoluteLocation> latest;
+    for (uint64_t object = 0; cache.status(ftn, *group, object); object++) {
+      latest = AbsoluteLocation{*group, object};
+    }
+    return latest;
+  }
+
+  void start(folly::EventBase* evb, std::function<void()> onLease) {
+    folly::coro::co_withCancellation(
+        cancelSource_.getToken(), run(shared_from_this(), std::move(onLease)))
+        .scheduleOn(evb)
+        .start();
+  }
+
+  void unsubscribe() override {
+    cancelSource_.requestCancellation();
+  }
+
+  void subscribeUpdate(SubscribeUpdate) override {}
+
+ private:
+  static folly::coro::Task<void> run(
+      std::shared_ptr<MoQCacheFollower> self,
+      std::function<void()> onLease) {
+    while (true) {
+      auto slept = co_await folly::coro::co_awaitTry(
+          folly::coro::sleep(kPollInterval));
+      if (slept.hasException()) {
+        // Unsubscribed
+        co_return;
+      }
+      if (self->cache_->acquireLease(
+              self->fullTrackName_, MoQCacheWriter::kLeaseTTL)) {
+        XLOG(INFO) << "Took cache lease for " << self->fullTrackName_
+                   << ", following upstream";
+        self->endSubgroups();
+        onLease();
+        co_return;
+      }
+      if (!self->poll()) {
+        co_return;
+      }
+    }
+  }
+
+  // Delivers the cached objects from next_ on.  Returns false once the track
+  // ended.
+  bool poll() {
+    if (!next_) {
+      // Nothing was cached when the follower started
+      auto group = cache_->latestGroup(fullTrackName_);
+      if (!group) {
+        return true;
+      }
+      next_ = AbsoluteLocation{*group, 0};
+    }
+    while (true) {
+      auto cached = cache_->get(fullTrackName_, next_->group, next_->object);
+      if (cached) {
+        if (!deliver(std::move(*cached))) {
+          return false;
+        }
+        continue;
+      }
+      // The rest of a group the writer moved past is not coming
+      auto group = cache_->latestGroup(fullTrackName_);
+      if (!group || *group <= next_->group) {
+        return true;
+      }
+      endSubgroups();
+      next_ = AbsoluteLocation{next_->group + 1, 0};
+    }
+  }
+
+  bool deliver(ShmObjectCache::CachedObject cached) {
+    auto objectID = next_->object;
+    next_->object++;
+    switch (cached.status) {
+      case ObjectStatus::NORMAL:
+        if (auto sub = subgroup(cached.subgroup)) {
+          sub->object(
+              objectID,
+              std::move(cached.payload),
+              std::move(cached.extensions));
+        }
+        return true;
+      case ObjectStatus::OBJECT_NOT_EXIST:
+        if (auto sub = subgroup(cached.subgroup)) {
+          sub->objectNotExists(objectID, std::move(cached.extensions));
+        }
+        return true;
+      case ObjectStatus::GROUP_NOT_EXIST:
+        consumer_->groupNotExists(
+            next_->group,
+            cached.subgroup,
+            priority_,
+            std::move(cached.extensions));
+        break;
+      case ObjectStatus::END_OF_GROUP:
+        if (auto sub = subgroup(cached.subgroup)) {
+          sub->endOfGroup(objectID, std::move(cached.extensions));
+          subgroups_.erase(cached.subgroup);
+        }
+        break;
+      case ObjectStatus::END_OF_TRACK_AND_GROUP:
+        if (auto sub = subgroup(cached.subgroup)) {
+          sub->endOfTrackAndGroup(objectID, std::move(cached.extensions));
+          subgroups_.erase(cached.subgroup);
+        }
+        [[fallthrough]];
+      case ObjectStatus::END_OF_TRACK:
+        endSubgroups();
+        consumer_->subscribeDone(
+            {subscribeOk().subscribeID,
+             SubscribeDoneStatusCode::TRACK_ENDED,
+             0, // filled in by session
+             "track ended",
+             AbsoluteLocation{next_->group, objectID}});
+        return false;
+    }
+    endSubgroups();
+    next_ = AbsoluteLocation{next_->group + 1, 0};
+    return true;
+  }
+
+  std::shared_ptr<SubgroupConsumer> subgroup(uint64_t subgroupID) {
+    auto it = subgroups_.find(subgroupID);
+    if (it != subgroups_.end()) {
+      return it->second;
+    }
+    auto res = consumer_->beginSubgroup(next_->group, subgroupID, priority_);
+    if (res.hasError()) {
+      XLOG(ERR) << "beginSubgroup failed for " << fullTrackName_
+                << " err=" << res.error().what();
+      return nullptr;
+    }
+    return subgroups_.emplace(subgroupID, std::move(res.value()))
+        .first->second;
+  }
+
+  void endSubgroups() {
+    for (auto& [subgroupID, sub] : subgroups_) {
+      sub->endOfSubgroup();
+    }
+    subgroups_.clear();
+  }
+
+  FullTrackName fullTrackName_;
+  std::shared_ptr<ShmObjectCache> cache_;
+  std::shared_ptr<TrackConsumer> consumer_;
+  Priority priority_;
+  // Where the next object is expected, none until the writer records a group
+  folly::Optional<AbsoluteLocation> next_;
+  folly::F14FastMap<uint64_t, std::shared_ptr<SubgroupConsumer>> subgroups_;
+  folly::CancellationSource cancelSource_;
+};
+
+} // namespace moxygen
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQConsumers.h"
+#include "moxygen/relay/MoQNamespaceQuota.h"
+#include "moxygen/util/ShmObjectCache.h"
+
+#include <folly/io/IOBufQueue.h>
+#include <folly/logging/xlog.h>
+
+namespace moxygen {
+
+// Passes a track through to another consumer, copying every object into a
+// ShmObjectCache.  Created holding the track's cache lease, it renews the
+// lease as objects arrive and releases it when destroyed.  While the lease is
+// lost it stops writing, and tries to take it back every kLeaseRetry.
+class MoQCacheWriter : public TrackConsumer,
+                       public std::enable_shared_from_this<MoQCacheWriter> {
+ public:
+  static constexpr std::chrono::milliseconds kLeaseTTL{10000};
+  static constexpr std::chrono::milliseconds kLeaseRetry{1000};
+
+  MoQCacheWriter(
+      FullTrackName ftn,
+      std::shared_ptr<ShmObjectCache> cache,
+      std::shared_ptr<TrackConsumer> downstream)
+      : fullTrackName_(std::move(ftn)),
+        cache_(std::move(cache)),
+        downstream_(std::move(downstream)),
+        leaseChecked_(std::chrono::steady_clock::now()) {}
+
+  ~MoQCacheWriter() override {
+    cache_->releaseLease(fullTrackName_);
+  }
+
+  // Skip cache writes beyond the quota's cache rate
+  void setQuota(std::shared_ptr<MoQNamespaceQuota> quota) {
+    quota_ = std::move(quota);
+  }
+
+  folly::Expected<std::shared_ptr<SubgroupConsumer>, MoQPublishError>
+  beginSubgroup(uint64_t groupID, uint64_t subgroupID, Priority priority)
+      override {
+    auto res = downstream_->beginSubgroup(groupID, subgroupID, priority);
+    if (res.hasError()) {
+      return res;
+    }
+    return std::make_shared<SubgroupWriter>(
+        shared_from_this(), groupID, subgroupID, std::move(res.value()));
+  }
+
+  folly::Expected<folly::SemiFuture<folly::Unit>, MoQPublishError>
+  awaitStreamCredit() override {
+    return downstream_->awaitStreamCredit();
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> objectStream(
+      const ObjectHeader& header,
+      Payload payload) override {
+    put(header.group,
+        header.subgroup,
+        header.id,
+        header.status,
+        header.extensions,
+        payload.get());
+    return downstream_->objectStream(header, std::move(payload));
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> datagram(
+      const ObjectHeader& header,
+      Payload payload) override {
+    put(header.group,
+        header.subgroup,
+        header.id,
+        header.status,
+        header.extensions,
+        payload.get());
+    return downstream_->datagram(header, std::move(payload));
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> groupNotExists(
+      uint64_t groupID,
+      uint64_t subgroup,
+      Priority pri,
+      Extensions extensions) override {
+    put(groupID, subgroup, 0, ObjectStatus::GROUP_NOT_EXIST, extensions);
+    return downstream_->groupNotExists(
+        groupID, subgroup, pri, std::move(extensions));
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> subscribeDone(
+      SubscribeDone subDone) override {
+    return downstream_->subscribeDone(std::move(subDone));
+  }
+
+ private:
+  class SubgroupWriter : public SubgroupConsumer {
+   public:
+    SubgroupWriter(
+        std::shared_ptr<MoQCacheWriter> writer,
+        uint64_t group,
+        uint64_t subgroup,
+        std::shared_ptr<SubgroupConsumer> downstream)
+        : writer_(std::move(writer)),
+          group_(group),
+          subgroup_(subgroup),
+          downstream_(std::move(downstream)) {}
+
+    folly::Expected<folly::Unit, MoQPublishError> object(
+        uint64_t objectID,
+        Payload payload,
+        Extensions extensions,
+        bool finSubgroup) override {
+      put(objectID, ObjectStatus::NORMAL, extensions, payload.get());
+      return downstream_->object(
+          objectID, std::move(payload), std::move(extensions), finSubgroup);
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> objectNotExists(
+        uint64_t objectID,
+        Extensions extensions,
+        bool finSubgroup) override {
+      put(objectID, ObjectStatus::OBJECT_NOT_EXIST, extensions);
+      return downstream_->objectNotExists(
+          objectID, std::move(extensions), finSubgroup);
+    }
+
+    void checkpoint() override {
+      downstream_->checkpoint();
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> beginObject(
+        uint64_t objectID,
+        uint64_t length,
+        Payload initialPayload,
+        Extensions extensions) override {
+      current_.emplace(objectID, length, extensions);
+      if (initialPayload) {
+        current_->payload.append(initialPayload->clone());
+      }
+      maybeFinishObject();
+      return downstream_->beginObject(
+          objectID, length, std::move(initialPayload), std::move(extensions));
+    }
+
+    folly::Expected<ObjectPublishStatus, MoQPublishError> objectPayload(
+        Payload payload,
+        bool finSubgroup) override {
+      if (current_ && payload) {
+        current_->payload.append(payload->clone());
+        maybeFinishObject();
+      }
+      return downstream_->objectPayload(std::move(payload), finSubgroup);
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> endOfGroup(
+        uint64_t endOfGroupObjectID,
+        Extensions extensions) override {
+      put(endOfGroupObjectID, ObjectStatus::END_OF_GROUP, extensions);
+      return downstream_->endOfGroup(
+          endOfGroupObjectID, std::move(extensions));
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> endOfTrackAndGroup(
+        uint64_t endOfTrackObjectID,
+        Extensions extensions) override {
+      put(endOfTrackObjectID,
+          ObjectStatus::END_OF_TRACK_AND_GROUP,
+          extensions);
+      return downstream_->endOfTrackAndGroup(
+          endOfTrackObjectID, std::move(extensions));
+    }
+
+    folly::Expected<folly::Unit, MoQPublishError> endOfSubgroup() override {
+      return downstream_->endOfSubgroup();
+    }
+
+    void reset(ResetStreamErrorCode error) override {
+      current_.reset();
+      downstream_->reset(error);
+    }
+
+   private:
+    struct StreamingObject {
+      StreamingObject(uint64_t i, uint64_t l, Extensions e)
+          : id(i), length(l), extensions(std::move(e)) {}
+      uint64_t id;
+      uint64_t length;
+      Extensions extensions;
+      folly::IOBufQueue payload{folly::IOBufQueue::cacheChainLength()};
+    };
+
+    void put(
+        uint64_t objectID,
+        ObjectStatus status,
+        const Extensions& extensions,
+        const folly::IOBuf* payload = nullptr) {
+      writer_->put(group_, subgroup_, objectID, status, extensions, payload);
+    }
+
+    void maybeFinishObject() {
+      if (current_->payload.chainLength() >= current_->length) {
+        put(current_->id,
+            ObjectStatus::NORMAL,
+            current_->extensions,
+            current_->payload.front());
+        current_.reset();
+      }
+    }
+
+    std::shared_ptr<MoQCacheWriter> writer_;
+    uint64_t group_;
+    uint64_t subgroup_;
+    std::shared_ptr<SubgroupConsumer> downstream_;
+    folly::Optional<StreamingObject> current_;
+  };
+
+  void put(
+      uint64_t group,
+      uint64_t subgroup,
+      uint64_t object,
+      ObjectStatus status,
+      const Extensions& extensions,
+      const folly::IOBuf* payload = nullptr) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - leaseChecked_ > (leaseHeld_ ? kLeaseTTL / 2 : kLeaseRetry)) {
+      leaseChecked_ = now;
+      auto held = cache_->acquireLease(fullTrackName_, kLeaseTTL);
+      if (held != leaseHeld_) {
+        XLOG_IF(INFO, held) << "Regained cache lease for " << fullTrackName_;
+        XLOG_IF(ERR, !held) << "Lost cache lease for " << fullTrackName_;
+        leaseHeld_ = held;
+        // The holder in between may have moved it
+        latestGroup_.reset();
+      }
+    }
+    if (!leaseHeld_) {
+      return;
+    }
+    if (quota_ &&
+        !quota_->chargeCache(payload ? payload->computeChainDataLength() : 0)) {
+      return;
+    }
+    if (cache_->put(
+            fullTrackName_,
+            group,
+            subgroup,
+            object,
+            status,
+            extensions,
+            payload) &&
+        (!latestGroup_ || *latestGroup_ < group)) {
+      latestGroup_ = group;
+      cache_->setLatestGroup(fullTrackName_, group);
+    }
+  }
+
+  FullTrackName fullTrackName_;
+  std::shared_ptr<ShmObjectCache> cache_;
+  std::shared_ptr<TrackConsumer> downstream_;
+  std::shared_ptr<MoQNamespaceQuota> quota_;
+  std::chrono::steady_clock::time_point leaseChecked_;
+  bool leaseHeld_{true};
+  folly::Optional<uint64_t> latestGroup_;
+};
+
+} // namespace moxygen
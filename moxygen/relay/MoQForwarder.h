@@ -8,11 +8,19 @@
 
 #include "moxygen/MoQLocation.h"
 #include "moxygen/MoQSession.h"
+#include "moxygen/relay/MoQNamespaceQuota.h"
+#include "moxygen/util/HeavyHitters.h"
+#include "moxygen/util/MemoryAccounting.h"
+#include "moxygen/util/MoQTracepoints.h"
 
 #include <folly/container/F14Set.h>
 #include <folly/hash/Hash.h>
+#include <folly/io/IOBufQueue.h>
 #include <folly/io/async/EventBase.h>
 
+#include <algorithm>
+#include <map>
+
 namespace moxygen {
 
 class MoQForwarder : public TrackConsumer {
@@ -22,6 +30,15 @@ class MoQForwarder : public TrackConsumer {
       folly::Optional<AbsoluteLocation> latest = folly::none)
       : fullTrackName_(std::move(ftn)), latest_(std::move(latest)) {}
 
+  ~MoQForwarder() override {
+    for (auto& liveFetch : liveFetches_) {
+      liveFetch->detach();
+    }
+    if (quota_) {
+      quota_->removeSubscribers(subscribers_.size());
+    }
+  }
+
   void setGroupOrder(GroupOrder order) {
     groupOrder_ = order;
   }
@@ -44,6 +61,18 @@ class MoQForwarder : public TrackConsumer {
     callback_ = std::move(callback);
   }
 
+  // Count the bytes forwarded to all subscribers towards this track's egress
+  void setHeavyHitters(std::shared_ptr<HeavyHitters> heavyHitters) {
+    heavyHitters_ = std::move(heavyHitters);
+    heavyHittersHash_ = HeavyHitters::hash(fullTrackName_);
+  }
+
+  // Count this track's subscribers and egress against a namespace quota.
+  // Set before adding subscribers.
+  void setQuota(std::shared_ptr<MoQNamespaceQuota> quota) {
+    quota_ = std::move(quota);
+  }
+
   struct SubgroupIdentifier {
     uint64_t group;
     uint64_t subgroup;
@@ -137,7 +166,9 @@ class MoQForwarder : public TrackConsumer {
         subReq.trackAlias,
         toSubscribeRange(subReq, latest_),
         std::move(consumer));
-    subscribers_.emplace(sessionPtr, subscriber);
+    if (subscribers_.emplace(sessionPtr, subscriber).second && quota_) {
+      quota_->addSubscriber();
+    }
     return subscriber;
   }
 
@@ -177,6 +208,280 @@ class MoQForwarder : public TrackConsumer {
     return SubscribeRange{start, {latest.group, latest.object + 1}};
   }
 
+  // Keep up to maxBytes of payload from the latest group, so that a FETCH
+  // reaching into it can be served locally by fetchLive().  0, the default,
+  // disables the buffer.
+  void setLiveGroupBuffer(uint64_t maxBytes) {
+    liveBufferMaxBytes_ = maxBytes;
+    if (liveBufferMaxBytes_ == 0) {
+      liveGroup_.reset();
+      liveObjects_.clear();
+      liveBufferBytes_ = 0;
+    }
+  }
+
+  // Where the buffered live group starts, none if nothing is buffered or
+  // the group outgrew the buffer
+  folly::Optional<AbsoluteLocation> liveBufferStart() const {
+    if (liveBufferMaxBytes_ == 0 || !liveGroup_ || liveBufferOverflow_) {
+      return folly::none;
+    }
+    return AbsoluteLocation{*liveGroup_, liveGroupFirstObject_};
+  }
+
+  struct LiveObject {
+    uint64_t subgroup;
+    ObjectStatus status;
+    Extensions extensions;
+    Payload payload;
+
+    LiveObject clone() const {
+      return {subgroup, status, extensions, maybeClone(payload)};
+    }
+  };
+
+  // A FETCH served from the live group.  It receives the buffered prefix,
+  // then each object as it arrives from upstream, until the end of the range.
+  //
+  // Subgroups arrive concurrently, so objects are queued and written in
+  // order once every open subgroup has moved past them.  Past
+  // kMaxLiveFetchReorder queued objects the earliest is written anyway, and
+  // any object arriving behind it is skipped.
+  class LiveFetch : public Publisher::FetchHandle {
+   public:
+    static constexpr size_t kMaxLiveFetchReorder = 64;
+    // Objects a held fetch may queue before it is reset
+    static constexpr size_t kMaxHeldLiveFetchObjects = 4096;
+
+    LiveFetch(
+        MoQForwarder& forwarder,
+        FetchOk ok,
+        std::shared_ptr<FetchConsumer> consumer,
+        AbsoluteLocation start,
+        AbsoluteLocation end,
+        bool held)
+        : Publisher::FetchHandle(std::move(ok)),
+          forwarder_(&forwarder),
+          consumer_(std::move(consumer)),
+          next_(start),
+          end_(end),
+          held_(held) {}
+
+    void fetchCancel() override {
+      // The session has already reset the stream
+      if (forwarder_) {
+        forwarder_->removeLiveFetch(this);
+      }
+      detach();
+    }
+
+    void detach() {
+      forwarder_ = nullptr;
+      done_ = true;
+      pending_.clear();
+    }
+
+    bool done() const {
+      return done_;
+    }
+
+    // Queues the object and writes what can be written.  Returns false once
+    // the fetch is complete or failed.
+    bool deliver(uint64_t group, uint64_t objectID, const LiveObject& object) {
+      if (done_) {
+        return false;
+      }
+      AbsoluteLocation loc{group, objectID};
+      if (loc < next_) {
+        XLOG(DBG4) << "Live fetch skipping " << group << "," << objectID;
+        return true;
+      }
+      pending_.try_emplace(loc, object.clone());
+      if (held_) {
+        if (pending_.size() > kMaxHeldLiveFetchObjects) {
+          XLOG(ERR) << "Live fetch queued too much waiting for its head";
+          reset(ResetStreamErrorCode::INTERNAL_ERROR);
+          return false;
+        }
+        return true;
+      }
+      return flush();
+    }
+
+    // Writes the queued objects no earlier object can still arrive before.
+    // Called as objects arrive and as subgroups close.
+    bool flush() {
+      while (!done_ && !held_ && !pending_.empty()) {
+        auto it = pending_.begin();
+        if (pending_.size() <= kMaxLiveFetchReorder && forwarder_ &&
+            !forwarder_->liveObjectsSettled(it->first)) {
+          break;
+        }
+        auto loc = it->first;
+        auto object = std::move(it->second);
+        pending_.erase(it);
+        if (!inRange(loc)) {
+          // Every object in the range has been written or skipped
+          finish();
+          break;
+        }
+        write(loc, object);
+      }
+      return !done_;
+    }
+
+    // Starts writing a held fetch once the part of the range before the
+    // live group has been served
+    bool release() {
+      held_ = false;
+      return flush();
+    }
+
+    void finish() {
+      if (!done_) {
+        consumer_->endOfFetch();
+        done_ = true;
+        pending_.clear();
+      }
+    }
+
+    void reset(ResetStreamErrorCode error) {
+      if (!done_) {
+        consumer_->reset(error);
+        done_ = true;
+        pending_.clear();
+      }
+    }
+
+   private:
+    void write(AbsoluteLocation loc, LiveObject& object) {
+      auto group = loc.group;
+      auto objectID = loc.object;
+      folly::Expected<folly::Unit, MoQPublishError> res{folly::unit};
+      switch (object.status) {
+        case ObjectStatus::NORMAL:
+          res = consumer_->object(
+              group,
+              object.subgroup,
+              objectID,
+              std::move(object.payload),
+              object.extensions);
+          break;
+        case ObjectStatus::OBJECT_NOT_EXIST:
+          res = consumer_->objectNotExists(
+              group, object.subgroup, objectID, object.extensions);
+          break;
+        case ObjectStatus::GROUP_NOT_EXIST:
+          res = consumer_->groupNotExists(
+              group, object.subgroup, object.extensions);
+          break;
+        case ObjectStatus::END_OF_GROUP:
+          res = consumer_->endOfGroup(
+              group, object.subgroup, objectID, object.extensions);
+          break;
+        case ObjectStatus::END_OF_TRACK_AND_GROUP:
+          // implies endOfFetch
+          consumer_->endOfTrackAndGroup(
+              group, object.subgroup, objectID, object.extensions);
+          done_ = true;
+          pending_.clear();
+          return;
+        case ObjectStatus::END_OF_TRACK:
+          finish();
+          return;
+      }
+      // Live objects cannot wait for the consumer, so BLOCKED only means
+      // the consumer is buffering
+      if (res.hasError() && res.error().code != MoQPublishError::BLOCKED) {
+        XLOG(ERR) << "Live fetch error: " << res.error().what();
+        reset(ResetStreamErrorCode::INTERNAL_ERROR);
+        return;
+      }
+      if (object.status == ObjectStatus::END_OF_GROUP ||
+          object.status == ObjectStatus::GROUP_NOT_EXIST) {
+        next_ = {group + 1, 0};
+      } else {
+        next_ = {group, objectID + 1};
+      }
+      if (!inRange(next_)) {
+        finish();
+      }
+    }
+
+    // The end is exclusive, and end.object == 0 means the whole end group
+    bool inRange(AbsoluteLocation loc) const {
+      return loc.group < end_.group ||
+          (loc.group == end_.group &&
+           (end_.object == 0 || loc.object < end_.object));
+    }
+
+    MoQForwarder* forwarder_;
+    std::shared_ptr<FetchConsumer> consumer_;
+    // Objects before next_ have been written or skipped
+    AbsoluteLocation next_;
+    AbsoluteLocation end_;
+    bool held_;
+    bool done_{false};
+    std::map<AbsoluteLocation, LiveObject> pending_;
+  };
+
+  // Serves FETCH [start, end) when start is in the buffered live group,
+  // otherwise returns nullptr.  The end may be past the latest object.  A
+  // held fetch queues objects without writing them until release(), so the
+  // caller can first serve the part of a FETCH that precedes the buffer.
+  std::shared_ptr<LiveFetch> fetchLive(
+      SubscribeID subscribeID,
+      GroupOrder groupOrder,
+      AbsoluteLocation start,
+      AbsoluteLocation end,
+      std::shared_ptr<FetchConsumer> consumer,
+      bool held = false) {
+    auto bufferStart = liveBufferStart();
+    if (!bufferStart || start.group != bufferStart->group ||
+        start < *bufferStart) {
+      return nullptr;
+    }
+    XCHECK(latest_);
+    auto liveFetch = std::make_shared<LiveFetch>(
+        *this,
+        FetchOk{
+            subscribeID,
+            MoQSession::resolveGroupOrder(GroupOrder::OldestFirst, groupOrder),
+            0, // not end of track
+            *latest_,
+            {}},
+        std::move(consumer),
+        start,
+        end,
+        held);
+    bool active = true;
+    for (auto it = liveObjects_.lower_bound(start.object);
+         active && it != liveObjects_.end();
+         ++it) {
+      active = liveFetch->deliver(*liveGroup_, it->first, it->second);
+    }
+    if (active) {
+      liveFetches_.push_back(liveFetch);
+    }
+    return liveFetch;
+  }
+
+  // Whether no object before loc can still arrive: every open subgroup of
+  // loc's group has sent an object at or past loc, and no earlier group
+  // has an open subgroup
+  bool liveObjectsSettled(AbsoluteLocation loc) const {
+    for (const auto& [identifier, subgroup] : subgroups_) {
+      if (identifier.group < loc.group) {
+        return false;
+      }
+      if (identifier.group == loc.group &&
+          (!subgroup->lastObject() || *subgroup->lastObject() < loc.object)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   void removeSession(
       const std::shared_ptr<MoQSession>& session,
       folly::Optional<SubscribeDone> subDone = folly::none) {
@@ -188,6 +493,9 @@ class MoQForwarder : public TrackConsumer {
     }
     subscribeDone(*subIt->second, subDone);
     subscribers_.erase(subIt);
+    if (quota_) {
+      quota_->removeSubscribers(1);
+    }
     XLOG(DBG1) << "subscribers_.size()=" << subscribers_.size();
     if (subscribers_.empty() && callback_) {
       callback_->onEmpty(this);
@@ -200,7 +508,9 @@ class MoQForwarder : public TrackConsumer {
     // TODO: Resetting subgroups here is too aggressive
     XLOG(DBG1) << "Resetting open subgroups for subscriber=" << &subscriber;
     for (auto& subgroup : subscriber.subgroups) {
-      subgroup.second->reset(ResetStreamErrorCode::CANCELLED);
+      if (subgroup.second) {
+        subgroup.second->reset(ResetStreamErrorCode::CANCELLED);
+      }
     }
     if (subDone) {
       subDone->subscribeID = subscriber.subscribeID;
@@ -210,6 +520,8 @@ class MoQForwarder : public TrackConsumer {
 
   void forEachSubscriber(
       std::function<void(const std::shared_ptr<Subscriber>&)> fn) {
+    MOQ_LOOP_SCOPE(FORWARD);
+    MOQ_MEM_SCOPE(FORWARDER);
     for (auto subscriberIt = subscribers_.begin();
          subscriberIt != subscribers_.end();) {
       const auto& sub = subscriberIt->second;
@@ -218,6 +530,147 @@ class MoQForwarder : public TrackConsumer {
     }
   }
 
+  // Sizes the payload only when the quota, heavy hitters or the probe need
+  // it
+  void traceForward(uint64_t group, uint64_t object, const Payload& payload) {
+    if (quota_ || heavyHitters_ ||
+        FOLLY_SDT_IS_ENABLED(moxygen, object_forwarded)) {
+      traceForward(group, object, payloadLength(payload));
+    }
+  }
+
+  void traceForward(uint64_t group, uint64_t object, uint64_t bytes) {
+    if (quota_) {
+      quota_->chargeEgress(bytes * subscribers_.size());
+    }
+    if (heavyHitters_) {
+      heavyHitters_->record(
+          HeavyHitterMetric::EGRESS_BYTES,
+          fullTrackName_,
+          heavyHittersHash_,
+          bytes * subscribers_.size());
+    }
+    if (FOLLY_SDT_IS_ENABLED(moxygen, object_forwarded)) {
+      if (traceNamespace_.empty()) {
+        traceNamespace_ = fullTrackName_.trackNamespace.describe();
+      }
+      FOLLY_SDT_WITH_SEMAPHORE(
+          moxygen,
+          object_forwarded,
+          traceNamespace_.c_str(),
+          fullTrackName_.trackName.c_str(),
+          group,
+          object,
+          bytes,
+          subscribers_.size());
+    }
+  }
+
+  static uint64_t payloadLength(const Payload& payload) {
+    return payload ? payload->computeChainDataLength() : 0;
+  }
+
+  // Completes the live fetches if the track ended, otherwise resets them
+  void endLiveFetches(bool trackEnded) {
+    auto liveFetches = std::move(liveFetches_);
+    liveFetches_.clear();
+    for (auto& liveFetch : liveFetches) {
+      if (trackEnded) {
+        liveFetch->finish();
+      } else {
+        liveFetch->reset(ResetStreamErrorCode::INTERNAL_ERROR);
+      }
+      liveFetch->detach();
+    }
+  }
+
+  void removeLiveFetch(LiveFetch* liveFetch) {
+    liveFetches_.erase(
+        std::remove_if(
+            liveFetches_.begin(),
+            liveFetches_.end(),
+            [liveFetch](const auto& lf) { return lf.get() == liveFetch; }),
+        liveFetches_.end());
+  }
+
+  void onLiveObject(
+      uint64_t group,
+      uint64_t subgroup,
+      uint64_t objectID,
+      ObjectStatus status,
+      const Extensions& extensions,
+      const Payload& payload) {
+    if (!wantsLiveObjects()) {
+      return;
+    }
+    LiveObject object{subgroup, status, extensions, maybeClone(payload)};
+    if (liveBufferMaxBytes_ > 0 && (!liveGroup_ || group >= *liveGroup_)) {
+      bufferLiveObject(group, objectID, object);
+    }
+    if (liveFetches_.empty()) {
+      return;
+    }
+    auto liveFetches = liveFetches_;
+    for (auto& liveFetch : liveFetches) {
+      if (!liveFetch->deliver(group, objectID, object)) {
+        removeLiveFetch(liveFetch.get());
+      }
+    }
+  }
+
+  void bufferLiveObject(
+      uint64_t group,
+      uint64_t objectID,
+      const LiveObject& object) {
+    if (!liveGroup_ || group > *liveGroup_) {
+      liveGroup_ = group;
+      liveGroupFirstObject_ = objectID;
+      liveObjects_.clear();
+      liveBufferBytes_ = 0;
+      liveBufferOverflow_ = false;
+    }
+    if (liveBufferOverflow_) {
+      return;
+    }
+    liveBufferBytes_ += payloadLength(object.payload);
+    if (liveBufferBytes_ > liveBufferMaxBytes_) {
+      XLOG(DBG1) << "Live group " << group << " outgrew the buffer for "
+                 << fullTrackName_;
+      liveBufferOverflow_ = true;
+      liveObjects_.clear();
+      return;
+    }
+    // A subgroup that started later may still bring lower objects
+    liveGroupFirstObject_ = std::min(liveGroupFirstObject_, objectID);
+    liveObjects_[objectID] = object.clone();
+  }
+
+  // Objects the live fetches are waiting on may now be writable
+  void flushLiveFetches() {
+    if (liveFetches_.empty()) {
+      return;
+    }
+    auto liveFetches = liveFetches_;
+    for (auto& liveFetch : liveFetches) {
+      if (!liveFetch->flush()) {
+        removeLiveFetch(liveFetch.get());
+      }
+    }
+  }
+
+  void closeSubgroup(const SubgroupIdentifier& identifier) {
+    subgroups_.erase(identifier);
+    // Including the subscribers that dropped it
+    for (auto& subscriber : subscribers_) {
+      subscriber.second->subgroups.erase(identifier);
+    }
+    flushLiveFetches();
+  }
+
+  bool wantsLiveObjects() const {
+    return liveBufferMaxBytes_ > 0 || !liveFetches_.empty();
+  }
+
   void updateLatest(uint64_t group, uint64_t object = 0) {
     AbsoluteLocation now{group, object};
     if (!latest_ || now > *latest_) {
@@ -257,6 +710,39 @@ class MoQForwarder : public TrackConsumer {
             sub.range.end});
   }
 
+  // The session drops a subgroup that waited too long for stream credit with
+  // TOO_FAR_BEHIND, and fails to open a stream with BLOCKED.  Either costs
+  // the subscriber that data, not the subscription.
+  static bool isDropped(const MoQPublishError& err) {
+    return err.code == MoQPublishError::TOO_FAR_BEHIND ||
+        err.code == MoQPublishError::BLOCKED;
+  }
+
+  void onError(const Subscriber& sub, const MoQPublishError& err) {
+    if (isDropped(err)) {
+      XLOG(DBG1) << "Dropped object for subscriber=" << &sub
+                 << " err=" << err.what();
+      return;
+    }
+    removeSession(sub, err);
+  }
+
+  // A dropped subgroup keeps an empty entry until it closes, so the rest of
+  // it is not sent on a new stream
+  void onSubgroupError(
+      Subscriber& sub,
+      const SubgroupIdentifier& identifier,
+      const MoQPublishError& err) {
+    if (isDropped(err)) {
+      XLOG(DBG1) << "Dropped subgroup=" << identifier.group << "/"
+                 << identifier.subgroup << " for subscriber=" << &sub
+                 << " err=" << err.what();
+      sub.subgroups[identifier] = nullptr;
+      return;
+    }
+    removeSession(sub, err);
+  }
+
   folly::Expected<std::shared_ptr<SubgroupConsumer>, MoQPublishError>
   beginSubgroup(uint64_t groupID, uint64_t subgroupID, Priority priority)
       override {
@@ -271,7 +757,7 @@ class MoQForwarder : public TrackConsumer {
       auto res =
           sub->trackConsumer->beginSubgroup(groupID, subgroupID, priority);
       if (res.hasError()) {
-        removeSession(*sub, res.error());
+        onSubgroupError(*sub, subgroupIdentifier, res.error());
       } else {
         sub->subgroups[subgroupIdentifier] = res.value();
       }
@@ -289,12 +775,20 @@ class MoQForwarder : public TrackConsumer {
       const ObjectHeader& header,
       Payload payload) override {
     updateLatest(header.group, header.id);
+    onLiveObject(
+        header.group,
+        header.subgroup,
+        header.id,
+        header.status,
+        header.extensions,
+        payload);
+    traceForward(header.group, header.id, payload);
     forEachSubscriber([&](const std::shared_ptr<Subscriber>& sub) {
       if (!checkRange(*sub)) {
         return;
       }
       sub->trackConsumer->objectStream(header, maybeClone(payload))
-          .onError([this, sub](const auto& err) { removeSession(*sub, err); });
+          .onError([this, sub](const auto& err) { onError(*sub, err); });
     });
     return folly::unit;
   }
@@ -305,12 +799,19 @@ class MoQForwarder : public TrackConsumer {
       Priority pri,
       Extensions extensions) override {
     updateLatest(groupID, 0);
+    onLiveObject(
+        groupID,
+        subgroup,
+        0,
+        ObjectStatus::GROUP_NOT_EXIST,
+        extensions,
+        nullptr);
     forEachSubscriber([&](const std::shared_ptr<Subscriber>& sub) {
       if (!checkRange(*sub)) {
         return;
       }
       sub->trackConsumer->groupNotExists(groupID, subgroup, pri, extensions)
-          .onError([this, sub](const auto& err) { removeSession(*sub, err); });
+          .onError([this, sub](const auto& err) { onError(*sub, err); });
     });
     return folly::unit;
   }
@@ -319,18 +820,27 @@ class MoQForwarder : public TrackConsumer {
       const ObjectHeader& header,
       Payload payload) override {
     updateLatest(header.group, header.id);
+    onLiveObject(
+        header.group,
+        header.subgroup,
+        header.id,
+        header.status,
+        header.extensions,
+        payload);
+    traceForward(header.group, header.id, payload);
     forEachSubscriber([&](const std::shared_ptr<Subscriber>& sub) {
       if (!checkRange(*sub)) {
         return;
       }
       sub->trackConsumer->datagram(header, maybeClone(payload))
-          .onError([this, sub](const auto& err) { removeSession(*sub, err); });
+          .onError([this, sub](const auto& err) { onError(*sub, err); });
     });
     return folly::unit;
   }
 
   folly::Expected<folly::Unit, MoQPublishError> subscribeDone(
       SubscribeDone subDone) override {
+    endLiveFetches(subDone.statusCode == SubscribeDoneStatusCode::TRACK_ENDED);
     forEachSubscriber([&](const std::shared_ptr<Subscriber>& sub) {
       removeSession(sub->session, subDone);
     });
@@ -339,6 +849,17 @@ class MoQForwarder : public TrackConsumer {
 
   class SubgroupForwarder : public SubgroupConsumer {
     folly::Optional<uint64_t> currentObjectLength_;
+    // Payload of the current streaming object, when buffering the live group
+    struct StreamingObject {
+      StreamingObject(uint64_t i, Extensions e)
+          : id(i), extensions(std::move(e)) {}
+      uint64_t id;
+      Extensions extensions;
+      folly::IOBufQueue payload{folly::IOBufQueue::cacheChainLength()};
+    };
+    folly::Optional<StreamingObject> currentObject_;
+    // The latest object begun on this subgroup
+    folly::Optional<uint64_t> lastObject_;
     MoQForwarder& forwarder_;
     SubgroupIdentifier identifier_;
     Priority priority_;
@@ -354,18 +875,35 @@ class MoQForwarder : public TrackConsumer {
             auto res = sub->trackConsumer->beginSubgroup(
                 identifier_.group, identifier_.subgroup, priority_);
             if (res.hasError()) {
-              forwarder_.removeSession(*sub, res.error());
-            } else {
-              auto emplaceRes =
-                  sub->subgroups.emplace(identifier_, res.value());
-              subgroupConsumerIt = emplaceRes.first;
+              forwarder_.onSubgroupError(*sub, identifier_, res.error());
+              return;
             }
+            auto emplaceRes = sub->subgroups.emplace(identifier_, res.value());
+            subgroupConsumerIt = emplaceRes.first;
+          } else if (!subgroupConsumerIt->second) {
+            // Dropped
+            return;
           }
           fn(sub, subgroupConsumerIt->second);
         }
       });
     }
 
+    void onLiveObject(
+        uint64_t objectID,
+        ObjectStatus status,
+        const Extensions& extensions,
+        const Payload& payload = nullptr) {
+      lastObject_ = objectID;
+      forwarder_.onLiveObject(
+          identifier_.group,
+          identifier_.subgroup,
+          objectID,
+          status,
+          extensions,
+          payload);
+    }
+
    public:
     SubgroupForwarder(
         MoQForwarder& forwarder,
@@ -376,6 +914,10 @@ class MoQForwarder : public TrackConsumer {
           identifier_{group, subgroup},
           priority_(priority) {}
 
+    const folly::Optional<uint64_t>& lastObject() const {
+      return lastObject_;
+    }
+
     folly::Expected<folly::Unit, MoQPublishError> object(
         uint64_t objectID,
         Payload payload,
@@ -386,20 +928,22 @@ class MoQForwarder : public TrackConsumer {
             MoQPublishError::API_ERROR, "Still publishing previous object"));
       }
       forwarder_.updateLatest(identifier_.group, objectID);
+      onLiveObject(objectID, ObjectStatus::NORMAL, extensions, payload);
+      forwarder_.traceForward(identifier_.group, objectID, payload);
       forEachSubscriberSubgroup(
           [&](const std::shared_ptr<Subscriber>& sub,
               const std::shared_ptr<SubgroupConsumer>& subgroupConsumer) {
             subgroupConsumer
                 ->object(objectID, maybeClone(payload), extensions, finSubgroup)
                 .onError([this, sub](const auto& err) {
-                  forwarder_.removeSession(*sub, err);
+                  forwarder_.onSubgroupError(*sub, identifier_, err);
                 });
             if (finSubgroup) {
               sub->subgroups.erase(identifier_);
             }
           });
       if (finSubgroup) {
-        forwarder_.subgroups_.erase(identifier_);
+        forwarder_.closeSubgroup(identifier_);
       }
       return folly::unit;
     }
@@ -413,19 +957,20 @@ class MoQForwarder : public TrackConsumer {
             MoQPublishError::API_ERROR, "Still publishing previous object"));
       }
       forwarder_.updateLatest(identifier_.group, objectID);
+      onLiveObject(objectID, ObjectStatus::OBJECT_NOT_EXIST, extensions);
       forEachSubscriberSubgroup(
           [&](const std::shared_ptr<Subscriber>& sub,
               const std::shared_ptr<SubgroupConsumer>& subgroupConsumer) {
             subgroupConsumer->objectNotExists(objectID, extensions, finSubgroup)
                 .onError([this, sub](const auto& err) {
-                  forwarder_.removeSession(*sub, err);
+                  forwarder_.onSubgroupError(*sub, identifier_, err);
                 });
             if (finSubgroup) {
               sub->subgroups.erase(identifier_);
             }
           });
       if (finSubgroup) {
-        forwarder_.subgroups_.erase(identifier_);
+        forwarder_.closeSubgroup(identifier_);
       }
       return folly::unit;
     }
@@ -445,7 +990,18 @@ class MoQForwarder : public TrackConsumer {
           (initialPayload) ? initialPayload->computeChainDataLength() : 0;
       if (length > payloadLength) {
         currentObjectLength_ = length - payloadLength;
+        lastObject_ = objectID;
+        if (forwarder_.wantsLiveObjects()) {
+          currentObject_.emplace(objectID, extensions);
+          if (initialPayload) {
+            currentObject_->payload.append(initialPayload->clone());
+          }
+        }
+      } else {
+        onLiveObject(
+            objectID, ObjectStatus::NORMAL, extensions, initialPayload);
       }
+      forwarder_.traceForward(identifier_.group, objectID, length);
       forEachSubscriberSubgroup(
           [&](const std::shared_ptr<Subscriber>& sub,
               const std::shared_ptr<SubgroupConsumer>& subgroupConsumer) {
@@ -453,7 +1009,7 @@ class MoQForwarder : public TrackConsumer {
                 ->beginObject(
                     objectID, length, maybeClone(initialPayload), extensions)
                 .onError([this, sub](const auto& err) {
-                  forwarder_.removeSession(*sub, err);
+                  forwarder_.onSubgroupError(*sub, identifier_, err);
                 });
           });
       return folly::unit;
@@ -467,16 +1023,17 @@ class MoQForwarder : public TrackConsumer {
             MoQPublishError::API_ERROR, "Still publishing previous object"));
       }
       forwarder_.updateLatest(identifier_.group, endOfGroupObjectID);
+      onLiveObject(endOfGroupObjectID, ObjectStatus::END_OF_GROUP, extensions);
       forEachSubscriberSubgroup(
           [&](const std::shared_ptr<Subscriber>& sub,
               const std::shared_ptr<SubgroupConsumer>& subgroupConsumer) {
             subgroupConsumer->endOfGroup(endOfGroupObjectID, extensions)
                 .onError([this, sub](const auto& err) {
-                  forwarder_.removeSession(*sub, err);
+                  forwarder_.onSubgroupError(*sub, identifier_, err);
                 });
             sub->subgroups.erase(identifier_);
           });
-      forwarder_.subgroups_.erase(identifier_);
+      forwarder_.closeSubgroup(identifier_);
       return folly::unit;
     }
 
@@ -488,16 +1045,18 @@ class MoQForwarder : public TrackConsumer {
             MoQPublishError::API_ERROR, "Still publishing previous object"));
       }
       forwarder_.updateLatest(identifier_.group, endOfTrackObjectID);
+      onLiveObject(
+          endOfTrackObjectID, ObjectStatus::END_OF_TRACK_AND_GROUP, extensions);
       forEachSubscriberSubgroup(
           [&](const std::shared_ptr<Subscriber>& sub,
               const std::shared_ptr<SubgroupConsumer>& subgroupConsumer) {
             subgroupConsumer->endOfTrackAndGroup(endOfTrackObjectID, extensions)
                 .onError([this, sub](const auto& err) {
-                  forwarder_.removeSession(*sub, err);
+                  forwarder_.onSubgroupError(*sub, identifier_, err);
                 });
             sub->subgroups.erase(identifier_);
           });
-      forwarder_.subgroups_.erase(identifier_);
+      forwarder_.closeSubgroup(identifier_);
       return folly::unit;
     }
 
@@ -511,22 +1070,23 @@ class MoQForwarder : public TrackConsumer {
               const std::shared_ptr<SubgroupConsumer>& subgroupConsumer) {
             subgroupConsumer->endOfSubgroup().onError(
                 [this, sub](const auto& err) {
-                  forwarder_.removeSession(*sub, err);
+                  forwarder_.onSubgroupError(*sub, identifier_, err);
                 });
             sub->subgroups.erase(identifier_);
           });
-      forwarder_.subgroups_.erase(identifier_);
+      forwarder_.closeSubgroup(identifier_);
       return folly::unit;
     }
 
     void reset(ResetStreamErrorCode error) override {
+      currentObject_.reset();
       forEachSubscriberSubgroup(
           [&](const std::shared_ptr<Subscriber>& sub,
               const std::shared_ptr<SubgroupConsumer>& subgroupConsumer) {
             subgroupConsumer->reset(error);
             sub->subgroups.erase(identifier_);
           });
-      forwarder_.subgroups_.erase(identifier_);
+      forwarder_.closeSubgroup(identifier_);
     }
 
     folly::Expected<ObjectPublishStatus, MoQPublishError> objectPayload(
@@ -542,12 +1102,15 @@ class MoQForwarder : public TrackConsumer {
             MoQPublishError::API_ERROR, "Payload exceeded length"));
       }
       *currentObjectLength_ -= payloadLength;
+      if (currentObject_ && payload) {
+        currentObject_->payload.append(payload->clone());
+      }
       forEachSubscriberSubgroup(
           [&](const std::shared_ptr<Subscriber>& sub,
               const std::shared_ptr<SubgroupConsumer>& subgroupConsumer) {
             subgroupConsumer->objectPayload(maybeClone(payload), finSubgroup)
                 .onError([this, sub](const auto& err) {
-                  forwarder_.removeSession(*sub, err);
+                  forwarder_.onSubgroupError(*sub, identifier_, err);
                 });
             if (finSubgroup) {
               sub->subgroups.erase(identifier_);
@@ -555,8 +1118,16 @@ class MoQForwarder : public TrackConsumer {
           });
       if (*currentObjectLength_ == 0) {
         currentObjectLength_.reset();
+        if (currentObject_) {
+          onLiveObject(
+              currentObject_->id,
+              ObjectStatus::NORMAL,
+              currentObject_->extensions,
+              currentObject_->payload.move());
+          currentObject_.reset();
+        }
         if (finSubgroup) {
-          forwarder_.subgroups_.erase(identifier_);
+          forwarder_.closeSubgroup(identifier_);
         }
         return ObjectPublishStatus::DONE;
       }
@@ -579,6 +1150,18 @@ class MoQForwarder : public TrackConsumer {
   GroupOrder groupOrder_{GroupOrder::OldestFirst};
   folly::Optional<AbsoluteLocation> latest_;
   std::shared_ptr<Callback> callback_;
+  std::shared_ptr<HeavyHitters> heavyHitters_;
+  uint64_t heavyHittersHash_{0};
+  // Namespace passed to the object_forwarded probe, set once attached
+  std::string traceNamespace_;
+  std::shared_ptr<MoQNamespaceQuota> quota_;
+  uint64_t liveBufferMaxBytes_{0};
+  uint64_t liveBufferBytes_{0};
+  bool liveBufferOverflow_{false};
+  folly::Optional<uint64_t> liveGroup_;
+  uint64_t liveGroupFirstObject_{0};
+  std::map<uint64_t, LiveObject> liveObjects_;
+  std::vector<std::shared_ptr<LiveFetch>> liveFetches_;
 };
 
 } // namespace moxygen
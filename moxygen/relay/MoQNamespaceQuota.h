@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQFramer.h"
+
+#include <folly/Optional.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace moxygen {
+
+// Resource limits for every track under a namespace prefix on a relay.
+//
+// Subscribers and upstream subscriptions are counted while they exist.
+// Egress and cache writes are measured in one second windows: while the
+// prefix is over its egress rate new SUBSCRIBEs and FETCHes are rejected,
+// and cache writes beyond the cache rate are skipped, so a tenant cannot
+// churn other tenants out of the shared cache.  Counters may be read from
+// any thread.
+class MoQNamespaceQuota
+    : public std::enable_shared_from_this<MoQNamespaceQuota> {
+ public:
+  // Unset limits are unlimited
+  struct Limits {
+    folly::Optional<uint64_t> maxUpstreamSubscriptions;
+    folly::Optional<uint64_t> maxSubscribers;
+    folly::Optional<uint64_t> maxEgressBytesPerSec;
+    folly::Optional<uint64_t> maxCacheBytesPerSec;
+  };
+
+  MoQNamespaceQuota(TrackNamespace prefix, Limits limits)
+      : prefix_(std::move(prefix)), limits_(std::move(limits)) {}
+
+  const TrackNamespace& prefix() const {
+    return prefix_;
+  }
+
+  const Limits& limits() const {
+    return limits_;
+  }
+
+  // Holds one upstream subscription against the quota until destroyed
+  class UpstreamTicket {
+   public:
+    UpstreamTicket() = default;
+    explicit UpstreamTicket(std::shared_ptr<MoQNamespaceQuota> quota)
+        : quota_(std::move(quota)) {}
+    UpstreamTicket(UpstreamTicket&&) noexcept = default;
+    UpstreamTicket& operator=(UpstreamTicket&& other) noexcept {
+      if (this != &other) {
+        release();
+        quota_ = std::move(other.quota_);
+      }
+      return *this;
+    }
+    UpstreamTicket(const UpstreamTicket&) = delete;
+    UpstreamTicket& operator=(const UpstreamTicket&) = delete;
+    ~UpstreamTicket() {
+      release();
+    }
+
+   private:
+    void release() {
+      if (quota_) {
+        quota_->upstreamSubscriptions_.fetch_sub(1, std::memory_order_relaxed);
+        quota_.reset();
+      }
+    }
+
+    std::shared_ptr<MoQNamespaceQuota> quota_;
+  };
+
+  // Returns none, and counts a rejection, at the upstream limit
+  folly::Optional<UpstreamTicket> acquireUpstream() {
+    auto count = upstreamSubscriptions_.fetch_add(1, std::memory_order_relaxed);
+    if (limits_.maxUpstreamSubscriptions &&
+        count >= *limits_.maxUpstreamSubscriptions) {
+      upstreamSubscriptions_.fetch_sub(1, std::memory_order_relaxed);
+      onRejected();
+      return folly::none;
+    }
+    return UpstreamTicket(shared_from_this());
+  }
+
+  // Whether a new subscriber may join.  Counts a rejection if not.
+  bool admitSubscriber() {
+    if ((limits_.maxSubscribers &&
+         subscribers_.load(std::memory_order_relaxed) >=
+             *limits_.maxSubscribers) ||
+        overEgress()) {
+      onRejected();
+      return false;
+    }
+    return true;
+  }
+
+  // Whether a FETCH may be served.  Counts a rejection if not.
+  bool admitFetch() {
+    if (overEgress()) {
+      onRejected();
+      return false;
+    }
+    return true;
+  }
+
+  // Called by the forwarders of the prefix's tracks
+  void addSubscriber() {
+    subscribers_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void removeSubscribers(uint64_t count) {
+    subscribers_.fetch_sub(count, std::memory_order_relaxed);
+  }
+
+  void chargeEgress(uint64_t bytes) {
+    egress_.add(bytes, now());
+  }
+
+  bool overEgress() const {
+    return limits_.maxEgressBytesPerSec &&
+        egress_.rate(now()) > *limits_.maxEgressBytesPerSec;
+  }
+
+  // Returns false, without charging, when writing bytes to the cache would
+  // exceed the cache rate
+  bool chargeCache(uint64_t bytes) {
+    auto sec = now();
+    if (limits_.maxCacheBytesPerSec &&
+        cache_.current(sec) + bytes > *limits_.maxCacheBytesPerSec) {
+      cacheSkipped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    cache_.add(bytes, sec);
+    return true;
+  }
+
+  struct Usage {
+    uint64_t upstreamSubscriptions{0};
+    uint64_t subscribers{0};
+    uint64_t egressBytesPerSec{0};
+    uint64_t cacheBytesPerSec{0};
+    uint64_t rejected{0};
+    uint64_t cacheSkipped{0};
+  };
+
+  Usage usage() const {
+    auto sec = now();
+    Usage usage;
+    usage.upstreamSubscriptions =
+        upstreamSubscriptions_.load(std::memory_order_relaxed);
+    usage.subscribers = subscribers_.load(std::memory_order_relaxed);
+    usage.egressBytesPerSec = egress_.rate(sec);
+    usage.cacheBytesPerSec = cache_.rate(sec);
+    usage.rejected = rejected_.load(std::memory_order_relaxed);
+    usage.cacheSkipped = cacheSkipped_.load(std::memory_order_relaxed);
+    return usage;
+  }
+
+ private:
+  // Bytes in the current and previous one second windows.  Concurrent
+  // rollover may lose a few bytes, which is fine for a quota.
+  class RateWindow {
+   public:
+    void add(uint64_t bytes, uint64_t sec) {
+      auto prev = second_.load(std::memory_order_relaxed);
+      if (sec != prev && second_.compare_exchange_strong(prev, sec)) {
+        auto last = current_.exchange(0, std::memory_order_relaxed);
+        previous_.store(sec == prev + 1 ? last : 0, std::memory_order_relaxed);
+      }
+      current_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Bytes so far in the window containing sec
+    uint64_t current(uint64_t sec) const {
+      return sec == second_.load(std::memory_order_relaxed)
+          ? current_.load(std::memory_order_relaxed)
+          : 0;
+    }
+
+    // The busier of the last complete window and the current one
+    uint64_t rate(uint64_t sec) const {
+      auto second = second_.load(std::memory_order_relaxed);
+      if (sec == second) {
+        return std::max(
+            previous_.load(std::memory_order_relaxed),
+            current_.load(std::memory_order_relaxed));
+      } else if (sec == second + 1) {
+        return current_.load(std::memory_order_relaxed);
+      }
+      return 0;
+    }
+
+   private:
+    std::atomic<uint64_t> second_{0};
+    std::atomic<uint64_t> current_{0};
+    std::atomic<uint64_t> previous_{0};
+  };
+
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void onRejected() {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  TrackNamespace prefix_;
+  Limits limits_;
+  std::atomic<uint64_t> upstreamSubscriptions_{0};
+  std::atomic<uint64_t> subscribers_{0};
+  std::atomic<uint64_t> rejected_{0};
+  std::atomic<uint64_t> cacheSkipped_{0};
+  RateWindow egress_;
+  RateWindow cache_;
+};
+
+} // namespace moxygen
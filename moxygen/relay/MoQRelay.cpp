@@ -6,16 +6,35 @@
 
 #include "moxygen/relay/MoQRelay.h"
 
+#include <folly/coro/Collect.h>
+#include <folly/coro/CurrentExecutor.h>
+
 namespace {
 constexpr uint8_t kDefaultUpstreamPriority = 128;
+// Larger FETCHes go upstream rather than being served from the cache
+constexpr size_t kMaxCachedFetchObjects = 4096;
+// Objects copied out of the cache before yielding the event loop
+constexpr size_t kCachedFetchBatch = 64;
+
+// The object after loc in a cached range, given loc's status
+moxygen::AbsoluteLocation nextCachedLocation(
+    moxygen::AbsoluteLocation loc,
+    moxygen::ObjectStatus status) {
+  if (status == moxygen::ObjectStatus::END_OF_GROUP ||
+      status == moxygen::ObjectStatus::GROUP_NOT_EXIST) {
+    return {loc.group + 1, 0};
+  }
+  return {loc.group, loc.object + 1};
 }
+} // namespace
 
 namespace moxygen {
 
 std::shared_ptr<MoQRelay::AnnounceNode> MoQRelay::findNamespaceNode(
     const TrackNamespace& ns,
     bool createMissingNodes,
-    std::vector<std::shared_ptr<MoQSession>>* sessions) {
+    std::vector<std::shared_ptr<MoQSession>>* sessions,
+    std::shared_ptr<MoQNamespaceQuota>* quota) {
   std::shared_ptr<AnnounceNode> nodePtr(
       std::shared_ptr<void>(), &announceRoot_);
   for (auto i = 0ul; i < ns.size(); i++) {
@@ -23,6 +42,9 @@ std::shared_ptr<MoQRelay::AnnounceNode> MoQRelay::findNamespaceNode(
       sessions->insert(
           sessions->end(), nodePtr->sessions.begin(), nodePtr->sessions.end());
     }
+    if (quota && nodePtr->quota) {
+      *quota = nodePtr->quota;
+    }
     auto& name = ns[i];
     auto it = nodePtr->children.find(name);
     if (it == nodePtr->children.end()) {
@@ -38,9 +60,38 @@ std::shared_ptr<MoQRelay::AnnounceNode> MoQRelay::findNamespaceNode(
       nodePtr = it->second;
     }
   }
+  if (quota && nodePtr->quota) {
+    *quota = nodePtr->quota;
+  }
   return nodePtr;
 }
 
+void MoQRelay::setNamespaceQuota(
+    const TrackNamespace& prefix,
+    MoQNamespaceQuota::Limits limits) {
+  auto nodePtr = findNamespaceNode(prefix, /*createMissingNodes=*/true);
+  if (nodePtr->quota) {
+    // Replaced, tracks already subscribed keep the old quota
+    auto it = std::find(
+        namespaceQuotas_.begin(), namespaceQuotas_.end(), nodePtr->quota);
+    if (it != namespaceQuotas_.end()) {
+      namespaceQuotas_.erase(it);
+    }
+  }
+  nodePtr->quota =
+      std::make_shared<MoQNamespaceQuota>(prefix, std::move(limits));
+  namespaceQuotas_.push_back(nodePtr->quota);
+}
+
+std::shared_ptr<MoQNamespaceQuota> MoQRelay::findNamespaceQuota(
+    const TrackNamespace& ns) {
+  std::shared_ptr<MoQNamespaceQuota> quota;
+  if (!namespaceQuotas_.empty()) {
+    findNamespaceNode(ns, /*createMissingNodes=*/false, nullptr, &quota);
+  }
+  return quota;
+}
+
 folly::coro::Task<Subscriber::AnnounceResult> MoQRelay::announce(
     Announce ann,
     std::shared_ptr<Subscriber::AnnounceCallback>) {
@@ -50,6 +101,16 @@ folly::coro::Task<Subscriber::AnnounceResult> MoQRelay::announce(
     co_return folly::makeUnexpected(AnnounceError{
         ann.trackNamespace, AnnounceErrorCode::UNINTERESTED, "bad namespace"});
   }
+  if (authorizer_) {
+    auto authRes = co_await authorizer_->authorize(
+        ann.params, ann.trackNamespace, AuthAction::ANNOUNCE);
+    if (authRes.hasError()) {
+      co_return folly::makeUnexpected(AnnounceError{
+          ann.trackNamespace,
+          AnnounceErrorCode::UNAUTHORIZED,
+          std::move(authRes.error())});
+    }
+  }
   std::vector<std::shared_ptr<MoQSession>> sessions;
   auto nodePtr = findNamespaceNode(
       ann.trackNamespace, /*createMissingNodes=*/true, &sessions);
@@ -131,6 +192,18 @@ MoQRelay::subscribeAnnounces(SubscribeAnnounces subNs) {
         SubscribeAnnouncesErrorCode::NAMESPACE_PREFIX_UNKNOWN,
         "empty"});
   }
+  if (authorizer_) {
+    auto authRes = co_await authorizer_->authorize(
+        subNs.params,
+        subNs.trackNamespacePrefix,
+        AuthAction::SUBSCRIBE_ANNOUNCES);
+    if (authRes.hasError()) {
+      co_return folly::makeUnexpected(SubscribeAnnouncesError{
+          subNs.trackNamespacePrefix,
+          SubscribeAnnouncesErrorCode::UNAUTHORIZED,
+          std::move(authRes.error())});
+    }
+  }
   auto session = MoQSession::getRequestSession();
   auto nodePtr = findNamespaceNode(
       subNs.trackNamespacePrefix, /*createMissingNodes=*/true);
@@ -189,10 +262,61 @@ std::shared_ptr<MoQSession> MoQRelay::findAnnounceSession(
   return nodePtr->sourceSession;
 }
 
+void MoQRelay::addAbrTrack(
+    FullTrackName abrTrack,
+    std::vector<MoQAbrForwarder::Rendition> renditions,
+    MoQAbrForwarder::Config config) {
+  XCHECK(!renditions.empty()) << "ABR track needs renditions";
+  abrTracks_[std::move(abrTrack)] = AbrTrack{std::move(renditions), config};
+}
+
 folly::coro::Task<Publisher::SubscribeResult> MoQRelay::subscribe(
     SubscribeRequest subReq,
     std::shared_ptr<TrackConsumer> consumer) {
   auto session = MoQSession::getRequestSession();
+  if (authorizer_) {
+    auto authRes = co_await authorizer_->authorize(
+        subReq.params,
+        subReq.fullTrackName.trackNamespace,
+        AuthAction::SUBSCRIBE);
+    if (authRes.hasError()) {
+      co_return folly::makeUnexpected(SubscribeError{
+          subReq.subscribeID,
+          SubscribeErrorCode::UNAUTHORIZED,
+          std::move(authRes.error())});
+    }
+  }
+  if (heavyHitters_) {
+    heavyHitters_->record(
+        HeavyHitterMetric::SUBSCRIBES, subReq.fullTrackName, 1);
+  }
+  auto quota = findNamespaceQuota(subReq.fullTrackName.trackNamespace);
+  if (quota && !quota->admitSubscriber()) {
+    co_return folly::makeUnexpected(SubscribeError{
+        subReq.subscribeID,
+        SubscribeErrorCode::TIMEOUT,
+        "namespace over quota, retry later"});
+  }
+  auto abrIt = abrTracks_.find(subReq.fullTrackName);
+  if (abrIt != abrTracks_.end()) {
+    co_return co_await subscribeAbr(
+        std::move(subReq),
+        std::move(consumer),
+        std::move(session),
+        abrIt->second);
+  }
+  co_return co_await subscribeImpl(
+      std::move(subReq),
+      std::move(consumer),
+      std::move(session),
+      std::move(quota));
+}
+
+folly::coro::Task<Publisher::SubscribeResult> MoQRelay::subscribeImpl(
+    SubscribeRequest subReq,
+    std::shared_ptr<TrackConsumer> consumer,
+    std::shared_ptr<MoQSession> session,
+    std::shared_ptr<MoQNamespaceQuota> quota) {
   auto subscriptionIt = subscriptions_.find(subReq.fullTrackName);
   if (subscriptionIt == subscriptions_.end()) {
     // first subscriber
@@ -222,6 +346,19 @@ folly::coro::Task<Publisher::SubscribeResult> MoQRelay::subscribe(
            SubscribeErrorCode::INTERNAL_ERROR,
            "self subscribe"}));
     }
+    folly::Optional<MoQNamespaceQuota::UpstreamTicket> quotaTicket;
+    if (quota) {
+      quotaTicket = quota->acquireUpstream();
+      if (!quotaTicket) {
+        co_return folly::makeUnexpected(SubscribeError(
+            {subReq.subscribeID,
+             SubscribeErrorCode::TIMEOUT,
+             "namespace upstream subscriptions over quota, retry later"}));
+      }
+    }
+    if (session) {
+      session->markRequestForwarded(subReq.subscribeID);
+    }
     subReq.priority = kDefaultUpstreamPriority;
     subReq.groupOrder = GroupOrder::Default;
     // We only subscribe upstream with LatestObject. This is to satisfy other
@@ -230,10 +367,16 @@ folly::coro::Task<Publisher::SubscribeResult> MoQRelay::subscribe(
     auto forwarder =
         std::make_shared<MoQForwarder>(subReq.fullTrackName, folly::none);
     forwarder->setCallback(shared_from_this());
-    subscriptions_.emplace(
+    forwarder->setLiveGroupBuffer(liveFetchBufferBytes_);
+    forwarder->setHeavyHitters(heavyHitters_);
+    forwarder->setQuota(quota);
+    auto emplaceRes = subscriptions_.emplace(
         std::piecewise_construct,
         std::forward_as_tuple(subReq.fullTrackName),
         std::forward_as_tuple(forwarder, upstreamSession));
+    if (quotaTicket) {
+      emplaceRes.first->second.quotaTicket = std::move(*quotaTicket);
+    }
     // The iterator returned from emplace does not survive across coroutine
     // resumption, so both the guard and updating the RelaySubscription below
     // require another lookup in the subscriptions_ map.
@@ -244,10 +387,29 @@ folly::coro::Task<Publisher::SubscribeResult> MoQRelay::subscribe(
         subscriptions_.erase(it);
       }
     });
+    emplaceRes.first->second.request = subReq;
+    emplaceRes.first->second.quota = quota;
     // Add subscriber first in case objects come before subscribe OK.
     auto subscriber = forwarder->addSubscriber(
         std::move(session), subReq, std::move(consumer));
-    auto subRes = co_await upstreamSession->subscribe(subReq, forwarder);
+    std::shared_ptr<TrackConsumer> upstreamConsumer = forwarder;
+    if (objectCache_) {
+      if (!objectCache_->acquireLease(
+              subReq.fullTrackName, MoQCacheWriter::kLeaseTTL)) {
+        // Another process on this host subscribes upstream and writes the
+        // track to the cache, follow it there
+        g.dismiss();
+        followCache(subReq, forwarder, subscriber, upstreamSession);
+        co_return subscriber;
+      }
+      // This process writes the track to the shared cache
+      auto cacheWriter = std::make_shared<MoQCacheWriter>(
+          subReq.fullTrackName, objectCache_, forwarder);
+      cacheWriter->setQuota(quota);
+      upstreamConsumer = std::move(cacheWriter);
+    }
+    auto subRes =
+        co_await upstreamSession->subscribe(subReq, upstreamConsumer);
     if (subRes.hasError()) {
       co_return folly::makeUnexpected(SubscribeError(
           {subReq.subscribeID,
@@ -291,6 +453,180 @@ folly::coro::Task<Publisher::SubscribeResult> MoQRelay::subscribe(
   }
 }
 
+void MoQRelay::followCache(
+    const SubscribeRequest& subReq,
+    const std::shared_ptr<MoQForwarder>& forwarder,
+    const std::shared_ptr<MoQForwarder::Subscriber>& subscriber,
+    const std::shared_ptr<MoQSession>& upstreamSession) {
+  auto latest = MoQCacheFollower::latest(*objectCache_, subReq.fullTrackName);
+  if (latest) {
+    forwarder->updateLatest(latest->group, latest->object);
+    subscriber->updateLatest(*latest);
+  }
+  // The cache is read in group order
+  forwarder->setGroupOrder(GroupOrder::OldestFirst);
+  subscriber->setPublisherGroupOrder(GroupOrder::OldestFirst);
+  auto follower = std::make_shared<MoQCacheFollower>(
+      SubscribeOk{
+          subReq.subscribeID,
+          std::chrono::milliseconds(0),
+          GroupOrder::OldestFirst,
+          latest,
+          {}},
+      subReq.fullTrackName,
+      objectCache_,
+      forwarder,
+      kDefaultUpstreamPriority);
+  auto it = subscriptions_.find(subReq.fullTrackName);
+  XCHECK(it != subscriptions_.end());
+  it->second.handle = follower;
+  it->second.promise.setValue(folly::unit);
+  XLOG(DBG1) << "Following " << subReq.fullTrackName << " in the cache";
+  follower->start(
+      upstreamSession->getEventBase(),
+      [weakSelf = std::weak_ptr<MoQRelay>(shared_from_this()),
+       ftn = subReq.fullTrackName,
+       evb = upstreamSession->getEventBase()] {
+        if (auto self = weakSelf.lock()) {
+          self->takeOverUpstream(ftn).scheduleOn(evb).start();
+        }
+      });
+}
+
+folly::coro::Task<void> MoQRelay::takeOverUpstream(FullTrackName ftn) {
+  auto it = subscriptions_.find(ftn);
+  if (it == subscriptions_.end()) {
+    objectCache_->releaseLease(ftn);
+    co_return;
+  }
+  auto forwarder = it->second.forwarder;
+  auto upstreamSession = it->second.upstream;
+  auto cacheWriter =
+      std::make_shared<MoQCacheWriter>(ftn, objectCache_, forwarder);
+  cacheWriter->setQuota(it->second.quota);
+  auto subRes =
+      co_await upstreamSession->subscribe(it->second.request, cacheWriter);
+  it = subscriptions_.find(ftn);
+  if (it == subscriptions_.end() || it->second.forwarder != forwarder) {
+    // The last subscriber left while subscribing
+    if (subRes.hasValue()) {
+      subRes.value()->unsubscribe();
+    }
+    co_return;
+  }
+  if (subRes.hasError()) {
+    XLOG(ERR) << "Upstream subscribe for " << ftn
+              << " failed taking over from the cache: "
+              << subRes.error().reasonPhrase;
+    forwarder->subscribeDone(
+        {SubscribeID(0),
+         SubscribeDoneStatusCode::INTERNAL_ERROR,
+         0, // filled in by session
+         "upstream subscribe failed",
+         forwarder->latest()});
+    co_return;
+  }
+  it->second.subscribeID = subRes.value()->subscribeOk().subscribeID;
+  it->second.handle = std::move(subRes.value());
+}
+
+folly::coro::Task<Publisher::SubscribeResult> MoQRelay::subscribeAbr(
+    SubscribeRequest subReq,
+    std::shared_ptr<TrackConsumer> consumer,
+    std::shared_ptr<MoQSession> session,
+    const AbrTrack& abrTrack) {
+  auto abrSubIt = abrSubscriptions_.find(subReq.fullTrackName);
+  if (abrSubIt == abrSubscriptions_.end()) {
+    // first subscriber, subscribe to every rendition through the relay
+    auto forwarder = std::make_shared<MoQAbrForwarder>(
+        subReq.fullTrackName, abrTrack.renditions, abrTrack.config);
+    forwarder->setCallback(shared_from_this());
+    abrSubscriptions_.emplace(subReq.fullTrackName, forwarder);
+    // Served once the renditions resolve upstream
+    session->markRequestForwarded(subReq.subscribeID);
+    auto g = folly::makeGuard([this, trackName = subReq.fullTrackName] {
+      auto it = abrSubscriptions_.find(trackName);
+      if (it != abrSubscriptions_.end()) {
+        it->second.promise.setException(std::runtime_error("failed"));
+        abrSubscriptions_.erase(it);
+      }
+    });
+    std::vector<folly::coro::Task<SubscribeResult>> renditionSubs;
+    for (size_t i = 0; i < forwarder->renditions().size(); i++) {
+      auto renditionReq = subReq;
+      renditionReq.fullTrackName = forwarder->renditions()[i].fullTrackName;
+      renditionReq.locType = LocationType::LatestGroup;
+      renditionReq.params.clear();
+      // The relay itself is the downstream session of a rendition
+      auto quota =
+          findNamespaceQuota(renditionReq.fullTrackName.trackNamespace);
+      renditionSubs.push_back(subscribeImpl(
+          std::move(renditionReq),
+          forwarder->renditionConsumer(i),
+          nullptr,
+          std::move(quota)));
+    }
+    auto results =
+        co_await folly::coro::collectAllRange(std::move(renditionSubs));
+    std::vector<std::shared_ptr<Publisher::SubscriptionHandle>> handles;
+    folly::Optional<SubscribeError> error;
+    for (auto& res : results) {
+      if (res.hasError()) {
+        error = std::move(res.error());
+      } else {
+        handles.push_back(std::move(res.value()));
+      }
+    }
+    if (error) {
+      for (auto& handle : handles) {
+        handle->unsubscribe();
+      }
+      co_return folly::makeUnexpected(SubscribeError(
+          {subReq.subscribeID,
+           error->errorCode,
+           folly::to<std::string>(
+               "rendition subscribe failed: ", error->reasonPhrase)}));
+    }
+    g.dismiss();
+    auto it = abrSubscriptions_.find(subReq.fullTrackName);
+    XCHECK(it != abrSubscriptions_.end());
+    it->second.renditions = std::move(handles);
+    it->second.promise.setValue(folly::unit);
+  } else if (!abrSubIt->second.promise.isFulfilled()) {
+    co_await abrSubIt->second.promise.getFuture();
+  }
+  auto it = abrSubscriptions_.find(subReq.fullTrackName);
+  XCHECK(it != abrSubscriptions_.end());
+  auto& abrSub = it->second;
+  folly::Optional<AbsoluteLocation> latest;
+  for (auto& handle : abrSub.renditions) {
+    auto& renditionLatest = handle->subscribeOk().latest;
+    if (renditionLatest && (!latest || *latest < *renditionLatest)) {
+      latest = renditionLatest;
+    }
+  }
+  co_return abrSub.forwarder->addSubscriber(
+      std::move(session),
+      subReq,
+      std::move(consumer),
+      abrSub.renditions.front()->subscribeOk().groupOrder,
+      latest);
+}
+
+void MoQRelay::onEmpty(MoQAbrForwarder* forwarder) {
+  auto it = abrSubscriptions_.find(forwarder->fullTrackName());
+  if (it == abrSubscriptions_.end() ||
+      it->second.forwarder.get() != forwarder) {
+    return;
+  }
+  XLOG(INFO) << "Removed last ABR subscriber for " << it->first;
+  auto renditions = std::move(it->second.renditions);
+  abrSubscriptions_.erase(it);
+  for (auto& handle : renditions) {
+    handle->unsubscribe();
+  }
+}
+
 folly::coro::Task<Publisher::FetchResult> MoQRelay::fetch(
     Fetch fetch,
     std::shared_ptr<FetchConsumer> consumer) {
@@ -304,6 +640,23 @@ folly::coro::Task<Publisher::FetchResult> MoQRelay::fetch(
          FetchErrorCode::TRACK_NOT_EXIST,
          "namespace required"}));
   }
+  if (authorizer_) {
+    auto authRes = co_await authorizer_->authorize(
+        fetch.params, fetch.fullTrackName.trackNamespace, AuthAction::FETCH);
+    if (authRes.hasError()) {
+      co_return folly::makeUnexpected(FetchError{
+          fetch.subscribeID,
+          FetchErrorCode::UNAUTHORIZED,
+          std::move(authRes.error())});
+    }
+  }
+  auto quota = findNamespaceQuota(fetch.fullTrackName.trackNamespace);
+  if (quota && !quota->admitFetch()) {
+    co_return folly::makeUnexpected(FetchError{
+        fetch.subscribeID,
+        FetchErrorCode::TIMEOUT,
+        "namespace over quota, retry later"});
+  }
 
   auto [standalone, joining] = fetchType(fetch);
   if (joining) {
@@ -328,6 +681,45 @@ folly::coro::Task<Publisher::FetchResult> MoQRelay::fetch(
     }
   }
 
+  auto liveSubscriptionIt = subscriptions_.find(fetch.fullTrackName);
+  auto range = std::get_if<StandaloneFetch>(&fetch.args);
+  if (range && liveSubscriptionIt != subscriptions_.end() &&
+      liveSubscriptionIt->second.promise.isFulfilled()) {
+    auto forwarder = liveSubscriptionIt->second.forwarder;
+    // Starts in the group being received, serve it and follow the live edge
+    auto fetchHandle = forwarder->fetchLive(
+        fetch.subscribeID,
+        fetch.groupOrder,
+        range->start,
+        range->end,
+        consumer);
+    if (fetchHandle) {
+      co_return fetchHandle;
+    }
+    // Starts earlier but reaches into the buffered group
+    auto bufferStart = forwarder->liveBufferStart();
+    if (bufferStart && range->start < *bufferStart &&
+        (range->end.group > bufferStart->group ||
+         (range->end.group == bufferStart->group &&
+          (range->end.object == 0 ||
+           range->end.object > bufferStart->object)))) {
+      co_return co_await fetchSplitLive(
+          std::move(fetch),
+          *bufferStart,
+          std::move(forwarder),
+          std::move(consumer),
+          std::move(session));
+    }
+  }
+
+  if (objectCache_) {
+    auto fetchHandle =
+        fetchFromCache(fetch, consumer, session->getEventBase());
+    if (fetchHandle) {
+      co_return fetchHandle;
+    }
+  }
+
   auto upstreamSession =
       findAnnounceSession(fetch.fullTrackName.trackNamespace);
   if (!upstreamSession) {
@@ -341,11 +733,382 @@ folly::coro::Task<Publisher::FetchResult> MoQRelay::fetch(
     co_return folly::makeUnexpected(FetchError(
         {fetch.subscribeID, FetchErrorCode::INTERNAL_ERROR, "self fetch"}));
   }
+  session->markRequestForwarded(fetch.subscribeID);
   fetch.priority = kDefaultUpstreamPriority;
   co_return co_await upstreamSession->fetch(fetch, std::move(consumer));
 }
 
+namespace {
+// Passes the head of a split FETCH to the downstream consumer, then hands
+// the stream over to the live tail
+class SplitFetchConsumer : public FetchConsumer {
+ public:
+  SplitFetchConsumer(
+      std::shared_ptr<FetchConsumer> consumer,
+      std::shared_ptr<MoQForwarder::LiveFetch> tail)
+      : consumer_(std::move(consumer)), tail_(std::move(tail)) {}
+
+  folly::Expected<folly::Unit, MoQPublishError> object(
+      uint64_t groupID,
+      uint64_t subgroupID,
+      uint64_t objectID,
+      Payload payload,
+      Extensions extensions,
+      bool finFetch) override {
+    return maybeRelease(
+        consumer_->object(
+            groupID,
+            subgroupID,
+            objectID,
+            std::move(payload),
+            std::move(extensions)),
+        finFetch);
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> objectNotExists(
+      uint64_t groupID,
+      uint64_t subgroupID,
+      uint64_t objectID,
+      Extensions extensions,
+      bool finFetch) override {
+    return maybeRelease(
+        consumer_->objectNotExists(
+            groupID, subgroupID, objectID, std::move(extensions)),
+        finFetch);
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> groupNotExists(
+      uint64_t groupID,
+      uint64_t subgroupID,
+      Extensions extensions,
+      bool finFetch) override {
+    return maybeRelease(
+        consumer_->groupNotExists(groupID, subgroupID, std::move(extensions)),
+        finFetch);
+  }
+
+  void checkpoint() override {
+    consumer_->checkpoint();
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> beginObject(
+      uint64_t groupID,
+      uint64_t subgroupID,
+      uint64_t objectID,
+      uint64_t length,
+      Payload initialPayload,
+      Extensions extensions) override {
+    return consumer_->beginObject(
+        groupID,
+        subgroupID,
+        objectID,
+        length,
+        std::move(initialPayload),
+        std::move(extensions));
+  }
+
+  folly::Expected<ObjectPublishStatus, MoQPublishError> objectPayload(
+      Payload payload,
+      bool finFetch) override {
+    auto res = consumer_->objectPayload(std::move(payload));
+    if (res.hasValue() && finFetch) {
+      tail_->release();
+    }
+    return res;
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> endOfGroup(
+      uint64_t groupID,
+      uint64_t subgroupID,
+      uint64_t objectID,
+      Extensions extensions,
+      bool finFetch) override {
+    return maybeRelease(
+        consumer_->endOfGroup(
+            groupID, subgroupID, objectID, std::move(extensions)),
+        finFetch);
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> endOfTrackAndGroup(
+      uint64_t groupID,
+      uint64_t subgroupID,
+      uint64_t objectID,
+      Extensions extensions) override {
+    // Nothing follows the end of the track
+    tail_->fetchCancel();
+    return consumer_->endOfTrackAndGroup(
+        groupID, subgroupID, objectID, std::move(extensions));
+  }
+
+  folly::Expected<folly::Unit, MoQPublishError> endOfFetch() override {
+    tail_->release();
+    return folly::unit;
+  }
+
+  void reset(ResetStreamErrorCode error) override {
+    tail_->fetchCancel();
+    consumer_->reset(error);
+  }
+
+  folly::Expected<folly::SemiFuture<folly::Unit>, MoQPublishError>
+  awaitReadyToConsume() override {
+    return consumer_->awaitReadyToConsume();
+  }
+
+ private:
+  folly::Expected<folly::Unit, MoQPublishError> maybeRelease(
+      folly::Expected<folly::Unit, MoQPublishError> res,
+      bool finFetch) {
+    if (finFetch && (res.hasValue() ||
+                     res.error().code == MoQPublishError::BLOCKED)) {
+      tail_->release();
+    }
+    return res;
+  }
+
+  std::shared_ptr<FetchConsumer> consumer_;
+  std::shared_ptr<MoQForwarder::LiveFetch> tail_;
+};
+
+class SplitFetchHandle : public Publisher::FetchHandle {
+ public:
+  SplitFetchHandle(
+      FetchOk ok,
+      std::shared_ptr<Publisher::FetchHandle> head,
+      std::shared_ptr<MoQForwarder::LiveFetch> tail)
+      : Publisher::FetchHandle(std::move(ok)),
+        head_(std::move(head)),
+        tail_(std::move(tail)) {}
+
+  void fetchCancel() override {
+    head_->fetchCancel();
+    tail_->fetchCancel();
+  }
+
+ private:
+  std::shared_ptr<Publisher::FetchHandle> head_;
+  std::shared_ptr<MoQForwarder::LiveFetch> tail_;
+};
+
+class CachedFetchHandle : public Publisher::FetchHandle {
+ public:
+  explicit CachedFetchHandle(FetchOk ok)
+      : Publisher::FetchHandle(std::move(ok)) {}
+
+  void fetchCancel() override {
+    cancelSource.requestCancellation();
+  }
+
+  folly::CancellationSource cancelSource;
+};
+} // namespace
+
+folly::coro::Task<Publisher::FetchResult> MoQRelay::fetchSplitLive(
+    Fetch fetch,
+    AbsoluteLocation bufferStart,
+    std::shared_ptr<MoQForwarder> forwarder,
+    std::shared_ptr<FetchConsumer> consumer,
+    std::shared_ptr<MoQSession> session) {
+  auto range = std::get<StandaloneFetch>(fetch.args);
+  auto tail = forwarder->fetchLive(
+      fetch.subscribeID,
+      fetch.groupOrder,
+      bufferStart,
+      range.end,
+      consumer,
+      /*held=*/true);
+  XCHECK(tail);
+  // The head ends where the buffer starts.  The end is exclusive, and
+  // end.object == 0 means the whole end group.
+  auto headFetch = fetch;
+  headFetch.args = StandaloneFetch(
+      range.start,
+      bufferStart.object > 0
+          ? bufferStart
+          : AbsoluteLocation{bufferStart.group - 1, 0});
+  std::shared_ptr<FetchConsumer> headConsumer =
+      std::make_shared<SplitFetchConsumer>(std::move(consumer), tail);
+  std::shared_ptr<FetchHandle> headHandle;
+  if (objectCache_) {
+    headHandle =
+        fetchFromCache(headFetch, headConsumer, session->getEventBase());
+  }
+  if (!headHandle) {
+    auto upstreamSession =
+        findAnnounceSession(fetch.fullTrackName.trackNamespace);
+    if (!upstreamSession || session.get() == upstreamSession.get()) {
+      tail->fetchCancel();
+      co_return folly::makeUnexpected(FetchError(
+          {fetch.subscribeID,
+           FetchErrorCode::TRACK_NOT_EXIST,
+           "no upstream for fetch head"}));
+    }
+    session->markRequestForwarded(fetch.subscribeID);
+    headFetch.priority = kDefaultUpstreamPriority;
+    auto headRes =
+        co_await upstreamSession->fetch(headFetch, std::move(headConsumer));
+    if (headRes.hasError()) {
+      tail->fetchCancel();
+      co_return folly::makeUnexpected(headRes.error());
+    }
+    headHandle = std::move(headRes.value());
+  }
+  XLOG(DBG1) << "Split fetch for " << fetch.fullTrackName
+             << ", live from group=" << bufferStart.group
+             << " object=" << bufferStart.object;
+  co_return std::make_shared<SplitFetchHandle>(
+      tail->fetchOk(), std::move(headHandle), std::move(tail));
+}
+
+std::shared_ptr<Publisher::FetchHandle> MoQRelay::fetchFromCache(
+    const Fetch& fetch,
+    std::shared_ptr<FetchConsumer>& consumer,
+    folly::EventBase* evb) {
+  auto [standalone, joining] = fetchType(fetch);
+  if (!standalone) {
+    // A joining fetch reaches here only while upstream is still resolving
+    // the subscribe, so upstream resolves and serves it too
+    return nullptr;
+  }
+  // Only check the cache covers the range here, by reading each object's
+  // status.  The objects are copied out in batches as the consumer takes
+  // them.  The end is exclusive, and end.object == 0 means the whole end
+  // group.
+  auto end = standalone->end;
+  auto loc = standalone->start;
+  folly::Optional<AbsoluteLocation> last;
+  size_t count = 0;
+  bool endOfTrack = false;
+  while (loc.group < end.group ||
+         (loc.group == end.group && (end.object == 0 || loc < end))) {
+    if (count == kMaxCachedFetchObjects) {
+      return nullptr;
+    }
+    auto status =
+        objectCache_->status(fetch.fullTrackName, loc.group, loc.object);
+    if (!status) {
+      return nullptr;
+    }
+    count++;
+    last = loc;
+    if (*status == ObjectStatus::END_OF_TRACK ||
+        *status == ObjectStatus::END_OF_TRACK_AND_GROUP) {
+      endOfTrack = true;
+      break;
+    }
+    loc = nextCachedLocation(loc, *status);
+  }
+  if (!last) {
+    return nullptr;
+  }
+  auto latest = *last;
+  auto subscriptionIt = subscriptions_.find(fetch.fullTrackName);
+  if (subscriptionIt != subscriptions_.end()) {
+    auto forwarderLatest = subscriptionIt->second.forwarder->latest();
+    if (forwarderLatest && latest < *forwarderLatest) {
+      latest = *forwarderLatest;
+    }
+  }
+  XLOG(DBG1) << "Serving fetch from cache, objects=" << count;
+  auto fetchHandle = std::make_shared<CachedFetchHandle>(FetchOk{
+      fetch.subscribeID,
+      MoQSession::resolveGroupOrder(GroupOrder::OldestFirst, fetch.groupOrder),
+      endOfTrack,
+      latest,
+      {}});
+  folly::coro::co_withCancellation(
+      fetchHandle->cancelSource.getToken(),
+      serveCachedFetch(
+          objectCache_,
+          fetch.fullTrackName,
+          standalone->start,
+          *last,
+          std::move(consumer)))
+      .scheduleOn(evb)
+      .start();
+  return fetchHandle;
+}
+
+folly::coro::Task<void> MoQRelay::serveCachedFetch(
+    std::shared_ptr<ShmObjectCache> cache,
+    FullTrackName fullTrackName,
+    AbsoluteLocation start,
+    AbsoluteLocation last,
+    std::shared_ptr<FetchConsumer> consumer) {
+  auto token = co_await folly::coro::co_current_cancellation_token;
+  size_t batch = 0;
+  for (auto loc = start; loc <= last;) {
+    if (token.isCancellationRequested()) {
+      consumer->reset(ResetStreamErrorCode::CANCELLED);
+      co_return;
+    }
+    if (++batch == kCachedFetchBatch) {
+      batch = 0;
+      co_await folly::coro::co_reschedule_on_current_executor;
+      continue;
+    }
+    auto cached = cache->get(fullTrackName, loc.group, loc.object);
+    if (!cached) {
+      // The ring wrapped over the rest of the range after FETCH_OK
+      XLOG(ERR) << "Cached fetch object evicted " << fullTrackName
+                << " loc=" << loc.group << "," << loc.object;
+      consumer->reset(ResetStreamErrorCode::INTERNAL_ERROR);
+      co_return;
+    }
+    auto group = loc.group;
+    auto id = loc.object;
+    auto& object = *cached;
+    loc = nextCachedLocation(loc, object.status);
+    folly::Expected<folly::Unit, MoQPublishError> res{folly::unit};
+    switch (object.status) {
+      case ObjectStatus::NORMAL:
+        res = consumer->object(
+            group,
+            object.subgroup,
+            id,
+            std::move(object.payload),
+            std::move(object.extensions));
+        break;
+      case ObjectStatus::OBJECT_NOT_EXIST:
+        res = consumer->objectNotExists(
+            group, object.subgroup, id, std::move(object.extensions));
+        break;
+      case ObjectStatus::GROUP_NOT_EXIST:
+        res = consumer->groupNotExists(
+            group, object.subgroup, std::move(object.extensions));
+        break;
+      case ObjectStatus::END_OF_GROUP:
+        res = consumer->endOfGroup(
+            group, object.subgroup, id, std::move(object.extensions));
+        break;
+      case ObjectStatus::END_OF_TRACK_AND_GROUP:
+        // implies endOfFetch
+        consumer->endOfTrackAndGroup(
+            group, object.subgroup, id, std::move(object.extensions));
+        co_return;
+      case ObjectStatus::END_OF_TRACK:
+        break;
+    }
+    if (res.hasError()) {
+      if (res.error().code != MoQPublishError::BLOCKED) {
+        XLOG(ERR) << "Cached fetch error: " << res.error().what();
+        consumer->reset(ResetStreamErrorCode::INTERNAL_ERROR);
+        co_return;
+      }
+      // the object was accepted, wait before writing the next one
+      auto awaitRes = consumer->awaitReadyToConsume();
+      if (!awaitRes) {
+        consumer->reset(ResetStreamErrorCode::INTERNAL_ERROR);
+        co_return;
+      }
+      co_await std::move(awaitRes.value());
+    }
+  }
+  consumer->endOfFetch();
+}
+
 void MoQRelay::onEmpty(MoQForwarder* forwarder) {
+  MOQ_LOOP_SCOPE(RELAY);
   // TODO: we shouldn't need a linear search if forwarder stores FullTrackName
   for (auto subscriptionIt = subscriptions_.begin();
        subscriptionIt != subscriptions_.end();
@@ -355,6 +1118,7 @@ void MoQRelay::onEmpty(MoQForwarder* forwarder) {
       continue;
     }
     XLOG(INFO) << "Removed last subscriber for " << subscriptionIt->first;
+    subscription.forwarder->endLiveFetches(/*trackEnded=*/false);
     subscription.handle->unsubscribe();
     subscriptionIt = subscriptions_.erase(subscriptionIt);
     return;
@@ -362,6 +1126,7 @@ void MoQRelay::onEmpty(MoQForwarder* forwarder) {
 }
 
 void MoQRelay::removeSession(const std::shared_ptr<MoQSession>& session) {
+  MOQ_LOOP_SCOPE(RELAY);
   // TODO: remove linear search by having each session track it's active
   // announcements, subscribes and subscribe namespaces
   std::vector<std::shared_ptr<MoQSession>> notifySessions;
@@ -419,6 +1184,15 @@ void MoQRelay::removeSession(const std::shared_ptr<MoQSession>& session) {
       subscription.forwarder->removeSession(session);
     }
   }
+
+  std::vector<std::shared_ptr<MoQAbrForwarder>> abrForwarders;
+  for (auto& abrSub : abrSubscriptions_) {
+    abrForwarders.push_back(abrSub.second.forwarder);
+  }
+  // may erase from abrSubscriptions_
+  for (auto& abrForwarder : abrForwarders) {
+    abrForwarder->removeSession(session);
+  }
 }
 
 } // namespace moxygen
@@ -8,7 +8,13 @@
 
 #include <folly/coro/SharedPromise.h>
 #include "moxygen/MoQSession.h"
+#include "moxygen/relay/MoQAbrForwarder.h"
+#include "moxygen/relay/MoQCacheFollower.h"
+#include "moxygen/relay/MoQCacheWriter.h"
 #include "moxygen/relay/MoQForwarder.h"
+#include "moxygen/relay/MoQNamespaceQuota.h"
+#include "moxygen/util/HeavyHitters.h"
+#include "moxygen/util/MoQAuthorizer.h"
 
 #include <folly/container/F14Set.h>
 
@@ -17,12 +23,69 @@ namespace moxygen {
 class MoQRelay : public Publisher,
                  public Subscriber,
                  public std::enable_shared_from_this<MoQRelay>,
-                 public MoQForwarder::Callback {
+                 public MoQForwarder::Callback,
+                 public MoQAbrForwarder::Callback {
  public:
   void setAllowedNamespacePrefix(TrackNamespace allowed) {
     allowedNamespacePrefix_ = std::move(allowed);
   }
 
+  // Require an AUTHORIZATION token that allows each SUBSCRIBE, FETCH,
+  // ANNOUNCE and SUBSCRIBE_ANNOUNCES
+  void setAuthorizer(std::shared_ptr<MoQAuthorizer> authorizer) {
+    authorizer_ = std::move(authorizer);
+  }
+
+  // Serve abrTrack as a virtual track.  Each subscriber receives the
+  // rendition that fits its throughput, switching at group boundaries, while
+  // the relay holds one upstream subscription per rendition.  A rendition
+  // track can belong to only one ABR track.
+  void addAbrTrack(
+      FullTrackName abrTrack,
+      std::vector<MoQAbrForwarder::Rendition> renditions,
+      MoQAbrForwarder::Config config = MoQAbrForwarder::Config());
+
+  // Share recently forwarded objects with the other relay processes on this
+  // host.  Only the process holding a track's lease subscribes upstream and
+  // writes it to the cache; the others feed their subscribers from the
+  // cache, and take over upstream when the lease expires.  Any process
+  // serves FETCHes the cache fully covers.
+  void setObjectCache(std::shared_ptr<ShmObjectCache> cache) {
+    objectCache_ = std::move(cache);
+  }
+
+  // Buffer up to maxBytes of each track's latest group, so that FETCHes
+  // reaching into it are served locally and follow the live edge.  Applies
+  // to tracks first subscribed after it is set.  0, the default, disables
+  // it.
+  void setLiveFetchBufferBytes(uint64_t maxBytes) {
+    liveFetchBufferBytes_ = maxBytes;
+  }
+
+  // Track the tracks with the most subscribes and forwarded bytes.  Applies
+  // to tracks first subscribed after it is set.
+  void setHeavyHitters(std::shared_ptr<HeavyHitters> heavyHitters) {
+    heavyHitters_ = std::move(heavyHitters);
+  }
+
+  const std::shared_ptr<HeavyHitters>& heavyHitters() const {
+    return heavyHitters_;
+  }
+
+  // Limit the resources used by the tracks under prefix.  A track is bound
+  // by the quota of its longest quota'd prefix, looked up in the announce
+  // tree.  Requests over quota fail with TIMEOUT so clients retry later.
+  // Applies to tracks first subscribed after it is set.
+  void setNamespaceQuota(
+      const TrackNamespace& prefix,
+      MoQNamespaceQuota::Limits limits);
+
+  // Every quota, for exporting usage
+  const std::vector<std::shared_ptr<MoQNamespaceQuota>>& namespaceQuotas()
+      const {
+    return namespaceQuotas_;
+  }
+
   folly::coro::Task<SubscribeResult> subscribe(
       SubscribeRequest subReq,
       std::shared_ptr<TrackConsumer> consumer) override;
@@ -69,14 +132,19 @@ class MoQRelay : public Publisher,
             announcements;
     // The session that ANNOUNCEd this node
     std::shared_ptr<MoQSession> sourceSession;
+    // Limits for everything under this node
+    std::shared_ptr<MoQNamespaceQuota> quota;
     MoQRelay& relay_;
   };
   AnnounceNode announceRoot_{*this};
   std::shared_ptr<AnnounceNode> findNamespaceNode(
       const TrackNamespace& ns,
       bool createMissingNodes,
-      std::vector<std::shared_ptr<MoQSession>>* sessions = nullptr);
+      std::vector<std::shared_ptr<MoQSession>>* sessions = nullptr,
+      std::shared_ptr<MoQNamespaceQuota>* quota = nullptr);
   std::shared_ptr<MoQSession> findAnnounceSession(const TrackNamespace& ns);
+  std::shared_ptr<MoQNamespaceQuota> findNamespaceQuota(
+      const TrackNamespace& ns);
 
   struct RelaySubscription {
     RelaySubscription(
@@ -86,13 +154,83 @@ class MoQRelay : public Publisher,
 
     std::shared_ptr<MoQForwarder> forwarder;
     std::shared_ptr<MoQSession> upstream;
+    // As sent upstream, or to send when taking over from the cache
+    SubscribeRequest request;
+    std::shared_ptr<MoQNamespaceQuota> quota;
     SubscribeID subscribeID{0};
+    // Upstream's, or the MoQCacheFollower's
     std::shared_ptr<Publisher::SubscriptionHandle> handle;
     folly::coro::SharedPromise<folly::Unit> promise;
+    MoQNamespaceQuota::UpstreamTicket quotaTicket;
   };
 
   void onEmpty(MoQForwarder* forwarder) override;
 
+  // quota is the track namespace's, found by the caller
+  folly::coro::Task<SubscribeResult> subscribeImpl(
+      SubscribeRequest subReq,
+      std::shared_ptr<TrackConsumer> consumer,
+      std::shared_ptr<MoQSession> session,
+      std::shared_ptr<MoQNamespaceQuota> quota);
+
+  // Serves a new subscription from the cache another process writes
+  void followCache(
+      const SubscribeRequest& subReq,
+      const std::shared_ptr<MoQForwarder>& forwarder,
+      const std::shared_ptr<MoQForwarder::Subscriber>& subscriber,
+      const std::shared_ptr<MoQSession>& upstreamSession);
+
+  // Subscribes upstream for a track followed in the cache, once this process
+  // took its lease
+  folly::coro::Task<void> takeOverUpstream(FullTrackName ftn);
+
+  struct AbrTrack {
+    std::vector<MoQAbrForwarder::Rendition> renditions;
+    MoQAbrForwarder::Config config;
+  };
+
+  struct AbrSubscription {
+    explicit AbrSubscription(std::shared_ptr<MoQAbrForwarder> f)
+        : forwarder(std::move(f)) {}
+
+    std::shared_ptr<MoQAbrForwarder> forwarder;
+    // Relay subscriptions to each rendition, in rendition order
+    std::vector<std::shared_ptr<Publisher::SubscriptionHandle>> renditions;
+    folly::coro::SharedPromise<folly::Unit> promise;
+  };
+
+  folly::coro::Task<SubscribeResult> subscribeAbr(
+      SubscribeRequest subReq,
+      std::shared_ptr<TrackConsumer> consumer,
+      std::shared_ptr<MoQSession> session,
+      const AbrTrack& abrTrack);
+
+  void onEmpty(MoQAbrForwarder* forwarder) override;
+
+  // Serves a FETCH that starts before the forwarder's buffered live group
+  // and reaches into it: the part before the buffer comes from the cache or
+  // upstream, then the rest from the live group
+  folly::coro::Task<FetchResult> fetchSplitLive(
+      Fetch fetch,
+      AbsoluteLocation bufferStart,
+      std::shared_ptr<MoQForwarder> forwarder,
+      std::shared_ptr<FetchConsumer> consumer,
+      std::shared_ptr<MoQSession> session);
+
+  // Returns nullptr unless the cache holds every object in the range
+  std::shared_ptr<FetchHandle> fetchFromCache(
+      const Fetch& fetch,
+      std::shared_ptr<FetchConsumer>& consumer,
+      folly::EventBase* evb);
+
+  // Copies [start, last] out of the cache as the consumer accepts it
+  static folly::coro::Task<void> serveCachedFetch(
+      std::shared_ptr<ShmObjectCache> cache,
+      FullTrackName fullTrackName,
+      AbsoluteLocation start,
+      AbsoluteLocation last,
+      std::shared_ptr<FetchConsumer> consumer);
+
   folly::coro::Task<void> announceToSession(
       std::shared_ptr<MoQSession> session,
       Announce ann,
@@ -101,8 +239,16 @@ class MoQRelay : public Publisher,
   void unannounce(const TrackNamespace& trackNamespace, AnnounceNode* node);
 
   TrackNamespace allowedNamespacePrefix_;
+  std::shared_ptr<MoQAuthorizer> authorizer_;
+  std::shared_ptr<ShmObjectCache> objectCache_;
+  uint64_t liveFetchBufferBytes_{0};
+  std::shared_ptr<HeavyHitters> heavyHitters_;
+  std::vector<std::shared_ptr<MoQNamespaceQuota>> namespaceQuotas_;
   folly::F14FastMap<FullTrackName, RelaySubscription, FullTrackName::hash>
       subscriptions_;
+  folly::F14FastMap<FullTrackName, AbrTrack, FullTrackName::hash> abrTracks_;
+  folly::F14FastMap<FullTrackName, AbrSubscription, FullTrackName::hash>
+      abrSubscriptions_;
 };
 
 } // namespace moxygen
@@ -6,8 +6,13 @@
 
 #include "moxygen/MoQServer.h"
 #include "moxygen/relay/MoQRelay.h"
+#include "moxygen/util/RequestLatencyStats.h"
 
+#include <folly/executors/GlobalExecutor.h>
 #include <folly/init/Init.h>
+#include <quic/QuicConstants.h>
+
+#include <atomic>
 
 using namespace proxygen;
 
@@ -15,26 +20,389 @@ DEFINE_string(cert, "", "Cert path");
 DEFINE_string(key, "", "Key path");
 DEFINE_string(endpoint, "/moq-relay", "End point");
 DEFINE_int32(port, 9668, "Relay Server Port");
+DEFINE_string(
+    capture_dir,
+    "",
+    "If set, write a capture of every session's ingress to this directory");
+DEFINE_string(
+    abr_track,
+    "",
+    "Serve a virtual ABR track from renditions in the same namespace, as "
+    "ns/abr=rendition@bps,rendition@bps");
+DEFINE_int32(
+    loop_stats_interval_ms,
+    0,
+    "If set, log worker event loop lag at this interval");
+DEFINE_string(
+    shm_cache_name,
+    "",
+    "If set, share an object cache with other relays on this host through "
+    "the named shared memory segment, e.g. /moxygen-cache");
+DEFINE_uint64(
+    live_fetch_buffer_kb,
+    0,
+    "If set, buffer up to this much of each track's latest group so FETCHes "
+    "reaching into it are served by the relay and follow the live edge");
+DEFINE_uint64(shm_cache_mb, 256, "Object data size of the shared cache");
+DEFINE_uint64(shm_cache_index_slots, 1 << 16, "Index size of the shared cache");
+DEFINE_string(
+    auth_hmac_key,
+    "",
+    "If set, require HMAC-SHA256 signed AUTHORIZATION tokens with this key");
+DEFINE_uint64(auth_cache_size, 4096, "Verified tokens cached per worker");
+DEFINE_bool(worker_arenas, false, "Give each worker its own jemalloc arena");
+DEFINE_int32(
+    mem_stats_interval_ms,
+    0,
+    "If set, account heap use by subsystem and log it at this interval");
+DEFINE_int32(
+    request_stats_interval_ms,
+    0,
+    "If set, log SUBSCRIBE and FETCH latency histograms at this interval");
+DEFINE_int32(
+    heavy_hitters_interval_ms,
+    0,
+    "If set, log the tracks with the most subscribes and egress bytes at this "
+    "interval, halving the counts after each report");
+DEFINE_uint64(heavy_hitters_top_k, 16, "Tracks reported per metric");
+DEFINE_string(
+    namespace_quotas,
+    "",
+    "Per namespace prefix limits, as prefix=limit:value,... separated by ';'. "
+    "Limits are upstream (subscriptions), subscribers, egress (bytes/s) and "
+    "cache (bytes/s), e.g. live/tenant1=subscribers:1000,egress:125000000");
+DEFINE_int32(
+    quota_stats_interval_ms,
+    0,
+    "If set, log the usage of each namespace quota at this interval");
+DEFINE_string(
+    transport_profile,
+    "default",
+    "QUIC tuning for accepted connections: default, live (edge viewers), "
+    "fetch (bulk fetch) or trunk (relay to relay)");
+DEFINE_string(
+    congestion_control,
+    "",
+    "Overrides the profile's congestion controller, e.g. cubic or bbr");
+DEFINE_uint64(init_cwnd_mss, 0, "Overrides the profile's initial cwnd");
+DEFINE_uint64(
+    conn_flow_control_window,
+    0,
+    "Overrides the profile's connection flow control window (bytes)");
+DEFINE_uint64(
+    stream_flow_control_window,
+    0,
+    "Overrides the profile's stream flow control window (bytes)");
+DEFINE_uint64(max_uni_streams, 0, "Overrides the profile's max uni streams");
+DEFINE_uint32(
+    datagram_buf_size,
+    0,
+    "Overrides the profile's datagram read and write buffer size");
+DEFINE_bool(pacing, false, "Overrides the profile's pacing when set");
 
 namespace {
 using namespace moxygen;
 
+class LoopStatsLogger : public MoQLoopStatsCallback {
+ public:
+  void onLoopStats(const LoopStats& stats) override {
+    auto avg = [](std::chrono::microseconds total, uint64_t n) {
+      return n ? total.count() / n : 0;
+    };
+    XLOG(INFO) << "evb=" << stats.evb << " loops=" << stats.loops
+               << " slow=" << stats.slowLoops
+               << " avgBusyUs=" << avg(stats.totalBusy, stats.loops)
+               << " maxBusyUs=" << stats.maxLoopBusy.count() << " ("
+               << getLoopSubsystemString(stats.maxLoopSubsystem) << ")"
+               << " avgLagUs="
+               << avg(stats.totalSchedulingDelay, stats.lagSamples)
+               << " maxLagUs=" << stats.maxSchedulingDelay.count();
+    for (size_t i = 0; i < kNumLoopSubsystems; i++) {
+      XLOG(DBG1) << "  " << getLoopSubsystemString(LoopSubsystem(i))
+                 << " busyUs=" << stats.subsystemBusy[i].count();
+    }
+  }
+};
+
+void logMemStats() {
+  auto stats = MemoryAccounting::snapshot();
+  for (size_t i = 0; i < kNumMemSubsystems; i++) {
+    const auto& sub = stats.subsystems[i];
+    XLOG(INFO) << "mem " << getMemSubsystemString(MemSubsystem(i))
+               << " allocatedBytes=" << sub.allocatedBytes
+               << " freedBytes=" << sub.freedBytes << " scopes=" << sub.scopes;
+  }
+  for (const auto& arena : MemoryAccounting::arenaStats()) {
+    XLOG(INFO) << "arena " << arena.arena
+               << " allocations=" << arena.allocations
+               << " deallocations=" << arena.deallocations
+               << " allocatedBytes=" << arena.allocatedBytes;
+  }
+}
+
+void logRequestStats(const RequestLatencyStats& stats) {
+  for (const auto& hist : stats.snapshot()) {
+    const auto& snap = hist.snapshot;
+    XLOG(INFO) << "latency " << hist.name << " count=" << snap.count
+               << " avgUs=" << snap.total.count() / snap.count
+               << " p50Us=" << snap.percentile(50).count()
+               << " p90Us=" << snap.percentile(90).count()
+               << " p99Us=" << snap.percentile(99).count()
+               << " maxUs=" << snap.max.count();
+  }
+}
+
+void logHeavyHitters(HeavyHitters& heavyHitters) {
+  for (size_t i = 0; i < kNumHeavyHitterMetrics; i++) {
+    auto metric = HeavyHitterMetric(i);
+    for (const auto& entry : heavyHitters.top(metric)) {
+      XLOG(INFO) << "heavy " << getHeavyHitterMetricString(metric) << " "
+                 << entry.fullTrackName << " estimate=" << entry.estimate;
+    }
+  }
+  heavyHitters.decay();
+}
+
+TransportConfig transportConfigFromFlags() {
+  TransportConfig config;
+  auto profile = parseTransportProfile(FLAGS_transport_profile);
+  if (profile.hasValue()) {
+    config.profile = profile.value();
+  } else {
+    XLOG(ERR) << profile.error() << ", using default";
+  }
+  if (!FLAGS_congestion_control.empty()) {
+    config.congestionControl =
+        quic::congestionControlStrToType(FLAGS_congestion_control);
+    if (!config.congestionControl) {
+      XLOG(ERR) << "Unknown --congestion_control "
+                << FLAGS_congestion_control;
+    }
+  }
+  if (FLAGS_init_cwnd_mss > 0) {
+    config.initCwndInMss = FLAGS_init_cwnd_mss;
+  }
+  if (FLAGS_conn_flow_control_window > 0) {
+    config.connFlowControlWindow = FLAGS_conn_flow_control_window;
+  }
+  if (FLAGS_stream_flow_control_window > 0) {
+    config.streamFlowControlWindow = FLAGS_stream_flow_control_window;
+  }
+  if (FLAGS_max_uni_streams > 0) {
+    config.maxUniStreams = FLAGS_max_uni_streams;
+  }
+  if (FLAGS_datagram_buf_size > 0) {
+    config.datagramBufSize = FLAGS_datagram_buf_size;
+  }
+  if (!gflags::GetCommandLineFlagInfoOrDie("pacing").is_default) {
+    config.pacing = FLAGS_pacing;
+  }
+  return config;
+}
+
+bool parseAbrTrack(
+    const std::string& spec,
+    FullTrackName& abrTrack,
+    std::vector<MoQAbrForwarder::Rendition>& renditions) {
+  std::string track;
+  std::string renditionList;
+  if (!folly::split('=', spec, track, renditionList)) {
+    return false;
+  }
+  auto slash = track.rfind('/');
+  if (slash == std::string::npos) {
+    return false;
+  }
+  abrTrack.trackNamespace = TrackNamespace(track.substr(0, slash), "/");
+  abrTrack.trackName = track.substr(slash + 1);
+  std::vector<std::string> specs;
+  folly::split(',', renditionList, specs);
+  for (auto& renditionSpec : specs) {
+    std::string name;
+    std::string bitrate;
+    if (!folly::split('@', renditionSpec, name, bitrate)) {
+      return false;
+    }
+    auto bps = folly::tryTo<uint64_t>(bitrate);
+    if (!bps) {
+      return false;
+    }
+    renditions.push_back({{abrTrack.trackNamespace, name}, *bps});
+  }
+  return !renditions.empty();
+}
+
+// Parses one prefix=limit:value,... entry of --namespace_quotas
+bool parseNamespaceQuota(
+    const std::string& spec,
+    TrackNamespace& prefix,
+    MoQNamespaceQuota::Limits& limits) {
+  std::string ns;
+  std::string limitList;
+  if (!folly::split('=', spec, ns, limitList)) {
+    return false;
+  }
+  prefix = TrackNamespace(ns, "/");
+  std::vector<std::string> specs;
+  folly::split(',', limitList, specs);
+  for (auto& limitSpec : specs) {
+    std::string name;
+    std::string value;
+    if (!folly::split(':', limitSpec, name, value)) {
+      return false;
+    }
+    auto n = folly::tryTo<uint64_t>(value);
+    if (!n) {
+      return false;
+    }
+    if (name == "upstream") {
+      limits.maxUpstreamSubscriptions = *n;
+    } else if (name == "subscribers") {
+      limits.maxSubscribers = *n;
+    } else if (name == "egress") {
+      limits.maxEgressBytesPerSec = *n;
+    } else if (name == "cache") {
+      limits.maxCacheBytesPerSec = *n;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void logQuotaStats(const MoQRelay& relay) {
+  for (const auto& quota : relay.namespaceQuotas()) {
+    auto usage = quota->usage();
+    XLOG(INFO) << "quota " << quota->prefix()
+               << " upstream=" << usage.upstreamSubscriptions
+               << " subscribers=" << usage.subscribers
+               << " egressBps=" << usage.egressBytesPerSec
+               << " cacheBps=" << usage.cacheBytesPerSec
+               << " rejected=" << usage.rejected
+               << " cacheSkipped=" << usage.cacheSkipped;
+  }
+}
+
 class MoQRelayServer : MoQServer {
  public:
   MoQRelayServer()
-      : MoQServer(FLAGS_port, FLAGS_cert, FLAGS_key, FLAGS_endpoint) {}
+      : MoQServer(
+            FLAGS_port,
+            FLAGS_cert,
+            FLAGS_key,
+            FLAGS_endpoint,
+            transportConfigFromFlags()) {
+    if (!FLAGS_abr_track.empty()) {
+      FullTrackName abrTrack;
+      std::vector<MoQAbrForwarder::Rendition> renditions;
+      if (parseAbrTrack(FLAGS_abr_track, abrTrack, renditions)) {
+        relay_->addAbrTrack(std::move(abrTrack), std::move(renditions));
+      } else {
+        XLOG(ERR) << "Invalid --abr_track: " << FLAGS_abr_track;
+      }
+    }
+    if (!FLAGS_auth_hmac_key.empty()) {
+      MoQAuthorizer::Config config;
+      config.cacheSize = FLAGS_auth_cache_size;
+      // HMAC verification is cheap enough for the event loop
+      relay_->setAuthorizer(std::make_shared<MoQAuthorizer>(
+          std::make_shared<HmacTokenVerifier>(FLAGS_auth_hmac_key), config));
+    }
+    relay_->setLiveFetchBufferBytes(FLAGS_live_fetch_buffer_kb << 10);
+    if (!FLAGS_shm_cache_name.empty()) {
+      ShmObjectCache::Config config;
+      config.name = FLAGS_shm_cache_name;
+      config.indexSlots = FLAGS_shm_cache_index_slots;
+      config.dataBytes = FLAGS_shm_cache_mb << 20;
+      auto cache = ShmObjectCache::open(std::move(config));
+      if (cache.hasValue()) {
+        relay_->setObjectCache(std::move(cache.value()));
+      } else {
+        XLOG(ERR) << "Failed to open shared cache: " << cache.error();
+      }
+    }
+    if (FLAGS_loop_stats_interval_ms > 0) {
+      LoopLagMonitor::Config config;
+      config.reportInterval =
+          std::chrono::milliseconds(FLAGS_loop_stats_interval_ms);
+      setLoopStatsCallback(std::make_shared<LoopStatsLogger>(), config);
+    }
+    if (!FLAGS_namespace_quotas.empty()) {
+      std::vector<std::string> specs;
+      folly::split(';', FLAGS_namespace_quotas, specs, /*ignoreEmpty=*/true);
+      for (auto& spec : specs) {
+        TrackNamespace prefix;
+        MoQNamespaceQuota::Limits limits;
+        if (parseNamespaceQuota(spec, prefix, limits)) {
+          relay_->setNamespaceQuota(prefix, std::move(limits));
+        } else {
+          XLOG(ERR) << "Invalid --namespace_quotas entry: " << spec;
+        }
+      }
+    }
+    if (FLAGS_heavy_hitters_interval_ms > 0) {
+      HeavyHitters::Config config;
+      config.topK = FLAGS_heavy_hitters_top_k;
+      heavyHitters_ = std::make_shared<HeavyHitters>(config);
+      relay_->setHeavyHitters(heavyHitters_);
+    }
+    if (FLAGS_worker_arenas) {
+      bindWorkerArenas();
+    }
+    MemoryAccounting::setEnabled(FLAGS_mem_stats_interval_ms > 0);
+  }
 
   void onNewSession(std::shared_ptr<MoQSession> clientSession) override {
     clientSession->setPublishHandler(relay_);
     clientSession->setSubscribeHandler(relay_);
+    if (FLAGS_request_stats_interval_ms > 0) {
+      clientSession->setPublisherStatsCallback(
+          requestStats_->publisherCallback());
+      clientSession->setSubscriberStatsCallback(
+          requestStats_->subscriberCallback());
+    }
+    if (!FLAGS_capture_dir.empty()) {
+      auto path = fmt::format(
+          "{}/moq-{}-{}.cap",
+          FLAGS_capture_dir,
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::system_clock::now().time_since_epoch())
+              .count(),
+          captureCount_++);
+      try {
+        clientSession->setCaptureWriter(std::make_shared<MoQCaptureWriter>(
+            path,
+            MoQControlCodec::Direction::SERVER,
+            folly::getGlobalCPUExecutor()));
+      } catch (const std::exception& ex) {
+        XLOG(ERR) << "Failed to open capture " << path
+                  << " ex=" << folly::exceptionStr(ex);
+      }
+    }
   }
 
   void terminateClientSession(std::shared_ptr<MoQSession> session) override {
     relay_->removeSession(session);
   }
 
+  const RequestLatencyStats& requestStats() const {
+    return *requestStats_;
+  }
+
+  const MoQRelay& relay() const {
+    return *relay_;
+  }
+
+  HeavyHitters* heavyHitters() const {
+    return heavyHitters_.get();
+  }
+
  private:
   std::shared_ptr<MoQRelay> relay_{std::make_shared<MoQRelay>()};
+  std::atomic<uint64_t> captureCount_{0};
+  std::shared_ptr<RequestLatencyStats> requestStats_{
+      std::make_shared<RequestLatencyStats>()};
+  std::shared_ptr<HeavyHitters> heavyHitters_;
 };
 } // namespace
 
@@ -42,6 +410,34 @@ int main(int argc, char* argv[]) {
   folly::Init init(&argc, &argv, true);
   MoQRelayServer moqRelayServer;
   folly::EventBase evb;
+  std::function<void()> memStatsTimer = [&] {
+    logMemStats();
+    evb.runAfterDelay(memStatsTimer, FLAGS_mem_stats_interval_ms);
+  };
+  if (FLAGS_mem_stats_interval_ms > 0) {
+    evb.runAfterDelay(memStatsTimer, FLAGS_mem_stats_interval_ms);
+  }
+  std::function<void()> requestStatsTimer = [&] {
+    logRequestStats(moqRelayServer.requestStats());
+    evb.runAfterDelay(requestStatsTimer, FLAGS_request_stats_interval_ms);
+  };
+  if (FLAGS_request_stats_interval_ms > 0) {
+    evb.runAfterDelay(requestStatsTimer, FLAGS_request_stats_interval_ms);
+  }
+  std::function<void()> heavyHittersTimer = [&] {
+    logHeavyHitters(*moqRelayServer.heavyHitters());
+    evb.runAfterDelay(heavyHittersTimer, FLAGS_heavy_hitters_interval_ms);
+  };
+  if (FLAGS_heavy_hitters_interval_ms > 0) {
+    evb.runAfterDelay(heavyHittersTimer, FLAGS_heavy_hitters_interval_ms);
+  }
+  std::function<void()> quotaStatsTimer = [&] {
+    logQuotaStats(moqRelayServer.relay());
+    evb.runAfterDelay(quotaStatsTimer, FLAGS_quota_stats_interval_ms);
+  };
+  if (FLAGS_quota_stats_interval_ms > 0) {
+    evb.runAfterDelay(quotaStatsTimer, FLAGS_quota_stats_interval_ms);
+  }
   evb.loopForever();
   return 0;
 }
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/portability/GFlags.h>
+#include "moxygen/MoQCodec.h"
+#include "moxygen/util/MoQCapture.h"
+
+#include <folly/container/F14Map.h>
+#include <folly/init/Init.h>
+
+#include <thread>
+
+DEFINE_string(capture, "", "Capture file written by MoQCaptureWriter");
+DEFINE_bool(
+    realtime,
+    false,
+    "Replay at recorded speed, else as fast as possible");
+DEFINE_int32(iterations, 1, "Number of times to replay the capture");
+
+namespace {
+using namespace moxygen;
+
+struct ReplayStats {
+  uint64_t records{0};
+  uint64_t bytes{0};
+  uint64_t controlFrames{0};
+  uint64_t subgroups{0};
+  uint64_t fetches{0};
+  uint64_t objects{0};
+  uint64_t datagrams{0};
+  uint64_t parseErrors{0};
+};
+
+// Counts control frames; the message contents are discarded
+class ReplayControlCallback : public MoQControlCodec::ControlCallback {
+ public:
+  explicit ReplayControlCallback(ReplayStats& stats) : stats_(stats) {}
+
+  void onFrame(FrameType) override {
+    stats_.controlFrames++;
+  }
+  void onClientSetup(ClientSetup) override {}
+  void onServerSetup(ServerSetup) override {}
+  void onSubscribe(SubscribeRequest) override {}
+  void onSubscribeUpdate(SubscribeUpdate) override {}
+  void onSubscribeOk(SubscribeOk) override {}
+  void onSubscribeError(SubscribeError) override {}
+  void onSubscribeDone(SubscribeDone) override {}
+  void onUnsubscribe(Unsubscribe) override {}
+  void onMaxSubscribeId(MaxSubscribeId) override {}
+  void onSubscribesBlocked(SubscribesBlocked) override {}
+  void onFetch(Fetch) override {}
+  void onFetchCancel(FetchCancel) override {}
+  void onFetchOk(FetchOk) override {}
+  void onFetchError(FetchError) override {}
+  void onAnnounce(Announce) override {}
+  void onAnnounceOk(AnnounceOk) override {}
+  void onAnnounceError(AnnounceError) override {}
+  void onUnannounce(Unannounce) override {}
+  void onAnnounceCancel(AnnounceCancel) override {}
+  void onSubscribeAnnounces(SubscribeAnnounces) override {}
+  void onSubscribeAnnouncesOk(SubscribeAnnouncesOk) override {}
+  void onSubscribeAnnouncesError(SubscribeAnnouncesError) override {}
+  void onUnsubscribeAnnounces(UnsubscribeAnnounces) override {}
+  void onTrackStatusRequest(TrackStatusRequest) override {}
+  void onTrackStatus(TrackStatus) override {}
+  void onGoaway(Goaway) override {}
+  void onConnectionError(ErrorCode error) override {
+    XLOG(ERR) << "Control parse error=" << folly::to_underlying(error);
+    stats_.parseErrors++;
+  }
+
+ private:
+  ReplayStats& stats_;
+};
+
+class ReplayObjectCallback : public MoQObjectStreamCodec::ObjectCallback {
+ public:
+  explicit ReplayObjectCallback(ReplayStats& stats) : stats_(stats) {}
+
+  void onFetchHeader(SubscribeID) override {
+    stats_.fetches++;
+  }
+  void onSubgroup(TrackAlias, uint64_t, uint64_t, uint8_t) override {
+    stats_.subgroups++;
+  }
+  void onObjectBegin(
+      uint64_t,
+      uint64_t,
+      uint64_t,
+      Extensions,
+      uint64_t,
+      Payload,
+      bool objectComplete,
+      bool) override {
+    if (objectComplete) {
+      stats_.objects++;
+    }
+  }
+  void onObjectStatus(
+      uint64_t,
+      uint64_t,
+      uint64_t,
+      Priority,
+      ObjectStatus,
+      Extensions) override {
+    stats_.objects++;
+  }
+  void onObjectPayload(Payload, bool objectComplete) override {
+    if (objectComplete) {
+      stats_.objects++;
+    }
+  }
+  void onEndOfStream() override {}
+  void onConnectionError(ErrorCode error) override {
+    XLOG(ERR) << "Stream parse error=" << folly::to_underlying(error);
+    stats_.parseErrors++;
+  }
+
+ private:
+  ReplayStats& stats_;
+};
+
+void replayDatagram(
+    std::unique_ptr<folly::IOBuf> datagram,
+    ReplayStats& stats) {
+  if (!datagram) {
+    return;
+  }
+  size_t remainingLength = datagram->computeChainDataLength();
+  folly::io::Cursor cursor(datagram.get());
+  auto type = quic::decodeQuicInteger(cursor);
+  if (!type) {
+    stats.parseErrors++;
+    return;
+  }
+  remainingLength -= type->second;
+  auto res = parseDatagramObjectHeader(
+      cursor, StreamType(type->first), remainingLength);
+  if (res.hasError()) {
+    stats.parseErrors++;
+    return;
+  }
+  stats.datagrams++;
+}
+
+// Feeds every record in the capture through fresh codecs, one per stream
+ReplayStats replay(const std::string& path, bool realtime) {
+  ReplayStats stats;
+  MoQCaptureReader reader(path);
+  ReplayControlCallback controlCallback(stats);
+  ReplayObjectCallback objectCallback(stats);
+  folly::F14FastMap<uint64_t, std::unique_ptr<MoQControlCodec>> controlCodecs;
+  folly::F14FastMap<uint64_t, std::unique_ptr<MoQObjectStreamCodec>>
+      streamCodecs;
+  auto start = std::chrono::steady_clock::now();
+  while (!reader.done()) {
+    auto record = reader.next();
+    if (record.hasError()) {
+      XLOG(ERR) << "Truncated or corrupt capture, stopping";
+      break;
+    }
+    if (realtime) {
+      std::this_thread::sleep_until(start + record->timestamp);
+    }
+    stats.records++;
+    stats.bytes += record->data ? record->data->computeChainDataLength() : 0;
+    switch (record->type) {
+      case CaptureRecordType::CONTROL: {
+        auto& codec = controlCodecs[record->streamID];
+        if (!codec) {
+          codec = std::make_unique<MoQControlCodec>(
+              reader.direction(), &controlCallback);
+          codec->setStreamId(record->streamID);
+        }
+        codec->onIngress(std::move(record->data), record->fin);
+        break;
+      }
+      case CaptureRecordType::STREAM: {
+        auto& codec = streamCodecs[record->streamID];
+        if (!codec) {
+          codec = std::make_unique<MoQObjectStreamCodec>(&objectCallback);
+          codec->setStreamId(record->streamID);
+        }
+        codec->onIngress(std::move(record->data), record->fin);
+        if (record->fin) {
+          streamCodecs.erase(record->streamID);
+        }
+        break;
+      }
+      case CaptureRecordType::DATAGRAM:
+        replayDatagram(std::move(record->data), stats);
+        break;
+    }
+  }
+  return stats;
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::Init init(&argc, &argv, false);
+  if (FLAGS_capture.empty()) {
+    XLOG(ERR) << "--capture is required";
+    return 1;
+  }
+  for (auto i = 0; i < FLAGS_iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    auto stats = replay(FLAGS_capture, FLAGS_realtime);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    auto seconds = std::max(elapsed.count(), int64_t(1)) / 1e6;
+    XLOG(INFO) << "iteration=" << i << " records=" << stats.records
+               << " bytes=" << stats.bytes
+               << " controlFrames=" << stats.controlFrames
+               << " subgroups=" << stats.subgroups
+               << " fetches=" << stats.fetches << " objects=" << stats.objects
+               << " datagrams=" << stats.datagrams
+               << " parseErrors=" << stats.parseErrors
+               << " elapsedUs=" << elapsed.count()
+               << " MBps=" << (stats.bytes / seconds / 1e6)
+               << " objectsPerSec=" << (stats.objects / seconds);
+  }
+  return 0;
+}
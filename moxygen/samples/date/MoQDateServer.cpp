@@ -10,6 +10,7 @@
 #include "moxygen/MoQServer.h"
 #include "moxygen/relay/MoQForwarder.h"
 #include "moxygen/relay/MoQRelayClient.h"
+#include "moxygen/util/HybridTrackPublisher.h"
 
 using namespace quic::samples;
 using namespace proxygen;
@@ -24,7 +25,8 @@ DEFINE_string(
     mode,
     "spg",
     "Transmission mode for track: stream-per-group (spg), "
-    "stream-per-object(spo), datagram");
+    "stream-per-object(spo), datagram, hybrid (minutes on streams, seconds "
+    "as datagrams)");
 DEFINE_bool(quic_transport, false, "Use raw QUIC transport");
 DEFINE_bool(datagrams, true, "Use one datagram for each object");
 
@@ -39,11 +41,14 @@ class MoQDateServer : public MoQServer,
                       public Publisher,
                       public std::enable_shared_from_this<MoQDateServer> {
  public:
-  enum class Mode { STREAM_PER_GROUP, STREAM_PER_OBJECT, DATAGRAM };
+  enum class Mode { STREAM_PER_GROUP, STREAM_PER_OBJECT, DATAGRAM, HYBRID };
 
   explicit MoQDateServer(Mode mode)
       : MoQServer(FLAGS_port, FLAGS_cert, FLAGS_key, "/moq-date"),
         forwarder_(dateTrackName()),
+        // forwarder_ outlives hybrid_
+        hybrid_(std::shared_ptr<TrackConsumer>(
+            std::shared_ptr<void>(), &forwarder_)),
         mode_(mode) {}
 
   bool startRelayClient() {
@@ -324,6 +329,9 @@ class MoQDateServer : public MoQServer,
           case Mode::DATAGRAM:
             publishDategram(minute, second);
             break;
+          case Mode::HYBRID:
+            publishHybrid(minute, second);
+            break;
         }
       }
       co_await folly::coro::sleep(std::chrono::seconds(1));
@@ -404,6 +412,34 @@ class MoQDateServer : public MoQServer,
     }
   }
 
+  void publishHybrid(uint64_t group, uint64_t second) {
+    uint64_t object = second;
+    ObjectHeader header{
+        TrackAlias(0),
+        group,
+        0,
+        object,
+        /*p=*/0, // priority
+        ObjectStatus::NORMAL,
+        kExtensions,
+        folly::none};
+    if (second == 0) {
+      hybrid_.publish(header, minutePayload(group), /*reliable=*/true);
+    }
+    header.id++;
+    header.extensions.clear();
+    hybrid_.publish(header, secondPayload(header.id));
+    if (header.id >= 60) {
+      header.id++;
+      header.status = ObjectStatus::END_OF_GROUP;
+      hybrid_.publish(header, nullptr);
+      auto& stats = hybrid_.getStats();
+      XLOG(DBG1) << "datagrams=" << stats.datagramObjects
+                 << " streamObjects=" << stats.streamObjects
+                 << " oversize=" << stats.oversizeObjects;
+    }
+  }
+
   void terminateClientSession(std::shared_ptr<MoQSession> session) override {
     XLOG(INFO) << __func__;
     forwarder_.removeSession(session);
@@ -414,6 +450,7 @@ class MoQDateServer : public MoQServer,
     return FullTrackName({TrackNamespace({"moq-date"}), "date"});
   }
   MoQForwarder forwarder_;
+  HybridTrackPublisher hybrid_;
   std::unique_ptr<MoQRelayClient> relayClient_;
   Mode mode_{Mode::STREAM_PER_GROUP};
   bool loopRunning_{false};
@@ -429,6 +466,8 @@ int main(int argc, char* argv[]) {
     mode = MoQDateServer::Mode::STREAM_PER_OBJECT;
   } else if (FLAGS_mode == "datagram") {
     mode = MoQDateServer::Mode::DATAGRAM;
+  } else if (FLAGS_mode == "hybrid") {
+    mode = MoQDateServer::Mode::HYBRID;
   } else {
     XLOG(ERR) << "Invalid mode: " << FLAGS_mode;
     return 1;
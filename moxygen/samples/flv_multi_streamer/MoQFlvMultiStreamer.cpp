@@ -0,0 +1,655 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <fcntl.h>
+#include <folly/container/F14Map.h>
+#include <folly/coro/Collect.h>
+#include <folly/coro/Sleep.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/init/Init.h>
+#include <folly/io/async/AsyncPipe.h>
+#include <folly/io/async/AsyncSignalHandler.h>
+#include <folly/portability/GFlags.h>
+#include <signal.h>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "moxygen/MoQClient.h"
+#include "moxygen/flv_parser/FlvSequentialReader.h"
+#include "moxygen/flv_parser/FlvStreamParser.h"
+#include "moxygen/moq_mi/MoQMi.h"
+
+DEFINE_string(
+    inputs_file,
+    "",
+    "File listing one '<track namespace> <FLV file or fifo>' per line");
+DEFINE_string(
+    connect_url,
+    "https://localhost:4433/moq",
+    "URL for webtransport server");
+DEFINE_string(track_namespace_delimiter, "/", "Track Namespace Delimiter");
+DEFINE_string(video_track_name, "video0", "Video track Name");
+DEFINE_string(audio_track_name, "audio0", "Audio track Name");
+DEFINE_int32(connect_timeout, 1000, "Connect timeout (ms)");
+DEFINE_int32(transaction_timeout, 120, "Transaction timeout (s)");
+DEFINE_bool(quic_transport, false, "Use raw QUIC transport");
+DEFINE_int32(num_sessions, 4, "Upstream sessions shared by all channels");
+DEFINE_int32(parser_threads, 4, "Threads used to read and parse FLV files");
+DEFINE_bool(pace, true, "Publish at the rate given by FLV media timestamps");
+DEFINE_int32(stats_interval, 10, "Per-channel lag stats interval (s), 0=off");
+
+namespace {
+using namespace moxygen;
+
+// One FLV input published as its own namespace. Regular files are read and
+// parsed on the shared parser pool, FIFOs are demuxed on the EventBase as
+// data arrives; all MoQ state is only touched on the EventBase.
+class FlvChannel : public flv::FlvStreamParser::Callback,
+                   public std::enable_shared_from_this<FlvChannel> {
+ public:
+  FlvChannel(folly::EventBase* evb, TrackNamespace ns, std::string path)
+      : evb_(evb),
+        path_(std::move(path)),
+        fullVideoTrackName_({ns, FLAGS_video_track_name}),
+        fullAudioTrackName_({ns, FLAGS_audio_track_name}),
+        trackNamespace_(std::move(ns)) {}
+
+  const TrackNamespace& trackNamespace() const {
+    return trackNamespace_;
+  }
+
+  const std::string& path() const {
+    return path_;
+  }
+
+  // Called on the EventBase once the namespace is announced
+  void start(folly::Executor::KeepAlive<> parserPool) {
+    XLOG(INFO) << __func__ << " ns=" << trackNamespace_ << " path=" << path_;
+    if (std::filesystem::is_fifo(path_)) {
+      openFifo();
+    } else {
+      readLoop().scheduleOn(std::move(parserPool)).start();
+    }
+  }
+
+  void stop() {
+    stopped_ = true;
+    pipeReader_.reset();
+    paced_.clear();
+  }
+
+  // flv::FlvStreamParser::Callback
+  void onTag(flv::FlvTag tag) override {
+    std::unique_ptr<flv::FlvSequentialReader::MediaItem> item;
+    try {
+      item = flvTagReader_.processTag(std::move(tag));
+    } catch (const std::exception& ex) {
+      onError(folly::exceptionStr(ex).toStdString());
+      return;
+    }
+    if (!item) {
+      return;
+    }
+    auto due = dueTime(*item);
+    paced_.emplace_back(std::move(item), due);
+    publishPaced();
+  }
+
+  void onError(const std::string& error) override {
+    XLOG(ERR) << "Error reading FLV ns=" << trackNamespace_ << ": " << error;
+    pipeReader_.reset();
+    paced_.clear();
+  }
+
+  folly::coro::Task<Publisher::SubscribeResult> subscribe(
+      SubscribeRequest subscribeReq,
+      std::shared_ptr<TrackConsumer> consumer) {
+    XLOG(INFO) << "SubscribeRequest track ns="
+               << subscribeReq.fullTrackName.trackNamespace
+               << " name=" << subscribeReq.fullTrackName.trackName
+               << " subscribe id=" << subscribeReq.subscribeID;
+    if (subscribeReq.locType != LocationType::LatestObject) {
+      co_return folly::makeUnexpected(SubscribeError{
+          subscribeReq.subscribeID,
+          SubscribeErrorCode::NOT_SUPPORTED,
+          "Only location LatestObject mode supported"});
+    }
+    AbsoluteLocation latest;
+    bool isVideo = subscribeReq.fullTrackName == fullVideoTrackName_;
+    if (isVideo) {
+      latest = latestVideo_;
+      videoPub_ = std::move(consumer);
+    } else if (subscribeReq.fullTrackName == fullAudioTrackName_) {
+      latest = latestAudio_;
+      audioPub_ = std::move(consumer);
+    } else {
+      co_return folly::makeUnexpected(SubscribeError{
+          subscribeReq.subscribeID,
+          SubscribeErrorCode::TRACK_NOT_EXIST,
+          "Full trackname NOT available"});
+    }
+    co_return std::make_shared<Subscription>(
+        SubscribeOk{
+            subscribeReq.subscribeID,
+            std::chrono::milliseconds(0),
+            MoQSession::resolveGroupOrder(
+                GroupOrder::OldestFirst, subscribeReq.groupOrder),
+            latest,
+            {}},
+        isVideo,
+        shared_from_this());
+  }
+
+  void logStats() {
+    if (stats_.items == 0) {
+      XLOG(INFO) << "ns=" << trackNamespace_ << " idle";
+      return;
+    }
+    XLOG(INFO) << "ns=" << trackNamespace_ << " items=" << stats_.items
+               << " bytes=" << stats_.bytes << " avgLagMs="
+               << (stats_.totalLag.count() / stats_.items / 1000.0)
+               << " maxLagMs=" << (stats_.maxLag.count() / 1000.0)
+               << " videoGroup=" << latestVideo_.group;
+    stats_ = ChannelStats();
+  }
+
+ private:
+  static const uint8_t AUDIO_STREAM_PRIORITY = 100; /* Lower is higher pri */
+  static const uint8_t VIDEO_STREAM_PRIORITY = 200;
+
+  struct ChannelStats {
+    uint64_t items{0};
+    uint64_t bytes{0};
+    // How far behind the media timeline the object was handed to MoQ
+    std::chrono::microseconds totalLag{0};
+    std::chrono::microseconds maxLag{0};
+  };
+
+  struct Subscription : public Publisher::SubscriptionHandle {
+    Subscription(
+        SubscribeOk ok,
+        bool isVideo,
+        std::shared_ptr<FlvChannel> channel)
+        : SubscriptionHandle(std::move(ok)),
+          isVideo_(isVideo),
+          channel_(std::move(channel)) {}
+
+    void subscribeUpdate(SubscribeUpdate) override {}
+    void unsubscribe() override {
+      XLOG(INFO) << "Unsubscribe id=" << subscribeOk_->subscribeID
+                 << " ns=" << channel_->trackNamespace_;
+      if (isVideo_) {
+        channel_->videoSgPub_.reset();
+        channel_->videoPub_.reset();
+      } else {
+        channel_->audioPub_.reset();
+      }
+    }
+
+   private:
+    bool isVideo_;
+    std::shared_ptr<FlvChannel> channel_;
+  };
+
+  // Regular files only.  Runs on the parser pool: reads wait on the disk,
+  // never on a writer, and pacing sleeps release the thread.
+  folly::coro::Task<void> readLoop() {
+    flv::FlvSequentialReader flvSeqReader(path_);
+    while (!stopped_) {
+      auto item = flvSeqReader.getNextItem();
+      if (item == nullptr) {
+        XLOG(ERR) << "Error reading FLV ns=" << trackNamespace_;
+        break;
+      }
+      auto due = dueTime(*item);
+      auto now = std::chrono::steady_clock::now();
+      if (due > now) {
+        co_await folly::coro::sleep(
+            std::chrono::duration_cast<folly::HighResDuration>(due - now));
+      }
+      auto isEOF = item->isEOF;
+      evb_->runInEventBaseThread(
+          [self = shared_from_this(), item = std::move(item), due]() mutable {
+            self->publish(std::move(item), due);
+          });
+      if (isEOF) {
+        XLOG(INFO) << "FLV file EOF ns=" << trackNamespace_;
+        break;
+      }
+    }
+  }
+
+  // Opening a FIFO blocks until a writer connects, which may never happen,
+  // so it is done on its own thread rather than on the parser pool.  Reads
+  // are then non-blocking on the EventBase.
+  void openFifo() {
+    std::thread([self = shared_from_this()] {
+      int fd = ::open(self->path_.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0 || ::fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        XLOG(ERR) << "Error opening " << self->path_ << " errno=" << errno;
+        if (fd >= 0) {
+          ::close(fd);
+        }
+        return;
+      }
+      self->evb_->runInEventBaseThread([self, fd] {
+        if (self->stopped_) {
+          ::close(fd);
+          return;
+        }
+        self->pipeReader_ = folly::AsyncPipeReader::newReader(
+            self->evb_, folly::NetworkSocket::fromFd(fd));
+        self->pipeReader_->setReadCB(&self->flvParser_);
+      });
+    }).detach();
+  }
+
+  // When the item should be published to follow the media timestamps
+  std::chrono::steady_clock::time_point dueTime(
+      const flv::FlvSequentialReader::MediaItem& item) {
+    auto now = std::chrono::steady_clock::now();
+    if (!FLAGS_pace || item.isEOF || item.timescale == 0) {
+      return now;
+    }
+    auto mediaTs = std::chrono::milliseconds(item.dts * 1000 / item.timescale);
+    if (!mediaStart_) {
+      mediaStart_ = now - mediaTs;
+    }
+    return *mediaStart_ + mediaTs;
+  }
+
+  // Publishes the FIFO items that are due.  While the oldest one is early
+  // the pipe is paused, so a FIFO written faster than real time is paced
+  // like a file instead of buffering without bound.
+  void publishPaced() {
+    while (!paced_.empty()) {
+      auto now = std::chrono::steady_clock::now();
+      auto due = paced_.front().second;
+      if (due > now) {
+        if (pipeReader_) {
+          pipeReader_->setReadCB(nullptr);
+        }
+        if (!pacingTimerScheduled_) {
+          pacingTimerScheduled_ = true;
+          evb_->runAfterDelay(
+              [self = shared_from_this()] {
+                self->pacingTimerScheduled_ = false;
+                self->publishPaced();
+              },
+              std::chrono::ceil<std::chrono::milliseconds>(due - now).count());
+        }
+        return;
+      }
+      auto item = std::move(paced_.front().first);
+      paced_.pop_front();
+      auto isEOF = item->isEOF;
+      publish(std::move(item), due);
+      if (isEOF) {
+        XLOG(INFO) << "FLV stream EOF ns=" << trackNamespace_;
+        pipeReader_.reset();
+        paced_.clear();
+        return;
+      }
+    }
+    if (pipeReader_) {
+      pipeReader_->setReadCB(&flvParser_);
+    }
+  }
+
+  void publish(
+      std::unique_ptr<flv::FlvSequentialReader::MediaItem> item,
+      std::chrono::steady_clock::time_point due) {
+    auto lag = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - due);
+    stats_.items++;
+    stats_.bytes += item->data ? item->data->computeChainDataLength() : 0;
+    stats_.totalLag += lag;
+    stats_.maxLag = std::max(stats_.maxLag, lag);
+    if (!item->data && !item->isEOF) {
+      return;
+    }
+    if (item->isEOF) {
+      publishVideo(item->clone());
+      publishAudio(std::move(item));
+    } else if (item->type == flv::FlvSequentialReader::MediaType::VIDEO) {
+      publishVideo(std::move(item));
+    } else if (item->type == flv::FlvSequentialReader::MediaType::AUDIO) {
+      publishAudio(std::move(item));
+    }
+  }
+
+  void publishAudio(std::unique_ptr<flv::FlvSequentialReader::MediaItem> item) {
+    if (item->isEOF || !audioPub_) {
+      return;
+    }
+    auto objPayload = encodeToMoQMi(std::move(item));
+    if (!objPayload) {
+      XLOG(ERR) << "Failed to encode audio frame ns=" << trackNamespace_;
+      return;
+    }
+    // The session fills in the track alias of the subscription
+    audioPub_->objectStream(
+        ObjectHeader{
+            TrackAlias(0),
+            latestAudio_.group++,
+            /*subgroup=*/0,
+            latestAudio_.object,
+            AUDIO_STREAM_PRIORITY,
+            ObjectStatus::NORMAL},
+        std::move(objPayload));
+  }
+
+  void publishVideo(std::unique_ptr<flv::FlvSequentialReader::MediaItem> item) {
+    if (item->isEOF) {
+      if (videoSgPub_) {
+        videoSgPub_->endOfGroup(latestVideo_.object);
+        videoSgPub_.reset();
+        latestVideo_.group++;
+        latestVideo_.object = 0;
+      }
+      return;
+    }
+    if (!videoPub_ || (!item->isIdr && !videoSgPub_)) {
+      return;
+    }
+    auto isIdr = item->isIdr;
+    auto objPayload = encodeToMoQMi(std::move(item));
+    if (!objPayload) {
+      XLOG(ERR) << "Failed to encode video frame ns=" << trackNamespace_;
+      return;
+    }
+    if (isIdr) {
+      if (videoSgPub_) {
+        videoSgPub_->endOfGroup(latestVideo_.object);
+        videoSgPub_.reset();
+        latestVideo_.group++;
+        latestVideo_.object = 0;
+      }
+      auto res = videoPub_->beginSubgroup(
+          latestVideo_.group, 0, VIDEO_STREAM_PRIORITY);
+      if (!res) {
+        XLOG(ERR) << "Error creating subgroup ns=" << trackNamespace_;
+        return;
+      }
+      videoSgPub_ = std::move(res.value());
+    }
+    videoSgPub_->object(latestVideo_.object++, std::move(objPayload));
+  }
+
+  static std::unique_ptr<folly::IOBuf> encodeToMoQMi(
+      std::unique_ptr<flv::FlvSequentialReader::MediaItem> item) {
+    if (item->type == flv::FlvSequentialReader::MediaType::VIDEO) {
+      return MoQMi::toObjectPayload(
+          std::make_unique<MoQMi::VideoH264AVCCWCPData>(
+              item->id,
+              item->pts,
+              item->timescale,
+              item->duration,
+              item->wallclock,
+              std::move(item->data),
+              std::move(item->metadata),
+              item->dts));
+    } else if (item->type == flv::FlvSequentialReader::MediaType::AUDIO) {
+      return MoQMi::toObjectPayload(
+          std::make_unique<MoQMi::AudioAACMP4LCWCPData>(
+              item->id,
+              item->pts,
+              item->timescale,
+              item->duration,
+              item->wallclock,
+              std::move(item->data),
+              item->sampleFreq,
+              item->numChannels));
+    }
+    return nullptr;
+  }
+
+  folly::EventBase* evb_;
+  std::string path_;
+  FullTrackName fullVideoTrackName_;
+  FullTrackName fullAudioTrackName_;
+  TrackNamespace trackNamespace_;
+  std::atomic<bool> stopped_{false};
+  folly::Optional<std::chrono::steady_clock::time_point> mediaStart_;
+
+  // FIFO input, only used on the EventBase
+  flv::FlvStreamParser flvParser_{*this};
+  flv::FlvSequentialReader flvTagReader_;
+  folly::AsyncPipeReader::UniquePtr pipeReader_;
+  std::deque<std::pair<
+      std::unique_ptr<flv::FlvSequentialReader::MediaItem>,
+      std::chrono::steady_clock::time_point>>
+      paced_;
+  bool pacingTimerScheduled_{false};
+
+  AbsoluteLocation latestVideo_{0, 0};
+  AbsoluteLocation latestAudio_{0, 0};
+  std::shared_ptr<TrackConsumer> audioPub_;
+  std::shared_ptr<TrackConsumer> videoPub_;
+  std::shared_ptr<SubgroupConsumer> videoSgPub_;
+  ChannelStats stats_;
+};
+
+// One upstream MoQ session carrying many channels, routing SUBSCRIBEs by
+// track namespace.
+class UpstreamSession : public Publisher,
+                        public std::enable_shared_from_this<UpstreamSession> {
+ public:
+  UpstreamSession(folly::EventBase* evb, proxygen::URL url)
+      : moqClient_(
+            evb,
+            std::move(url),
+            FLAGS_quic_transport
+                ? MoQClient::TransportType::QUIC
+                : MoQClient::TransportType::H3_WEBTRANSPORT) {}
+
+  void addChannel(std::shared_ptr<FlvChannel> channel) {
+    auto ns = channel->trackNamespace();
+    channels_.emplace(std::move(ns), std::move(channel));
+  }
+
+  // Connects, then announces every channel and starts its reader on the
+  // parser pool once the announce succeeds.
+  folly::coro::Task<void> run(folly::Executor::KeepAlive<> parserPool) {
+    try {
+      co_await moqClient_.setupMoQSession(
+          std::chrono::milliseconds(FLAGS_connect_timeout),
+          std::chrono::seconds(FLAGS_transaction_timeout),
+          /*publishHandler=*/shared_from_this(),
+          /*subscribeHandler=*/nullptr);
+    } catch (const std::exception& ex) {
+      XLOG(ERR) << folly::exceptionStr(ex);
+      co_return;
+    }
+    std::vector<folly::coro::Task<void>> announces;
+    for (auto& [ns, channel] : channels_) {
+      announces.emplace_back(announceAndStart(channel, parserPool));
+    }
+    co_await folly::coro::collectAllRange(std::move(announces));
+  }
+
+  void stop() {
+    for (auto& [ns, channel] : channels_) {
+      channel->stop();
+    }
+    for (auto& handle : announceHandles_) {
+      handle->unannounce();
+    }
+    announceHandles_.clear();
+    if (moqClient_.moqSession_) {
+      moqClient_.moqSession_->close(SessionCloseErrorCode::NO_ERROR);
+    }
+  }
+
+  void logStats() {
+    for (auto& [ns, channel] : channels_) {
+      channel->logStats();
+    }
+  }
+
+  folly::coro::Task<SubscribeResult> subscribe(
+      SubscribeRequest subscribeReq,
+      std::shared_ptr<TrackConsumer> consumer) override {
+    auto it = channels_.find(subscribeReq.fullTrackName.trackNamespace);
+    if (it == channels_.end()) {
+      co_return folly::makeUnexpected(SubscribeError{
+          subscribeReq.subscribeID,
+          SubscribeErrorCode::TRACK_NOT_EXIST,
+          "Namespace NOT available"});
+    }
+    co_return co_await it->second->subscribe(
+        std::move(subscribeReq), std::move(consumer));
+  }
+
+ private:
+  folly::coro::Task<void> announceAndStart(
+      std::shared_ptr<FlvChannel> channel,
+      folly::Executor::KeepAlive<> parserPool) {
+    if (!moqClient_.moqSession_) {
+      co_return;
+    }
+    auto annResp = co_await moqClient_.moqSession_->announce(
+        {channel->trackNamespace(), {}});
+    if (annResp.hasError()) {
+      XLOG(ERR) << "Announce error trackNamespace="
+                << annResp.error().trackNamespace << " code="
+                << folly::to_underlying(annResp.error().errorCode)
+                << " reason=" << annResp.error().reasonPhrase;
+      co_return;
+    }
+    announceHandles_.emplace_back(std::move(annResp.value()));
+    channel->start(std::move(parserPool));
+  }
+
+  MoQClient moqClient_;
+  folly::F14FastMap<
+      TrackNamespace,
+      std::shared_ptr<FlvChannel>,
+      TrackNamespace::hash>
+      channels_;
+  std::vector<std::shared_ptr<Subscriber::AnnounceHandle>> announceHandles_;
+};
+
+// Parses --inputs_file, skipping blank lines and '#' comments
+std::vector<std::pair<TrackNamespace, std::string>> readInputs(
+    const std::string& inputsFile) {
+  std::vector<std::pair<TrackNamespace, std::string>> inputs;
+  std::ifstream in(inputsFile);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string ns;
+    std::string path;
+    if (!(fields >> ns >> path)) {
+      XLOG(ERR) << "Ignoring malformed input line: " << line;
+      continue;
+    }
+    if (!std::filesystem::exists(path)) {
+      XLOG(ERR) << "Ignoring missing input " << path;
+      continue;
+    }
+    inputs.emplace_back(
+        TrackNamespace(ns, FLAGS_track_namespace_delimiter), path);
+  }
+  return inputs;
+}
+
+folly::coro::Task<void> statsLoop(
+    std::vector<std::shared_ptr<UpstreamSession>> sessions) {
+  while (true) {
+    co_await folly::coro::sleep(std::chrono::seconds(FLAGS_stats_interval));
+    for (auto& session : sessions) {
+      session->logStats();
+    }
+  }
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::Init init(&argc, &argv, false);
+  folly::EventBase eventBase;
+  proxygen::URL url(FLAGS_connect_url);
+  if (!url.hasHost() || !url.isValid()) {
+    XLOGF(ERR, "Invalid url: {}", FLAGS_connect_url);
+    return 1;
+  }
+  auto inputs = readInputs(FLAGS_inputs_file);
+  if (inputs.empty()) {
+    XLOGF(ERR, "No usable inputs in {}", FLAGS_inputs_file);
+    return 1;
+  }
+  auto numSessions = std::clamp<size_t>(FLAGS_num_sessions, 1, inputs.size());
+  XLOGF(
+      INFO,
+      "Publishing {} channels over {} sessions, {} parser threads",
+      inputs.size(),
+      numSessions,
+      FLAGS_parser_threads);
+
+  std::vector<std::shared_ptr<UpstreamSession>> sessions;
+  for (size_t i = 0; i < numSessions; i++) {
+    sessions.emplace_back(std::make_shared<UpstreamSession>(&eventBase, url));
+  }
+  for (size_t i = 0; i < inputs.size(); i++) {
+    sessions[i % numSessions]->addChannel(std::make_shared<FlvChannel>(
+        &eventBase, std::move(inputs[i].first), std::move(inputs[i].second)));
+  }
+  folly::CPUThreadPoolExecutor parserPool(
+      std::max(FLAGS_parser_threads, 1),
+      std::make_shared<folly::NamedThreadFactory>("FlvParser"));
+
+  class SigHandler : public folly::AsyncSignalHandler {
+   public:
+    explicit SigHandler(folly::EventBase* evb, std::function<void(int)> fn)
+        : folly::AsyncSignalHandler(evb), fn_(std::move(fn)) {
+      registerSignalHandler(SIGTERM);
+      registerSignalHandler(SIGINT);
+    }
+    void signalReceived(int signum) noexcept override {
+      XLOG(INFO) << __func__ << " signum=" << signum;
+      fn_(signum);
+      unreg();
+    }
+
+    void unreg() {
+      unregisterSignalHandler(SIGTERM);
+      unregisterSignalHandler(SIGINT);
+    }
+
+   private:
+    std::function<void(int)> fn_;
+  };
+
+  folly::CancellationSource statsCancel;
+  SigHandler handler(&eventBase, [&sessions, &statsCancel](int) mutable {
+    statsCancel.requestCancellation();
+    for (auto& session : sessions) {
+      session->stop();
+    }
+  });
+
+  for (auto& session : sessions) {
+    session->run(folly::getKeepAliveToken(parserPool))
+        .scheduleOn(&eventBase)
+        .start();
+  }
+  if (FLAGS_stats_interval > 0) {
+    folly::coro::co_withCancellation(
+        statsCancel.getToken(), statsLoop(sessions))
+        .scheduleOn(&eventBase)
+        .start();
+  }
+  if (!eventBase.loop()) {
+    return 1;
+  }
+  return 0;
+}
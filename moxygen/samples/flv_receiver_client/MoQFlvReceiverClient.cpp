@@ -11,6 +11,7 @@
 #include <folly/init/Init.h>
 #include <folly/io/async/AsyncSignalHandler.h>
 #include <signal.h>
+#include "moxygen/cmaf/CmafMuxer.h"
 #include "moxygen/dejitter/DeJitter.h"
 #include "moxygen/flv_parser/FlvWriter.h"
 #include "moxygen/moq_mi/MoQMi.h"
@@ -23,6 +24,11 @@ DEFINE_string(
     flv_outpath,
     "",
     "File name to save the received FLV file to (ex: /tmp/test.flv)");
+DEFINE_string(
+    fmp4_outpath,
+    "",
+    "File name to save the received media as fragmented MP4 (CMAF) instead "
+    "of FLV (ex: /tmp/test.mp4)");
 DEFINE_string(track_namespace, "flvstreamer", "Track Namespace");
 DEFINE_string(track_namespace_delimiter, "/", "Track Namespace Delimiter");
 DEFINE_string(video_track_name, "video0", "Video track Name");
@@ -36,6 +42,11 @@ DEFINE_int32(
 DEFINE_bool(quic_transport, false, "Use raw QUIC transport");
 DEFINE_bool(fetch, false, "Use fetch rather than subscribe");
 DEFINE_string(auth, "secret", "MOQ subscription auth string");
+DEFINE_int32(
+    catch_up_max_group_lag,
+    -1,
+    "Abandon subgroups that trail the newest group by more than this many "
+    "groups (-1 disables catch-up mode)");
 
 namespace {
 using namespace moxygen;
@@ -154,6 +165,47 @@ class FlvWriterShared : flv::FlvWriter {
   bool firstIDRWritten_{false};
 };
 
+// Muxes MoQMi payloads straight into fragmented MP4, one media segment per
+// video group, without going through FLV tags
+class CmafWriterShared {
+ public:
+  explicit CmafWriterShared(const std::string& outPath)
+      : f_(outPath, std::ofstream::binary),
+        muxer_(
+            cmaf::CmafMuxer::Config(),
+            [this](std::unique_ptr<folly::IOBuf> segment, bool init) {
+              writeSegment(std::move(segment), init);
+            }) {}
+
+  ~CmafWriterShared() {
+    std::lock_guard<std::mutex> g(mutex_);
+    muxer_.flush();
+    f_.close();
+  }
+
+  bool writeMoqMiPayload(MoQMi::MoqMiTag moqMiTag) {
+    if (moqMiTag.index() == MoQMi::MoqMITagTypeIndex::MOQMI_TAG_INDEX_READCMD) {
+      return false;
+    }
+    std::lock_guard<std::mutex> g(mutex_);
+    muxer_.add(std::move(moqMiTag));
+    return f_.good();
+  }
+
+ private:
+  void writeSegment(std::unique_ptr<folly::IOBuf> segment, bool init) {
+    XLOG(DBG1) << "Writing " << (init ? "init" : "media")
+               << " segment, size: " << segment->computeChainDataLength();
+    for (auto range : *segment) {
+      f_.write(reinterpret_cast<const char*>(range.data()), range.size());
+    }
+  }
+
+  std::ofstream f_;
+  std::mutex mutex_;
+  cmaf::CmafMuxer muxer_;
+};
+
 class TrackReceiverHandler : public ObjectReceiverCallback {
  public:
   explicit TrackReceiverHandler(
@@ -231,9 +283,10 @@ class TrackReceiverHandler : public ObjectReceiverCallback {
         }
       }
 
-      if (flvw_ && std::get<0>(deJitterData).has_value()) {
-        if (flvw_->writeMoqMiPayload(
-                std::move(std::get<0>(deJitterData).value()))) {
+      if ((flvw_ || cmafw_) && std::get<0>(deJitterData).has_value()) {
+        auto moqMiTag = std::move(std::get<0>(deJitterData).value());
+        if (flvw_ ? flvw_->writeMoqMiPayload(std::move(moqMiTag))
+                  : cmafw_->writeMoqMiPayload(std::move(moqMiTag))) {
           XLOG(DBG1) << trackMediaType_.toStr() << " Wrote payload to output";
         } else {
           XLOG(WARNING) << trackMediaType_.toStr() << " Payload write failed";
@@ -255,6 +308,11 @@ class TrackReceiverHandler : public ObjectReceiverCallback {
   void onSubscribeDone(SubscribeDone) override {
     baton.post();
   }
+  void onSubgroupSkipped(uint64_t groupID, uint64_t subgroupID, uint64_t live)
+      override {
+    XLOG(WARN) << trackMediaType_.toStr() << " Skipped stale group=" << groupID
+               << " subgroup=" << subgroupID << " live=" << live;
+  }
 
   folly::coro::Baton baton;
 
@@ -262,6 +320,10 @@ class TrackReceiverHandler : public ObjectReceiverCallback {
     flvw_ = flvw;
   }
 
+  void setCmafWriterShared(std::shared_ptr<CmafWriterShared> cmafw) {
+    cmafw_ = std::move(cmafw);
+  }
+
  private:
   void logData(const MoQMi::MoqMiTag& payloadDecodedData) const {
     if (payloadDecodedData.index() ==
@@ -330,6 +392,7 @@ class TrackReceiverHandler : public ObjectReceiverCallback {
   }
 
   std::shared_ptr<FlvWriterShared> flvw_;
+  std::shared_ptr<CmafWriterShared> cmafw_;
   TrackType trackMediaType_;
   std::unique_ptr<dejitter::DeJitter<MoQMi::MoqMiTag>> deJitter_;
   uint32_t dejitterBufferSizeMs_;
@@ -343,13 +406,15 @@ class MoQFlvReceiverClient
       folly::EventBase* evb,
       proxygen::URL url,
       bool useQuic,
-      const std::string& flvOutPath)
+      const std::string& flvOutPath,
+      const std::string& fmp4OutPath)
       : moqClient_(
             evb,
             std::move(url),
             (useQuic ? MoQClient::TransportType::QUIC
                      : MoQClient::TransportType::H3_WEBTRANSPORT)),
-        flvOutPath_(flvOutPath) {}
+        flvOutPath_(flvOutPath),
+        fmp4OutPath_(fmp4OutPath) {}
 
   folly::coro::Task<void> run(
       SubscribeRequest subAudio,
@@ -364,13 +429,23 @@ class MoQFlvReceiverClient
           /*publishHandler=*/nullptr,
           /*subscribeHandler=*/shared_from_this());
       // Create output file
-      flvw_ = std::make_shared<FlvWriterShared>(flvOutPath_);
-      trackReceiverHandlerAudio_.setFlvWriterShared(flvw_);
-      trackReceiverHandlerVideo_.setFlvWriterShared(flvw_);
+      if (!fmp4OutPath_.empty()) {
+        cmafw_ = std::make_shared<CmafWriterShared>(fmp4OutPath_);
+        trackReceiverHandlerAudio_.setCmafWriterShared(cmafw_);
+        trackReceiverHandlerVideo_.setCmafWriterShared(cmafw_);
+      } else {
+        flvw_ = std::make_shared<FlvWriterShared>(flvOutPath_);
+        trackReceiverHandlerAudio_.setFlvWriterShared(flvw_);
+        trackReceiverHandlerVideo_.setFlvWriterShared(flvw_);
+      }
 
       // Subscribe to audio
       subRxHandlerAudio_ = std::make_shared<ObjectReceiver>(
           ObjectReceiver::SUBSCRIBE, &trackReceiverHandlerAudio_);
+      if (FLAGS_catch_up_max_group_lag >= 0) {
+        subRxHandlerAudio_->setCatchUpPolicy(
+            {.maxGroupLag = uint64_t(FLAGS_catch_up_max_group_lag)});
+      }
       auto trackAudio = co_await moqClient_.moqSession_->subscribe(
           subAudio, subRxHandlerAudio_);
       if (trackAudio.hasValue()) {
@@ -392,6 +467,10 @@ class MoQFlvReceiverClient
       // Subscribe to video
       subRxHandlerVideo_ = std::make_shared<ObjectReceiver>(
           ObjectReceiver::SUBSCRIBE, &trackReceiverHandlerVideo_);
+      if (FLAGS_catch_up_max_group_lag >= 0) {
+        subRxHandlerVideo_->setCatchUpPolicy(
+            {.maxGroupLag = uint64_t(FLAGS_catch_up_max_group_lag)});
+      }
       auto trackVideo = co_await moqClient_.moqSession_->subscribe(
           subVideo, subRxHandlerVideo_);
       if (trackVideo.hasValue()) {
@@ -454,7 +533,9 @@ class MoQFlvReceiverClient
   std::shared_ptr<Publisher::SubscriptionHandle> audioSubscribeHandle_;
   std::shared_ptr<Publisher::SubscriptionHandle> videoSubscribeHandle_;
   std::string flvOutPath_;
+  std::string fmp4OutPath_;
   std::shared_ptr<FlvWriterShared> flvw_;
+  std::shared_ptr<CmafWriterShared> cmafw_;
   TrackReceiverHandler trackReceiverHandlerAudio_ = TrackReceiverHandler(
       TrackType::MediaType::Audio,
       FLAGS_dejitter_buffer_size_ms);
@@ -479,7 +560,11 @@ int main(int argc, char* argv[]) {
   XLOGF(INFO, "Starting consumer from URL: {}", FLAGS_connect_url);
 
   auto flvReceiverClient = std::make_shared<MoQFlvReceiverClient>(
-      &eventBase, std::move(url), FLAGS_quic_transport, FLAGS_flv_outpath);
+      &eventBase,
+      std::move(url),
+      FLAGS_quic_transport,
+      FLAGS_flv_outpath,
+      FLAGS_fmp4_outpath);
 
   class SigHandler : public folly::AsyncSignalHandler {
    public:
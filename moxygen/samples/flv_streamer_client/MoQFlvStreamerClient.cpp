@@ -4,13 +4,16 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <fcntl.h>
 #include <folly/init/Init.h>
+#include <folly/io/async/AsyncPipe.h>
 #include <folly/io/async/AsyncSignalHandler.h>
 #include <folly/portability/GFlags.h>
 #include <signal.h>
 #include <filesystem>
 #include "moxygen/MoQClient.h"
 #include "moxygen/flv_parser/FlvSequentialReader.h"
+#include "moxygen/flv_parser/FlvStreamParser.h"
 #include "moxygen/moq_mi/MoQMi.h"
 
 DEFINE_string(input_flv_file, "", "FLV input fifo file");
@@ -31,6 +34,7 @@ using namespace moxygen;
 
 class MoQFlvStreamerClient
     : public Publisher,
+      public flv::FlvStreamParser::Callback,
       public std::enable_shared_from_this<MoQFlvStreamerClient> {
  public:
   MoQFlvStreamerClient(
@@ -61,7 +65,12 @@ class MoQFlvStreamerClient
       auto annResp = co_await moqClient_.moqSession_->announce(std::move(ann));
       if (annResp.hasValue()) {
         announceHandle_ = std::move(annResp.value());
-        folly::getGlobalIOExecutor()->add([this] { publishLoop(); });
+        if (std::filesystem::is_fifo(FLAGS_input_flv_file)) {
+          startPushIngest();
+        } else {
+          // Regular files can not be polled
+          folly::getGlobalIOExecutor()->add([this] { publishLoop(); });
+        }
       } else {
         XLOG(INFO) << "Announce error trackNamespace="
                    << annResp.error().trackNamespace << " code="
@@ -77,6 +86,7 @@ class MoQFlvStreamerClient
 
   void stop() {
     XLOG(INFO) << __func__;
+    pipeReader_.reset();
     if (announceHandle_) {
       announceHandle_->unannounce();
     }
@@ -97,43 +107,7 @@ class MoQFlvStreamerClient
         XLOG(ERR) << "Error reading FLV file";
         break;
       }
-      for (auto& sub : subscriptions_) {
-        XLOG(DBG1) << "Evaluating to send item: " << item->id
-                   << ", type: " << folly::to_underlying(item->type)
-                   << ", to subID-TrackAlias: "
-                   << sub.second->subscribeOk().subscribeID << "-"
-                   << sub.second->trackAlias;
-
-        if (videoPub_ && sub.second->consumer == videoPub_.get()) {
-          if (item->data &&
-              (item->type == flv::FlvSequentialReader::MediaType::VIDEO ||
-               item->isEOF)) {
-            // Send audio data in a thread (stream per object). Clone it since
-            // we can have multiple subscribers
-            auto itemClone = item->clone();
-            moqClient_.getEventBase()->runInEventBaseThread(
-                [self(this), itemClone(std::move(itemClone))]() mutable {
-                  self->publishVideo(std::move(itemClone));
-                });
-          }
-        }
-        if (audioPub_ && sub.second->consumer == audioPub_.get()) {
-          // Audio
-          if (item->data &&
-              (item->type == flv::FlvSequentialReader::MediaType::AUDIO ||
-               item->isEOF)) {
-            // Send audio data in a thread (stream per object). Clone it since
-            // we can have multiple subscribers
-            auto itemClone = item->clone();
-            moqClient_.getEventBase()->runInEventBaseThread(
-                [self(this),
-                 trackAlias(sub.second->trackAlias),
-                 itemClone(std::move(itemClone))]() mutable {
-                  self->publishAudio(trackAlias, std::move(itemClone));
-                });
-          }
-        }
-      }
+      publishItem(*item);
       if (item->isEOF) {
         XLOG(INFO) << "FLV file EOF";
         break;
@@ -141,6 +115,92 @@ class MoQFlvStreamerClient
     }
   }
 
+  // Demuxes a FIFO on the event base, only opening it can block
+  void startPushIngest() {
+    XLOG(INFO) << __func__;
+    folly::getGlobalIOExecutor()->add([this] {
+      // Waits for a writer
+      int fd = ::open(FLAGS_input_flv_file.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0 || ::fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        XLOG(ERR) << "Error opening " << FLAGS_input_flv_file
+                  << " errno=" << errno;
+        if (fd >= 0) {
+          ::close(fd);
+        }
+        return;
+      }
+      moqClient_.getEventBase()->runInEventBaseThread([this, fd] {
+        pipeReader_ = folly::AsyncPipeReader::newReader(
+            moqClient_.getEventBase(), folly::NetworkSocket::fromFd(fd));
+        pipeReader_->setReadCB(&flvParser_);
+      });
+    });
+  }
+
+  // flv::FlvStreamParser::Callback
+  void onTag(flv::FlvTag tag) override {
+    std::unique_ptr<flv::FlvSequentialReader::MediaItem> item;
+    try {
+      item = flvTagReader_.processTag(std::move(tag));
+    } catch (const std::exception& ex) {
+      onError(folly::exceptionStr(ex).toStdString());
+      return;
+    }
+    if (!item) {
+      return;
+    }
+    publishItem(*item);
+    if (item->isEOF) {
+      XLOG(INFO) << "FLV stream EOF";
+      pipeReader_.reset();
+    }
+  }
+
+  void onError(const std::string& error) override {
+    XLOG(ERR) << "Error reading FLV stream: " << error;
+    pipeReader_.reset();
+  }
+
+  void publishItem(flv::FlvSequentialReader::MediaItem& item) {
+    for (auto& sub : subscriptions_) {
+      XLOG(DBG1) << "Evaluating to send item: " << item.id
+                 << ", type: " << folly::to_underlying(item.type)
+                 << ", to subID-TrackAlias: "
+                 << sub.second->subscribeOk().subscribeID << "-"
+                 << sub.second->trackAlias;
+
+      if (videoPub_ && sub.second->consumer == videoPub_.get()) {
+        if (item.data &&
+            (item.type == flv::FlvSequentialReader::MediaType::VIDEO ||
+             item.isEOF)) {
+          // Send audio data in a thread (stream per object). Clone it since
+          // we can have multiple subscribers
+          auto itemClone = item.clone();
+          moqClient_.getEventBase()->runInEventBaseThread(
+              [self(this), itemClone(std::move(itemClone))]() mutable {
+                self->publishVideo(std::move(itemClone));
+              });
+        }
+      }
+      if (audioPub_ && sub.second->consumer == audioPub_.get()) {
+        // Audio
+        if (item.data &&
+            (item.type == flv::FlvSequentialReader::MediaType::AUDIO ||
+             item.isEOF)) {
+          // Send audio data in a thread (stream per object). Clone it since
+          // we can have multiple subscribers
+          auto itemClone = item.clone();
+          moqClient_.getEventBase()->runInEventBaseThread(
+              [self(this),
+               trackAlias(sub.second->trackAlias),
+               itemClone(std::move(itemClone))]() mutable {
+                self->publishAudio(trackAlias, std::move(itemClone));
+              });
+        }
+      }
+    }
+  }
+
   folly::coro::Task<SubscribeResult> subscribe(
       SubscribeRequest subscribeReq,
       std::shared_ptr<TrackConsumer> consumer) override {
@@ -339,6 +399,10 @@ class MoQFlvStreamerClient
   std::shared_ptr<TrackConsumer> audioPub_;
   std::shared_ptr<TrackConsumer> videoPub_;
   std::shared_ptr<SubgroupConsumer> videoSgPub_;
+
+  flv::FlvStreamParser flvParser_{*this};
+  flv::FlvSequentialReader flvTagReader_;
+  folly::AsyncPipeReader::UniquePtr pipeReader_;
 };
 } // namespace
 
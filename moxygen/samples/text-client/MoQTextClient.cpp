@@ -23,6 +23,10 @@ DEFINE_string(eg, "", "End group");
 DEFINE_int32(connect_timeout, 1000, "Connect timeout (ms)");
 DEFINE_int32(transaction_timeout, 120, "Transaction timeout (s)");
 DEFINE_bool(quic_transport, true, "Use raw QUIC transport");
+DEFINE_string(
+    transport_profile,
+    "default",
+    "QUIC tuning: default, live, fetch or trunk");
 DEFINE_bool(fetch, false, "Use fetch rather than subscribe");
 DEFINE_bool(jfetch, false, "Joining fetch");
 
@@ -124,7 +128,14 @@ class MoQTextClient : public Subscriber,
             std::move(url),
             (FLAGS_quic_transport ? MoQClient::TransportType::QUIC
                                   : MoQClient::TransportType::H3_WEBTRANSPORT)),
-        fullTrackName_(std::move(ftn)) {}
+        fullTrackName_(std::move(ftn)) {
+    auto profile = parseTransportProfile(FLAGS_transport_profile);
+    if (profile.hasValue()) {
+      moqClient_.setTransportConfig({profile.value()});
+    } else {
+      XLOG(ERR) << profile.error();
+    }
+  }
 
   folly::coro::Task<void> run(SubscribeRequest sub) noexcept {
     XLOG(INFO) << __func__;
@@ -7,9 +7,19 @@
 #pragma once
 
 #include <moxygen/MoQFramer.h>
+#include <moxygen/util/LoopLagMonitor.h>
+#include <chrono>
 
 namespace moxygen {
 
+// How far a SUBSCRIBE or FETCH had progressed when a latency was measured
+enum class RequestPhase : uint8_t {
+  // SUBSCRIBE_OK or FETCH_OK
+  RESPONSE = 0,
+  // The first subgroup or fetch stream, or the first datagram
+  FIRST_OBJECT = 1,
+};
+
 /*
  * The stats in the MoQStatsCallback are common to both the publisher
  * and subscriber. The comments above each function describe when they're
@@ -43,10 +53,53 @@ class MoQStatsCallback {
    */
   virtual void onFetchError(FetchErrorCode errorCode) = 0;
 
+  /*
+   * Publisher: An ANNOUNCE received no response before its deadline
+   * Subscriber: A SUBSCRIBE, FETCH, SUBSCRIBE_ANNOUNCES or
+   * TRACK_STATUS_REQUEST received no response before its deadline, or the
+   * streams announced by a SUBSCRIBE_DONE (requestType = SUBSCRIBE_DONE)
+   * never arrived
+   */
+  virtual void onRequestTimeout(FrameType /*requestType*/) {}
+
+  /*
+   * Time from a SUBSCRIBE or FETCH (requestType) to reaching phase.
+   * Publisher: measured from receiving the request to sending.  forwarded
+   * is set when the application passed the request upstream, see
+   * MoQSession::markRequestForwarded.
+   * Subscriber: measured from sending the request to receiving.  forwarded
+   * is always false.
+   */
+  virtual void onRequestLatency(
+      FrameType /*requestType*/,
+      RequestPhase /*phase*/,
+      std::chrono::microseconds /*latency*/,
+      bool /*forwarded*/) {}
+
   // TODO: Add more stats
 };
 
-class MoQPublisherStatsCallback : public MoQStatsCallback {};
+class MoQPublisherStatsCallback : public MoQStatsCallback {
+ public:
+  // A subgroup could not open a stream for lack of stream credit, and was
+  // queued until credit arrives
+  virtual void onSubgroupQueued() {}
+
+  // A queued subgroup was dropped: the queue or its buffer was full, or
+  // stream credit could not be awaited
+  virtual void onPendingSubgroupDropped() {}
+};
+
+/*
+ * Per worker EventBase health, reported periodically by LoopLagMonitor on the
+ * monitored thread.
+ */
+class MoQLoopStatsCallback {
+ public:
+  virtual ~MoQLoopStatsCallback() = default;
+
+  virtual void onLoopStats(const LoopStats& stats) = 0;
+};
 
 class MoQSubscriberStatsCallback : public MoQStatsCallback {};
 
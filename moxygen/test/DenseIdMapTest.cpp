@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/DenseIdMap.h"
+#include "moxygen/MoQFramer.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+
+using IdMap = DenseIdMap<SubscribeID, int, SubscribeID::hash>;
+
+TEST(DenseIdMap, SlidingWindow) {
+  IdMap map;
+  for (uint64_t i = 0; i < 10; i++) {
+    EXPECT_TRUE(map.emplace(i, int(i)).second);
+  }
+  EXPECT_FALSE(map.emplace(3, 0).second);
+  EXPECT_EQ(map.size(), 10);
+  EXPECT_EQ(map.windowSlots(), 10);
+  EXPECT_EQ(map.find(4)->second, 4);
+
+  // Erasing the oldest IDs slides the window forward
+  EXPECT_EQ(map.erase(0), 1);
+  EXPECT_EQ(map.erase(1), 1);
+  EXPECT_EQ(map.erase(1), 0);
+  EXPECT_EQ(map.windowSlots(), 8);
+  // Holes in the middle stay
+  map.erase(map.find(5));
+  EXPECT_EQ(map.windowSlots(), 8);
+  EXPECT_EQ(map.find(5), map.end());
+  EXPECT_EQ(map.size(), 7);
+
+  std::vector<uint64_t> ids;
+  for (auto& [id, value] : map) {
+    ids.push_back(id.value);
+  }
+  EXPECT_EQ(ids, (std::vector<uint64_t>{2, 3, 4, 6, 7, 8, 9}));
+}
+
+TEST(DenseIdMap, Fallback) {
+  IdMap map;
+  map[10] = 10;
+  // Below the window and far beyond it
+  map[2] = 2;
+  map[10 + IdMap::kMaxGap + 100] = 3;
+  EXPECT_EQ(map.windowSlots(), 1);
+  EXPECT_EQ(map.fallbackSize(), 2);
+  EXPECT_EQ(map.find(2)->second, 2);
+  EXPECT_EQ(map.size(), 3);
+
+  // The window grows over an ID already in the fallback
+  for (uint64_t i = 11; i < 10 + IdMap::kMaxGap + 200; i += 50) {
+    map[i] = 1;
+  }
+  EXPECT_FALSE(map.emplace(10 + IdMap::kMaxGap + 100, 0).second);
+  EXPECT_EQ(map.find(10 + IdMap::kMaxGap + 100)->second, 3);
+
+  size_t count = 0;
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    count++;
+  }
+  EXPECT_EQ(count, map.size());
+
+  EXPECT_EQ(map.erase(2), 1);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST(DenseIdMap, PinnedIdDoesNotStretchWindow) {
+  IdMap map;
+  map[0] = -1;
+  // Every other ID is short lived
+  for (uint64_t i = 1; i < 4 * IdMap::kMaxSlots; i++) {
+    map[i] = int(i);
+    if (i > 1) {
+      EXPECT_EQ(map.erase(i - 1), 1);
+    }
+  }
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_LT(map.windowSlots(), IdMap::kMinCompactSlots);
+  // Only the pinned ID was moved out of the window
+  EXPECT_EQ(map.fallbackSize(), 1);
+  EXPECT_EQ(map.find(0)->second, -1);
+  EXPECT_EQ(
+      map.find(4 * IdMap::kMaxSlots - 1)->second,
+      int(4 * IdMap::kMaxSlots - 1));
+  EXPECT_FALSE(map.emplace(0, 0).second);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/HeavyHitters.h"
+
+#include <folly/portability/GTest.h>
+#include <folly/synchronization/Baton.h>
+#include <future>
+#include <thread>
+
+using namespace moxygen;
+
+namespace {
+FullTrackName track(const std::string& name) {
+  return FullTrackName{TrackNamespace({"live"}), name};
+}
+} // namespace
+
+TEST(HeavyHittersTest, SketchNeverUndercounts) {
+  CountMinSketch sketch(64, 4);
+  for (uint64_t key = 0; key < 1000; key++) {
+    sketch.add(key, key % 7 + 1);
+  }
+  for (uint64_t key = 0; key < 1000; key++) {
+    EXPECT_GE(sketch.estimate(key), key % 7 + 1);
+  }
+  EXPECT_EQ(sketch.add(5000, 3), sketch.estimate(5000));
+
+  CountMinSketch other(64, 4);
+  other.add(1, 100);
+  auto before = sketch.estimate(1);
+  sketch.merge(other);
+  EXPECT_EQ(sketch.estimate(1), before + 100);
+
+  sketch.decay();
+  EXPECT_GE(sketch.estimate(1), (before + 100) / 2);
+  EXPECT_LE(sketch.estimate(1), (before + 100) / 2 + 1);
+}
+
+TEST(HeavyHittersTest, TopTracks) {
+  HeavyHitters::Config config;
+  config.topK = 3;
+  HeavyHitters heavyHitters(config);
+  for (int i = 0; i < 200; i++) {
+    heavyHitters.record(
+        HeavyHitterMetric::EGRESS_BYTES, track(folly::to<std::string>(i)), 10);
+  }
+  heavyHitters.record(HeavyHitterMetric::EGRESS_BYTES, track("hot"), 100000);
+  heavyHitters.record(HeavyHitterMetric::EGRESS_BYTES, track("warm"), 50000);
+  heavyHitters.record(HeavyHitterMetric::SUBSCRIBES, track("popular"), 1);
+
+  auto top = heavyHitters.top(HeavyHitterMetric::EGRESS_BYTES);
+  ASSERT_EQ(top.size(), 3);
+  EXPECT_EQ(top[0].fullTrackName, track("hot"));
+  EXPECT_GE(top[0].estimate, 100000);
+  EXPECT_EQ(top[1].fullTrackName, track("warm"));
+
+  auto subscribes = heavyHitters.top(HeavyHitterMetric::SUBSCRIBES);
+  ASSERT_EQ(subscribes.size(), 1);
+  EXPECT_EQ(subscribes[0].fullTrackName, track("popular"));
+
+  heavyHitters.decay();
+  top = heavyHitters.top(HeavyHitterMetric::EGRESS_BYTES);
+  EXPECT_EQ(top[0].fullTrackName, track("hot"));
+  EXPECT_LT(top[0].estimate, 100000);
+}
+
+TEST(HeavyHittersTest, MergesWorkers) {
+  HeavyHitters heavyHitters;
+  folly::Baton<> recorded[2];
+  std::promise<void> done;
+  auto doneFuture = done.get_future().share();
+  auto work = [&heavyHitters, doneFuture](folly::Baton<>& baton) {
+    for (int i = 0; i < 100; i++) {
+      heavyHitters.record(HeavyHitterMetric::SUBSCRIBES, track("shared"), 1);
+    }
+    baton.post();
+    // Keep the worker's state alive until it has been merged
+    doneFuture.wait();
+  };
+  std::thread t1(work, std::ref(recorded[0]));
+  std::thread t2(work, std::ref(recorded[1]));
+  recorded[0].wait();
+  recorded[1].wait();
+  auto top = heavyHitters.top(HeavyHitterMetric::SUBSCRIBES);
+  done.set_value();
+  t1.join();
+  t2.join();
+  ASSERT_EQ(top.size(), 1);
+  EXPECT_EQ(top[0].fullTrackName, track("shared"));
+  EXPECT_EQ(top[0].estimate, 200);
+}
+
+TEST(HeavyHittersTest, DecayLetsNewTracksIn) {
+  HeavyHitters::Config config;
+  config.topK = 1;
+  HeavyHitters heavyHitters(config);
+  auto old = track("old");
+  heavyHitters.record(
+      HeavyHitterMetric::EGRESS_BYTES, old, HeavyHitters::hash(old), 100);
+  auto fresh = track("new");
+  auto freshHash = HeavyHitters::hash(fresh);
+  heavyHitters.record(HeavyHitterMetric::EGRESS_BYTES, fresh, freshHash, 50);
+  EXPECT_EQ(
+      heavyHitters.top(HeavyHitterMetric::EGRESS_BYTES)[0].fullTrackName, old);
+
+  // Three decays leave the old track at 12 or 13 and the new one at 7
+  for (int i = 0; i < 3; i++) {
+    heavyHitters.decay();
+  }
+  heavyHitters.record(HeavyHitterMetric::EGRESS_BYTES, fresh, freshHash, 10);
+  auto top = heavyHitters.top(HeavyHitterMetric::EGRESS_BYTES);
+  ASSERT_EQ(top.size(), 1);
+  EXPECT_EQ(top[0].fullTrackName, fresh);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/HybridTrackPublisher.h"
+#include "moxygen/test/Mocks.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+using testing::_;
+using testing::Return;
+
+namespace {
+
+ObjectHeader makeHeader(uint64_t group, uint64_t id, uint8_t priority = 0) {
+  return ObjectHeader(TrackAlias(1), group, 0, id, priority);
+}
+
+class HybridTrackPublisherTest : public testing::Test {
+ protected:
+  std::shared_ptr<MockTrackConsumer> consumer_{
+      std::make_shared<testing::StrictMock<MockTrackConsumer>>()};
+  std::shared_ptr<MockSubgroupConsumer> subgroup_{
+      std::make_shared<testing::StrictMock<MockSubgroupConsumer>>()};
+};
+
+} // namespace
+
+TEST_F(HybridTrackPublisherTest, SmallObjectsUseDatagrams) {
+  HybridTrackPublisher publisher(consumer_);
+  EXPECT_CALL(*consumer_, datagram(_, _))
+      .WillOnce(Return(folly::unit))
+      .WillOnce(Return(folly::unit));
+  auto res = publisher.publish(
+      makeHeader(0, 0), folly::IOBuf::copyBuffer(std::string(100, 'a')));
+  EXPECT_EQ(*res, HybridTrackPublisher::Delivery::DATAGRAM);
+  res = publisher.publish(makeHeader(0, 1), nullptr);
+  EXPECT_EQ(*res, HybridTrackPublisher::Delivery::DATAGRAM);
+  EXPECT_EQ(publisher.getStats().datagramObjects, 2);
+  EXPECT_EQ(publisher.getStats().datagramBytes, 100);
+}
+
+TEST_F(HybridTrackPublisherTest, LargeAndReliableObjectsUseStreams) {
+  HybridTrackPublisher::Policy policy;
+  policy.maxDatagramSize = 500;
+  policy.maxDatagramPriority = 10;
+  HybridTrackPublisher publisher(consumer_, policy);
+
+  EXPECT_CALL(*consumer_, beginSubgroup(0, 0, 0))
+      .WillOnce(Return(subgroup_));
+  EXPECT_CALL(*subgroup_, object(0, _, _, false))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*subgroup_, object(1, _, _, false))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*subgroup_, object(2, _, _, false))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*subgroup_, endOfGroup(3, _)).WillOnce(Return(folly::unit));
+
+  // Too big
+  auto res = publisher.publish(
+      makeHeader(0, 0), folly::IOBuf::copyBuffer(std::string(500, 'a')));
+  EXPECT_EQ(*res, HybridTrackPublisher::Delivery::STREAM);
+  // Must deliver
+  res = publisher.publish(
+      makeHeader(0, 1), folly::IOBuf::copyBuffer("config"), true);
+  EXPECT_EQ(*res, HybridTrackPublisher::Delivery::STREAM);
+  // Not urgent enough
+  res = publisher.publish(
+      makeHeader(0, 2, 20), folly::IOBuf::copyBuffer("late"));
+  EXPECT_EQ(*res, HybridTrackPublisher::Delivery::STREAM);
+  // Status objects
+  auto header = makeHeader(0, 3);
+  header.status = ObjectStatus::END_OF_GROUP;
+  res = publisher.publish(header, nullptr);
+  EXPECT_EQ(*res, HybridTrackPublisher::Delivery::STREAM);
+
+  EXPECT_EQ(publisher.getStats().streamObjects, 4);
+  EXPECT_EQ(publisher.getStats().oversizeObjects, 1);
+  EXPECT_EQ(publisher.getStats().subgroupsOpened, 1);
+}
+
+TEST_F(HybridTrackPublisherTest, NewGroupEndsOpenSubgroup) {
+  HybridTrackPublisher publisher(consumer_);
+  auto next = std::make_shared<testing::StrictMock<MockSubgroupConsumer>>();
+  EXPECT_CALL(*consumer_, beginSubgroup(0, 0, 0)).WillOnce(Return(subgroup_));
+  EXPECT_CALL(*consumer_, beginSubgroup(1, 0, 0)).WillOnce(Return(next));
+  EXPECT_CALL(*subgroup_, object(0, _, _, false))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*subgroup_, endOfSubgroup()).WillOnce(Return(folly::unit));
+  EXPECT_CALL(*next, object(0, _, _, false)).WillOnce(Return(folly::unit));
+  EXPECT_CALL(*next, endOfSubgroup()).WillOnce(Return(folly::unit));
+
+  publisher.publish(makeHeader(0, 0), folly::IOBuf::copyBuffer("a"), true);
+  publisher.publish(makeHeader(1, 0), folly::IOBuf::copyBuffer("b"), true);
+  EXPECT_TRUE(publisher.endOfSubgroup().hasValue());
+  EXPECT_EQ(publisher.getStats().subgroupsOpened, 2);
+}
+
+TEST_F(HybridTrackPublisherTest, BlockedStream) {
+  HybridTrackPublisher publisher(consumer_);
+  EXPECT_CALL(*consumer_, beginSubgroup(0, 0, 0))
+      .WillOnce(Return(folly::makeUnexpected(
+          MoQPublishError(MoQPublishError::BLOCKED))));
+  auto res =
+      publisher.publish(makeHeader(0, 0), folly::IOBuf::copyBuffer("a"), true);
+  ASSERT_TRUE(res.hasError());
+  EXPECT_EQ(res.error().code, MoQPublishError::BLOCKED);
+  EXPECT_EQ(publisher.getStats().streamObjects, 0);
+}
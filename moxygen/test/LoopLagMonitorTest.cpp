@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/LoopLagMonitor.h"
+#include "moxygen/stats/MoQStats.h"
+
+#include <folly/Utility.h>
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+using namespace std::chrono_literals;
+
+namespace {
+
+class FakeLoopStatsCallback : public MoQLoopStatsCallback {
+ public:
+  void onLoopStats(const LoopStats& loopStats) override {
+    stats.push_back(loopStats);
+    if (onStats) {
+      onStats();
+    }
+  }
+
+  std::vector<LoopStats> stats;
+  std::function<void()> onStats;
+};
+
+// Keeps the loop busy for at least d
+void spin(std::chrono::milliseconds d) {
+  auto end = std::chrono::steady_clock::now() + d;
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+std::chrono::microseconds busy(
+    const LoopStats& stats,
+    LoopSubsystem subsystem) {
+  return stats.subsystemBusy[folly::to_underlying(subsystem)];
+}
+
+class LoopLagMonitorTest : public testing::Test {
+ protected:
+  void start(LoopLagMonitor::Config config) {
+    monitor_ = std::make_unique<LoopLagMonitor>(&evb_, config, callback_);
+  }
+
+  // Runs the loop until the first report
+  const LoopStats& firstReport() {
+    callback_->onStats = [this] { evb_.terminateLoopSoon(); };
+    evb_.loopForever();
+    EXPECT_FALSE(callback_->stats.empty());
+    return callback_->stats.front();
+  }
+
+  folly::EventBase evb_;
+  std::shared_ptr<FakeLoopStatsCallback> callback_{
+      std::make_shared<FakeLoopStatsCallback>()};
+  std::unique_ptr<LoopLagMonitor> monitor_;
+};
+
+} // namespace
+
+TEST_F(LoopLagMonitorTest, NestedScopesAreExclusive) {
+  start({.probeInterval = 10ms,
+         .reportInterval = 200ms,
+         .slowLoopThreshold = 20ms});
+  evb_.runInEventBaseThread([] {
+    MOQ_LOOP_SCOPE(RELAY);
+    spin(5ms);
+    {
+      MOQ_LOOP_SCOPE(FORWARD);
+      spin(40ms);
+    }
+    spin(5ms);
+  });
+  const auto& stats = firstReport();
+  EXPECT_EQ(stats.evb, &evb_);
+  EXPECT_GE(busy(stats, LoopSubsystem::FORWARD), 40ms);
+  EXPECT_GE(busy(stats, LoopSubsystem::RELAY), 10ms);
+  // Charged with the nested FORWARD time it would pass it
+  EXPECT_LT(
+      busy(stats, LoopSubsystem::RELAY), busy(stats, LoopSubsystem::FORWARD));
+  EXPECT_EQ(busy(stats, LoopSubsystem::DATA_PARSE), 0us);
+
+  // The busy iteration is the longest, and mostly forwarding
+  EXPECT_GE(stats.maxLoopBusy, 50ms);
+  EXPECT_EQ(stats.maxLoopSubsystem, LoopSubsystem::FORWARD);
+  EXPECT_GT(stats.loops, 1);
+  EXPECT_GE(stats.totalBusy, stats.maxLoopBusy);
+  EXPECT_EQ(stats.slowLoops, 1);
+}
+
+TEST_F(LoopLagMonitorTest, UnmarkedTimeIsOther) {
+  start({.probeInterval = 10ms,
+         .reportInterval = 200ms,
+         .slowLoopThreshold = 20ms});
+  evb_.runInEventBaseThread([] {
+    {
+      MOQ_LOOP_SCOPE(CONTROL_PARSE);
+      spin(5ms);
+    }
+    spin(30ms);
+  });
+  const auto& stats = firstReport();
+  EXPECT_GE(busy(stats, LoopSubsystem::CONTROL_PARSE), 5ms);
+  EXPECT_GE(busy(stats, LoopSubsystem::OTHER), 30ms);
+  EXPECT_EQ(stats.maxLoopSubsystem, LoopSubsystem::OTHER);
+}
+
+TEST_F(LoopLagMonitorTest, SchedulingDelay) {
+  start({.probeInterval = 10ms,
+         .reportInterval = 200ms,
+         .slowLoopThreshold = 20ms});
+  // Holds the loop past the pending probe's deadline
+  evb_.runAfterDelay([] { spin(50ms); }, 5);
+  const auto& stats = firstReport();
+  EXPECT_GE(stats.lagSamples, 2);
+  EXPECT_GE(stats.maxSchedulingDelay, 30ms);
+  EXPECT_GE(stats.totalSchedulingDelay, stats.maxSchedulingDelay);
+  EXPECT_GE(stats.slowLoops, 1);
+}
+
+TEST_F(LoopLagMonitorTest, ReportsEveryInterval) {
+  start({.probeInterval = 10ms,
+         .reportInterval = 50ms,
+         .slowLoopThreshold = 20ms});
+  evb_.runInEventBaseThread([] { spin(30ms); });
+  callback_->onStats = [this] {
+    if (callback_->stats.size() == 3) {
+      evb_.terminateLoopSoon();
+    }
+  };
+  evb_.loopForever();
+  ASSERT_EQ(callback_->stats.size(), 3);
+  for (const auto& stats : callback_->stats) {
+    EXPECT_EQ(stats.evb, &evb_);
+    EXPECT_GE(stats.interval, 50ms);
+    EXPECT_GT(stats.lagSamples, 0);
+  }
+  // Each report starts from zero
+  EXPECT_EQ(callback_->stats[0].slowLoops, 1);
+  EXPECT_EQ(callback_->stats[1].slowLoops, 0);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/MemoryAccounting.h"
+
+#include <folly/Utility.h>
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+
+namespace {
+
+const MemSubsystemStats& codecStats(const MemStats& stats) {
+  return stats.subsystems[folly::to_underlying(MemSubsystem::CODEC)];
+}
+
+} // namespace
+
+TEST(MemoryAccountingTest, ScopesChargeSubsystem) {
+  MemoryAccounting::setEnabled(false);
+  auto before = MemoryAccounting::snapshot();
+  {
+    MOQ_MEM_SCOPE(CODEC);
+  }
+  EXPECT_EQ(
+      codecStats(MemoryAccounting::snapshot()).scopes,
+      codecStats(before).scopes);
+
+  MemoryAccounting::setEnabled(true);
+  std::vector<std::unique_ptr<char[]>> blocks;
+  {
+    MOQ_MEM_SCOPE(CODEC);
+    {
+      // Exclusive of nested scopes
+      MOQ_MEM_SCOPE(CACHE);
+    }
+    for (int i = 0; i < 16; i++) {
+      blocks.emplace_back(new char[4096]);
+    }
+  }
+  MemoryAccounting::setEnabled(false);
+  auto after = MemoryAccounting::snapshot();
+  EXPECT_EQ(codecStats(after).scopes, codecStats(before).scopes + 1);
+  if (after.jemalloc) {
+    EXPECT_GE(
+        codecStats(after).allocatedBytes - codecStats(before).allocatedBytes,
+        16 * 4096);
+  } else {
+    EXPECT_EQ(codecStats(after).allocatedBytes, 0);
+  }
+}
+
+TEST(MemoryAccountingTest, ThreadArena) {
+  auto arena = MemoryAccounting::bindThreadArena();
+  EXPECT_EQ(arena.hasValue(), MemoryAccounting::usingJemalloc());
+  if (arena.hasValue()) {
+    auto stats = MemoryAccounting::arenaStats();
+    ASSERT_FALSE(stats.empty());
+    EXPECT_EQ(stats.back().arena, arena.value());
+  }
+}
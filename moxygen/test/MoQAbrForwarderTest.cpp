@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/relay/MoQAbrForwarder.h"
+#include "moxygen/test/Mocks.h"
+
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/GTest.h>
+#include <proxygen/lib/http/webtransport/test/FakeSharedWebTransport.h>
+#include <deque>
+
+using namespace moxygen;
+using testing::_;
+using testing::Return;
+
+namespace {
+
+const FullTrackName kAbrTrack{TrackNamespace({"live"}), "abr"};
+
+// With a 1ms srtt the estimate is cwnd * 8000 bits/s, and the default
+// headroom leaves 80% of it for the rendition
+constexpr uint64_t kLowCwnd = 100;
+constexpr uint64_t kMidCwnd = 500;
+constexpr uint64_t kHighCwnd = 1000;
+
+class MoQAbrForwarderTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    forwarder_ = std::make_shared<MoQAbrForwarder>(
+        kAbrTrack,
+        std::vector<MoQAbrForwarder::Rendition>{
+            {{kAbrTrack.trackNamespace, "high"}, 6000000},
+            {{kAbrTrack.trackNamespace, "low"}, 500000},
+            {{kAbrTrack.trackNamespace, "mid"}, 3000000}});
+    for (size_t i = 0; i < forwarder_->renditions().size(); i++) {
+      renditions_.push_back(forwarder_->renditionConsumer(i));
+    }
+  }
+
+  struct TestSubscriber {
+    std::unique_ptr<proxygen::test::FakeSharedWebTransport> wt;
+    std::shared_ptr<MoQSession> session;
+    std::shared_ptr<testing::StrictMock<MockTrackConsumer>> consumer;
+    std::shared_ptr<uint64_t> cwnd;
+    std::shared_ptr<MoQAbrForwarder::Subscriber> handle;
+  };
+
+  TestSubscriber& addSubscriber(uint64_t cwnd) {
+    auto& sub = subscribers_.emplace_back();
+    sub.wt = std::make_unique<proxygen::test::FakeSharedWebTransport>();
+    sub.session = std::make_shared<MoQSession>(sub.wt.get(), &evb_);
+    sub.cwnd = std::make_shared<uint64_t>(cwnd);
+    sub.session->setTransportMetricsProvider([cwnd = sub.cwnd] {
+      TransportMetrics metrics;
+      metrics.srtt = std::chrono::milliseconds(1);
+      metrics.congestionWindow = *cwnd;
+      return folly::Optional<TransportMetrics>(metrics);
+    });
+    sub.consumer = std::make_shared<testing::StrictMock<MockTrackConsumer>>();
+    SubscribeRequest subReq;
+    subReq.subscribeID = SubscribeID(subscribers_.size());
+    subReq.fullTrackName = kAbrTrack;
+    subReq.groupOrder = GroupOrder::OldestFirst;
+    sub.handle = forwarder_->addSubscriber(
+        sub.session,
+        subReq,
+        sub.consumer,
+        GroupOrder::OldestFirst,
+        folly::none);
+    return sub;
+  }
+
+  // Rendition i starts group with priority i, so expectations can tell
+  // which rendition a subscriber got
+  void beginGroup(size_t rendition, uint64_t group) {
+    auto res =
+        renditions_[rendition]->beginSubgroup(group, 0, Priority(rendition));
+    ASSERT_TRUE(res.hasValue());
+  }
+
+  void beginGroupAll(uint64_t group, std::vector<size_t> order = {0, 1, 2}) {
+    for (auto rendition : order) {
+      beginGroup(rendition, group);
+    }
+  }
+
+  void expectGroup(TestSubscriber& sub, uint64_t group, size_t rendition) {
+    EXPECT_CALL(*sub.consumer, beginSubgroup(group, 0, Priority(rendition)))
+        .WillOnce(Return(std::make_shared<
+                         testing::NiceMock<MockSubgroupConsumer>>()));
+  }
+
+  folly::EventBase evb_;
+  std::shared_ptr<MoQAbrForwarder> forwarder_;
+  std::vector<std::shared_ptr<TrackConsumer>> renditions_;
+  std::deque<TestSubscriber> subscribers_;
+};
+
+} // namespace
+
+TEST_F(MoQAbrForwarderTest, InitialPick) {
+  EXPECT_EQ(forwarder_->renditions()[0].fullTrackName.trackName, "low");
+  auto& low = addSubscriber(kLowCwnd);
+  auto& high = addSubscriber(kHighCwnd);
+  expectGroup(low, 0, 0);
+  // Starts at the best fit, not one step at a time
+  expectGroup(high, 0, 2);
+  beginGroupAll(0);
+  EXPECT_EQ(low.handle->rendition, 0);
+  EXPECT_EQ(high.handle->rendition, 2);
+  EXPECT_EQ(high.handle->switches, 0);
+}
+
+TEST_F(MoQAbrForwarderTest, UpswitchOneRenditionPerGroup) {
+  auto& sub = addSubscriber(kLowCwnd);
+  expectGroup(sub, 0, 0);
+  beginGroupAll(0);
+
+  *sub.cwnd = kHighCwnd;
+  expectGroup(sub, 1, 1);
+  beginGroupAll(1);
+  expectGroup(sub, 2, 2);
+  beginGroupAll(2);
+  EXPECT_EQ(sub.handle->switches, 2);
+}
+
+TEST_F(MoQAbrForwarderTest, DownswitchOnCongestion) {
+  auto& sub = addSubscriber(kHighCwnd);
+  expectGroup(sub, 0, 2);
+  beginGroupAll(0);
+
+  // Drops straight to the rendition that fits, even when the current one
+  // starts the group first
+  *sub.cwnd = kLowCwnd;
+  expectGroup(sub, 1, 0);
+  beginGroupAll(1, {2, 1, 0});
+  EXPECT_EQ(sub.handle->rendition, 0);
+  EXPECT_EQ(sub.handle->switches, 1);
+
+  *sub.cwnd = kMidCwnd;
+  expectGroup(sub, 2, 1);
+  beginGroupAll(2);
+}
+
+TEST_F(MoQAbrForwarderTest, NeverJoinsStartedGroup) {
+  // The high rendition started group 0 before the subscriber arrived
+  beginGroup(2, 0);
+  auto& sub = addSubscriber(kHighCwnd);
+  expectGroup(sub, 0, 1);
+  beginGroup(0, 0);
+  beginGroup(1, 0);
+
+  expectGroup(sub, 1, 2);
+  beginGroupAll(1);
+}
+
+TEST_F(MoQAbrForwarderTest, RenditionRemoval) {
+  auto& sub = addSubscriber(kHighCwnd);
+  expectGroup(sub, 0, 2);
+  beginGroupAll(0);
+
+  SubscribeDone subDone{
+      SubscribeID(0),
+      SubscribeDoneStatusCode::TRACK_ENDED,
+      0,
+      "",
+      folly::none};
+  renditions_[2]->subscribeDone(subDone);
+  expectGroup(sub, 1, 1);
+  beginGroup(0, 1);
+  beginGroup(1, 1);
+
+  renditions_[1]->subscribeDone(subDone);
+  expectGroup(sub, 2, 0);
+  beginGroup(0, 2);
+
+  // The subscriber is done once every rendition is
+  EXPECT_CALL(*sub.consumer, subscribeDone(_))
+      .WillOnce(Return(folly::unit));
+  renditions_[0]->subscribeDone(subDone);
+  EXPECT_TRUE(forwarder_->empty());
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/MoQAuthorizer.h"
+
+#include <folly/coro/BlockingWait.h>
+#include <folly/coro/Collect.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+
+namespace {
+
+const std::string kKey = "secret";
+
+AuthGrant makeGrant(std::vector<std::string> scope, uint8_t actions) {
+  return AuthGrant{
+      TrackNamespace(std::move(scope)),
+      actions,
+      std::chrono::system_clock::now() + std::chrono::hours(1)};
+}
+
+std::vector<TrackRequestParameter> authParams(std::string token) {
+  return {
+      {{folly::to_underlying(TrackRequestParamKey::AUTHORIZATION),
+        std::move(token),
+        0}}};
+}
+
+class CountingVerifier : public MoQTokenVerifier {
+ public:
+  explicit CountingVerifier(bool expensive) : expensive_(expensive) {}
+
+  folly::Expected<AuthGrant, std::string> verify(
+      const std::string& token) override {
+    calls++;
+    if (fail) {
+      throw std::runtime_error("verifier unavailable");
+    }
+    return inner_.verify(token);
+  }
+
+  bool expensive() const override {
+    return expensive_;
+  }
+
+  std::atomic<int> calls{0};
+  std::atomic<bool> fail{false};
+
+ private:
+  HmacTokenVerifier inner_{kKey};
+  bool expensive_;
+};
+
+} // namespace
+
+TEST(HmacTokenVerifierTest, SignVerify) {
+  HmacTokenVerifier verifier(kKey);
+  auto grant = makeGrant({"live", "sports"}, 0x3);
+  auto token = HmacTokenVerifier::sign(kKey, grant);
+  auto res = verifier.verify(token);
+  ASSERT_TRUE(res.hasValue());
+  EXPECT_EQ(res->scope, grant.scope);
+  EXPECT_EQ(res->actions, 0x3);
+  auto now = std::chrono::system_clock::now();
+  EXPECT_TRUE(res->allows(
+      TrackNamespace({"live", "sports", "a"}), AuthAction::FETCH, now));
+  EXPECT_FALSE(
+      res->allows(TrackNamespace({"live", "news"}), AuthAction::FETCH, now));
+  EXPECT_FALSE(res->allows(
+      TrackNamespace({"live", "sports"}), AuthAction::ANNOUNCE, now));
+  EXPECT_FALSE(res->allows(
+      TrackNamespace({"live", "sports"}),
+      AuthAction::SUBSCRIBE,
+      now + std::chrono::hours(2)));
+
+  EXPECT_TRUE(HmacTokenVerifier("other").verify(token).hasError());
+  token[0] = 'L';
+  EXPECT_TRUE(verifier.verify(token).hasError());
+  EXPECT_TRUE(verifier.verify("garbage").hasError());
+}
+
+TEST(MoQAuthorizerTest, CachesVerification) {
+  auto verifier = std::make_shared<CountingVerifier>(false);
+  MoQAuthorizer authorizer(verifier);
+  auto params = authParams(
+      HmacTokenVerifier::sign(kKey, makeGrant({"live"}, 0x1)));
+  TrackNamespace ns({"live", "a"});
+  for (int i = 0; i < 3; i++) {
+    auto res = folly::coro::blockingWait(
+        authorizer.authorize(params, ns, AuthAction::SUBSCRIBE));
+    EXPECT_TRUE(res.hasValue());
+  }
+  auto res = folly::coro::blockingWait(
+      authorizer.authorize(params, ns, AuthAction::ANNOUNCE));
+  EXPECT_TRUE(res.hasError());
+  EXPECT_EQ(verifier->calls, 1);
+
+  // Failures are cached too
+  auto badParams = authParams("bad|1|1|00");
+  for (int i = 0; i < 2; i++) {
+    res = folly::coro::blockingWait(
+        authorizer.authorize(badParams, ns, AuthAction::SUBSCRIBE));
+    EXPECT_TRUE(res.hasError());
+  }
+  EXPECT_EQ(verifier->calls, 2);
+
+  res = folly::coro::blockingWait(
+      authorizer.authorize({}, ns, AuthAction::SUBSCRIBE));
+  EXPECT_TRUE(res.hasError());
+}
+
+TEST(MoQAuthorizerTest, ExpensiveVerifyIsShared) {
+  auto verifier = std::make_shared<CountingVerifier>(true);
+  folly::CPUThreadPoolExecutor executor(1);
+  MoQAuthorizer authorizer(
+      verifier, MoQAuthorizer::Config(), folly::getKeepAliveToken(executor));
+  auto params = authParams(
+      HmacTokenVerifier::sign(kKey, makeGrant({"live"}, 0x1)));
+  TrackNamespace ns({"live"});
+  auto [res1, res2] = folly::coro::blockingWait(folly::coro::collectAll(
+      authorizer.authorize(params, ns, AuthAction::SUBSCRIBE),
+      authorizer.authorize(params, ns, AuthAction::SUBSCRIBE)));
+  EXPECT_TRUE(res1.hasValue());
+  EXPECT_TRUE(res2.hasValue());
+  EXPECT_EQ(verifier->calls, 1);
+}
+
+TEST(MoQAuthorizerTest, VerifierThrows) {
+  auto verifier = std::make_shared<CountingVerifier>(true);
+  verifier->fail = true;
+  folly::CPUThreadPoolExecutor executor(1);
+  MoQAuthorizer authorizer(
+      verifier, MoQAuthorizer::Config(), folly::getKeepAliveToken(executor));
+  auto params = authParams(
+      HmacTokenVerifier::sign(kKey, makeGrant({"live"}, 0x1)));
+  TrackNamespace ns({"live"});
+  // The request sharing the verification is failed too
+  auto [res1, res2] = folly::coro::blockingWait(folly::coro::collectAll(
+      authorizer.authorize(params, ns, AuthAction::SUBSCRIBE),
+      authorizer.authorize(params, ns, AuthAction::SUBSCRIBE)));
+  EXPECT_TRUE(res1.hasError());
+  EXPECT_TRUE(res2.hasError());
+  EXPECT_EQ(verifier->calls, 1);
+
+  // The failure is not cached
+  verifier->fail = false;
+  auto res = folly::coro::blockingWait(
+      authorizer.authorize(params, ns, AuthAction::SUBSCRIBE));
+  EXPECT_TRUE(res.hasValue());
+  EXPECT_EQ(verifier->calls, 2);
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/relay/MoQCacheFollower.h"
+#include "moxygen/test/Mocks.h"
+
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/GTest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace moxygen;
+using namespace std::chrono_literals;
+using testing::_;
+using testing::Return;
+
+namespace {
+
+const FullTrackName kTrack{TrackNamespace({"test"}), "track"};
+
+class MoQCacheFollowerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    config_.name = folly::to<std::string>("/moxygen-follower-", ::getpid());
+    config_.indexSlots = 64;
+    config_.dataBytes = 4096;
+    ShmObjectCache::remove(config_.name);
+    cache_ = std::move(ShmObjectCache::open(config_).value());
+    // Stops the test if the follower never finishes
+    evb_.runAfterDelay([this] { evb_.terminateLoopSoon(); }, 5000);
+  }
+
+  void TearDown() override {
+    ShmObjectCache::remove(config_.name);
+  }
+
+  // Another process takes the lease for ttl and writes objects 0 and 1 of
+  // group 5
+  void writeInChild(std::chrono::milliseconds ttl) {
+    auto pid = ::fork();
+    if (pid == 0) {
+      auto child = ShmObjectCache::open(config_);
+      if (!child.hasValue() || !child.value()->acquireLease(kTrack, ttl)) {
+        _exit(1);
+      }
+      for (uint64_t object = 0; object < 2; object++) {
+        put(*child.value(), 5, object, ObjectStatus::NORMAL);
+      }
+      child.value()->setLatestGroup(kTrack, 5);
+      _exit(0);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  static void put(
+      ShmObjectCache& cache,
+      uint64_t group,
+      uint64_t object,
+      ObjectStatus status) {
+    auto payload = folly::IOBuf::copyBuffer("data");
+    cache.put(
+        kTrack,
+        group,
+        0,
+        object,
+        status,
+        noExtensions(),
+        status == ObjectStatus::NORMAL ? payload.get() : nullptr);
+  }
+
+  std::shared_ptr<MoQCacheFollower> makeFollower() {
+    auto latest = MoQCacheFollower::latest(*cache_, kTrack);
+    return std::make_shared<MoQCacheFollower>(
+        SubscribeOk{
+            SubscribeID(1),
+            std::chrono::milliseconds(0),
+            GroupOrder::OldestFirst,
+            latest,
+            {}},
+        kTrack,
+        cache_,
+        consumer_,
+        128);
+  }
+
+  folly::EventBase evb_;
+  ShmObjectCache::Config config_;
+  std::shared_ptr<ShmObjectCache> cache_;
+  std::shared_ptr<testing::StrictMock<MockTrackConsumer>> consumer_{
+      std::make_shared<testing::StrictMock<MockTrackConsumer>>()};
+  std::shared_ptr<testing::StrictMock<MockSubgroupConsumer>> subgroup_{
+      std::make_shared<testing::StrictMock<MockSubgroupConsumer>>()};
+};
+
+} // namespace
+
+TEST_F(MoQCacheFollowerTest, FollowsWriterThenTakesLease) {
+  writeInChild(300ms);
+  auto latest = MoQCacheFollower::latest(*cache_, kTrack);
+  ASSERT_TRUE(latest.has_value());
+  EXPECT_EQ(latest->group, 5);
+  EXPECT_EQ(latest->object, 1);
+  auto follower = makeFollower();
+
+  // Written after the follower's latest
+  put(*cache_, 5, 2, ObjectStatus::NORMAL);
+  put(*cache_, 5, 3, ObjectStatus::END_OF_GROUP);
+  testing::InSequence seq;
+  EXPECT_CALL(*consumer_, beginSubgroup(5, 0, _)).WillOnce(Return(subgroup_));
+  EXPECT_CALL(*subgroup_, object(2, _, _, false))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*subgroup_, endOfGroup(3, _)).WillOnce(Return(folly::unit));
+
+  // The child's lease expires without being renewed
+  bool tookLease = false;
+  follower->start(&evb_, [&] {
+    tookLease = true;
+    evb_.terminateLoopSoon();
+  });
+  evb_.loopForever();
+  EXPECT_TRUE(tookLease);
+}
+
+TEST_F(MoQCacheFollowerTest, TrackEnds) {
+  writeInChild(10s);
+  auto follower = makeFollower();
+  put(*cache_, 5, 2, ObjectStatus::END_OF_TRACK_AND_GROUP);
+  testing::InSequence seq;
+  EXPECT_CALL(*consumer_, beginSubgroup(5, 0, _)).WillOnce(Return(subgroup_));
+  EXPECT_CALL(*subgroup_, endOfTrackAndGroup(2, _))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*consumer_, subscribeDone(_))
+      .WillOnce([this](SubscribeDone subDone) {
+        EXPECT_EQ(subDone.statusCode, SubscribeDoneStatusCode::TRACK_ENDED);
+        evb_.terminateLoopSoon();
+        return folly::unit;
+      });
+
+  bool tookLease = false;
+  follower->start(&evb_, [&] { tookLease = true; });
+  evb_.loopForever();
+  // The writer still holds the lease
+  EXPECT_FALSE(tookLease);
+}
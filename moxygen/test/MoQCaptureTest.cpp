@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/MoQCapture.h"
+
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/portability/GTest.h>
+#include <folly/testing/TestUtil.h>
+
+namespace moxygen::test {
+
+TEST(MoQCaptureTest, RoundTrip) {
+  folly::test::TemporaryFile tmp;
+  auto path = tmp.path().string();
+  {
+    MoQCaptureWriter writer(path, MoQControlCodec::Direction::CLIENT);
+    auto control = folly::IOBuf::copyBuffer("control");
+    control->appendToChain(folly::IOBuf::copyBuffer("chain"));
+    writer.onControlData(0, control.get(), false);
+    writer.onStreamData(3, nullptr, true);
+    auto datagram = folly::IOBuf::copyBuffer("dgram");
+    writer.onDatagram(datagram.get());
+  }
+
+  MoQCaptureReader reader(path);
+  EXPECT_EQ(reader.direction(), MoQControlCodec::Direction::CLIENT);
+
+  auto record = reader.next();
+  ASSERT_TRUE(record.hasValue());
+  EXPECT_EQ(record->type, CaptureRecordType::CONTROL);
+  EXPECT_EQ(record->streamID, 0);
+  EXPECT_FALSE(record->fin);
+  EXPECT_EQ(record->data->moveToFbString().toStdString(), "controlchain");
+
+  record = reader.next();
+  ASSERT_TRUE(record.hasValue());
+  EXPECT_EQ(record->type, CaptureRecordType::STREAM);
+  EXPECT_EQ(record->streamID, 3);
+  EXPECT_TRUE(record->fin);
+  EXPECT_EQ(record->data, nullptr);
+
+  record = reader.next();
+  ASSERT_TRUE(record.hasValue());
+  EXPECT_EQ(record->type, CaptureRecordType::DATAGRAM);
+  EXPECT_EQ(record->data->moveToFbString().toStdString(), "dgram");
+  EXPECT_GE(record->timestamp.count(), 0);
+
+  EXPECT_TRUE(reader.done());
+  EXPECT_EQ(reader.next().error(), ErrorCode::PARSE_UNDERFLOW);
+}
+
+TEST(MoQCaptureTest, WritesInOrderOnExecutor) {
+  folly::test::TemporaryFile tmp;
+  auto path = tmp.path().string();
+  // Enough records for several flushes
+  constexpr uint64_t kRecords = 1000;
+  auto data = folly::IOBuf::copyBuffer(std::string(1000, 'x'));
+  {
+    folly::CPUThreadPoolExecutor executor(4);
+    {
+      MoQCaptureWriter writer(
+          path,
+          MoQControlCodec::Direction::SERVER,
+          folly::getKeepAliveToken(executor));
+      for (uint64_t i = 0; i < kRecords; i++) {
+        writer.onStreamData(i, data.get(), false);
+      }
+    }
+    // Waits for the queued writes
+    executor.join();
+  }
+
+  MoQCaptureReader reader(path);
+  EXPECT_EQ(reader.direction(), MoQControlCodec::Direction::SERVER);
+  for (uint64_t i = 0; i < kRecords; i++) {
+    auto record = reader.next();
+    ASSERT_TRUE(record.hasValue());
+    EXPECT_EQ(record->streamID, i);
+    EXPECT_EQ(record->data->computeChainDataLength(), 1000);
+  }
+  EXPECT_TRUE(reader.done());
+}
+
+TEST(MoQCaptureTest, NotACapture) {
+  folly::test::TemporaryFile tmp;
+  EXPECT_THROW(
+      MoQCaptureReader reader(tmp.path().string()), std::runtime_error);
+}
+
+} // namespace moxygen::test
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/MoQClient.h"
+
+#include <folly/coro/Sleep.h>
+#include <folly/futures/ThreadWheelTimekeeper.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/GTest.h>
+#include <proxygen/lib/http/webtransport/test/FakeSharedWebTransport.h>
+#include <deque>
+
+using namespace moxygen;
+using namespace std::chrono_literals;
+
+namespace {
+
+// How a fake attempt's setup ends, and after how long
+struct Attempt {
+  std::chrono::milliseconds delay;
+  bool fail{false};
+  // Finishes setup even after the race cancelled it
+  bool ignoresCancel{false};
+};
+
+class MoQClientRaceTest : public testing::Test {
+ protected:
+  folly::Try<std::unique_ptr<MoQClient>> race(
+      std::vector<Attempt> attempts,
+      std::chrono::milliseconds attemptDelay,
+      folly::CancellationToken token = {}) {
+    MoQClient::RaceOptions options;
+    // Two addresses and two transports, no DNS
+    options.addresses = {
+        folly::SocketAddress("::1", 4433),
+        folly::SocketAddress("127.0.0.1", 4433)};
+    options.attemptDelay = attemptDelay;
+    options.setupSession = [this, attempts](MoQClient& client) {
+      return fakeSetup(client, attempts.at(started_++));
+    };
+    folly::Try<std::unique_ptr<MoQClient>> result;
+    folly::coro::co_withCancellation(
+        std::move(token),
+        folly::coro::co_invoke(
+            [&]() -> folly::coro::Task<void> {
+              result = co_await folly::coro::co_awaitTry(
+                  MoQClient::connectRacing(
+                      &evb_,
+                      proxygen::URL("https://localhost:4433/moq"),
+                      std::move(options),
+                      1s,
+                      1s,
+                      nullptr,
+                      nullptr));
+            }))
+        .scheduleOn(&evb_)
+        .start();
+    // Runs until every attempt, winners and losers, has finished
+    evb_.loop();
+    return result;
+  }
+
+  folly::coro::Task<void> fakeSetup(MoQClient& client, Attempt attempt) {
+    if (attempt.ignoresCancel) {
+      co_await folly::coro::co_withCancellation(
+          folly::CancellationToken(), folly::coro::sleep(attempt.delay, &tk_));
+    } else {
+      co_await folly::coro::sleep(attempt.delay, &tk_);
+    }
+    if (attempt.fail) {
+      co_yield folly::coro::co_error(std::runtime_error("attempt failed"));
+    }
+    auto& wt = transports_.emplace_back(
+        std::make_unique<proxygen::test::FakeSharedWebTransport>());
+    client.moqSession_ = std::make_shared<MoQSession>(wt.get(), &evb_);
+    sessions_.push_back(client.moqSession_);
+  }
+
+  folly::EventBase evb_;
+  folly::EventBaseThreadTimekeeper tk_{evb_};
+  size_t started_{0};
+  std::deque<std::unique_ptr<proxygen::test::FakeSharedWebTransport>>
+      transports_;
+  std::vector<std::shared_ptr<MoQSession>> sessions_;
+};
+
+} // namespace
+
+TEST_F(MoQClientRaceTest, FirstSetupWins) {
+  // The second attempt starts after 50ms and finishes first
+  auto result = race({{100ms}, {10ms}}, 50ms);
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_EQ(started_, 2);
+  ASSERT_EQ(sessions_.size(), 1);
+  EXPECT_EQ(result.value()->moqSession_, sessions_[0]);
+}
+
+TEST_F(MoQClientRaceTest, LosersClosed) {
+  // The first attempt finishes setup after the second won
+  auto result = race({{100ms, false, true}, {10ms}}, 50ms);
+  ASSERT_TRUE(result.hasValue());
+  ASSERT_EQ(sessions_.size(), 2);
+  EXPECT_EQ(result.value()->moqSession_, sessions_[0]);
+  EXPECT_FALSE(sessions_[0]->getCancelToken().isCancellationRequested());
+  EXPECT_TRUE(sessions_[1]->getCancelToken().isCancellationRequested());
+}
+
+TEST_F(MoQClientRaceTest, FailureStartsNextAttempt) {
+  // Neither attempt waits for the 10s delay
+  auto start = std::chrono::steady_clock::now();
+  auto result = race({{5ms, true}, {5ms}}, 10s);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_EQ(started_, 2);
+}
+
+TEST_F(MoQClientRaceTest, AllFail) {
+  auto result =
+      race({{5ms, true}, {10ms, true}, {5ms, true}, {5ms, true}}, 1ms);
+  EXPECT_EQ(started_, 4);
+  EXPECT_TRUE(sessions_.empty());
+  ASSERT_TRUE(result.hasException<std::runtime_error>());
+  EXPECT_STREQ(result.exception().get_exception()->what(), "attempt failed");
+}
+
+TEST_F(MoQClientRaceTest, CallerCancels) {
+  folly::CancellationSource cancelSource;
+  evb_.runAfterDelay([&] { cancelSource.requestCancellation(); }, 10);
+  auto start = std::chrono::steady_clock::now();
+  auto result = race({{1s}, {1s}}, 10s, cancelSource.getToken());
+  // No further attempt starts, and the running one is stopped
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 500ms);
+  EXPECT_TRUE(result.hasException<folly::OperationCancelled>());
+  EXPECT_EQ(started_, 1);
+  EXPECT_TRUE(sessions_.empty());
+}
@@ -331,6 +331,38 @@ TEST(MoQCodec, FetchHeaderUnderflow) {
   codec.onIngress(writeBuf.splitAtMost(2), true);
 }
 
+TEST(MoQCodec, FetchObjectHeaderSplit) {
+  testing::StrictMock<MockMoQCodecCallback> callback;
+  MoQObjectStreamCodec codec(&callback);
+  folly::IOBufQueue writeBuf{folly::IOBufQueue::cacheChainLength()};
+  SubscribeID subscribeId(1);
+  auto res = writeFetchHeader(writeBuf, subscribeId);
+  ObjectHeader obj(subscribeId, 2, 3, 4, 5, 5, getTestExtensions());
+  auto streamType = StreamType::FETCH_HEADER;
+  res = writeStreamObject(
+      writeBuf, streamType, obj, folly::IOBuf::copyBuffer("hello"));
+  obj.id++;
+  obj.status = ObjectStatus::OBJECT_NOT_EXIST;
+  obj.length = 0;
+  res = writeStreamObject(writeBuf, streamType, obj, nullptr);
+
+  // Every header field arrives in its own read
+  EXPECT_CALL(callback, onFetchHeader(subscribeId));
+  EXPECT_CALL(
+      callback,
+      onObjectBegin(2, 3, 4, getTestExtensions(), 5, _, false, false));
+  EXPECT_CALL(callback, onObjectPayload(_, _)).Times(strlen("hello"));
+  EXPECT_CALL(
+      callback,
+      onObjectStatus(
+          2, 3, 5, 5, ObjectStatus::OBJECT_NOT_EXIST, getTestExtensions()));
+  EXPECT_CALL(callback, onEndOfStream());
+  while (!writeBuf.empty()) {
+    codec.onIngress(writeBuf.split(1), false);
+  }
+  codec.onIngress(nullptr, true);
+}
+
 TEST(MoQCodec, InvalidFrame) {
   folly::IOBufQueue writeBuf{folly::IOBufQueue::cacheChainLength()};
   writeBuf.append(std::string(" "));
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/relay/MoQForwarder.h"
+#include "moxygen/test/Mocks.h"
+
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/GTest.h>
+#include <proxygen/lib/http/webtransport/test/FakeSharedWebTransport.h>
+
+using namespace moxygen;
+using testing::_;
+using testing::Return;
+
+namespace {
+
+const FullTrackName kTrack{TrackNamespace({"test"}), "track"};
+
+Payload makePayload() {
+  return folly::IOBuf::copyBuffer("data");
+}
+
+class MoQForwarderLiveFetchTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    forwarder_.setLiveGroupBuffer(1 << 20);
+    subgroup_ = forwarder_.beginSubgroup(5, 0, 0).value();
+    subgroup_->object(0, makePayload());
+    subgroup_->object(1, makePayload());
+  }
+
+  std::shared_ptr<Publisher::FetchHandle> fetchLive(
+      AbsoluteLocation start,
+      AbsoluteLocation end) {
+    return forwarder_.fetchLive(
+        SubscribeID(1), GroupOrder::Default, start, end, consumer_);
+  }
+
+  MoQForwarder forwarder_{kTrack};
+  std::shared_ptr<SubgroupConsumer> subgroup_;
+  std::shared_ptr<MockFetchConsumer> consumer_{
+      std::make_shared<testing::StrictMock<MockFetchConsumer>>()};
+};
+
+MoQPublishError tooFarBehind() {
+  return MoQPublishError(MoQPublishError::TOO_FAR_BEHIND, "dropped");
+}
+
+class MoQForwarderDropTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    SubscribeRequest subReq;
+    subReq.subscribeID = SubscribeID(1);
+    subReq.fullTrackName = kTrack;
+    subReq.groupOrder = GroupOrder::OldestFirst;
+    subReq.locType = LocationType::LatestObject;
+    forwarder_.addSubscriber(session_, subReq, consumer_);
+  }
+
+  std::shared_ptr<testing::StrictMock<MockSubgroupConsumer>> expectSubgroup(
+      uint64_t group) {
+    auto subgroup =
+        std::make_shared<testing::StrictMock<MockSubgroupConsumer>>();
+    EXPECT_CALL(*consumer_, beginSubgroup(group, 0, _))
+        .WillOnce(Return(subgroup));
+    return subgroup;
+  }
+
+  folly::EventBase evb_;
+  std::unique_ptr<proxygen::test::FakeSharedWebTransport> wt_{
+      std::make_unique<proxygen::test::FakeSharedWebTransport>()};
+  std::shared_ptr<MoQSession> session_{
+      std::make_shared<MoQSession>(wt_.get(), &evb_)};
+  MoQForwarder forwarder_{kTrack};
+  std::shared_ptr<testing::StrictMock<MockTrackConsumer>> consumer_{
+      std::make_shared<testing::StrictMock<MockTrackConsumer>>()};
+};
+
+} // namespace
+
+TEST_F(MoQForwarderDropTest, DroppedSubgroupsKeepSubscriber) {
+  // The session gave up waiting for stream credit to open group 1
+  EXPECT_CALL(*consumer_, beginSubgroup(1, 0, _))
+      .WillOnce(Return(folly::makeUnexpected(tooFarBehind())));
+  auto subgroup = forwarder_.beginSubgroup(1, 0, 0).value();
+  // and the rest of the subgroup is not sent on a new stream
+  subgroup->object(0, makePayload());
+  subgroup->object(1, makePayload(), noExtensions(), true);
+  EXPECT_FALSE(forwarder_.empty());
+
+  // Group 2 is dropped after it opened
+  auto group2 = expectSubgroup(2);
+  subgroup = forwarder_.beginSubgroup(2, 0, 0).value();
+  EXPECT_CALL(*group2, object(0, _, _, false))
+      .WillOnce(Return(folly::makeUnexpected(tooFarBehind())));
+  subgroup->object(0, makePayload());
+  subgroup->object(1, makePayload());
+  subgroup->endOfGroup(2);
+  EXPECT_FALSE(forwarder_.empty());
+
+  // The subscriber gets the next group
+  auto group3 = expectSubgroup(3);
+  subgroup = forwarder_.beginSubgroup(3, 0, 0).value();
+  EXPECT_CALL(*group3, object(0, _, _, false)).WillOnce(Return(folly::unit));
+  subgroup->object(0, makePayload());
+
+  // Other errors still end the subscription
+  EXPECT_CALL(*group3, object(1, _, _, false))
+      .WillOnce(Return(folly::makeUnexpected(MoQPublishError(
+          MoQPublishError::WRITE_ERROR, "write failed"))));
+  EXPECT_CALL(*group3, reset(ResetStreamErrorCode::CANCELLED));
+  EXPECT_CALL(*consumer_, subscribeDone(_)).WillOnce(Return(folly::unit));
+  subgroup->object(1, makePayload());
+  EXPECT_TRUE(forwarder_.empty());
+}
+
+TEST_F(MoQForwarderLiveFetchTest, FollowsLiveEdge) {
+  testing::InSequence seq;
+  EXPECT_CALL(*consumer_, object(5, 0, 1, _, _, _))
+      .WillOnce(Return(folly::unit));
+  auto handle = fetchLive({5, 1}, {5, 4});
+  ASSERT_NE(handle, nullptr);
+  EXPECT_EQ(handle->fetchOk().latestGroupAndObject.group, 5);
+  EXPECT_EQ(handle->fetchOk().latestGroupAndObject.object, 1);
+
+  EXPECT_CALL(*consumer_, object(5, 0, 2, _, _, _))
+      .WillOnce(Return(folly::unit));
+  subgroup_->object(2, makePayload());
+  EXPECT_CALL(*consumer_, object(5, 0, 3, _, _, _))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*consumer_, endOfFetch()).WillOnce(Return(folly::unit));
+  subgroup_->object(3, makePayload());
+  // Past the end of the fetch
+  subgroup_->object(4, makePayload());
+}
+
+TEST_F(MoQForwarderLiveFetchTest, WholeGroup) {
+  testing::InSequence seq;
+  EXPECT_CALL(*consumer_, object(5, 0, 0, _, _, _))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*consumer_, object(5, 0, 1, _, _, _))
+      .WillOnce(Return(folly::unit));
+  auto handle = fetchLive({5, 0}, {5, 0});
+  ASSERT_NE(handle, nullptr);
+  EXPECT_CALL(*consumer_, endOfGroup(5, 0, 2, _, _))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*consumer_, endOfFetch()).WillOnce(Return(folly::unit));
+  subgroup_->endOfGroup(2);
+}
+
+TEST_F(MoQForwarderLiveFetchTest, NotInLiveGroup) {
+  EXPECT_EQ(fetchLive({4, 0}, {5, 2}), nullptr);
+  forwarder_.setLiveGroupBuffer(0);
+  EXPECT_EQ(fetchLive({5, 0}, {5, 2}), nullptr);
+}
+
+TEST_F(MoQForwarderLiveFetchTest, CancelAndUpstreamDone) {
+  EXPECT_CALL(*consumer_, object(5, 0, 1, _, _, _))
+      .WillOnce(Return(folly::unit));
+  auto handle = fetchLive({5, 1}, {6, 0});
+  ASSERT_NE(handle, nullptr);
+  handle->fetchCancel();
+  // No longer delivered
+  subgroup_->object(2, makePayload());
+
+  auto consumer2 = std::make_shared<testing::StrictMock<MockFetchConsumer>>();
+  EXPECT_CALL(*consumer2, object(5, 0, 2, _, _, _))
+      .WillOnce(Return(folly::unit));
+  auto handle2 = forwarder_.fetchLive(
+      SubscribeID(2), GroupOrder::Default, {5, 2}, {6, 0}, consumer2);
+  ASSERT_NE(handle2, nullptr);
+  EXPECT_CALL(*consumer2, reset(ResetStreamErrorCode::INTERNAL_ERROR));
+  forwarder_.subscribeDone(
+      {SubscribeID(0),
+       SubscribeDoneStatusCode::GOING_AWAY,
+       0,
+       "",
+       folly::none});
+}
+
+TEST_F(MoQForwarderLiveFetchTest, ReordersSubgroups) {
+  EXPECT_CALL(*consumer_, object(5, 0, 0, _, _, _))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*consumer_, object(5, 0, 1, _, _, _))
+      .WillOnce(Return(folly::unit));
+  auto handle = fetchLive({5, 0}, {6, 0});
+  ASSERT_NE(handle, nullptr);
+
+  testing::InSequence seq;
+  auto subgroup1 = forwarder_.beginSubgroup(5, 1, 0).value();
+  // Subgroup 0 may still send object 2
+  subgroup1->object(3, makePayload());
+  EXPECT_CALL(*consumer_, object(5, 0, 2, _, _, _))
+      .WillOnce(Return(folly::unit));
+  subgroup_->object(2, makePayload());
+  EXPECT_CALL(*consumer_, object(5, 1, 3, _, _, _))
+      .WillOnce(Return(folly::unit));
+  subgroup_->object(4, makePayload());
+  // Object 4 waits for subgroup 1 to move past it or close
+  EXPECT_CALL(*consumer_, object(5, 0, 4, _, _, _))
+      .WillOnce(Return(folly::unit));
+  subgroup1->endOfSubgroup();
+}
+
+TEST_F(MoQForwarderLiveFetchTest, HeldUntilReleased) {
+  auto handle = forwarder_.fetchLive(
+      SubscribeID(1),
+      GroupOrder::Default,
+      {5, 0},
+      {5, 3},
+      consumer_,
+      /*held=*/true);
+  ASSERT_NE(handle, nullptr);
+  subgroup_->object(2, makePayload());
+
+  testing::InSequence seq;
+  EXPECT_CALL(*consumer_, object(5, 0, 0, _, _, _))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*consumer_, object(5, 0, 1, _, _, _))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*consumer_, object(5, 0, 2, _, _, _))
+      .WillOnce(Return(folly::unit));
+  EXPECT_CALL(*consumer_, endOfFetch()).WillOnce(Return(folly::unit));
+  EXPECT_FALSE(handle->release());
+}
+
+TEST(MoQForwarderLiveBufferTest, ByteCap) {
+  MoQForwarder forwarder(kTrack);
+  // Room for one 4 byte payload
+  forwarder.setLiveGroupBuffer(6);
+  auto subgroup = forwarder.beginSubgroup(5, 0, 0).value();
+  subgroup->object(0, makePayload());
+  ASSERT_TRUE(forwarder.liveBufferStart().has_value());
+  EXPECT_EQ(forwarder.liveBufferStart()->group, 5);
+  subgroup->object(1, makePayload());
+  EXPECT_FALSE(forwarder.liveBufferStart().has_value());
+
+  // The next group starts a new buffer
+  subgroup = forwarder.beginSubgroup(6, 0, 0).value();
+  subgroup->object(0, makePayload());
+  ASSERT_TRUE(forwarder.liveBufferStart().has_value());
+  EXPECT_EQ(forwarder.liveBufferStart()->group, 6);
+
+  // Disabled by default
+  MoQForwarder unbuffered(kTrack);
+  unbuffered.beginSubgroup(5, 0, 0).value()->object(0, makePayload());
+  EXPECT_FALSE(unbuffered.liveBufferStart().has_value());
+}
@@ -5,6 +5,7 @@
  */
 
 #include "moxygen/MoQFramer.h"
+#include "moxygen/MoQFramerSchema.h"
 #include <folly/portability/GTest.h>
 #include "moxygen/test/TestUtils.h"
 
@@ -547,6 +548,85 @@ TEST(FramerTests, SingleObjectStream) {
   cursor.skip(*parseResult->length);
 }
 
+TEST(FramerTests, SchemaWrite) {
+  folly::IOBufQueue writeBuf{folly::IOBufQueue::cacheChainLength()};
+  FetchError fetchError{
+      SubscribeID(1000), FetchErrorCode::NOT_SUPPORTED, "not supported"};
+  auto size = schema::FetchErrorMessage::payloadSize(fetchError);
+  ASSERT_TRUE(size.has_value());
+  auto result = writeFetchError(writeBuf, fetchError);
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_EQ(*result, *size);
+  // 1 byte frame type, 2 byte length
+  EXPECT_EQ(writeBuf.chainLength(), 3 + *size);
+
+  auto serialized = writeBuf.move();
+  folly::io::Cursor cursor(serialized.get());
+  cursor.skip(3);
+  auto parsed = parseFetchError(cursor, *size);
+  ASSERT_TRUE(parsed.hasValue());
+  EXPECT_EQ(parsed->subscribeID, fetchError.subscribeID);
+  EXPECT_EQ(parsed->errorCode, fetchError.errorCode);
+  EXPECT_EQ(parsed->reasonPhrase, fetchError.reasonPhrase);
+}
+
+TEST(FramerTests, SchemaWriteErrors) {
+  folly::IOBufQueue writeBuf{folly::IOBufQueue::cacheChainLength()};
+  // Not representable as a varint
+  EXPECT_TRUE(
+      writeUnsubscribe(writeBuf, Unsubscribe{SubscribeID(1ull << 62)})
+          .hasError());
+  // Exceeds the 2 byte control message length
+  EXPECT_TRUE(
+      writeGoaway(writeBuf, Goaway{std::string(1 << 14, 'a')}).hasError());
+  EXPECT_TRUE(writeBuf.empty());
+
+  // An absolute start needs a start location
+  SubscribeRequest subscribeRequest;
+  subscribeRequest.fullTrackName = FullTrackName({TrackNamespace({"a"}), "b"});
+  subscribeRequest.groupOrder = GroupOrder::OldestFirst;
+  subscribeRequest.locType = LocationType::AbsoluteStart;
+  EXPECT_TRUE(writeSubscribeRequest(writeBuf, subscribeRequest).hasError());
+  EXPECT_TRUE(writeBuf.empty());
+}
+
+TEST(FramerTests, SchemaConditionalFields) {
+  folly::IOBufQueue writeBuf{folly::IOBufQueue::cacheChainLength()};
+  SubscribeRequest subscribeRequest;
+  subscribeRequest.subscribeID = 1;
+  subscribeRequest.trackAlias = 2;
+  subscribeRequest.fullTrackName = FullTrackName({TrackNamespace({"a"}), "b"});
+  subscribeRequest.groupOrder = GroupOrder::NewestFirst;
+  subscribeRequest.locType = LocationType::AbsoluteRange;
+  subscribeRequest.start = AbsoluteLocation{3, 4};
+  subscribeRequest.endGroup = 5;
+  auto size = writeSubscribeRequest(writeBuf, subscribeRequest);
+  ASSERT_TRUE(size.hasValue());
+  // Default is not a valid SUBSCRIBE_OK group order
+  SubscribeOk subscribeOk{
+      1, std::chrono::milliseconds(0), GroupOrder::Default, folly::none, {}};
+  ASSERT_TRUE(writeSubscribeOk(writeBuf, subscribeOk).hasValue());
+
+  auto serialized = writeBuf.move();
+  folly::io::Cursor cursor(serialized.get());
+  cursor.skip(3);
+  auto parsed = parseSubscribeRequest(cursor, *size);
+  ASSERT_TRUE(parsed.hasValue());
+  EXPECT_EQ(parsed->trackAlias, TrackAlias(2));
+  EXPECT_EQ(parsed->fullTrackName, subscribeRequest.fullTrackName);
+  EXPECT_EQ(parsed->groupOrder, GroupOrder::NewestFirst);
+  ASSERT_TRUE(parsed->start.has_value());
+  EXPECT_EQ(parsed->start->group, 3);
+  EXPECT_EQ(parsed->start->object, 4);
+  EXPECT_EQ(parsed->endGroup, 5);
+  EXPECT_TRUE(parsed->params.empty());
+
+  cursor.skip(3);
+  auto parsedOk = parseSubscribeOk(cursor, cursor.totalLength());
+  ASSERT_TRUE(parsedOk.hasError());
+  EXPECT_EQ(parsedOk.error(), ErrorCode::INVALID_MESSAGE);
+}
+
 /* Test cases to add
  *
  * parseStreamHeader (group)
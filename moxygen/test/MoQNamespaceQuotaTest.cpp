@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/relay/MoQNamespaceQuota.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+
+namespace {
+std::shared_ptr<MoQNamespaceQuota> makeQuota(
+    MoQNamespaceQuota::Limits limits) {
+  return std::make_shared<MoQNamespaceQuota>(
+      TrackNamespace({"tenant"}), std::move(limits));
+}
+} // namespace
+
+TEST(MoQNamespaceQuotaTest, UpstreamTickets) {
+  MoQNamespaceQuota::Limits limits;
+  limits.maxUpstreamSubscriptions = 2;
+  auto quota = makeQuota(limits);
+
+  auto first = quota->acquireUpstream();
+  auto second = quota->acquireUpstream();
+  ASSERT_TRUE(first && second);
+  EXPECT_FALSE(quota->acquireUpstream());
+  EXPECT_EQ(quota->usage().upstreamSubscriptions, 2);
+  EXPECT_EQ(quota->usage().rejected, 1);
+
+  // Moving a ticket keeps the count, destroying it releases it
+  MoQNamespaceQuota::UpstreamTicket moved(std::move(*first));
+  first.reset();
+  EXPECT_EQ(quota->usage().upstreamSubscriptions, 2);
+  second.reset();
+  EXPECT_EQ(quota->usage().upstreamSubscriptions, 1);
+  EXPECT_TRUE(quota->acquireUpstream());
+}
+
+TEST(MoQNamespaceQuotaTest, Subscribers) {
+  MoQNamespaceQuota::Limits limits;
+  limits.maxSubscribers = 2;
+  auto quota = makeQuota(limits);
+
+  EXPECT_TRUE(quota->admitSubscriber());
+  quota->addSubscriber();
+  quota->addSubscriber();
+  EXPECT_FALSE(quota->admitSubscriber());
+  quota->removeSubscribers(1);
+  EXPECT_TRUE(quota->admitSubscriber());
+  EXPECT_EQ(quota->usage().subscribers, 1);
+  EXPECT_EQ(quota->usage().rejected, 1);
+}
+
+TEST(MoQNamespaceQuotaTest, EgressAndCacheRates) {
+  MoQNamespaceQuota::Limits limits;
+  limits.maxEgressBytesPerSec = 1000;
+  limits.maxCacheBytesPerSec = 1000;
+  auto quota = makeQuota(limits);
+
+  EXPECT_TRUE(quota->admitFetch());
+  quota->chargeEgress(1200);
+  EXPECT_TRUE(quota->overEgress());
+  EXPECT_FALSE(quota->admitFetch());
+  EXPECT_FALSE(quota->admitSubscriber());
+
+  EXPECT_FALSE(quota->chargeCache(1200));
+  EXPECT_TRUE(quota->chargeCache(600));
+  // Status objects carry no payload
+  EXPECT_TRUE(quota->chargeCache(0));
+
+  auto usage = quota->usage();
+  EXPECT_GE(usage.egressBytesPerSec, 1200);
+  EXPECT_EQ(usage.cacheSkipped, 1);
+  EXPECT_EQ(usage.rejected, 2);
+}
+
+TEST(MoQNamespaceQuotaTest, Unlimited) {
+  auto quota = makeQuota(MoQNamespaceQuota::Limits());
+  for (int i = 0; i < 100; i++) {
+    quota->addSubscriber();
+    quota->chargeEgress(1 << 20);
+    EXPECT_TRUE(quota->chargeCache(1 << 20));
+  }
+  EXPECT_TRUE(quota->admitSubscriber());
+  EXPECT_TRUE(quota->acquireUpstream());
+  EXPECT_EQ(quota->usage().rejected, 0);
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/relay/MoQRelay.h"
+#include "moxygen/test/Mocks.h"
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/Request.h>
+#include <folly/portability/GTest.h>
+#include <proxygen/lib/http/webtransport/test/FakeSharedWebTransport.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace moxygen;
+using testing::_;
+using testing::Return;
+
+namespace {
+
+const FullTrackName kTrack{TrackNamespace({"test"}), "track"};
+
+// A relay whose track is written to the object cache by another process.
+// The relay follows it from the cache, so its live group starts mid group 2
+// while groups 1 and 2 before that are only in the cache.
+class MoQRelaySplitFetchTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    ShmObjectCache::Config config;
+    config.name = folly::to<std::string>("/moxygen-relay-", ::getpid());
+    config.indexSlots = 256;
+    config.dataBytes = 1 << 16;
+    ShmObjectCache::remove(config.name);
+    cacheName_ = config.name;
+    cache_ = std::move(ShmObjectCache::open(config).value());
+    writeInChild(config);
+
+    relay_->setObjectCache(cache_);
+    relay_->setLiveFetchBufferBytes(1 << 20);
+    start(upstream_, [this]() -> folly::coro::Task<void> {
+      auto res =
+          co_await relay_->announce({kTrack.trackNamespace, {}}, nullptr);
+      EXPECT_TRUE(res.hasValue());
+      announced_ = true;
+    });
+    loopUntil([this] { return announced_; });
+
+    ON_CALL(*trackConsumer_, beginSubgroup(_, _, _))
+        .WillByDefault(Return(subgroup_));
+    start(downstream_, [this]() -> folly::coro::Task<void> {
+      SubscribeRequest subReq;
+      subReq.subscribeID = SubscribeID(1);
+      subReq.fullTrackName = kTrack;
+      subReq.groupOrder = GroupOrder::OldestFirst;
+      subReq.locType = LocationType::LatestObject;
+      auto res = co_await relay_->subscribe(subReq, trackConsumer_);
+      EXPECT_TRUE(res.hasValue());
+      subscription_ = std::move(res.value());
+    });
+    loopUntil([this] { return subscription_ != nullptr; });
+    EXPECT_EQ(subscription_->subscribeOk().latest->group, 2);
+    EXPECT_EQ(subscription_->subscribeOk().latest->object, 0);
+
+    // Group 2 goes on live, and the follower forwards it
+    putLive(1);
+    putLive(2);
+  }
+
+  void TearDown() override {
+    // Stops the cache follower
+    subscription_->unsubscribe();
+    evb_.loopOnce(EVLOOP_NONBLOCK);
+    ShmObjectCache::remove(cacheName_);
+  }
+
+  // Another process holds the lease and wrote group 1 and object 0 of group
+  // 2
+  void writeInChild(const ShmObjectCache::Config& config) {
+    auto pid = ::fork();
+    if (pid == 0) {
+      auto child = ShmObjectCache::open(config);
+      if (!child.hasValue() ||
+          !child.value()->acquireLease(kTrack, std::chrono::seconds(10))) {
+        _exit(1);
+      }
+      auto& cache = *child.value();
+      put(cache, 1, 0, ObjectStatus::NORMAL);
+      put(cache, 1, 1, ObjectStatus::NORMAL);
+      put(cache, 1, 2, ObjectStatus::END_OF_GROUP);
+      put(cache, 2, 0, ObjectStatus::NORMAL);
+      cache.setLatestGroup(kTrack, 2);
+      _exit(0);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  static void put(
+      ShmObjectCache& cache,
+      uint64_t group,
+      uint64_t object,
+      ObjectStatus status) {
+    auto payload = folly::IOBuf::copyBuffer("data");
+    cache.put(
+        kTrack,
+        group,
+        0,
+        object,
+        status,
+        noExtensions(),
+        status == ObjectStatus::NORMAL ? payload.get() : nullptr);
+  }
+
+  // Writes an object of group 2 and waits for the relay to forward it
+  void putLive(uint64_t object) {
+    bool forwarded = false;
+    EXPECT_CALL(*subgroup_, object(object, _, _, false))
+        .WillOnce([&forwarded] {
+          forwarded = true;
+          return folly::unit;
+        });
+    put(*cache_, 2, object, ObjectStatus::NORMAL);
+    loopUntil([&forwarded] { return forwarded; });
+  }
+
+  // Runs task on behalf of a session, as if it had sent the request
+  void start(
+      std::shared_ptr<MoQSession> session,
+      folly::Function<folly::coro::Task<void>()> task) {
+    folly::RequestContextScopeGuard guard;
+    folly::RequestContext::get()->setContextData(
+        folly::RequestToken("moq_session"),
+        std::make_unique<MoQSession::MoQSessionRequestData>(
+            std::move(session)));
+    folly::coro::co_invoke(std::move(task)).scheduleOn(&evb_).start();
+  }
+
+  void loopUntil(folly::Function<bool()> done) {
+    while (!done()) {
+      evb_.loopOnce();
+    }
+  }
+
+  folly::Function<folly::coro::Task<void>()> fetch(
+      AbsoluteLocation start,
+      AbsoluteLocation end) {
+    return [this, start, end]() -> folly::coro::Task<void> {
+      Fetch fetch(
+          SubscribeID(2), kTrack, start, end, 0, GroupOrder::OldestFirst);
+      auto res = co_await relay_->fetch(fetch, fetchConsumer_);
+      EXPECT_TRUE(res.hasValue());
+      fetchHandle_ = std::move(res.value());
+    };
+  }
+
+  folly::EventBase evb_;
+  std::string cacheName_;
+  std::shared_ptr<ShmObjectCache> cache_;
+  std::shared_ptr<MoQRelay> relay_{std::make_shared<MoQRelay>()};
+  std::unique_ptr<proxygen::test::FakeSharedWebTransport> upstreamWt_{
+      std::make_unique<proxygen::test::FakeSharedWebTransport>()};
+  std::unique_ptr<proxygen::test::FakeSharedWebTransport> downstreamWt_{
+      std::make_unique<proxygen::test::FakeSharedWebTransport>()};
+  std::shared_ptr<MoQSession> upstream_{
+      std::make_shared<MoQSession>(upstreamWt_.get(), &evb_)};
+  std::shared_ptr<MoQSession> downstream_{
+      std::make_shared<MoQSession>(downstreamWt_.get(), &evb_)};
+  bool announced_{false};
+  std::shared_ptr<testing::NiceMock<MockTrackConsumer>> trackConsumer_{
+      std::make_shared<testing::NiceMock<MockTrackConsumer>>()};
+  std::shared_ptr<testing::NiceMock<MockSubgroupConsumer>> subgroup_{
+      std::make_shared<testing::NiceMock<MockSubgroupConsumer>>()};
+  std::shared_ptr<Publisher::SubscriptionHandle> subscription_;
+  std::shared_ptr<testing::StrictMock<MockFetchConsumer>> fetchConsumer_{
+      std::make_shared<testing::StrictMock<MockFetchConsumer>>()};
+  std::shared_ptr<Publisher::FetchHandle> fetchHandle_;
+};
+
+} // namespace
+
+TEST_F(MoQRelaySplitFetchTest, CacheThenLive) {
+  bool done = false;
+  {
+    // Each object once, in order, across the boundary at 2,1
+    testing::InSequence seq;
+    EXPECT_CALL(*fetchConsumer_, object(1, 0, 0, _, _, false))
+        .WillOnce(Return(folly::unit));
+    EXPECT_CALL(*fetchConsumer_, object(1, 0, 1, _, _, false))
+        .WillOnce(Return(folly::unit));
+    EXPECT_CALL(*fetchConsumer_, endOfGroup(1, 0, 2, _, false))
+        .WillOnce(Return(folly::unit));
+    for (uint64_t object = 0; object < 4; object++) {
+      EXPECT_CALL(*fetchConsumer_, object(2, 0, object, _, _, false))
+          .WillOnce(Return(folly::unit));
+    }
+    EXPECT_CALL(*fetchConsumer_, endOfFetch()).WillOnce([&done] {
+      done = true;
+      return folly::unit;
+    });
+  }
+  start(downstream_, fetch({1, 0}, {2, 4}));
+  loopUntil([this] { return fetchHandle_ != nullptr; });
+  EXPECT_EQ(fetchHandle_->fetchOk().latestGroupAndObject.group, 2);
+  // The rest of the range arrives live
+  putLive(3);
+  loopUntil([&done] { return done; });
+}
+
+TEST_F(MoQRelaySplitFetchTest, CancelReleasesBothHalves) {
+  bool reset = false;
+  {
+    testing::InSequence seq;
+    EXPECT_CALL(*fetchConsumer_, object(1, 0, 0, _, _, false))
+        .WillOnce([this] {
+          fetchHandle_->fetchCancel();
+          return folly::unit;
+        });
+    // The cache stops serving the head
+    EXPECT_CALL(*fetchConsumer_, reset(ResetStreamErrorCode::CANCELLED))
+        .WillOnce([&reset] { reset = true; });
+  }
+  start(downstream_, fetch({1, 0}, {3, 0}));
+  loopUntil([&reset] { return reset; });
+
+  // and the live group no longer feeds the tail
+  putLive(3);
+  putLive(4);
+}
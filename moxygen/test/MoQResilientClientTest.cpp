@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/MoQResilientClient.h"
+#include "moxygen/test/Mocks.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+using testing::_;
+using testing::Return;
+
+namespace {
+
+SubscribeDone sessionClosed() {
+  return {
+      SubscribeID(0),
+      SubscribeDoneStatusCode::SESSION_CLOSED,
+      0,
+      "closed",
+      folly::none};
+}
+
+} // namespace
+
+TEST(ResumableTrackConsumer, DropsOverlapAfterResume) {
+  auto downstream = std::make_shared<testing::StrictMock<MockTrackConsumer>>();
+  auto sg1 = std::make_shared<testing::StrictMock<MockSubgroupConsumer>>();
+  auto sg2 = std::make_shared<testing::StrictMock<MockSubgroupConsumer>>();
+  auto consumer = std::make_shared<ResumableTrackConsumer>(downstream);
+  EXPECT_FALSE(consumer->resume());
+
+  EXPECT_CALL(*downstream, beginSubgroup(1, 0, _)).WillOnce(Return(sg1));
+  EXPECT_CALL(*sg1, object(0, _, _, false)).WillOnce(Return(folly::unit));
+  EXPECT_CALL(*sg1, beginObject(1, 10, _, _)).WillOnce(Return(folly::unit));
+  auto subgroup = consumer->beginSubgroup(1, 0, 0).value();
+  subgroup->object(0, folly::IOBuf::copyBuffer("a"), noExtensions(), false);
+  // Object 1 is cut off by the session ending
+  subgroup->beginObject(1, 10, folly::IOBuf::copyBuffer("b"), noExtensions());
+  EXPECT_TRUE(consumer->subscribeDone(sessionClosed()));
+  EXPECT_FALSE(consumer->done());
+
+  auto resume = consumer->resume();
+  ASSERT_TRUE(resume);
+  EXPECT_EQ(resume->group, 1);
+  EXPECT_EQ(resume->object, 1);
+
+  // The new subscription repeats group 0 and object 0, then sends object 1
+  auto old = consumer->beginSubgroup(0, 0, 0).value();
+  EXPECT_TRUE(old->object(5, nullptr, noExtensions(), true));
+  EXPECT_CALL(*downstream, beginSubgroup(1, 0, _)).WillOnce(Return(sg2));
+  EXPECT_CALL(*sg2, object(1, _, _, false)).WillOnce(Return(folly::unit));
+  subgroup = consumer->beginSubgroup(1, 0, 0).value();
+  EXPECT_TRUE(subgroup->beginObject(0, 5, nullptr, noExtensions()));
+  EXPECT_EQ(
+      subgroup->objectPayload(folly::IOBuf::copyBuffer("hello"), false)
+          .value(),
+      ObjectPublishStatus::DONE);
+  subgroup->object(1, folly::IOBuf::copyBuffer("b"), noExtensions(), false);
+  EXPECT_EQ(consumer->largestDelivered()->object, 1);
+
+  // Datagrams are filtered the same way
+  ObjectHeader dup(TrackAlias(1), 1, 0, 0);
+  EXPECT_TRUE(consumer->datagram(dup, nullptr));
+}
+
+TEST(ResumableTrackConsumer, ForwardsFinalSubscribeDone) {
+  auto downstream = std::make_shared<testing::StrictMock<MockTrackConsumer>>();
+  auto consumer = std::make_shared<ResumableTrackConsumer>(downstream);
+  EXPECT_CALL(*downstream, subscribeDone(_)).WillOnce(Return(folly::unit));
+  SubscribeDone ended{
+      SubscribeID(0),
+      SubscribeDoneStatusCode::TRACK_ENDED,
+      0,
+      "",
+      folly::none};
+  consumer->subscribeDone(ended);
+  EXPECT_TRUE(consumer->done());
+
+  // Not resumable once torn down locally
+  auto other = std::make_shared<ResumableTrackConsumer>(downstream);
+  other->setResumable(false);
+  EXPECT_CALL(*downstream, subscribeDone(_)).WillOnce(Return(folly::unit));
+  other->subscribeDone(sessionClosed());
+  EXPECT_TRUE(other->done());
+}
@@ -6,6 +6,7 @@
 
 #include "moxygen/MoQSession.h"
 #include <folly/coro/BlockingWait.h>
+#include <folly/coro/Sleep.h>
 #include <folly/futures/ThreadWheelTimekeeper.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/portability/GMock.h>
@@ -22,12 +23,69 @@ using testing::_;
 
 const size_t kTestMaxSubscribeId = 2;
 
+// Fails createUniStream once the stream credit it was given is used up,
+// like a peer that stopped raising MAX_STREAMS
+class CreditLimitedWebTransport
+    : public proxygen::test::FakeSharedWebTransport {
+ public:
+  folly::Expected<StreamWriteHandle*, ErrorCode> createUniStream() override {
+    if (uniCredit_ == 0) {
+      return folly::makeUnexpected(ErrorCode::GENERIC_ERROR);
+    }
+    uniCredit_--;
+    return FakeSharedWebTransport::createUniStream();
+  }
+
+  folly::SemiFuture<folly::Unit> awaitUniStreamCredit() override {
+    if (creditFailed_) {
+      return folly::makeSemiFuture<folly::Unit>(
+          std::runtime_error("no more credit"));
+    }
+    if (uniCredit_ > 0) {
+      return folly::makeSemiFuture();
+    }
+    auto [promise, future] = folly::makePromiseContract<folly::Unit>();
+    creditPromise_ = std::move(promise);
+    return std::move(future);
+  }
+
+  void setUniCredit(uint64_t credit) {
+    uniCredit_ = credit;
+  }
+
+  void grantUniCredit(uint64_t credit) {
+    uniCredit_ += credit;
+    if (creditPromise_) {
+      creditPromise_->setValue();
+      creditPromise_.reset();
+    }
+  }
+
+  // Fails the current and any later awaitUniStreamCredit
+  void failUniCredit() {
+    creditFailed_ = true;
+    if (creditPromise_) {
+      creditPromise_->setException(std::runtime_error("no more credit"));
+      creditPromise_.reset();
+    }
+  }
+
+ private:
+  uint64_t uniCredit_{std::numeric_limits<uint64_t>::max()};
+  bool creditFailed_{false};
+  folly::Optional<folly::Promise<folly::Unit>> creditPromise_;
+};
+
 class MoQSessionTest : public testing::Test,
                        public MoQSession::ServerSetupCallback {
  public:
   MoQSessionTest() {
-    std::tie(clientWt_, serverWt_) =
-        proxygen::test::FakeSharedWebTransport::makeSharedWebTransport();
+    clientWt_ = std::make_unique<proxygen::test::FakeSharedWebTransport>();
+    auto serverWt = std::make_unique<CreditLimitedWebTransport>();
+    serverCredit_ = serverWt.get();
+    serverWt_ = std::move(serverWt);
+    clientWt_->setPeer(serverWt_.get());
+    serverWt_->setPeer(clientWt_.get());
     clientSession_ = std::make_shared<MoQSession>(clientWt_.get(), &eventBase_);
     serverWt_->setPeerHandler(clientSession_.get());
 
@@ -75,6 +133,8 @@ class MoQSessionTest : public testing::Test,
   folly::EventBase eventBase_;
   std::unique_ptr<proxygen::test::FakeSharedWebTransport> clientWt_;
   std::unique_ptr<proxygen::test::FakeSharedWebTransport> serverWt_;
+  // serverWt_, for tests that run the server out of stream credit
+  CreditLimitedWebTransport* serverCredit_{nullptr};
   std::shared_ptr<MoQSession> clientSession_;
   std::shared_ptr<MoQSession> serverSession_;
   std::shared_ptr<MockPublisher> clientPublisher{
@@ -661,6 +721,51 @@ TEST_F(MoQSessionTest, TrackStatus) {
   eventBase_.loop();
 }
 
+TEST_F(MoQSessionTest, SubscribeTimeout) {
+  setupMoQSession();
+  MoQSession::RequestTimeouts timeouts;
+  timeouts.subscribe = std::chrono::milliseconds(100);
+  clientSession_->setRequestTimeouts(timeouts);
+  auto f = [this](std::shared_ptr<MoQSession> session) mutable
+      -> folly::coro::Task<void> {
+    SubscribeRequest sub{
+        SubscribeID(0),
+        TrackAlias(0),
+        FullTrackName{TrackNamespace{{"foo"}}, "bar"},
+        0,
+        GroupOrder::OldestFirst,
+        LocationType::LatestObject,
+        folly::none,
+        0,
+        {}};
+    EXPECT_CALL(
+        *clientSubscriberStatsCallback_,
+        onRequestTimeout(FrameType::SUBSCRIBE));
+    EXPECT_CALL(
+        *clientSubscriberStatsCallback_,
+        onSubscribeError(SubscribeErrorCode::TIMEOUT));
+    auto res = co_await session->subscribe(
+        sub, std::make_shared<testing::StrictMock<MockTrackConsumer>>());
+    EXPECT_TRUE(res.hasError());
+    EXPECT_EQ(res.error().errorCode, SubscribeErrorCode::TIMEOUT);
+    session->close(SessionCloseErrorCode::NO_ERROR);
+  };
+  EXPECT_CALL(*serverPublisher, subscribe(_, _))
+      .WillOnce(testing::Invoke(
+          [](auto sub, auto) -> folly::coro::Task<Publisher::SubscribeResult> {
+            // Never responds before the client gives up
+            co_await folly::coro::sleepReturnEarlyOnCancel(
+                std::chrono::seconds(5));
+            co_return folly::makeUnexpected(SubscribeError{
+                sub.subscribeID,
+                SubscribeErrorCode::INTERNAL_ERROR,
+                "too slow",
+                folly::none});
+          }));
+  f(clientSession_).scheduleOn(&eventBase_).start();
+  eventBase_.loop();
+}
+
 TEST_F(MoQSessionTest, SubscribeAnnouncesOk) {
   setupMoQSession();
   eventBase_.loopOnce();
@@ -709,7 +814,6 @@ TEST_F(MoQSessionTest, SubscribeAnnouncesOk) {
 // order on invalid pub track
 // publishStreamPerObject
 // publish with payloadOffset > 0
-// createUniStream fails
 // publish invalid group/object per forward pref
 // publish without length
 // publish object larger than length
@@ -1179,3 +1283,255 @@ TEST_F(MoQSessionTest, Datagrams) {
   f(clientSession_).scheduleOn(&eventBase_).start();
   eventBase_.loop();
 }
+
+namespace {
+SubscribeRequest getPendingSubgroupsSubscribe() {
+  return SubscribeRequest{
+      SubscribeID(0),
+      TrackAlias(0),
+      FullTrackName{TrackNamespace{{"foo"}}, "bar"},
+      0,
+      GroupOrder::OldestFirst,
+      LocationType::LatestObject,
+      folly::none,
+      0,
+      {}};
+}
+
+SubscribeDone getPendingSubgroupsDone(SubscribeID subscribeID) {
+  return SubscribeDone{
+      subscribeID,
+      SubscribeDoneStatusCode::TRACK_ENDED,
+      0, // it's set by the session anyways
+      "end of track",
+      folly::none};
+}
+} // namespace
+
+TEST_F(MoQSessionTest, PendingSubgroupsOpenByPriority) {
+  setupMoQSession();
+  serverCredit_->setUniCredit(0);
+  [](std::shared_ptr<MoQSession> clientSession) -> folly::coro::Task<void> {
+    auto trackPublisher =
+        std::make_shared<testing::StrictMock<MockTrackConsumer>>();
+    auto sg1 = std::make_shared<testing::StrictMock<MockSubgroupConsumer>>();
+    auto sg2 = std::make_shared<testing::StrictMock<MockSubgroupConsumer>>();
+    {
+      // The second subgroup has the higher priority, so it opens first
+      testing::InSequence seq;
+      EXPECT_CALL(*trackPublisher, beginSubgroup(0, 1, _))
+          .WillOnce(testing::Return(sg2));
+      EXPECT_CALL(*trackPublisher, beginSubgroup(0, 0, _))
+          .WillOnce(testing::Return(sg1));
+    }
+    folly::coro::Baton baton;
+    EXPECT_CALL(*sg2, object(0, _, _, true))
+        .WillOnce(testing::Return(folly::unit));
+    EXPECT_CALL(*sg1, object(0, _, _, true))
+        .WillOnce(testing::Invoke([&] {
+          baton.post();
+          return folly::unit;
+        }));
+    EXPECT_CALL(*trackPublisher, subscribeDone(_))
+        .WillOnce(testing::Return(folly::unit));
+    auto res = co_await clientSession->subscribe(
+        getPendingSubgroupsSubscribe(), trackPublisher);
+    co_await baton;
+    clientSession->close(SessionCloseErrorCode::NO_ERROR);
+  }(clientSession_)
+                   .scheduleOn(&eventBase_)
+                   .start();
+  EXPECT_CALL(*serverPublisherStatsCallback_, onSubgroupQueued()).Times(2);
+  EXPECT_CALL(*serverPublisher, subscribe(_, _))
+      .WillOnce(testing::Invoke(
+          [this](auto sub, auto pub)
+              -> folly::coro::Task<Publisher::SubscribeResult> {
+            EXPECT_CALL(*serverPublisherStatsCallback_, onSubscribeSuccess());
+            eventBase_.add([this, pub] {
+              // Both are buffered until credit arrives
+              auto low = pub->beginSubgroup(0, 0, 200).value();
+              auto high = pub->beginSubgroup(0, 1, 10).value();
+              EXPECT_TRUE(low->object(
+                                 0,
+                                 moxygen::test::makeBuf(10),
+                                 noExtensions(),
+                                 true)
+                              .hasValue());
+              EXPECT_TRUE(high->object(
+                                  0,
+                                  moxygen::test::makeBuf(10),
+                                  noExtensions(),
+                                  true)
+                              .hasValue());
+              eventBase_.add([this] { serverCredit_->grantUniCredit(2); });
+            });
+            co_return std::make_shared<MockSubscriptionHandle>(SubscribeOk{
+                sub.subscribeID,
+                std::chrono::milliseconds(0),
+                GroupOrder::OldestFirst,
+                folly::none,
+                {}});
+          }));
+  eventBase_.loop();
+}
+
+TEST_F(MoQSessionTest, PendingSubgroupsDropStalestOnOverflow) {
+  setupMoQSession();
+  serverCredit_->setUniCredit(0);
+  [](std::shared_ptr<MoQSession> clientSession) -> folly::coro::Task<void> {
+    auto trackPublisher =
+        std::make_shared<testing::StrictMock<MockTrackConsumer>>();
+    folly::coro::Baton baton;
+    EXPECT_CALL(*trackPublisher, subscribeDone(_))
+        .WillOnce(testing::Invoke([&] {
+          baton.post();
+          return folly::unit;
+        }));
+    auto res = co_await clientSession->subscribe(
+        getPendingSubgroupsSubscribe(), trackPublisher);
+    co_await baton;
+    clientSession->close(SessionCloseErrorCode::NO_ERROR);
+  }(clientSession_)
+                   .scheduleOn(&eventBase_)
+                   .start();
+  // One more than the session queues
+  constexpr uint64_t kSubgroups = 33;
+  EXPECT_CALL(*serverPublisherStatsCallback_, onSubgroupQueued())
+      .Times(kSubgroups);
+  EXPECT_CALL(*serverPublisherStatsCallback_, onPendingSubgroupDropped())
+      .Times(1);
+  EXPECT_CALL(*serverPublisher, subscribe(_, _))
+      .WillOnce(testing::Invoke(
+          [this](auto sub, auto pub)
+              -> folly::coro::Task<Publisher::SubscribeResult> {
+            EXPECT_CALL(*serverPublisherStatsCallback_, onSubscribeSuccess());
+            eventBase_.add([pub, sub] {
+              std::vector<std::shared_ptr<SubgroupConsumer>> subgroups;
+              for (uint64_t i = 0; i < kSubgroups; i++) {
+                subgroups.push_back(pub->beginSubgroup(0, i, 0).value());
+              }
+              // The first subgroup waited longest and was dropped
+              auto res = subgroups[0]->object(0, moxygen::test::makeBuf(10));
+              ASSERT_TRUE(res.hasError());
+              EXPECT_EQ(res.error().code, MoQPublishError::TOO_FAR_BEHIND);
+              EXPECT_TRUE(
+                  subgroups[1]->object(0, moxygen::test::makeBuf(10))
+                      .hasValue());
+              pub->subscribeDone(getPendingSubgroupsDone(sub.subscribeID));
+            });
+            co_return std::make_shared<MockSubscriptionHandle>(SubscribeOk{
+                sub.subscribeID,
+                std::chrono::milliseconds(0),
+                GroupOrder::OldestFirst,
+                folly::none,
+                {}});
+          }));
+  eventBase_.loop();
+}
+
+TEST_F(MoQSessionTest, PendingSubgroupsDropWhenCreditFails) {
+  setupMoQSession();
+  serverCredit_->setUniCredit(0);
+  [](std::shared_ptr<MoQSession> clientSession) -> folly::coro::Task<void> {
+    auto trackPublisher =
+        std::make_shared<testing::StrictMock<MockTrackConsumer>>();
+    folly::coro::Baton baton;
+    EXPECT_CALL(*trackPublisher, subscribeDone(_))
+        .WillOnce(testing::Invoke([&] {
+          baton.post();
+          return folly::unit;
+        }));
+    auto res = co_await clientSession->subscribe(
+        getPendingSubgroupsSubscribe(), trackPublisher);
+    co_await baton;
+    clientSession->close(SessionCloseErrorCode::NO_ERROR);
+  }(clientSession_)
+                   .scheduleOn(&eventBase_)
+                   .start();
+  auto subgroups =
+      std::make_shared<std::vector<std::shared_ptr<SubgroupConsumer>>>();
+  std::shared_ptr<TrackConsumer> trackPub;
+  SubscribeID subscribeID(0);
+  EXPECT_CALL(*serverPublisherStatsCallback_, onSubgroupQueued()).Times(2);
+  EXPECT_CALL(*serverPublisherStatsCallback_, onPendingSubgroupDropped())
+      .WillOnce(testing::Return())
+      .WillOnce(testing::Invoke([&] {
+        // Both queued subgroups are dropped, and say so on the next write
+        eventBase_.add([&] {
+          for (auto& subgroup : *subgroups) {
+            auto res = subgroup->object(0, moxygen::test::makeBuf(10));
+            ASSERT_TRUE(res.hasError());
+            EXPECT_EQ(res.error().code, MoQPublishError::TOO_FAR_BEHIND);
+          }
+          trackPub->subscribeDone(getPendingSubgroupsDone(subscribeID));
+        });
+      }));
+  EXPECT_CALL(*serverPublisher, subscribe(_, _))
+      .WillOnce(testing::Invoke(
+          [&](auto sub,
+              auto pub) -> folly::coro::Task<Publisher::SubscribeResult> {
+            EXPECT_CALL(*serverPublisherStatsCallback_, onSubscribeSuccess());
+            trackPub = pub;
+            subscribeID = sub.subscribeID;
+            eventBase_.add([&] {
+              subgroups->push_back(trackPub->beginSubgroup(0, 0, 0).value());
+              subgroups->push_back(trackPub->beginSubgroup(0, 1, 0).value());
+              serverCredit_->failUniCredit();
+            });
+            co_return std::make_shared<MockSubscriptionHandle>(SubscribeOk{
+                sub.subscribeID,
+                std::chrono::milliseconds(0),
+                GroupOrder::OldestFirst,
+                folly::none,
+                {}});
+          }));
+  eventBase_.loop();
+}
+
+TEST_F(MoQSessionTest, TransportMetricsReports) {
+  setupMoQSession();
+  clientSession_->setTransportMetricsProvider(
+      []() -> folly::Optional<TransportMetrics> {
+        TransportMetrics metrics;
+        metrics.srtt = std::chrono::milliseconds(10);
+        metrics.congestionWindow = 12500;
+        return metrics;
+      });
+  std::vector<TransportMetrics> reports;
+  clientSession_->setTransportMetricsCallback(
+      std::chrono::milliseconds(20), [&](const TransportMetrics& metrics) {
+        reports.push_back(metrics);
+        if (reports.size() == 3) {
+          clientSession_->close(SessionCloseErrorCode::NO_ERROR);
+        }
+      });
+  // Long enough for several more reports had the close not stopped them
+  eventBase_.runAfterDelay([this] { eventBase_.terminateLoopSoon(); }, 200);
+  eventBase_.loopForever();
+  ASSERT_EQ(reports.size(), 3);
+  EXPECT_EQ(reports[0].congestionWindow, 12500);
+  EXPECT_EQ(reports[0].deliveryRate, 10000000);
+}
+
+TEST_F(MoQSessionTest, TransportMetricsZeroIntervalStops) {
+  setupMoQSession();
+  clientSession_->setTransportMetricsProvider(
+      []() -> folly::Optional<TransportMetrics> { return TransportMetrics(); });
+  size_t reports = 0;
+  auto countReports = [&](const TransportMetrics&) { reports++; };
+  clientSession_->setTransportMetricsCallback(
+      std::chrono::milliseconds(20), countReports);
+  size_t reportsBeforeStop = 0;
+  eventBase_.runAfterDelay(
+      [&] {
+        reportsBeforeStop = reports;
+        clientSession_->setTransportMetricsCallback(
+            std::chrono::milliseconds(0), countReports);
+      },
+      100);
+  eventBase_.runAfterDelay([this] { eventBase_.terminateLoopSoon(); }, 300);
+  eventBase_.loopForever();
+  EXPECT_GT(reportsBeforeStop, 0);
+  EXPECT_EQ(reports, reportsBeforeStop);
+  clientSession_->close(SessionCloseErrorCode::NO_ERROR);
+}
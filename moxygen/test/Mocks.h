@@ -281,6 +281,12 @@ class MockPublisherStats : public MoQPublisherStatsCallback {
   MOCK_METHOD(void, onFetchSuccess, (), (override));
 
   MOCK_METHOD(void, onFetchError, (FetchErrorCode), (override));
+
+  MOCK_METHOD(void, onRequestTimeout, (FrameType), (override));
+
+  MOCK_METHOD(void, onSubgroupQueued, (), (override));
+
+  MOCK_METHOD(void, onPendingSubgroupDropped, (), (override));
 };
 
 class MockSubscriberStats : public MoQSubscriberStatsCallback {
@@ -294,6 +300,8 @@ class MockSubscriberStats : public MoQSubscriberStatsCallback {
   MOCK_METHOD(void, onFetchSuccess, (), (override));
 
   MOCK_METHOD(void, onFetchError, (FetchErrorCode), (override));
+
+  MOCK_METHOD(void, onRequestTimeout, (FrameType), (override));
 };
 
 } // namespace moxygen
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/ObjectReceiver.h"
+
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+using testing::_;
+using testing::Return;
+
+namespace {
+
+const uint64_t kTimestampExtension = 0x10;
+
+class MockObjectReceiverCallback : public ObjectReceiverCallback {
+ public:
+  MOCK_METHOD(
+      FlowControlState,
+      onObject,
+      (const ObjectHeader&, Payload),
+      (override));
+  MOCK_METHOD(void, onObjectStatus, (const ObjectHeader&), (override));
+  MOCK_METHOD(void, onEndOfStream, (), (override));
+  MOCK_METHOD(void, onError, (ResetStreamErrorCode), (override));
+  MOCK_METHOD(void, onSubscribeDone, (SubscribeDone), (override));
+  MOCK_METHOD(
+      void,
+      onSubgroupSkipped,
+      (uint64_t, uint64_t, uint64_t),
+      (override));
+};
+
+Payload makePayload() {
+  return folly::IOBuf::copyBuffer("data");
+}
+
+Extensions timestamp(uint64_t value) {
+  return {Extension{kTimestampExtension, value, {}}};
+}
+
+bool isCancelled(const folly::Expected<folly::Unit, MoQPublishError>& res) {
+  return res.hasError() && res.error().code == MoQPublishError::CANCELLED;
+}
+
+class ObjectReceiverTest : public testing::Test {
+ protected:
+  std::shared_ptr<SubgroupConsumer> beginSubgroup(uint64_t group) {
+    auto res = receiver_.beginSubgroup(group, 0, 0);
+    return res.hasValue() ? res.value() : nullptr;
+  }
+
+  testing::StrictMock<MockObjectReceiverCallback> callback_;
+  ObjectReceiver receiver_{ObjectReceiver::SUBSCRIBE, &callback_};
+};
+
+} // namespace
+
+TEST_F(ObjectReceiverTest, DisabledByDefault) {
+  auto old = beginSubgroup(1);
+  ASSERT_NE(old, nullptr);
+  ASSERT_NE(beginSubgroup(10), nullptr);
+  // Late groups and subgroups are still delivered
+  ASSERT_NE(beginSubgroup(2), nullptr);
+  EXPECT_CALL(callback_, onObject(_, _))
+      .WillOnce(Return(ObjectReceiverCallback::FlowControlState::UNBLOCKED));
+  EXPECT_TRUE(old->object(0, makePayload(), timestamp(0), false).hasValue());
+}
+
+TEST_F(ObjectReceiverTest, SkipsOnGroupLag) {
+  receiver_.setCatchUpPolicy(CatchUpPolicy{});
+  auto old = beginSubgroup(1);
+  ASSERT_NE(old, nullptr);
+  EXPECT_CALL(callback_, onObject(_, _))
+      .WillOnce(Return(ObjectReceiverCallback::FlowControlState::UNBLOCKED));
+  EXPECT_TRUE(old->object(0, makePayload(), noExtensions(), false));
+
+  // One group behind is within the lag
+  ASSERT_NE(beginSubgroup(2), nullptr);
+  EXPECT_CALL(callback_, onObject(_, _))
+      .WillOnce(Return(ObjectReceiverCallback::FlowControlState::UNBLOCKED));
+  EXPECT_TRUE(old->object(1, makePayload(), noExtensions(), false));
+
+  // Reported once, then every later object is refused
+  ASSERT_NE(beginSubgroup(3), nullptr);
+  EXPECT_CALL(callback_, onSubgroupSkipped(1, 0, 3));
+  EXPECT_TRUE(isCancelled(old->object(2, makePayload(), {}, false)));
+  EXPECT_TRUE(isCancelled(old->objectNotExists(3, {}, false)));
+  EXPECT_TRUE(old->objectPayload(makePayload(), false).hasError());
+
+  // Stale subgroups are refused when they open
+  EXPECT_CALL(callback_, onSubgroupSkipped(0, 0, 3));
+  EXPECT_EQ(beginSubgroup(0), nullptr);
+}
+
+TEST_F(ObjectReceiverTest, SkipsOnTimestampLag) {
+  CatchUpPolicy policy;
+  policy.maxGroupLag = 100;
+  policy.timestampExtensionType = kTimestampExtension;
+  policy.maxTimestampLag = 100;
+  receiver_.setCatchUpPolicy(policy);
+  auto slow = beginSubgroup(1);
+  auto fast = beginSubgroup(2);
+  ASSERT_NE(slow, nullptr);
+  ASSERT_NE(fast, nullptr);
+
+  EXPECT_CALL(callback_, onObject(_, _))
+      .Times(4)
+      .WillRepeatedly(
+          Return(ObjectReceiverCallback::FlowControlState::UNBLOCKED));
+  EXPECT_TRUE(slow->object(0, makePayload(), timestamp(1000), false));
+  EXPECT_TRUE(fast->object(0, makePayload(), timestamp(1050), false));
+  EXPECT_TRUE(slow->object(1, makePayload(), timestamp(1000), false));
+
+  EXPECT_TRUE(fast->object(1, makePayload(), timestamp(1200), false));
+  EXPECT_CALL(callback_, onSubgroupSkipped(1, 0, 2));
+  EXPECT_TRUE(
+      isCancelled(slow->object(2, makePayload(), timestamp(1050), false)));
+  // Objects without the extension are judged on group lag alone
+  EXPECT_CALL(callback_, onObject(_, _))
+      .WillOnce(Return(ObjectReceiverCallback::FlowControlState::UNBLOCKED));
+  EXPECT_TRUE(fast->object(2, makePayload(), noExtensions(), false));
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/RequestLatencyStats.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+using std::chrono::microseconds;
+
+TEST(RequestLatencyStatsTest, HistogramBuckets) {
+  EXPECT_EQ(LatencyHistogram::bucketIndex(microseconds(0)), 0);
+  EXPECT_EQ(LatencyHistogram::bucketIndex(microseconds(1)), 1);
+  EXPECT_EQ(LatencyHistogram::bucketIndex(microseconds(3)), 2);
+  EXPECT_EQ(LatencyHistogram::bucketIndex(microseconds(1024)), 11);
+  EXPECT_EQ(
+      LatencyHistogram::bucketIndex(microseconds(1ULL << 40)),
+      LatencyHistogram::kNumBuckets - 1);
+
+  LatencyHistogram histogram;
+  for (int i = 0; i < 90; i++) {
+    histogram.record(microseconds(100));
+  }
+  for (int i = 0; i < 10; i++) {
+    histogram.record(microseconds(5000));
+  }
+  auto snap = histogram.snapshot();
+  EXPECT_EQ(snap.count, 100);
+  EXPECT_EQ(snap.total, microseconds(90 * 100 + 10 * 5000));
+  EXPECT_EQ(snap.max, microseconds(5000));
+  EXPECT_EQ(snap.percentile(50), microseconds(128));
+  EXPECT_EQ(snap.percentile(99), microseconds(5000));
+}
+
+TEST(RequestLatencyStatsTest, SplitByForwarded) {
+  auto stats = std::make_shared<RequestLatencyStats>();
+  auto pub = stats->publisherCallback();
+  auto sub = stats->subscriberCallback();
+  pub->onRequestLatency(
+      FrameType::SUBSCRIBE, RequestPhase::RESPONSE, microseconds(10), false);
+  pub->onRequestLatency(
+      FrameType::SUBSCRIBE, RequestPhase::RESPONSE, microseconds(900), true);
+  sub->onRequestLatency(
+      FrameType::FETCH, RequestPhase::FIRST_OBJECT, microseconds(50), false);
+  // Ignored
+  sub->onRequestLatency(
+      FrameType::ANNOUNCE, RequestPhase::RESPONSE, microseconds(50), false);
+
+  EXPECT_EQ(
+      stats
+          ->histogram(
+              RequestRole::PUBLISHER,
+              FrameType::SUBSCRIBE,
+              RequestPhase::RESPONSE,
+              /*forwarded=*/true)
+          .snapshot()
+          .max,
+      microseconds(900));
+  auto snaps = stats->snapshot();
+  ASSERT_EQ(snaps.size(), 3);
+  EXPECT_EQ(snaps[0].name, "publisher.subscribe.response.local");
+  EXPECT_EQ(snaps[1].name, "publisher.subscribe.response.forwarded");
+  EXPECT_EQ(snaps[2].name, "subscriber.fetch.first_object.local");
+  EXPECT_EQ(snaps[2].snapshot.count, 1);
+}
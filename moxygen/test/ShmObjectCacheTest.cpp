@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/ShmObjectCache.h"
+
+#include <folly/portability/GTest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace moxygen;
+
+namespace {
+
+const FullTrackName kTrack{TrackNamespace({"test"}), "track"};
+
+class ShmObjectCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    config_.name = folly::to<std::string>("/moxygen-test-", ::getpid());
+    config_.indexSlots = 64;
+    config_.dataBytes = 4096;
+    ShmObjectCache::remove(config_.name);
+  }
+
+  void TearDown() override {
+    ShmObjectCache::remove(config_.name);
+  }
+
+  std::unique_ptr<ShmObjectCache> open() {
+    auto cache = ShmObjectCache::open(config_);
+    EXPECT_TRUE(cache.hasValue());
+    return std::move(cache.value());
+  }
+
+  ShmObjectCache::Config config_;
+};
+
+} // namespace
+
+TEST_F(ShmObjectCacheTest, PutGet) {
+  auto cache = open();
+  Extensions extensions{{2, 10, {}}, {3, 0, {1, 2, 3}}};
+  auto payload = folly::IOBuf::copyBuffer("hello");
+  payload->appendToChain(folly::IOBuf::copyBuffer(" world"));
+  EXPECT_TRUE(cache->put(
+      kTrack, 1, 2, 3, ObjectStatus::NORMAL, extensions, payload.get()));
+  EXPECT_TRUE(cache->put(
+      kTrack, 1, 2, 4, ObjectStatus::END_OF_GROUP, noExtensions(), nullptr));
+
+  auto object = cache->get(kTrack, 1, 3);
+  ASSERT_TRUE(object.has_value());
+  EXPECT_EQ(object->subgroup, 2);
+  EXPECT_EQ(object->status, ObjectStatus::NORMAL);
+  EXPECT_EQ(object->extensions, extensions);
+  EXPECT_EQ(object->payload->moveToFbString().toStdString(), "hello world");
+
+  object = cache->get(kTrack, 1, 4);
+  ASSERT_TRUE(object.has_value());
+  EXPECT_EQ(object->status, ObjectStatus::END_OF_GROUP);
+  EXPECT_EQ(object->payload, nullptr);
+
+  EXPECT_EQ(cache->status(kTrack, 1, 3), ObjectStatus::NORMAL);
+  EXPECT_EQ(cache->status(kTrack, 1, 4), ObjectStatus::END_OF_GROUP);
+  EXPECT_FALSE(cache->status(kTrack, 1, 5).has_value());
+  EXPECT_FALSE(cache->get(kTrack, 1, 5).has_value());
+  EXPECT_FALSE(
+      cache->get({TrackNamespace({"test"}), "other"}, 1, 3).has_value());
+}
+
+TEST_F(ShmObjectCacheTest, SharedAcrossInstances) {
+  auto writer = open();
+  auto reader = open();
+  auto payload = folly::IOBuf::copyBuffer("shared");
+  EXPECT_TRUE(writer->put(
+      kTrack, 0, 0, 0, ObjectStatus::NORMAL, noExtensions(), payload.get()));
+  auto object = reader->get(kTrack, 0, 0);
+  ASSERT_TRUE(object.has_value());
+  EXPECT_EQ(object->payload->moveToFbString().toStdString(), "shared");
+
+  config_.dataBytes *= 2;
+  EXPECT_TRUE(ShmObjectCache::open(config_).hasError());
+}
+
+TEST_F(ShmObjectCacheTest, RingOverwritesOldObjects) {
+  auto cache = open();
+  std::string data(500, 'x');
+  for (uint64_t i = 0; i < 20; i++) {
+    auto payload = folly::IOBuf::copyBuffer(data);
+    EXPECT_TRUE(cache->put(
+        kTrack, 0, 0, i, ObjectStatus::NORMAL, noExtensions(), payload.get()));
+  }
+  EXPECT_FALSE(cache->get(kTrack, 0, 0).has_value());
+  EXPECT_TRUE(cache->get(kTrack, 0, 19).has_value());
+
+  // Larger than a quarter of the ring
+  auto large = folly::IOBuf::copyBuffer(std::string(2000, 'y'));
+  EXPECT_FALSE(cache->put(
+      kTrack, 1, 0, 0, ObjectStatus::NORMAL, noExtensions(), large.get()));
+}
+
+TEST_F(ShmObjectCacheTest, LeaseIsExclusive) {
+  auto cache = open();
+  EXPECT_TRUE(cache->acquireLease(kTrack, std::chrono::seconds(10)));
+  // Renewal by the holder
+  EXPECT_TRUE(cache->acquireLease(kTrack, std::chrono::seconds(10)));
+
+  auto childAcquires = [this] {
+    auto pid = ::fork();
+    if (pid == 0) {
+      auto child = ShmObjectCache::open(config_);
+      _exit(
+          child.hasValue() &&
+                  child.value()->acquireLease(
+                      kTrack, std::chrono::seconds(10))
+              ? 0
+              : 1);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  };
+  EXPECT_FALSE(childAcquires());
+  cache->releaseLease(kTrack);
+  EXPECT_TRUE(childAcquires());
+  // The child exited without releasing, wait for expiry
+  EXPECT_FALSE(cache->acquireLease(kTrack, std::chrono::seconds(10)));
+}
+
+TEST_F(ShmObjectCacheTest, LeaseSlotsAreReused) {
+  auto cache = open();
+  // More tracks than the lease table has slots
+  constexpr int kTracks = 10000;
+  auto track = [](int i) {
+    return FullTrackName{TrackNamespace({"churn"}), folly::to<std::string>(i)};
+  };
+  for (int i = 0; i < kTracks; i++) {
+    ASSERT_TRUE(cache->acquireLease(track(i), std::chrono::seconds(10)));
+    cache->releaseLease(track(i));
+  }
+  // Expired leases are taken over without being released
+  for (int i = 0; i < kTracks; i++) {
+    ASSERT_TRUE(
+        cache->acquireLease(track(kTracks + i), std::chrono::milliseconds(0)));
+  }
+  EXPECT_TRUE(cache->acquireLease(kTrack, std::chrono::seconds(10)));
+  EXPECT_TRUE(cache->acquireLease(kTrack, std::chrono::seconds(10)));
+}
+
+TEST_F(ShmObjectCacheTest, LatestGroup) {
+  auto cache = open();
+  EXPECT_FALSE(cache->latestGroup(kTrack).has_value());
+  // Only the lease holder records it
+  cache->setLatestGroup(kTrack, 3);
+  EXPECT_FALSE(cache->latestGroup(kTrack).has_value());
+  ASSERT_TRUE(cache->acquireLease(kTrack, std::chrono::seconds(10)));
+  cache->setLatestGroup(kTrack, 0);
+  EXPECT_EQ(cache->latestGroup(kTrack), 0);
+  cache->setLatestGroup(kTrack, 7);
+  EXPECT_EQ(cache->latestGroup(kTrack), 7);
+  // Kept for the next holder
+  cache->releaseLease(kTrack);
+  EXPECT_EQ(cache->latestGroup(kTrack), 7);
+}
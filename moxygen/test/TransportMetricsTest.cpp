@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/TransportMetrics.h"
+
+#include <folly/portability/GTest.h>
+#include <thread>
+
+using namespace moxygen;
+using namespace std::chrono_literals;
+
+namespace {
+
+class TransportMetricsSamplerTest : public testing::Test {
+ protected:
+  TransportMetricsSamplerTest() {
+    (*current_)->srtt = 10ms;
+    (*current_)->congestionWindow = 12500;
+  }
+
+  // Samples whatever current_ holds at the time
+  TransportMetricsSampler makeSampler() {
+    return TransportMetricsSampler(
+        [current = current_] { return *current; });
+  }
+
+  std::shared_ptr<folly::Optional<TransportMetrics>> current_{
+      std::make_shared<folly::Optional<TransportMetrics>>(
+          TransportMetrics())};
+};
+
+// 12500 bytes per 10ms
+constexpr uint64_t kCwndRate = 10000000;
+
+} // namespace
+
+TEST_F(TransportMetricsSamplerTest, NoMetrics) {
+  EXPECT_FALSE(TransportMetricsSampler(nullptr).sample().has_value());
+  auto sampler = makeSampler();
+  current_->reset();
+  EXPECT_FALSE(sampler.sample().has_value());
+}
+
+TEST_F(TransportMetricsSamplerTest, CwndOverSrttWithoutAcks) {
+  auto sampler = makeSampler();
+  auto metrics = sampler.sample();
+  ASSERT_TRUE(metrics.has_value());
+  EXPECT_EQ(metrics->congestionWindow, 12500);
+  EXPECT_EQ(metrics->deliveryRate, kCwndRate);
+
+  // Still no acked bytes to measure from
+  (*current_)->congestionWindow = 25000;
+  EXPECT_EQ(sampler.sample()->deliveryRate, 2 * kCwndRate);
+
+  // Nor an RTT
+  (*current_)->srtt = 0us;
+  EXPECT_EQ(sampler.sample()->deliveryRate, 0);
+}
+
+TEST_F(TransportMetricsSamplerTest, HoldsRateWithinMinInterval) {
+  (*current_)->bytesAcked = 0;
+  auto sampler = makeSampler();
+  EXPECT_EQ(sampler.sample()->deliveryRate, kCwndRate);
+
+  // Too soon after the first sample to measure the acks
+  (*current_)->bytesAcked = 1000000;
+  auto metrics = sampler.sample();
+  EXPECT_EQ(metrics->bytesAcked, 1000000);
+  EXPECT_EQ(metrics->deliveryRate, kCwndRate);
+}
+
+TEST_F(TransportMetricsSamplerTest, MeasuresAckedBytes) {
+  (*current_)->bytesAcked = 0;
+  auto sampler = makeSampler();
+  sampler.sample();
+
+  // 150000 bytes over at least 150ms is at most 8Mbps
+  std::this_thread::sleep_for(150ms);
+  (*current_)->bytesAcked = 150000;
+  auto rate = sampler.sample()->deliveryRate;
+  EXPECT_LE(rate, 8000000);
+  EXPECT_GT(rate, 2000000);
+
+  // Measured from the last sample, not the first
+  std::this_thread::sleep_for(150ms);
+  (*current_)->bytesAcked = 150000 + 300000;
+  auto nextRate = sampler.sample()->deliveryRate;
+  EXPECT_LE(nextRate, 16000000);
+  EXPECT_GT(nextRate, rate);
+
+  // A counter that went backwards keeps the last rate
+  std::this_thread::sleep_for(150ms);
+  (*current_)->bytesAcked = 0;
+  EXPECT_EQ(sampler.sample()->deliveryRate, nextRate);
+}
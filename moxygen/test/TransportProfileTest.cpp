@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/TransportProfile.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace moxygen;
+
+TEST(TransportProfileTest, Parse) {
+  for (auto profile :
+       {TransportProfile::DEFAULT,
+        TransportProfile::LIVE,
+        TransportProfile::FETCH,
+        TransportProfile::TRUNK}) {
+    auto parsed = parseTransportProfile(getTransportProfileString(profile));
+    ASSERT_TRUE(parsed.hasValue());
+    EXPECT_EQ(parsed.value(), profile);
+  }
+  EXPECT_TRUE(parseTransportProfile("fast").hasError());
+}
+
+TEST(TransportProfileTest, DefaultLeavesSettings) {
+  quic::TransportSettings expected;
+  quic::TransportSettings ts;
+  TransportConfig().apply(ts);
+  EXPECT_EQ(
+      ts.defaultCongestionController, expected.defaultCongestionController);
+  EXPECT_EQ(ts.initCwndInMss, expected.initCwndInMss);
+  EXPECT_EQ(ts.pacingEnabled, expected.pacingEnabled);
+  EXPECT_EQ(
+      ts.advertisedInitialMaxStreamsUni,
+      expected.advertisedInitialMaxStreamsUni);
+}
+
+TEST(TransportProfileTest, OverridesProfile) {
+  TransportConfig config;
+  config.profile = TransportProfile::TRUNK;
+  config.congestionControl = quic::CongestionControlType::Cubic;
+  config.streamFlowControlWindow = 1 << 20;
+  quic::TransportSettings ts;
+  config.apply(ts);
+  EXPECT_EQ(ts.defaultCongestionController, quic::CongestionControlType::Cubic);
+  EXPECT_TRUE(ts.pacingEnabled);
+  EXPECT_EQ(ts.initCwndInMss, 64);
+  EXPECT_EQ(ts.advertisedInitialUniStreamFlowControlWindow, 1 << 20);
+  EXPECT_EQ(ts.advertisedInitialBidiRemoteStreamFlowControlWindow, 1 << 20);
+  EXPECT_EQ(ts.advertisedInitialMaxStreamsUni, 10000);
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/container/F14Map.h>
+#include <deque>
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <utility>
+
+namespace moxygen {
+
+// Map keyed by a monotonically allocated ID (SubscribeID, TrackAlias).
+//
+// Live IDs are kept in a sliding window of slots indexed by ID - base, so
+// lookups are a bounds check plus an index.  The window slides forward as the
+// oldest IDs are erased.  IDs below the window, or too far beyond its end, go
+// to a fallback map.  When a few long lived IDs hold the front of a mostly
+// empty window, they are moved to the fallback so the window can slide.  The
+// interface is the subset of F14FastMap that MoQSession uses.
+//
+// As with F14FastMap, inserting may invalidate iterators and references.
+// Erasing only invalidates those to the erased element.
+template <class Key, class Value, class Hash>
+class DenseIdMap {
+ public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<const Key, Value>;
+  using FallbackMap = folly::F14FastMap<Key, Value, Hash>;
+
+  // Largest number of empty slots appended to reach a new ID
+  static constexpr uint64_t kMaxGap = 1024;
+  static constexpr uint64_t kMaxSlots = 1 << 16;
+  // Windows at least this large are compacted once fewer than one in
+  // kSparseRatio slots is live
+  static constexpr uint64_t kMinCompactSlots = 64;
+  static constexpr uint64_t kSparseRatio = 4;
+
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = DenseIdMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type*;
+    using reference = value_type&;
+
+    iterator() = default;
+
+    reference operator*() const {
+      return inWindow_ ? *map_->slotFor(id_) : *fallbackIt_;
+    }
+    pointer operator->() const {
+      return &**this;
+    }
+    iterator& operator++() {
+      if (inWindow_) {
+        *this = map_->firstFrom(id_ + 1);
+      } else {
+        ++fallbackIt_;
+      }
+      return *this;
+    }
+    iterator operator++(int) {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
+    bool operator==(const iterator& other) const {
+      return inWindow_ == other.inWindow_ &&
+          (inWindow_ ? id_ == other.id_ : fallbackIt_ == other.fallbackIt_);
+    }
+
+   private:
+    friend class DenseIdMap;
+    iterator(DenseIdMap* map, uint64_t id)
+        : map_(map), id_(id), inWindow_(true) {}
+    iterator(DenseIdMap* map, typename FallbackMap::iterator it)
+        : map_(map), fallbackIt_(it) {}
+
+    DenseIdMap* map_{nullptr};
+    uint64_t id_{0};
+    bool inWindow_{false};
+    typename FallbackMap::iterator fallbackIt_;
+  };
+
+  iterator begin() {
+    return firstFrom(base_);
+  }
+  iterator end() {
+    return iterator(this, fallback_.end());
+  }
+
+  size_t size() const {
+    return windowCount_ + fallback_.size();
+  }
+  bool empty() const {
+    return size() == 0;
+  }
+
+  iterator find(const Key& key) {
+    if (slotFor(key.value)) {
+      return iterator(this, key.value);
+    }
+    if (fallback_.empty()) {
+      return end();
+    }
+    return iterator(this, fallback_.find(key));
+  }
+
+  template <class... Args>
+  std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+    auto id = key.value;
+    if (!fallback_.empty()) {
+      // The window may have grown over an ID placed in the fallback earlier
+      auto fbIt = fallback_.find(key);
+      if (fbIt != fallback_.end()) {
+        return {iterator(this, fbIt), false};
+      }
+    }
+    if (!slots_.empty() && id >= base_ && id - base_ < slots_.size()) {
+      auto& slot = slots_[id - base_];
+      if (slot) {
+        return {iterator(this, id), false};
+      }
+      slot.emplace(
+          std::piecewise_construct,
+          std::forward_as_tuple(key),
+          std::forward_as_tuple(std::forward<Args>(args)...));
+      windowCount_++;
+      return {iterator(this, id), true};
+    }
+    if (!slots_.empty() && id >= base_) {
+      compact();
+    }
+    if (fits(id)) {
+      if (slots_.empty()) {
+        base_ = id;
+      }
+      slots_.resize(id - base_ + 1);
+      slots_.back().emplace(
+          std::piecewise_construct,
+          std::forward_as_tuple(key),
+          std::forward_as_tuple(std::forward<Args>(args)...));
+      windowCount_++;
+      return {iterator(this, id), true};
+    }
+    auto res = fallback_.try_emplace(key, std::forward<Args>(args)...);
+    return {iterator(this, res.first), res.second};
+  }
+
+  template <class V>
+  std::pair<iterator, bool> emplace(const Key& key, V&& value) {
+    return try_emplace(key, std::forward<V>(value));
+  }
+
+  Value& operator[](const Key& key) {
+    return try_emplace(key).first->second;
+  }
+
+  size_t erase(const Key& key) {
+    auto id = key.value;
+    if (slotFor(id)) {
+      eraseSlot(id);
+      return 1;
+    }
+    return fallback_.erase(key);
+  }
+
+  void erase(iterator it) {
+    if (it.inWindow_) {
+      eraseSlot(it.id_);
+    } else {
+      fallback_.erase(it.fallbackIt_);
+    }
+  }
+
+  void clear() {
+    slots_.clear();
+    windowCount_ = 0;
+    fallback_.clear();
+  }
+
+  // For tests and stats
+  size_t windowSlots() const {
+    return slots_.size();
+  }
+  size_t fallbackSize() const {
+    return fallback_.size();
+  }
+
+ private:
+  value_type* slotFor(uint64_t id) {
+    if (id < base_ || id - base_ >= slots_.size()) {
+      return nullptr;
+    }
+    auto& slot = slots_[id - base_];
+    return slot ? &*slot : nullptr;
+  }
+
+  // Whether id can be placed in the window by appending slots
+  bool fits(uint64_t id) const {
+    if (slots_.empty()) {
+      return true;
+    }
+    if (id < base_) {
+      return false;
+    }
+    auto index = id - base_;
+    return index - slots_.size() < kMaxGap && index < kMaxSlots;
+  }
+
+  // Moves the oldest IDs to the fallback while the window is mostly holes
+  void compact() {
+    while (slots_.size() >= kMinCompactSlots &&
+           windowCount_ * kSparseRatio < slots_.size()) {
+      // The front slot is always live
+      auto& front = *slots_.front();
+      fallback_.try_emplace(front.first, std::move(front.second));
+      eraseSlot(front.first.value);
+    }
+  }
+
+  iterator firstFrom(uint64_t id) {
+    for (id = std::max(id, base_); id - base_ < slots_.size(); id++) {
+      if (slots_[id - base_]) {
+        return iterator(this, id);
+      }
+    }
+    return iterator(this, fallback_.begin());
+  }
+
+  void eraseSlot(uint64_t id) {
+    if (!slotFor(id)) {
+      return;
+    }
+    slots_[id - base_].reset();
+    windowCount_--;
+    while (!slots_.empty() && !slots_.front()) {
+      slots_.pop_front();
+      base_++;
+    }
+    while (!slots_.empty() && !slots_.back()) {
+      slots_.pop_back();
+    }
+  }
+
+  std::deque<std::optional<value_type>> slots_;
+  uint64_t base_{0};
+  size_t windowCount_{0};
+  FallbackMap fallback_;
+};
+
+} // namespace moxygen
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/HeavyHitters.h"
+
+#include <folly/Utility.h>
+#include <folly/container/F14Map.h>
+#include <folly/hash/Hash.h>
+#include <folly/logging/xlog.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace moxygen {
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth)
+    : width_(std::max<size_t>(width, 1)),
+      depth_(std::max<size_t>(depth, 1)),
+      counters_(width_ * depth_) {}
+
+size_t CountMinSketch::slot(uint64_t hash, size_t row) const {
+  // Double hashing stands in for depth_ independent hash functions
+  uint64_t step = folly::hash::twang_mix64(hash) | 1;
+  return row * width_ + (hash + row * step) % width_;
+}
+
+uint64_t CountMinSketch::add(uint64_t hash, uint64_t count) {
+  auto estimate = std::numeric_limits<uint64_t>::max();
+  for (size_t row = 0; row < depth_; row++) {
+    auto value =
+        counters_[slot(hash, row)].fetch_add(count, std::memory_order_relaxed);
+    estimate = std::min(estimate, value + count);
+  }
+  return estimate;
+}
+
+uint64_t CountMinSketch::estimate(uint64_t hash) const {
+  auto estimate = std::numeric_limits<uint64_t>::max();
+  for (size_t row = 0; row < depth_; row++) {
+    estimate = std::min(
+        estimate, counters_[slot(hash, row)].load(std::memory_order_relaxed));
+  }
+  return estimate;
+}
+
+void CountMinSketch::merge(const CountMinSketch& other) {
+  XCHECK(width_ == other.width_ && depth_ == other.depth_);
+  for (size_t i = 0; i < counters_.size(); i++) {
+    counters_[i].fetch_add(
+        other.counters_[i].load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+  }
+}
+
+void CountMinSketch::decay() {
+  // Concurrent adds only grow the counter, so this cannot underflow
+  for (auto& counter : counters_) {
+    counter.fetch_sub(
+        counter.load(std::memory_order_relaxed) / 2,
+        std::memory_order_relaxed);
+  }
+}
+
+const char* getHeavyHitterMetricString(HeavyHitterMetric metric) {
+  switch (metric) {
+    case HeavyHitterMetric::EGRESS_BYTES:
+      return "egress_bytes";
+    case HeavyHitterMetric::SUBSCRIBES:
+      return "subscribes";
+  }
+  return "unknown";
+}
+
+void HeavyHitters::Candidates::offer(
+    const FullTrackName& fullTrackName,
+    uint64_t hash,
+    uint64_t estimate) {
+  for (size_t j = 0; j < size_; j++) {
+    if (hashes_[j] == hash) {
+      estimates_[j] = estimate;
+      updateThreshold();
+      return;
+    }
+  }
+  size_t j = size_;
+  if (size_ < hashes_.size()) {
+    size_++;
+  } else {
+    // Replace the smallest candidate, which this track has outgrown
+    j = std::min_element(estimates_.begin(), estimates_.end()) -
+        estimates_.begin();
+  }
+  hashes_[j] = hash;
+  estimates_[j] = estimate;
+  tracks_[j].store(
+      std::make_shared<const Track>(Track{fullTrackName, hash}),
+      std::memory_order_release);
+  updateThreshold();
+}
+
+void HeavyHitters::Candidates::decay(size_t halvings) {
+  auto shift = std::min<size_t>(halvings, 63);
+  for (size_t j = 0; j < size_; j++) {
+    estimates_[j] >>= shift;
+  }
+  updateThreshold();
+}
+
+void HeavyHitters::Candidates::updateThreshold() {
+  // Any track may join until every slot is taken
+  threshold_ = size_ < hashes_.size()
+      ? 0
+      : *std::min_element(estimates_.begin(), estimates_.end());
+}
+
+HeavyHitters::Worker::Worker(const Config& config) {
+  sketches.reserve(kNumHeavyHitterMetrics);
+  candidates.reserve(kNumHeavyHitterMetrics);
+  for (size_t i = 0; i < kNumHeavyHitterMetrics; i++) {
+    sketches.emplace_back(config.width, config.depth);
+    candidates.emplace_back(config.topK);
+  }
+}
+
+HeavyHitters::HeavyHitters(Config config)
+    : config_(config),
+      workers_([this] { return new Worker(config_); }) {}
+
+void HeavyHitters::record(
+    HeavyHitterMetric metric,
+    const FullTrackName& fullTrackName,
+    uint64_t hash,
+    uint64_t count) {
+  if (count == 0 || config_.topK == 0) {
+    return;
+  }
+  auto& worker = *workers_;
+  auto decays = decays_.load(std::memory_order_relaxed);
+  if (worker.decays != decays) {
+    for (auto& candidates : worker.candidates) {
+      candidates.decay(decays - worker.decays);
+    }
+    worker.decays = decays;
+  }
+  auto i = folly::to_underlying(metric);
+  auto estimate = worker.sketches[i].add(hash, count);
+  // Estimates only grow between decays, so a candidate always passes
+  if (estimate > worker.candidates[i].threshold()) {
+    worker.candidates[i].offer(fullTrackName, hash, estimate);
+  }
+}
+
+std::vector<HeavyHitters::Entry> HeavyHitters::top(
+    HeavyHitterMetric metric) const {
+  auto i = folly::to_underlying(metric);
+  CountMinSketch merged(config_.width, config_.depth);
+  folly::F14FastMap<uint64_t, FullTrackName> tracks;
+  for (auto& worker : workers_.accessAllThreads()) {
+    merged.merge(worker.sketches[i]);
+    worker.candidates[i].forEachTrack([&tracks](const auto& track) {
+      tracks.emplace(track.hash, track.fullTrackName);
+    });
+  }
+  std::vector<Entry> result;
+  result.reserve(tracks.size());
+  for (const auto& [hash, track] : tracks) {
+    result.push_back({track, merged.estimate(hash)});
+  }
+  std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+    return a.estimate > b.estimate;
+  });
+  if (result.size() > config_.topK) {
+    result.resize(config_.topK);
+  }
+  return result;
+}
+
+void HeavyHitters::decay() {
+  for (auto& worker : workers_.accessAllThreads()) {
+    for (auto& sketch : worker.sketches) {
+      sketch.decay();
+    }
+  }
+  decays_.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace moxygen
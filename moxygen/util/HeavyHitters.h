@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/ThreadLocal.h>
+#include <folly/concurrency/AtomicSharedPtr.h>
+#include <moxygen/MoQFramer.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace moxygen {
+
+// Count-min sketch over hashed keys.  Estimates never undercount, and
+// overcount by at most e * total / width with probability 1 - e^-depth.
+// One thread may add while others read or merge.
+class CountMinSketch {
+ public:
+  CountMinSketch(size_t width, size_t depth);
+
+  // Returns the key's estimate after adding count
+  uint64_t add(uint64_t hash, uint64_t count);
+  uint64_t estimate(uint64_t hash) const;
+
+  // Adds the counters of other, which must have the same dimensions
+  void merge(const CountMinSketch& other);
+
+  // Halves every counter
+  void decay();
+
+  size_t width() const {
+    return width_;
+  }
+  size_t depth() const {
+    return depth_;
+  }
+
+ private:
+  size_t slot(uint64_t hash, size_t row) const;
+
+  size_t width_;
+  size_t depth_;
+  std::vector<std::atomic<uint64_t>> counters_;
+};
+
+enum class HeavyHitterMetric : uint8_t {
+  // Object bytes times the subscribers they were forwarded to
+  EGRESS_BYTES = 0,
+  SUBSCRIBES = 1,
+};
+constexpr size_t kNumHeavyHitterMetrics = 2;
+
+const char* getHeavyHitterMetricString(HeavyHitterMetric metric);
+
+// Finds the tracks that dominate each metric without a counter per track.
+// Every worker thread records into its own sketch and keeps its own top K
+// candidates, without locks; top() merges them.  Counts are cumulative until
+// decay(), so calling decay() once per report interval weights recent
+// traffic.
+class HeavyHitters {
+ public:
+  struct Config {
+    size_t topK{16};
+    size_t width{2048};
+    size_t depth{4};
+  };
+
+  explicit HeavyHitters(Config config = Config());
+
+  static uint64_t hash(const FullTrackName& fullTrackName) {
+    return FullTrackName::hash()(fullTrackName);
+  }
+
+  // Called from the worker that forwards or accepts the track.  Callers
+  // that record often should cache hash(fullTrackName) and pass it in.
+  void record(
+      HeavyHitterMetric metric,
+      const FullTrackName& fullTrackName,
+      uint64_t hash,
+      uint64_t count);
+  void record(
+      HeavyHitterMetric metric,
+      const FullTrackName& fullTrackName,
+      uint64_t count) {
+    record(metric, fullTrackName, hash(fullTrackName), count);
+  }
+
+  struct Entry {
+    FullTrackName fullTrackName;
+    uint64_t estimate{0};
+  };
+  // Up to topK tracks, largest estimate first
+  std::vector<Entry> top(HeavyHitterMetric metric) const;
+
+  // May be called from any thread
+  void decay();
+
+  const Config& config() const {
+    return config_;
+  }
+
+ private:
+  // A worker's top K tracks for one metric.  Tracks are told apart by hash.
+  class Candidates {
+   public:
+    struct Track {
+      FullTrackName fullTrackName;
+      uint64_t hash{0};
+    };
+
+    explicit Candidates(size_t topK)
+        : tracks_(topK), hashes_(topK, 0), estimates_(topK, 0) {}
+
+    // Only estimates above this can change the candidates
+    uint64_t threshold() const {
+      return threshold_;
+    }
+
+    void offer(
+        const FullTrackName& fullTrackName,
+        uint64_t hash,
+        uint64_t estimate);
+
+    void decay(size_t halvings);
+
+    // Any thread
+    template <class Fn>
+    void forEachTrack(Fn&& fn) const {
+      for (const auto& track : tracks_) {
+        if (auto t = track.load(std::memory_order_acquire)) {
+          fn(*t);
+        }
+      }
+    }
+
+   private:
+    void updateThreshold();
+
+    // Published for top()
+    std::vector<folly::atomic_shared_ptr<const Track>> tracks_;
+    // Owned by the worker
+    std::vector<uint64_t> hashes_;
+    std::vector<uint64_t> estimates_;
+    size_t size_{0};
+    uint64_t threshold_{0};
+  };
+
+  // Other threads only read the sketches and the candidates' tracks
+  struct Worker {
+    explicit Worker(const Config& config);
+
+    std::vector<CountMinSketch> sketches;
+    std::vector<Candidates> candidates;
+    uint64_t decays{0};
+  };
+  struct WorkerTag {};
+
+  Config config_;
+  // Workers halve their candidates' estimates when this changes
+  std::atomic<uint64_t> decays_{0};
+  mutable folly::ThreadLocal<Worker, WorkerTag, folly::AccessModeStrict>
+      workers_;
+};
+
+} // namespace moxygen
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/HybridTrackPublisher.h"
+
+#include <limits>
+
+namespace moxygen {
+
+size_t HybridTrackPublisher::datagramSize(
+    const ObjectHeader& header,
+    size_t payloadLength) {
+  ObjectHeader sizing = header;
+  // Largest varint, the session picks the real alias
+  sizing.trackIdentifier = TrackAlias((uint64_t(1) << 62) - 1);
+  sizing.status = ObjectStatus::NORMAL;
+  sizing.length = payloadLength;
+  folly::IOBufQueue buf{folly::IOBufQueue::cacheChainLength()};
+  auto res = writeDatagramObject(buf, sizing, nullptr);
+  if (!res) {
+    return std::numeric_limits<size_t>::max();
+  }
+  return *res + payloadLength;
+}
+
+folly::Expected<HybridTrackPublisher::Delivery, MoQPublishError>
+HybridTrackPublisher::publish(
+    const ObjectHeader& header,
+    Payload payload,
+    bool reliable) {
+  auto length = payload ? payload->computeChainDataLength() : 0;
+  if (!reliable && header.status == ObjectStatus::NORMAL &&
+      header.priority <= policy_.maxDatagramPriority) {
+    if (datagramSize(header, length) <= policy_.maxDatagramSize) {
+      auto res = consumer_->datagram(header, std::move(payload));
+      if (res.hasError()) {
+        return folly::makeUnexpected(res.error());
+      }
+      stats_.datagramObjects++;
+      stats_.datagramBytes += length;
+      return Delivery::DATAGRAM;
+    }
+    stats_.oversizeObjects++;
+  }
+  auto res = publishStream(header, std::move(payload));
+  if (res.hasError()) {
+    return folly::makeUnexpected(res.error());
+  }
+  stats_.streamObjects++;
+  stats_.streamBytes += length;
+  return Delivery::STREAM;
+}
+
+folly::Expected<folly::Unit, MoQPublishError>
+HybridTrackPublisher::publishStream(
+    const ObjectHeader& header,
+    Payload payload) {
+  switch (header.status) {
+    case ObjectStatus::GROUP_NOT_EXIST:
+      return consumer_->groupNotExists(
+          header.group, header.subgroup, header.priority, header.extensions);
+    case ObjectStatus::END_OF_TRACK: {
+      auto res = endOfSubgroup();
+      if (res.hasError()) {
+        return res;
+      }
+      return consumer_->objectStream(header, nullptr);
+    }
+    default:
+      break;
+  }
+
+  if (subgroup_ &&
+      (group_ != header.group || subgroupID_ != header.subgroup)) {
+    auto res = endOfSubgroup();
+    if (res.hasError()) {
+      return res;
+    }
+  }
+  if (!subgroup_) {
+    auto res = consumer_->beginSubgroup(
+        header.group, header.subgroup, header.priority);
+    if (res.hasError()) {
+      return folly::makeUnexpected(res.error());
+    }
+    subgroup_ = std::move(res.value());
+    group_ = header.group;
+    subgroupID_ = header.subgroup;
+    stats_.subgroupsOpened++;
+  }
+
+  switch (header.status) {
+    case ObjectStatus::NORMAL:
+      return subgroup_->object(
+          header.id, std::move(payload), header.extensions);
+    case ObjectStatus::OBJECT_NOT_EXIST:
+      return subgroup_->objectNotExists(header.id, header.extensions);
+    case ObjectStatus::END_OF_GROUP:
+      return std::exchange(subgroup_, nullptr)
+          ->endOfGroup(header.id, header.extensions);
+    case ObjectStatus::END_OF_TRACK_AND_GROUP:
+      return std::exchange(subgroup_, nullptr)
+          ->endOfTrackAndGroup(header.id, header.extensions);
+    default:
+      return folly::makeUnexpected(
+          MoQPublishError(MoQPublishError::API_ERROR, "Invalid status"));
+  }
+}
+
+folly::Expected<folly::Unit, MoQPublishError>
+HybridTrackPublisher::endOfSubgroup() {
+  if (!subgroup_) {
+    return folly::unit;
+  }
+  return std::exchange(subgroup_, nullptr)->endOfSubgroup();
+}
+
+} // namespace moxygen
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQConsumers.h"
+
+namespace moxygen {
+
+// Publishes a track mixing datagrams and subgroup streams, chosen per object.
+//
+// Objects that are small enough to fit in a datagram and urgent enough go as
+// datagrams.  Everything else, including objects the caller marks reliable and
+// all status objects, goes on a subgroup stream.  For example, audio frames
+// can go as datagrams while occasional config frames are delivered reliably.
+//
+// The stream side carries one subgroup at a time.  Publishing to a different
+// subgroup ends the open one, so objects sent on streams must be published in
+// subgroup order.
+class HybridTrackPublisher {
+ public:
+  // 1200 byte QUIC minimum MTU, less QUIC packet and DATAGRAM frame overhead
+  static constexpr size_t kDefaultMaxDatagramSize = 1150;
+
+  struct Policy {
+    // Largest encoded MoQ datagram, ie: the path MTU less QUIC overhead
+    size_t maxDatagramSize{kDefaultMaxDatagramSize};
+    // Objects with a larger (less urgent) priority value use streams
+    uint8_t maxDatagramPriority{255};
+  };
+
+  enum class Delivery { DATAGRAM, STREAM };
+
+  struct Stats {
+    uint64_t datagramObjects{0};
+    uint64_t datagramBytes{0};
+    uint64_t streamObjects{0};
+    uint64_t streamBytes{0};
+    // Objects that qualified for a datagram but did not fit
+    uint64_t oversizeObjects{0};
+    uint64_t subgroupsOpened{0};
+  };
+
+  explicit HybridTrackPublisher(
+      std::shared_ptr<TrackConsumer> consumer,
+      Policy policy = Policy())
+      : consumer_(std::move(consumer)), policy_(policy) {}
+
+  // Publishes one object or object status.  Returns how it was delivered.
+  // Stream opens can fail with BLOCKED, see TrackConsumer::awaitStreamCredit.
+  folly::Expected<Delivery, MoQPublishError> publish(
+      const ObjectHeader& header,
+      Payload payload,
+      bool reliable = false);
+
+  // Ends the open subgroup stream, if any
+  folly::Expected<folly::Unit, MoQPublishError> endOfSubgroup();
+
+  void setPolicy(Policy policy) {
+    policy_ = policy;
+  }
+
+  const Stats& getStats() const {
+    return stats_;
+  }
+
+  // Encoded size of header and payload as a datagram, assuming the largest
+  // possible track alias
+  static size_t datagramSize(const ObjectHeader& header, size_t payloadLength);
+
+ private:
+  folly::Expected<folly::Unit, MoQPublishError> publishStream(
+      const ObjectHeader& header,
+      Payload payload);
+
+  std::shared_ptr<TrackConsumer> consumer_;
+  Policy policy_;
+  Stats stats_;
+
+  std::shared_ptr<SubgroupConsumer> subgroup_;
+  uint64_t group_{0};
+  uint64_t subgroupID_{0};
+};
+
+} // namespace moxygen
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/LoopLagMonitor.h"
+#include "moxygen/stats/MoQStats.h"
+
+#include <folly/Utility.h>
+#include <folly/io/async/EventBaseObserver.h>
+#include <folly/logging/xlog.h>
+
+namespace moxygen {
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+thread_local LoopLagMonitor* LoopLagMonitor::current_{nullptr};
+
+const char* getLoopSubsystemString(LoopSubsystem subsystem) {
+  switch (subsystem) {
+    case LoopSubsystem::OTHER:
+      return "other";
+    case LoopSubsystem::CONTROL_PARSE:
+      return "control_parse";
+    case LoopSubsystem::DATA_PARSE:
+      return "data_parse";
+    case LoopSubsystem::FORWARD:
+      return "forward";
+    case LoopSubsystem::RELAY:
+      return "relay";
+  }
+  return "unknown";
+}
+
+class LoopLagMonitor::Observer : public folly::EventBaseObserver {
+ public:
+  explicit Observer(LoopLagMonitor& monitor) : monitor_(monitor) {}
+
+  uint32_t getSampleRate() const override {
+    return 1;
+  }
+
+  void loopSample(int64_t busyTime, int64_t /*idleTime*/) override {
+    monitor_.onLoopSample(microseconds(busyTime));
+  }
+
+ private:
+  LoopLagMonitor& monitor_;
+};
+
+LoopLagMonitor::LoopLagMonitor(
+    folly::EventBase* evb,
+    Config config,
+    std::shared_ptr<MoQLoopStatsCallback> callback)
+    : folly::AsyncTimeout(evb),
+      evb_(evb),
+      config_(config),
+      callback_(std::move(callback)),
+      observer_(std::make_shared<Observer>(*this)) {
+  evb_->dcheckIsInEventBaseThread();
+  XCHECK(!current_) << "Only one LoopLagMonitor per thread";
+  current_ = this;
+  evb_->setObserver(observer_);
+  lastSwitch_ = lastReport_ = steady_clock::now();
+  stats_.evb = evb_;
+  scheduleProbe();
+}
+
+LoopLagMonitor::~LoopLagMonitor() {
+  if (current_ == this) {
+    current_ = nullptr;
+  }
+  evb_->setObserver(nullptr);
+}
+
+void LoopLagMonitor::install(
+    const std::vector<folly::EventBase*>& evbs,
+    Config config,
+    std::shared_ptr<MoQLoopStatsCallback> callback) {
+  for (auto evb : evbs) {
+    evb->runInEventBaseThread([evb, config, callback] {
+      auto monitor = new LoopLagMonitor(evb, config, callback);
+      evb->runOnDestruction([monitor] { delete monitor; });
+    });
+  }
+}
+
+LoopSubsystem LoopLagMonitor::enter(LoopSubsystem subsystem) {
+  auto prev = active_;
+  if (subsystem == prev) {
+    return prev;
+  }
+  auto now = steady_clock::now();
+  if (prev != LoopSubsystem::OTHER) {
+    loopBusy_[folly::to_underlying(prev)] += now - lastSwitch_;
+  }
+  active_ = subsystem;
+  lastSwitch_ = now;
+  return prev;
+}
+
+void LoopLagMonitor::onLoopSample(microseconds busy) {
+  if (active_ != LoopSubsystem::OTHER) {
+    // Loop callbacks never span iterations, but be safe
+    enter(LoopSubsystem::OTHER);
+  }
+  microseconds attributed{0};
+  size_t dominant = 0;
+  microseconds dominantSpent{0};
+  for (size_t i = 1; i < kNumLoopSubsystems; i++) {
+    auto spent = duration_cast<microseconds>(loopBusy_[i]);
+    loopBusy_[i] = std::chrono::nanoseconds(0);
+    stats_.subsystemBusy[i] += spent;
+    attributed += spent;
+    if (spent > dominantSpent) {
+      dominant = i;
+      dominantSpent = spent;
+    }
+  }
+  auto other = busy > attributed ? busy - attributed : microseconds(0);
+  stats_.subsystemBusy[0] += other;
+  if (other >= dominantSpent) {
+    dominant = 0;
+  }
+
+  stats_.loops++;
+  stats_.totalBusy += busy;
+  if (busy >= config_.slowLoopThreshold) {
+    stats_.slowLoops++;
+  }
+  if (busy > stats_.maxLoopBusy) {
+    stats_.maxLoopBusy = busy;
+    stats_.maxLoopSubsystem = LoopSubsystem(dominant);
+  }
+}
+
+void LoopLagMonitor::scheduleProbe() {
+  probeDeadline_ = steady_clock::now() + config_.probeInterval;
+  scheduleTimeout(config_.probeInterval);
+}
+
+void LoopLagMonitor::timeoutExpired() noexcept {
+  auto now = steady_clock::now();
+  auto delay = now > probeDeadline_
+      ? duration_cast<microseconds>(now - probeDeadline_)
+      : microseconds(0);
+  stats_.lagSamples++;
+  stats_.totalSchedulingDelay += delay;
+  stats_.maxSchedulingDelay = std::max(stats_.maxSchedulingDelay, delay);
+  if (now - lastReport_ >= config_.reportInterval) {
+    report(now);
+  }
+  scheduleProbe();
+}
+
+void LoopLagMonitor::report(steady_clock::time_point now) {
+  stats_.interval =
+      std::chrono::duration_cast<std::chrono::milliseconds>(now - lastReport_);
+  if (callback_) {
+    callback_->onLoopStats(stats_);
+  }
+  stats_ = LoopStats();
+  stats_.evb = evb_;
+  lastReport_ = now;
+}
+
+} // namespace moxygen
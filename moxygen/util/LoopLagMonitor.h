@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Preprocessor.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+#include <array>
+#include <chrono>
+
+namespace moxygen {
+
+class MoQLoopStatsCallback;
+
+// Work that runs on a worker EventBase, for attributing loop time
+enum class LoopSubsystem : uint8_t {
+  OTHER = 0,
+  CONTROL_PARSE = 1,
+  DATA_PARSE = 2,
+  FORWARD = 3,
+  RELAY = 4,
+};
+constexpr size_t kNumLoopSubsystems = 5;
+
+const char* getLoopSubsystemString(LoopSubsystem subsystem);
+
+struct LoopStats {
+  folly::EventBase* evb{nullptr};
+  std::chrono::milliseconds interval{0};
+
+  // Loop iterations
+  uint64_t loops{0};
+  uint64_t slowLoops{0};
+  std::chrono::microseconds totalBusy{0};
+  std::chrono::microseconds maxLoopBusy{0};
+  // Subsystem that used the most time in the longest iteration
+  LoopSubsystem maxLoopSubsystem{LoopSubsystem::OTHER};
+
+  // How late a timer scheduled on the loop ran
+  uint64_t lagSamples{0};
+  std::chrono::microseconds totalSchedulingDelay{0};
+  std::chrono::microseconds maxSchedulingDelay{0};
+
+  // Time inside MOQ_LOOP_SCOPE markers, by subsystem.  OTHER is busy time
+  // outside any marker.
+  std::array<std::chrono::microseconds, kNumLoopSubsystems> subsystemBusy{};
+};
+
+// Measures how responsive one EventBase is.
+//
+// A probe timer measures scheduling delay, and an EventBaseObserver records
+// the busy time of every loop iteration.  Code marked with MOQ_LOOP_SCOPE is
+// charged to its subsystem, exclusive of nested scopes.  A LoopStats summary
+// goes to the callback every reportInterval, on the monitored thread.
+//
+// Replaces any other EventBaseObserver on the evb.
+class LoopLagMonitor : public folly::AsyncTimeout {
+ public:
+  struct Config {
+    std::chrono::milliseconds probeInterval{std::chrono::milliseconds(100)};
+    std::chrono::milliseconds reportInterval{std::chrono::seconds(10)};
+    // Iterations at least this long count as slow loops
+    std::chrono::microseconds slowLoopThreshold{
+        std::chrono::milliseconds(10)};
+  };
+
+  // Must be constructed on the evb thread
+  LoopLagMonitor(
+      folly::EventBase* evb,
+      Config config,
+      std::shared_ptr<MoQLoopStatsCallback> callback);
+  ~LoopLagMonitor() override;
+
+  // Starts a monitor on each evb.  Each monitor is owned by its evb and
+  // destroyed with it.
+  static void install(
+      const std::vector<folly::EventBase*>& evbs,
+      Config config,
+      std::shared_ptr<MoQLoopStatsCallback> callback);
+
+  // Monitor of the current thread, if any
+  static LoopLagMonitor* current() {
+    return current_;
+  }
+
+  // Charges the time since the last switch to the active subsystem and makes
+  // subsystem active.  Returns the previously active subsystem.
+  LoopSubsystem enter(LoopSubsystem subsystem);
+
+ private:
+  class Observer;
+
+  void timeoutExpired() noexcept override;
+  void onLoopSample(std::chrono::microseconds busy);
+  void scheduleProbe();
+  void report(std::chrono::steady_clock::time_point now);
+
+  static thread_local LoopLagMonitor* current_;
+
+  folly::EventBase* evb_;
+  Config config_;
+  std::shared_ptr<MoQLoopStatsCallback> callback_;
+  std::shared_ptr<Observer> observer_;
+
+  LoopSubsystem active_{LoopSubsystem::OTHER};
+  std::chrono::steady_clock::time_point lastSwitch_;
+  // Time charged to each subsystem in the current iteration
+  std::array<std::chrono::nanoseconds, kNumLoopSubsystems> loopBusy_{};
+
+  std::chrono::steady_clock::time_point probeDeadline_;
+  std::chrono::steady_clock::time_point lastReport_;
+  LoopStats stats_;
+};
+
+// Charges the enclosing scope to a subsystem of the thread's LoopLagMonitor.
+// Costs a thread local read when no monitor is installed.
+class LoopScope {
+ public:
+  explicit LoopScope(LoopSubsystem subsystem)
+      : monitor_(LoopLagMonitor::current()) {
+    if (monitor_) {
+      prev_ = monitor_->enter(subsystem);
+    }
+  }
+  ~LoopScope() {
+    if (monitor_) {
+      monitor_->enter(prev_);
+    }
+  }
+  LoopScope(const LoopScope&) = delete;
+  LoopScope& operator=(const LoopScope&) = delete;
+
+ private:
+  LoopLagMonitor* monitor_;
+  LoopSubsystem prev_{LoopSubsystem::OTHER};
+};
+
+#define MOQ_LOOP_SCOPE(subsystem)                     \
+  ::moxygen::LoopScope FB_ANONYMOUS_VARIABLE(loopScope)( \
+      ::moxygen::LoopSubsystem::subsystem)
+
+} // namespace moxygen
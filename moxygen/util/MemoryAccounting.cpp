@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/MemoryAccounting.h"
+
+#include <folly/Synchronized.h>
+#include <folly/ThreadLocal.h>
+#include <folly/Utility.h>
+#include <folly/logging/xlog.h>
+#include <folly/memory/MallctlHelper.h>
+#include <folly/memory/Malloc.h>
+
+namespace {
+using moxygen::kNumMemSubsystems;
+using moxygen::MemSubsystem;
+
+using Counters = std::array<std::atomic<uint64_t>, kNumMemSubsystems>;
+
+// Totals of exited threads
+Counters retiredAllocated;
+Counters retiredFreed;
+Counters retiredScopes;
+
+// Only written by the owning thread, read by snapshot
+struct ThreadAccount {
+  ThreadAccount() {
+    if (!folly::usingJEMalloc()) {
+      return;
+    }
+    try {
+      folly::mallctlRead("thread.allocatedp", &allocatedp);
+      folly::mallctlRead("thread.deallocatedp", &deallocatedp);
+      lastAllocated = *allocatedp;
+      lastFreed = *deallocatedp;
+    } catch (const std::exception& ex) {
+      XLOG(ERR) << "No jemalloc thread counters: " << ex.what();
+      allocatedp = deallocatedp = nullptr;
+    }
+  }
+
+  ~ThreadAccount() {
+    charge();
+    for (size_t i = 0; i < kNumMemSubsystems; i++) {
+      retiredAllocated[i] += allocated[i].load(std::memory_order_relaxed);
+      retiredFreed[i] += freed[i].load(std::memory_order_relaxed);
+      retiredScopes[i] += scopes[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  void charge() {
+    if (!allocatedp) {
+      return;
+    }
+    auto nowAllocated = *allocatedp;
+    auto nowFreed = *deallocatedp;
+    auto i = folly::to_underlying(active);
+    allocated[i].fetch_add(
+        nowAllocated - lastAllocated, std::memory_order_relaxed);
+    freed[i].fetch_add(nowFreed - lastFreed, std::memory_order_relaxed);
+    lastAllocated = nowAllocated;
+    lastFreed = nowFreed;
+  }
+
+  uint64_t* allocatedp{nullptr};
+  uint64_t* deallocatedp{nullptr};
+  uint64_t lastAllocated{0};
+  uint64_t lastFreed{0};
+  MemSubsystem active{MemSubsystem::OTHER};
+  Counters allocated{};
+  Counters freed{};
+  Counters scopes{};
+};
+
+struct AccountTag {};
+folly::ThreadLocal<ThreadAccount, AccountTag, folly::AccessModeStrict>
+    accounts;
+
+folly::Synchronized<std::vector<unsigned>> arenas;
+} // namespace
+
+namespace moxygen {
+
+std::atomic<bool> MemoryAccounting::enabled_{false};
+
+const char* getMemSubsystemString(MemSubsystem subsystem) {
+  switch (subsystem) {
+    case MemSubsystem::OTHER:
+      return "other";
+    case MemSubsystem::CONTROL:
+      return "control";
+    case MemSubsystem::FORWARDER:
+      return "forwarder";
+    case MemSubsystem::CODEC:
+      return "codec";
+    case MemSubsystem::CACHE:
+      return "cache";
+  }
+  return "unknown";
+}
+
+bool MemoryAccounting::usingJemalloc() {
+  return folly::usingJEMalloc();
+}
+
+folly::Expected<unsigned, std::string> MemoryAccounting::bindThreadArena() {
+  if (!usingJemalloc()) {
+    return folly::makeUnexpected(std::string("not using jemalloc"));
+  }
+  try {
+    unsigned arena = 0;
+    folly::mallctlRead("arenas.create", &arena);
+    folly::mallctlWrite("thread.arena", arena);
+    arenas.wlock()->push_back(arena);
+    return arena;
+  } catch (const std::exception& ex) {
+    return folly::makeUnexpected(std::string(ex.what()));
+  }
+}
+
+void MemoryAccounting::bindWorkerArenas(
+    const std::vector<folly::EventBase*>& evbs) {
+  for (auto evb : evbs) {
+    evb->runInEventBaseThread([evb] {
+      auto arena = bindThreadArena();
+      if (arena.hasError()) {
+        XLOG(ERR) << "Failed to bind arena for evb=" << evb
+                  << " err=" << arena.error();
+        return;
+      }
+      XLOG(DBG1) << "evb=" << evb << " bound to arena " << arena.value();
+    });
+  }
+}
+
+MemStats MemoryAccounting::snapshot() {
+  MemStats stats;
+  stats.jemalloc = usingJemalloc();
+  for (size_t i = 0; i < kNumMemSubsystems; i++) {
+    auto& sub = stats.subsystems[i];
+    sub.allocatedBytes = retiredAllocated[i].load(std::memory_order_relaxed);
+    sub.freedBytes = retiredFreed[i].load(std::memory_order_relaxed);
+    sub.scopes = retiredScopes[i].load(std::memory_order_relaxed);
+  }
+  // Bytes in a scope that is still open are charged when it is left
+  for (const auto& account : accounts.accessAllThreads()) {
+    for (size_t i = 0; i < kNumMemSubsystems; i++) {
+      auto& sub = stats.subsystems[i];
+      sub.allocatedBytes +=
+          account.allocated[i].load(std::memory_order_relaxed);
+      sub.freedBytes += account.freed[i].load(std::memory_order_relaxed);
+      sub.scopes += account.scopes[i].load(std::memory_order_relaxed);
+    }
+  }
+  return stats;
+}
+
+std::vector<ArenaStats> MemoryAccounting::arenaStats() {
+  std::vector<ArenaStats> result;
+  if (!usingJemalloc()) {
+    return result;
+  }
+  auto read = [](unsigned arena, const char* stat) -> uint64_t {
+    auto cmd = fmt::format("stats.arenas.{}.{}", arena, stat);
+    size_t value = 0;
+    folly::mallctlRead(cmd.c_str(), &value);
+    return value;
+  };
+  try {
+    // Refresh the stats snapshot
+    uint64_t epoch = 1;
+    folly::mallctlReadWrite("epoch", &epoch, epoch);
+    for (auto arena : *arenas.rlock()) {
+      ArenaStats stats;
+      stats.arena = arena;
+      stats.allocations =
+          read(arena, "small.nmalloc") + read(arena, "large.nmalloc");
+      stats.deallocations =
+          read(arena, "small.ndalloc") + read(arena, "large.ndalloc");
+      stats.allocatedBytes =
+          read(arena, "small.allocated") + read(arena, "large.allocated");
+      result.push_back(stats);
+    }
+  } catch (const std::exception& ex) {
+    XLOG(ERR) << "Failed to read arena stats: " << ex.what();
+  }
+  return result;
+}
+
+MemSubsystem MemoryAccounting::enter(MemSubsystem subsystem) {
+  auto& account = *accounts;
+  account.scopes[folly::to_underlying(subsystem)].fetch_add(
+      1, std::memory_order_relaxed);
+  auto prev = account.active;
+  if (subsystem != prev) {
+    account.charge();
+    account.active = subsystem;
+  }
+  return prev;
+}
+
+void MemoryAccounting::restore(MemSubsystem subsystem) {
+  auto& account = *accounts;
+  if (subsystem != account.active) {
+    account.charge();
+    account.active = subsystem;
+  }
+}
+
+} // namespace moxygen
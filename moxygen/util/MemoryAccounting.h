@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Expected.h>
+#include <folly/Preprocessor.h>
+#include <folly/io/async/EventBase.h>
+#include <array>
+#include <atomic>
+
+namespace moxygen {
+
+// Owner of allocations, for accounting heap use
+enum class MemSubsystem : uint8_t {
+  OTHER = 0,
+  CONTROL = 1,
+  FORWARDER = 2,
+  CODEC = 3,
+  CACHE = 4,
+};
+constexpr size_t kNumMemSubsystems = 5;
+
+const char* getMemSubsystemString(MemSubsystem subsystem);
+
+struct MemSubsystemStats {
+  // Bytes allocated and freed by the thread while the subsystem was active.
+  // Frees are charged where they happen, not to the allocating subsystem.
+  uint64_t allocatedBytes{0};
+  uint64_t freedBytes{0};
+  // Times a MOQ_MEM_SCOPE for the subsystem was entered
+  uint64_t scopes{0};
+};
+
+struct MemStats {
+  // False without jemalloc, only scopes are counted then
+  bool jemalloc{false};
+  std::array<MemSubsystemStats, kNumMemSubsystems> subsystems{};
+};
+
+// Per worker arena usage, from jemalloc's arena stats
+struct ArenaStats {
+  unsigned arena{0};
+  uint64_t allocations{0};
+  uint64_t deallocations{0};
+  uint64_t allocatedBytes{0};
+};
+
+// Heap placement and accounting for worker threads, on top of jemalloc.
+//
+// bindWorkerArenas gives each worker EventBase its own arena so workers do
+// not contend on arena locks.  With accounting enabled, code marked with
+// MOQ_MEM_SCOPE is charged the bytes its thread allocates and frees, read
+// from jemalloc's per thread counters when entering and leaving a scope and
+// exclusive of nested scopes.  Everything is a no-op without jemalloc.
+class MemoryAccounting {
+ public:
+  static bool usingJemalloc();
+
+  // Creates an arena for the calling thread.  Returns its index.
+  static folly::Expected<unsigned, std::string> bindThreadArena();
+
+  // Binds every evb thread to an arena of its own
+  static void bindWorkerArenas(const std::vector<folly::EventBase*>& evbs);
+
+  static void setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  static bool enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // Totals over all threads, including exited ones
+  static MemStats snapshot();
+
+  // Stats of every arena created by bindThreadArena
+  static std::vector<ArenaStats> arenaStats();
+
+  // Charges the thread's allocations since the last switch to the active
+  // subsystem and makes subsystem active.  Returns the previously active
+  // subsystem.
+  static MemSubsystem enter(MemSubsystem subsystem);
+  static void restore(MemSubsystem subsystem);
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+// Charges the enclosing scope to a subsystem.  Costs an atomic load when
+// accounting is disabled.
+class MemScope {
+ public:
+  explicit MemScope(MemSubsystem subsystem)
+      : active_(MemoryAccounting::enabled()) {
+    if (active_) {
+      prev_ = MemoryAccounting::enter(subsystem);
+    }
+  }
+  ~MemScope() {
+    if (active_) {
+      MemoryAccounting::restore(prev_);
+    }
+  }
+  MemScope(const MemScope&) = delete;
+  MemScope& operator=(const MemScope&) = delete;
+
+ private:
+  bool active_;
+  MemSubsystem prev_{MemSubsystem::OTHER};
+};
+
+#define MOQ_MEM_SCOPE(subsystem)                    \
+  ::moxygen::MemScope FB_ANONYMOUS_VARIABLE(memScope)( \
+      ::moxygen::MemSubsystem::subsystem)
+
+} // namespace moxygen
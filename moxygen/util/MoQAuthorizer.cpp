@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/MoQAuthorizer.h"
+
+#include <folly/String.h>
+#include <folly/coro/Invoke.h>
+#include <folly/logging/xlog.h>
+#include <folly/ssl/OpenSSLHash.h>
+
+#include <openssl/crypto.h>
+
+namespace {
+constexpr size_t kMacBytes = 32;
+
+std::string hmac(const std::string& key, folly::StringPiece data) {
+  std::array<uint8_t, kMacBytes> mac;
+  folly::ssl::OpenSSLHash::hmac_sha256(
+      folly::range(mac),
+      folly::ByteRange(folly::StringPiece(key)),
+      folly::ByteRange(data));
+  std::string hex;
+  folly::hexlify(mac, hex);
+  return hex;
+}
+} // namespace
+
+namespace moxygen {
+
+folly::Expected<AuthGrant, std::string> HmacTokenVerifier::verify(
+    const std::string& token) {
+  auto macPos = token.rfind('|');
+  if (macPos == std::string::npos) {
+    return folly::makeUnexpected(std::string("malformed token"));
+  }
+  folly::StringPiece signedPart(token.data(), macPos);
+  auto expected = hmac(key_, signedPart);
+  auto mac = folly::StringPiece(token).subpiece(macPos + 1);
+  if (mac.size() != expected.size() ||
+      CRYPTO_memcmp(mac.data(), expected.data(), mac.size()) != 0) {
+    return folly::makeUnexpected(std::string("bad signature"));
+  }
+  std::vector<folly::StringPiece> fields;
+  folly::split('|', signedPart, fields);
+  if (fields.size() != 3) {
+    return folly::makeUnexpected(std::string("malformed token"));
+  }
+  auto actions = folly::tryTo<uint8_t>(fields[1]);
+  auto expiry = folly::tryTo<int64_t>(fields[2]);
+  if (!actions || !expiry) {
+    return folly::makeUnexpected(std::string("malformed token"));
+  }
+  AuthGrant grant;
+  if (!fields[0].empty()) {
+    grant.scope = TrackNamespace(fields[0].str(), "/");
+  }
+  grant.actions = *actions;
+  grant.expiry = std::chrono::system_clock::time_point(
+      std::chrono::seconds(*expiry));
+  return grant;
+}
+
+std::string HmacTokenVerifier::sign(
+    const std::string& key,
+    const AuthGrant& grant) {
+  auto signedPart = folly::to<std::string>(
+      grant.scope.describe(),
+      "|",
+      grant.actions,
+      "|",
+      std::chrono::duration_cast<std::chrono::seconds>(
+          grant.expiry.time_since_epoch())
+          .count());
+  return folly::to<std::string>(signedPart, "|", hmac(key, signedPart));
+}
+
+MoQAuthorizer::MoQAuthorizer(
+    std::shared_ptr<MoQTokenVerifier> verifier,
+    Config config,
+    folly::Executor::KeepAlive<> verifyExecutor)
+    : verifier_(std::move(verifier)),
+      config_(config),
+      verifyExecutor_(std::move(verifyExecutor)),
+      cache_([size = config.cacheSize] { return new ThreadCache(size); }) {}
+
+folly::Optional<std::string> MoQAuthorizer::findToken(
+    const std::vector<TrackRequestParameter>& params) {
+  for (const auto& param : params) {
+    if (param.key ==
+        folly::to_underlying(TrackRequestParamKey::AUTHORIZATION)) {
+      return param.asString;
+    }
+  }
+  return folly::none;
+}
+
+folly::coro::Task<MoQAuthorizer::Result> MoQAuthorizer::authorize(
+    const std::vector<TrackRequestParameter>& params,
+    const TrackNamespace& ns,
+    AuthAction action) {
+  auto token = findToken(params);
+  if (!token) {
+    return folly::coro::makeTask<Result>(
+        folly::makeUnexpected(std::string("missing authorization")));
+  }
+  auto& results = cache_->results;
+  auto it = results.find(*token);
+  if (it != results.end()) {
+    if (it->second.verified.hasValue() ||
+        std::chrono::steady_clock::now() < it->second.expires) {
+      return folly::coro::makeTask<Result>(
+          check(it->second.verified, ns, action));
+    }
+    results.erase(*token);
+  }
+  return authorizeUncached(std::move(*token), ns, action);
+}
+
+folly::coro::Task<MoQAuthorizer::Result> MoQAuthorizer::authorizeUncached(
+    std::string token,
+    TrackNamespace ns,
+    AuthAction action) {
+  auto inflightIt = cache_->inflight.find(token);
+  if (inflightIt != cache_->inflight.end()) {
+    auto promise = inflightIt->second;
+    auto verified = co_await promise->getFuture();
+    co_return check(verified, ns, action);
+  }
+  auto promise = std::make_shared<folly::coro::SharedPromise<Verified>>();
+  cache_->inflight.emplace(token, promise);
+  auto verifiedTry = co_await folly::coro::co_awaitTry(verify(token));
+  // Resumed on the calling thread, so this is the same ThreadCache
+  auto& cache = *cache_;
+  cache.inflight.erase(token);
+  if (verifiedTry.hasException()) {
+    // Not cached, the next request with this token tries again
+    promise->setValue(
+        folly::makeUnexpected(std::string("token verification failed")));
+    if (verifiedTry.hasException<folly::OperationCancelled>()) {
+      co_yield folly::coro::co_error(std::move(verifiedTry.exception()));
+    }
+    XLOG(ERR) << "Token verification failed: "
+              << verifiedTry.exception().what();
+    co_return folly::makeUnexpected(std::string("token verification failed"));
+  }
+  auto verified = std::move(verifiedTry.value());
+  cache.results.set(
+      token,
+      {verified, std::chrono::steady_clock::now() + config_.negativeTTL});
+  promise->setValue(verified);
+  co_return check(verified, ns, action);
+}
+
+folly::coro::Task<MoQAuthorizer::Verified> MoQAuthorizer::verify(
+    std::string token) {
+  if (!verifier_->expensive() || !verifyExecutor_) {
+    co_return verifier_->verify(token);
+  }
+  co_return co_await folly::coro::co_invoke(
+      [verifier = verifier_,
+       token = std::move(token)]() -> folly::coro::Task<Verified> {
+        co_return verifier->verify(token);
+      })
+      .scheduleOn(verifyExecutor_);
+}
+
+MoQAuthorizer::Result MoQAuthorizer::check(
+    const Verified& verified,
+    const TrackNamespace& ns,
+    AuthAction action) {
+  if (verified.hasError()) {
+    return folly::makeUnexpected(verified.error());
+  }
+  if (!verified->allows(ns, action, std::chrono::system_clock::now())) {
+    return folly::makeUnexpected(std::string("token does not allow request"));
+  }
+  return folly::unit;
+}
+
+} // namespace moxygen
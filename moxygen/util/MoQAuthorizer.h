@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQFramer.h"
+
+#include <folly/Executor.h>
+#include <folly/ThreadLocal.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/container/F14Map.h>
+#include <folly/coro/SharedPromise.h>
+#include <folly/coro/Task.h>
+
+namespace moxygen {
+
+// Bit flags, a token may allow several
+enum class AuthAction : uint8_t {
+  SUBSCRIBE = 0x1,
+  FETCH = 0x2,
+  ANNOUNCE = 0x4,
+  SUBSCRIBE_ANNOUNCES = 0x8,
+};
+
+// What a verified token allows
+struct AuthGrant {
+  // Namespaces starting with scope, empty allows every namespace
+  TrackNamespace scope;
+  uint8_t actions{0};
+  std::chrono::system_clock::time_point expiry;
+
+  bool allows(
+      const TrackNamespace& ns,
+      AuthAction action,
+      std::chrono::system_clock::time_point now) const {
+    return (actions & folly::to_underlying(action)) && now < expiry &&
+        ns.startsWith(scope);
+  }
+};
+
+// Checks the value of an AUTHORIZATION parameter
+class MoQTokenVerifier {
+ public:
+  virtual ~MoQTokenVerifier() = default;
+
+  virtual folly::Expected<AuthGrant, std::string> verify(
+      const std::string& token) = 0;
+
+  // Whether verify is too slow to run on an event loop
+  virtual bool expensive() const {
+    return false;
+  }
+};
+
+// Verifies tokens of the form
+//   <scope, '/' delimited>|<AuthAction bits>|<expiry, unix seconds>|<mac>
+// where mac is the hex HMAC-SHA256 of the text before it.
+class HmacTokenVerifier : public MoQTokenVerifier {
+ public:
+  explicit HmacTokenVerifier(std::string key) : key_(std::move(key)) {}
+
+  folly::Expected<AuthGrant, std::string> verify(
+      const std::string& token) override;
+
+  static std::string sign(const std::string& key, const AuthGrant& grant);
+
+ private:
+  std::string key_;
+};
+
+// Authorizes requests by their AUTHORIZATION token.  Verification results,
+// including failures, are cached in an LRU per thread, so repeated requests
+// with one token are a hash lookup on the calling event loop.  Concurrent
+// requests with an uncached token on one thread share a single verification.
+// Expensive verifiers run on verifyExecutor when one is given.
+class MoQAuthorizer {
+ public:
+  struct Config {
+    size_t cacheSize{4096};
+    // How long a failed verification is remembered
+    std::chrono::milliseconds negativeTTL{5000};
+  };
+
+  explicit MoQAuthorizer(
+      std::shared_ptr<MoQTokenVerifier> verifier,
+      Config config = Config(),
+      folly::Executor::KeepAlive<> verifyExecutor = {});
+
+  using Result = folly::Expected<folly::Unit, std::string>;
+  folly::coro::Task<Result> authorize(
+      const std::vector<TrackRequestParameter>& params,
+      const TrackNamespace& ns,
+      AuthAction action);
+
+  static folly::Optional<std::string> findToken(
+      const std::vector<TrackRequestParameter>& params);
+
+ private:
+  using Verified = folly::Expected<AuthGrant, std::string>;
+
+  struct CachedResult {
+    Verified verified;
+    // Failures only, grants carry their own expiry
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  struct ThreadCache {
+    explicit ThreadCache(size_t size) : results(size) {}
+
+    folly::EvictingCacheMap<std::string, CachedResult> results;
+    folly::F14FastMap<
+        std::string,
+        std::shared_ptr<folly::coro::SharedPromise<Verified>>>
+        inflight;
+  };
+
+  folly::coro::Task<Result>
+  authorizeUncached(std::string token, TrackNamespace ns, AuthAction action);
+  folly::coro::Task<Verified> verify(std::string token);
+  static Result check(
+      const Verified& verified,
+      const TrackNamespace& ns,
+      AuthAction action);
+
+  std::shared_ptr<MoQTokenVerifier> verifier_;
+  Config config_;
+  folly::Executor::KeepAlive<> verifyExecutor_;
+  folly::ThreadLocal<ThreadCache> cache_;
+};
+
+} // namespace moxygen
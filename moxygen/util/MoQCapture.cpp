@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/MoQCapture.h"
+
+#include <folly/FileUtil.h>
+#include <folly/executors/SerialExecutor.h>
+#include <folly/io/Cursor.h>
+#include <folly/logging/xlog.h>
+
+#include <fcntl.h>
+#include <fmt/format.h>
+
+namespace {
+constexpr folly::StringPiece kCaptureMagic{"MOQCAP01"};
+constexpr size_t kRecordHeaderSize = 1 + 1 + 8 + 8 + 4;
+constexpr size_t kFlushThreshold = 64 * 1024;
+// Capture is disabled rather than buffering more than this for the disk
+constexpr uint64_t kMaxQueuedBytes = 64 * 1024 * 1024;
+
+std::unique_ptr<folly::IOBuf> readCapture(const std::string& path) {
+  std::string contents;
+  if (!folly::readFile(path.c_str(), contents)) {
+    throw std::runtime_error(fmt::format("Failed to read capture {}", path));
+  }
+  if (contents.size() < kCaptureMagic.size() + 1 ||
+      folly::StringPiece(contents).subpiece(0, kCaptureMagic.size()) !=
+          kCaptureMagic) {
+    throw std::runtime_error(fmt::format("Not a MoQ capture {}", path));
+  }
+  return folly::IOBuf::fromString(std::move(contents));
+}
+} // namespace
+
+namespace moxygen {
+
+MoQCaptureWriter::Output::Output(const std::string& path)
+    : file(path, O_WRONLY | O_CREAT | O_TRUNC) {}
+
+void MoQCaptureWriter::Output::write(std::unique_ptr<folly::IOBuf> buf) {
+  if (error) {
+    return;
+  }
+  for (auto range : *buf) {
+    auto res = folly::writeFull(file.fd(), range.data(), range.size());
+    if (res < 0 || size_t(res) != range.size()) {
+      XLOG(ERR) << "Capture write failed, disabling capture errno=" << errno;
+      error = true;
+      return;
+    }
+  }
+}
+
+MoQCaptureWriter::MoQCaptureWriter(
+    const std::string& path,
+    MoQControlCodec::Direction dir,
+    folly::Executor::KeepAlive<> writeExecutor)
+    : output_(std::make_shared<Output>(path)),
+      start_(std::chrono::steady_clock::now()) {
+  if (writeExecutor) {
+    // Keeps the records in order on a multi-threaded executor
+    writeExecutor_ = folly::SerialExecutor::create(std::move(writeExecutor));
+  }
+  folly::io::QueueAppender appender(&buf_, kCaptureMagic.size() + 1);
+  appender.push(
+      reinterpret_cast<const uint8_t*>(kCaptureMagic.data()),
+      kCaptureMagic.size());
+  appender.writeBE<uint8_t>(folly::to_underlying(dir));
+}
+
+MoQCaptureWriter::~MoQCaptureWriter() {
+  flush();
+}
+
+void MoQCaptureWriter::append(
+    CaptureRecordType type,
+    uint64_t streamID,
+    const folly::IOBuf* data,
+    bool fin) {
+  if (output_->error) {
+    return;
+  }
+  auto length = data ? data->computeChainDataLength() : 0;
+  auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_);
+  folly::io::QueueAppender appender(&buf_, kRecordHeaderSize + length);
+  appender.writeBE<uint8_t>(folly::to_underlying(type));
+  appender.writeBE<uint8_t>(fin ? 1 : 0);
+  appender.writeBE<uint64_t>(streamID);
+  appender.writeBE<uint64_t>(timestamp.count());
+  appender.writeBE<uint32_t>(length);
+  if (data) {
+    // Copy rather than clone so the capture doesn't pin transport buffers
+    for (auto range : *data) {
+      appender.push(range.data(), range.size());
+    }
+  }
+  if (buf_.chainLength() >= kFlushThreshold) {
+    flush();
+  }
+}
+
+void MoQCaptureWriter::flush() {
+  if (output_->error || buf_.empty()) {
+    return;
+  }
+  auto buf = buf_.move();
+  if (!writeExecutor_) {
+    output_->write(std::move(buf));
+    return;
+  }
+  auto length = buf->computeChainDataLength();
+  if (output_->queuedBytes.fetch_add(length) + length > kMaxQueuedBytes) {
+    XLOG(ERR) << "Capture writes fell behind, disabling capture";
+    output_->error = true;
+    return;
+  }
+  writeExecutor_->add(
+      [output = output_, buf = std::move(buf), length]() mutable {
+        output->write(std::move(buf));
+        output->queuedBytes -= length;
+      });
+}
+
+MoQCaptureReader::MoQCaptureReader(const std::string& path)
+    : contents_(readCapture(path)), cursor_(contents_.get()) {
+  cursor_.skip(kCaptureMagic.size());
+  dir_ = MoQControlCodec::Direction(cursor_.readBE<uint8_t>());
+}
+
+folly::Expected<CaptureRecord, ErrorCode> MoQCaptureReader::next() {
+  if (!cursor_.canAdvance(kRecordHeaderSize)) {
+    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+  }
+  CaptureRecord record;
+  auto type = cursor_.readBE<uint8_t>();
+  if (type > folly::to_underlying(CaptureRecordType::DATAGRAM)) {
+    XLOG(ERR) << "Invalid capture record type=" << uint32_t(type);
+    return folly::makeUnexpected(ErrorCode::PARSE_ERROR);
+  }
+  record.type = CaptureRecordType(type);
+  record.fin = cursor_.readBE<uint8_t>() & 0x1;
+  record.streamID = cursor_.readBE<uint64_t>();
+  record.timestamp = std::chrono::microseconds(cursor_.readBE<uint64_t>());
+  auto length = cursor_.readBE<uint32_t>();
+  if (!cursor_.canAdvance(length)) {
+    return folly::makeUnexpected(ErrorCode::PARSE_UNDERFLOW);
+  }
+  if (length > 0) {
+    cursor_.clone(record.data, length);
+  }
+  return record;
+}
+
+} // namespace moxygen
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQCodec.h"
+
+#include <folly/Executor.h>
+#include <folly/File.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+#include <atomic>
+#include <chrono>
+
+namespace moxygen {
+
+/*
+ * Compact binary capture of the ingress side of a MoQSession, for offline
+ * debugging and replay benchmarks.
+ *
+ * File layout (all integers big-endian):
+ *   magic "MOQCAP01" (8 bytes), direction (1 byte, MoQControlCodec::Direction
+ *   of the capturing session)
+ *   records:
+ *     type (1 byte), flags (1 byte, bit 0 = FIN), stream ID (8 bytes),
+ *     timestamp in us since capture start (8 bytes), length (4 bytes), data
+ */
+enum class CaptureRecordType : uint8_t {
+  CONTROL = 0,
+  STREAM = 1,
+  DATAGRAM = 2,
+};
+
+struct CaptureRecord {
+  CaptureRecordType type{CaptureRecordType::CONTROL};
+  bool fin{false};
+  uint64_t streamID{0};
+  std::chrono::microseconds timestamp{0};
+  std::unique_ptr<folly::IOBuf> data;
+};
+
+class MoQCaptureWriter {
+ public:
+  // Records are buffered and written in order on writeExecutor, so the
+  // capturing event loop never blocks on the disk.  Without an executor
+  // they are written inline.  Throws std::system_error if the file cannot
+  // be created.
+  MoQCaptureWriter(
+      const std::string& path,
+      MoQControlCodec::Direction dir,
+      folly::Executor::KeepAlive<> writeExecutor = {});
+  ~MoQCaptureWriter();
+
+  MoQCaptureWriter(const MoQCaptureWriter&) = delete;
+  MoQCaptureWriter& operator=(const MoQCaptureWriter&) = delete;
+
+  void onControlData(uint64_t streamID, const folly::IOBuf* data, bool fin) {
+    append(CaptureRecordType::CONTROL, streamID, data, fin);
+  }
+
+  void onStreamData(uint64_t streamID, const folly::IOBuf* data, bool fin) {
+    append(CaptureRecordType::STREAM, streamID, data, fin);
+  }
+
+  void onDatagram(const folly::IOBuf* datagram) {
+    append(CaptureRecordType::DATAGRAM, 0, datagram, false);
+  }
+
+  void flush();
+
+ private:
+  void append(
+      CaptureRecordType type,
+      uint64_t streamID,
+      const folly::IOBuf* data,
+      bool fin);
+
+  // Shared with queued writes, which may outlive the writer
+  struct Output {
+    explicit Output(const std::string& path);
+    void write(std::unique_ptr<folly::IOBuf> buf);
+
+    folly::File file;
+    std::atomic<bool> error{false};
+    std::atomic<uint64_t> queuedBytes{0};
+  };
+
+  std::shared_ptr<Output> output_;
+  folly::Executor::KeepAlive<> writeExecutor_;
+  folly::IOBufQueue buf_{folly::IOBufQueue::cacheChainLength()};
+  std::chrono::steady_clock::time_point start_;
+};
+
+class MoQCaptureReader {
+ public:
+  // Loads the entire capture into memory so replay is not disk bound.
+  // Throws std::runtime_error if the file is missing or not a capture.
+  explicit MoQCaptureReader(const std::string& path);
+
+  MoQControlCodec::Direction direction() const {
+    return dir_;
+  }
+
+  bool done() const {
+    return cursor_.isAtEnd();
+  }
+
+  // PARSE_UNDERFLOW indicates a truncated trailing record
+  folly::Expected<CaptureRecord, ErrorCode> next();
+
+ private:
+  std::unique_ptr<folly::IOBuf> contents_;
+  folly::io::Cursor cursor_;
+  MoQControlCodec::Direction dir_{MoQControlCodec::Direction::SERVER};
+};
+
+} // namespace moxygen
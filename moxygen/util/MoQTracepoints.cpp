@@ -0,0 +1,9 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/MoQTracepoints.h"
+
+FOLLY_SDT_DEFINE_SEMAPHORE(moxygen, object_forwarded)
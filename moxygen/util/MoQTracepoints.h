@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/tracing/StaticTracepoint.h>
+
+// USDT probes under the "moxygen" provider, for bpftrace/perf.  A probe is a
+// nop until a tracer attaches.  Arguments are all integers, except track
+// names and namespaces which are C strings.  See scripts/bpftrace for examples.
+//
+//   control_frame(type, length)
+//       MoQControlCodec parsed a control message
+//   subgroup_rx_open(alias, group, subgroup)
+//   subgroup_rx_close(alias, group, subgroup)
+//       MoQObjectStreamCodec parsed a subgroup header / the stream FIN
+//   subgroup_open(alias, group, subgroup)
+//   subgroup_close(alias, group, subgroup, lastObject, reset)
+//       A subgroup stream was opened / finished or reset by a publisher
+//   write_blocked(id, group, subgroup)
+//       A publisher is waiting for stream flow control, id is the track
+//       alias of a subgroup or the subscribe ID of a fetch
+//   stream_blocked(subscribeID, group)
+//       A publisher could not open a stream, out of stream credit
+//   fetch_served(subscribeID, lastGroup, lastObject, reset)
+//       A fetch stream was completed
+//   object_forwarded(trackNamespace, trackName, group, object, bytes,
+//                    subscribers)
+//       MoQForwarder fanned an object out to its subscribers.  Guarded by a
+//       semaphore, the arguments are only computed while attached.
+#define MOQ_TRACEPOINT(name, ...) FOLLY_SDT(moxygen, name, ##__VA_ARGS__)
+
+FOLLY_SDT_DECLARE_SEMAPHORE(moxygen, object_forwarded);
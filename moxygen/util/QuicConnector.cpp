@@ -5,8 +5,10 @@
 #include <folly/futures/ThreadWheelTimekeeper.h>
 #include <quic/client/QuicClientTransport.h>
 #include <quic/common/events/FollyQuicEventBase.h>
+#include <quic/common/events/HighResQuicTimer.h>
 #include <quic/common/udpsocket/FollyQuicAsyncUDPSocket.h>
 #include <quic/fizz/client/handshake/FizzClientQuicHandshakeContext.h>
+#include <quic/fizz/client/handshake/QuicPskCache.h>
 
 namespace {
 
@@ -70,7 +72,10 @@ QuicConnector::connectQuic(
     folly::SocketAddress connectAddr,
     std::chrono::milliseconds timeoutMs,
     std::shared_ptr<fizz::CertificateVerifier> verifier,
-    std::string alpn) {
+    std::string alpn,
+    std::shared_ptr<quic::QuicPskCache> pskCache,
+    std::string hostname,
+    quic::TransportSettings transportSettings) {
   auto qEvb = std::make_shared<quic::FollyQuicEventBase>(eventBase);
   auto sock = std::make_unique<quic::FollyQuicAsyncUDPSocket>(qEvb);
   auto fizzContext = std::make_shared<fizz::client::FizzClientContext>();
@@ -81,10 +86,27 @@ QuicConnector::connectQuic(
       quic::FizzClientQuicHandshakeContext::Builder()
           .setFizzClientContext(fizzContext)
           .setCertificateVerifier(std::move(verifier))
+          .setPskCache(pskCache)
           .build(),
       /*connectionIdSize=*/0);
   quicClient->addNewPeerAddress(connectAddr);
   quicClient->setSupportedVersions({quic::QuicVersion::QUIC_V1});
+  if (pskCache) {
+    // With a cached ticket the transport is ready as soon as the client
+    // hello is sent, so the caller's first flight goes out as 0-RTT
+    quicClient->setHostname(
+        hostname.empty() ? connectAddr.getAddressStr() : hostname);
+    transportSettings.attemptEarlyData = true;
+    quicClient->setEarlyDataAppParamsFunctions(
+        [](const auto&, const auto&) { return true; },
+        []() -> std::unique_ptr<folly::IOBuf> { return nullptr; });
+  }
+  if (transportSettings.pacingEnabled) {
+    // The transport turns pacing off without a timer
+    quicClient->setPacingTimer(std::make_shared<quic::HighResQuicTimer>(
+        eventBase, transportSettings.pacingTimerResolution));
+  }
+  quicClient->setTransportSettings(transportSettings);
   folly::CancellationToken cancellationToken =
       co_await folly::coro::co_current_cancellation_token;
   QuicConnectCB cb(quicClient, std::move(cancellationToken));
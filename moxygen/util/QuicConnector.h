@@ -4,10 +4,12 @@
 #include <folly/SocketAddress.h>
 #include <folly/coro/Task.h>
 #include <folly/io/async/EventBase.h>
+#include <quic/state/TransportSettings.h>
 
 namespace quic {
 class QuicClientTransport;
-}
+class QuicPskCache;
+} // namespace quic
 
 namespace moxygen {
 
@@ -19,7 +21,13 @@ class QuicConnector {
       folly::SocketAddress connectAddr,
       std::chrono::milliseconds timeoutMs,
       std::shared_ptr<fizz::CertificateVerifier> verifier,
-      std::string alpn = "moq-00");
+      std::string alpn = "moq-00",
+      // When set, resumption tickets are stored here and a cached ticket for
+      // hostname is used to send 0-RTT data
+      std::shared_ptr<quic::QuicPskCache> pskCache = nullptr,
+      std::string hostname = "",
+      // Usually built with TransportConfig::apply
+      quic::TransportSettings transportSettings = quic::TransportSettings());
 };
 
 } // namespace moxygen
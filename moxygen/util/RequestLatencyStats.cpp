@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/RequestLatencyStats.h"
+
+#include <folly/Bits.h>
+#include <folly/Utility.h>
+#include <fmt/format.h>
+
+namespace {
+using moxygen::FetchErrorCode;
+using moxygen::FrameType;
+using moxygen::RequestLatencyStats;
+using moxygen::RequestPhase;
+using moxygen::RequestRole;
+using moxygen::SubscribeErrorCode;
+
+// Adapts the stats callback of one role to RequestLatencyStats
+template <typename Base, RequestRole kRole>
+class LatencyStatsCallback : public Base {
+ public:
+  explicit LatencyStatsCallback(std::shared_ptr<RequestLatencyStats> stats)
+      : stats_(std::move(stats)) {}
+
+  void onSubscribeSuccess() override {}
+  void onSubscribeError(SubscribeErrorCode) override {}
+  void onFetchSuccess() override {}
+  void onFetchError(FetchErrorCode) override {}
+
+  void onRequestLatency(
+      FrameType requestType,
+      RequestPhase phase,
+      std::chrono::microseconds latency,
+      bool forwarded) override {
+    stats_->record(kRole, requestType, phase, forwarded, latency);
+  }
+
+ private:
+  std::shared_ptr<RequestLatencyStats> stats_;
+};
+} // namespace
+
+namespace moxygen {
+
+size_t LatencyHistogram::bucketIndex(std::chrono::microseconds latency) {
+  if (latency.count() <= 0) {
+    return 0;
+  }
+  return std::min<size_t>(
+      folly::findLastSet(uint64_t(latency.count())), kNumBuckets - 1);
+}
+
+void LatencyHistogram::record(std::chrono::microseconds latency) {
+  uint64_t us = std::max<int64_t>(latency.count(), 0);
+  buckets_[bucketIndex(latency)].fetch_add(1, std::memory_order_relaxed);
+  totalUs_.fetch_add(us, std::memory_order_relaxed);
+  auto max = maxUs_.load(std::memory_order_relaxed);
+  while (us > max &&
+         !maxUs_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+  }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot snap;
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    snap.count += snap.buckets[i];
+  }
+  snap.total =
+      std::chrono::microseconds(totalUs_.load(std::memory_order_relaxed));
+  snap.max = std::chrono::microseconds(maxUs_.load(std::memory_order_relaxed));
+  return snap;
+}
+
+std::chrono::microseconds LatencyHistogram::Snapshot::percentile(
+    double pct) const {
+  if (count == 0) {
+    return std::chrono::microseconds(0);
+  }
+  // Rank of the sample, 1 based
+  auto rank = std::max<uint64_t>(uint64_t(count * pct / 100.0 + 0.5), 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets - 1; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return std::min(std::chrono::microseconds(uint64_t(1) << i), max);
+    }
+  }
+  return max;
+}
+
+size_t RequestLatencyStats::index(
+    RequestRole role,
+    bool fetch,
+    RequestPhase phase,
+    bool forwarded) {
+  return folly::to_underlying(role) << 3 | size_t(fetch) << 2 |
+      folly::to_underlying(phase) << 1 | size_t(forwarded);
+}
+
+void RequestLatencyStats::record(
+    RequestRole role,
+    FrameType requestType,
+    RequestPhase phase,
+    bool forwarded,
+    std::chrono::microseconds latency) {
+  if (requestType != FrameType::SUBSCRIBE && requestType != FrameType::FETCH) {
+    return;
+  }
+  histograms_[index(role, requestType == FrameType::FETCH, phase, forwarded)]
+      .record(latency);
+}
+
+const LatencyHistogram& RequestLatencyStats::histogram(
+    RequestRole role,
+    FrameType requestType,
+    RequestPhase phase,
+    bool forwarded) const {
+  return histograms_[index(
+      role, requestType == FrameType::FETCH, phase, forwarded)];
+}
+
+std::vector<RequestLatencyStats::NamedSnapshot> RequestLatencyStats::snapshot()
+    const {
+  std::vector<NamedSnapshot> result;
+  for (auto role : {RequestRole::PUBLISHER, RequestRole::SUBSCRIBER}) {
+    for (auto fetch : {false, true}) {
+      for (auto phase : {RequestPhase::RESPONSE, RequestPhase::FIRST_OBJECT}) {
+        for (auto forwarded : {false, true}) {
+          auto snap = histograms_[index(role, fetch, phase, forwarded)]
+                          .snapshot();
+          if (snap.count == 0) {
+            continue;
+          }
+          result.push_back(
+              {fmt::format(
+                   "{}.{}.{}.{}",
+                   role == RequestRole::PUBLISHER ? "publisher" : "subscriber",
+                   fetch ? "fetch" : "subscribe",
+                   phase == RequestPhase::RESPONSE ? "response"
+                                                   : "first_object",
+                   forwarded ? "forwarded" : "local"),
+               snap});
+        }
+      }
+    }
+  }
+  return result;
+}
+
+std::shared_ptr<MoQPublisherStatsCallback>
+RequestLatencyStats::publisherCallback() {
+  return std::make_shared<
+      LatencyStatsCallback<MoQPublisherStatsCallback, RequestRole::PUBLISHER>>(
+      shared_from_this());
+}
+
+std::shared_ptr<MoQSubscriberStatsCallback>
+RequestLatencyStats::subscriberCallback() {
+  return std::make_shared<LatencyStatsCallback<
+      MoQSubscriberStatsCallback,
+      RequestRole::SUBSCRIBER>>(shared_from_this());
+}
+
+} // namespace moxygen
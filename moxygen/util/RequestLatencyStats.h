@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <moxygen/stats/MoQStats.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace moxygen {
+
+// Latency histogram with power of two buckets, safe to record from any
+// thread.  Bucket 0 counts latencies under 1us, bucket i > 0 counts
+// [2^(i-1), 2^i) us and the last bucket is unbounded.
+class LatencyHistogram {
+ public:
+  static constexpr size_t kNumBuckets = 32;
+
+  struct Snapshot {
+    std::array<uint64_t, kNumBuckets> buckets{};
+    uint64_t count{0};
+    std::chrono::microseconds total{0};
+    std::chrono::microseconds max{0};
+
+    // Upper bound of the bucket holding the pct'th percentile (0 - 100)
+    std::chrono::microseconds percentile(double pct) const;
+  };
+
+  void record(std::chrono::microseconds latency);
+  Snapshot snapshot() const;
+
+  static size_t bucketIndex(std::chrono::microseconds latency);
+
+ private:
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_{};
+  std::atomic<uint64_t> totalUs_{0};
+  std::atomic<uint64_t> maxUs_{0};
+};
+
+enum class RequestRole : uint8_t { PUBLISHER = 0, SUBSCRIBER = 1 };
+
+// SUBSCRIBE and FETCH latency histograms reported through the stats
+// callbacks, split by role, request, phase and whether the request was
+// forwarded upstream.  One instance can be shared by every session.
+class RequestLatencyStats
+    : public std::enable_shared_from_this<RequestLatencyStats> {
+ public:
+  // Other request types are ignored
+  void record(
+      RequestRole role,
+      FrameType requestType,
+      RequestPhase phase,
+      bool forwarded,
+      std::chrono::microseconds latency);
+
+  const LatencyHistogram& histogram(
+      RequestRole role,
+      FrameType requestType,
+      RequestPhase phase,
+      bool forwarded) const;
+
+  struct NamedSnapshot {
+    // eg. "publisher.subscribe.first_object.forwarded"
+    std::string name;
+    LatencyHistogram::Snapshot snapshot;
+  };
+  // Histograms with at least one sample
+  std::vector<NamedSnapshot> snapshot() const;
+
+  // Install with MoQSession::setPublisherStatsCallback and
+  // setSubscriberStatsCallback.  Both keep this object alive.
+  std::shared_ptr<MoQPublisherStatsCallback> publisherCallback();
+  std::shared_ptr<MoQSubscriberStatsCallback> subscriberCallback();
+
+ private:
+  static constexpr size_t kNumHistograms = 16;
+
+  static size_t index(
+      RequestRole role,
+      bool fetch,
+      RequestPhase phase,
+      bool forwarded);
+
+  std::array<LatencyHistogram, kNumHistograms> histograms_;
+};
+
+} // namespace moxygen
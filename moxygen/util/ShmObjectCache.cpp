@@ -0,0 +1,531 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/ShmObjectCache.h"
+#include "moxygen/util/MemoryAccounting.h"
+
+#include <folly/Conv.h>
+#include <folly/ScopeGuard.h>
+#include <folly/Utility.h>
+#include <folly/hash/Hash.h>
+#include <folly/io/Cursor.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+constexpr uint64_t kMagic = 0x6d6f71636163686eULL;
+constexpr uint64_t kVersion = 2;
+constexpr size_t kLeaseSlots = 4096;
+constexpr size_t kMaxProbe = 8;
+
+struct RecordHeader {
+  uint64_t trackHash;
+  uint64_t group;
+  uint64_t subgroup;
+  uint64_t object;
+  uint64_t status;
+  uint32_t extensionBytes;
+  uint32_t payloadBytes;
+};
+
+// std::chrono::steady_clock is CLOCK_MONOTONIC, which all processes share
+uint64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string encodeExtensions(const moxygen::Extensions& extensions) {
+  std::string out;
+  auto append = [&out](const void* p, size_t n) {
+    out.append(static_cast<const char*>(p), n);
+  };
+  for (const auto& ext : extensions) {
+    append(&ext.type, sizeof(ext.type));
+    if (ext.type & 0x1) {
+      uint32_t len = ext.arrayValue.size();
+      append(&len, sizeof(len));
+      append(ext.arrayValue.data(), len);
+    } else {
+      append(&ext.intValue, sizeof(ext.intValue));
+    }
+  }
+  return out;
+}
+
+folly::Optional<moxygen::Extensions> decodeExtensions(
+    folly::io::Cursor cursor) {
+  moxygen::Extensions extensions;
+  while (!cursor.isAtEnd()) {
+    moxygen::Extension ext;
+    if (!cursor.tryReadLE(ext.type)) {
+      return folly::none;
+    }
+    if (ext.type & 0x1) {
+      uint32_t len = 0;
+      if (!cursor.tryReadLE(len) || !cursor.canAdvance(len)) {
+        return folly::none;
+      }
+      ext.arrayValue.resize(len);
+      cursor.pull(ext.arrayValue.data(), len);
+    } else if (!cursor.tryReadLE(ext.intValue)) {
+      return folly::none;
+    }
+    extensions.push_back(std::move(ext));
+  }
+  return extensions;
+}
+} // namespace
+
+namespace moxygen {
+
+struct ShmObjectCache::LeaseEntry {
+  std::atomic<uint64_t> trackHash;
+  std::atomic<uint64_t> pid;
+  std::atomic<uint64_t> expiresNs;
+  // The holder's latest group + 1, 0 if none
+  std::atomic<uint64_t> latestGroup;
+};
+
+// Guarded by a seqlock: odd seq means a writer is updating the entry
+struct ShmObjectCache::IndexEntry {
+  std::atomic<uint64_t> seq;
+  std::atomic<uint64_t> trackHash;
+  std::atomic<uint64_t> group;
+  std::atomic<uint64_t> object;
+  std::atomic<uint64_t> offset;
+  std::atomic<uint64_t> length;
+};
+
+struct ShmObjectCache::Header {
+  std::atomic<uint64_t> magic;
+  uint64_t version;
+  uint64_t indexSlots;
+  uint64_t dataBytes;
+  // Ever increasing, the ring position is writeOffset % dataBytes
+  std::atomic<uint64_t> writeOffset;
+  LeaseEntry leases[kLeaseSlots];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+folly::Expected<std::unique_ptr<ShmObjectCache>, std::string>
+ShmObjectCache::open(Config config) {
+  auto size = sizeof(Header) + config.indexSlots * sizeof(IndexEntry) +
+      config.dataBytes;
+  bool created = true;
+  int fd = ::shm_open(config.name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    created = false;
+    fd = ::shm_open(config.name.c_str(), O_RDWR, 0);
+  }
+  if (fd < 0) {
+    return folly::makeUnexpected(
+        folly::to<std::string>("shm_open failed errno=", errno));
+  }
+  SCOPE_EXIT {
+    ::close(fd);
+  };
+  if (created) {
+    if (::ftruncate(fd, size) != 0) {
+      return folly::makeUnexpected(
+          folly::to<std::string>("ftruncate failed errno=", errno));
+    }
+  } else {
+    // The creator may still be sizing the segment
+    struct stat st {};
+    for (int i = 0; i < 1000; i++) {
+      if (::fstat(fd, &st) == 0 && size_t(st.st_size) == size) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (size_t(st.st_size) != size) {
+      return folly::makeUnexpected(std::string("segment size mismatch"));
+    }
+  }
+  auto base =
+      ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    return folly::makeUnexpected(
+        folly::to<std::string>("mmap failed errno=", errno));
+  }
+  auto header = static_cast<Header*>(base);
+  if (created) {
+    header->version = kVersion;
+    header->indexSlots = config.indexSlots;
+    header->dataBytes = config.dataBytes;
+    header->magic.store(kMagic, std::memory_order_release);
+  } else {
+    for (int i = 0; i < 1000; i++) {
+      if (header->magic.load(std::memory_order_acquire) == kMagic) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (header->magic.load(std::memory_order_acquire) != kMagic ||
+        header->version != kVersion ||
+        header->indexSlots != config.indexSlots ||
+        header->dataBytes != config.dataBytes) {
+      ::munmap(base, size);
+      return folly::makeUnexpected(std::string("segment layout mismatch"));
+    }
+  }
+  return std::unique_ptr<ShmObjectCache>(
+      new ShmObjectCache(base, size, std::move(config)));
+}
+
+void ShmObjectCache::remove(const std::string& name) {
+  ::shm_unlink(name.c_str());
+}
+
+ShmObjectCache::ShmObjectCache(void* base, size_t size, Config config)
+    : base_(base),
+      size_(size),
+      config_(std::move(config)),
+      header_(static_cast<Header*>(base)),
+      pid_(::getpid()) {}
+
+ShmObjectCache::~ShmObjectCache() {
+  ::munmap(base_, size_);
+}
+
+uint64_t ShmObjectCache::trackHash(const FullTrackName& ftn) {
+  uint64_t hash = folly::hash::FNV_64_HASH_START;
+  for (const auto& part : ftn.trackNamespace.trackNamespace) {
+    hash = folly::hash::fnv64_buf(part.data(), part.size(), hash);
+    // Separator, so {"ab"} and {"a", "b"} differ
+    hash = folly::hash::fnv64_buf("/", 1, hash);
+  }
+  hash = folly::hash::fnv64_buf("\0", 1, hash);
+  hash = folly::hash::fnv64(ftn.trackName, hash);
+  return hash == 0 ? 1 : hash;
+}
+
+ShmObjectCache::IndexEntry* ShmObjectCache::indexEntry(uint64_t slot) const {
+  auto entries = reinterpret_cast<IndexEntry*>(header_ + 1);
+  return &entries[slot % config_.indexSlots];
+}
+
+uint8_t* ShmObjectCache::data() const {
+  return reinterpret_cast<uint8_t*>(indexEntry(0) + config_.indexSlots);
+}
+
+bool ShmObjectCache::valid(uint64_t offset, uint64_t length) const {
+  // A reservation ending past offset + dataBytes reuses the record's bytes
+  auto head = header_->writeOffset.load(std::memory_order_acquire);
+  return length > 0 && offset + length <= head &&
+      head <= offset + config_.dataBytes;
+}
+
+folly::Optional<uint64_t> ShmObjectCache::reserve(uint64_t length) {
+  if (length > config_.dataBytes / 4) {
+    return folly::none;
+  }
+  auto offset = header_->writeOffset.load(std::memory_order_relaxed);
+  while (true) {
+    auto pos = offset % config_.dataBytes;
+    // Records are contiguous, skip the tail of the ring if it is too short
+    auto start =
+        pos + length > config_.dataBytes ? offset + config_.dataBytes - pos
+                                         : offset;
+    if (header_->writeOffset.compare_exchange_weak(
+            offset, start + length, std::memory_order_acq_rel)) {
+      return start;
+    }
+  }
+}
+
+bool ShmObjectCache::put(
+    const FullTrackName& ftn,
+    uint64_t group,
+    uint64_t subgroup,
+    uint64_t object,
+    ObjectStatus status,
+    const Extensions& extensions,
+    const folly::IOBuf* payload) {
+  auto hash = trackHash(ftn);
+  auto encodedExtensions = encodeExtensions(extensions);
+  auto payloadLength = payload ? payload->computeChainDataLength() : 0;
+  RecordHeader record{
+      hash,
+      group,
+      subgroup,
+      object,
+      folly::to_underlying(status),
+      uint32_t(encodedExtensions.size()),
+      uint32_t(payloadLength)};
+  auto length = sizeof(record) + encodedExtensions.size() + payloadLength;
+  auto offset = reserve(length);
+  if (!offset) {
+    return false;
+  }
+  auto dst = data() + *offset % config_.dataBytes;
+  memcpy(dst, &record, sizeof(record));
+  dst += sizeof(record);
+  memcpy(dst, encodedExtensions.data(), encodedExtensions.size());
+  dst += encodedExtensions.size();
+  if (payload) {
+    for (auto range : *payload) {
+      memcpy(dst, range.data(), range.size());
+      dst += range.size();
+    }
+  }
+
+  // Prefer the entry already holding this object, then a free or stale one
+  auto slot = folly::hash::hash_combine(hash, group, object);
+  IndexEntry* target = nullptr;
+  IndexEntry* replaceable = nullptr;
+  for (size_t i = 0; i < kMaxProbe; i++) {
+    auto entry = indexEntry(slot + i);
+    if (entry->trackHash.load(std::memory_order_relaxed) == hash &&
+        entry->group.load(std::memory_order_relaxed) == group &&
+        entry->object.load(std::memory_order_relaxed) == object) {
+      target = entry;
+      break;
+    }
+    if (!replaceable &&
+        (entry->trackHash.load(std::memory_order_relaxed) == 0 ||
+         !valid(
+             entry->offset.load(std::memory_order_relaxed),
+             entry->length.load(std::memory_order_relaxed)))) {
+      replaceable = entry;
+    }
+  }
+  if (!target) {
+    target = replaceable ? replaceable : indexEntry(slot);
+  }
+
+  auto seq = target->seq.load(std::memory_order_relaxed);
+  do {
+    if (seq & 1) {
+      // Another writer holds the entry, drop this update
+      return false;
+    }
+  } while (!target->seq.compare_exchange_weak(
+      seq, seq + 1, std::memory_order_acquire));
+  target->trackHash.store(hash, std::memory_order_relaxed);
+  target->group.store(group, std::memory_order_relaxed);
+  target->object.store(object, std::memory_order_relaxed);
+  target->offset.store(*offset, std::memory_order_relaxed);
+  target->length.store(length, std::memory_order_relaxed);
+  target->seq.store(seq + 2, std::memory_order_release);
+  return true;
+}
+
+folly::Optional<std::pair<uint64_t, uint64_t>> ShmObjectCache::findRecord(
+    uint64_t hash,
+    uint64_t group,
+    uint64_t object) const {
+  auto slot = folly::hash::hash_combine(hash, group, object);
+  for (size_t i = 0; i < kMaxProbe; i++) {
+    auto entry = indexEntry(slot + i);
+    auto seq = entry->seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+      continue;
+    }
+    auto entryHash = entry->trackHash.load(std::memory_order_relaxed);
+    auto entryGroup = entry->group.load(std::memory_order_relaxed);
+    auto entryObject = entry->object.load(std::memory_order_relaxed);
+    auto offset = entry->offset.load(std::memory_order_relaxed);
+    auto length = entry->length.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry->seq.load(std::memory_order_relaxed) != seq ||
+        entryHash != hash || entryGroup != group || entryObject != object) {
+      continue;
+    }
+    if (length < sizeof(RecordHeader) || !valid(offset, length)) {
+      return folly::none;
+    }
+    return std::make_pair(offset, length);
+  }
+  return folly::none;
+}
+
+folly::Optional<ShmObjectCache::CachedObject> ShmObjectCache::get(
+    const FullTrackName& ftn,
+    uint64_t group,
+    uint64_t object) const {
+  MOQ_MEM_SCOPE(CACHE);
+  auto hash = trackHash(ftn);
+  auto found = findRecord(hash, group, object);
+  if (!found) {
+    return folly::none;
+  }
+  auto [offset, length] = *found;
+  auto buf = folly::IOBuf::create(length);
+  memcpy(buf->writableData(), data() + offset % config_.dataBytes, length);
+  buf->append(length);
+  // Keeps the copy from being reordered after the second check
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (!valid(offset, length)) {
+    // Overwritten while copying
+    return folly::none;
+  }
+  RecordHeader record;
+  memcpy(&record, buf->data(), sizeof(record));
+  if (record.trackHash != hash || record.group != group ||
+      record.object != object ||
+      sizeof(record) + record.extensionBytes + record.payloadBytes !=
+          length) {
+    return folly::none;
+  }
+  buf->trimStart(sizeof(record));
+  auto extensionBuf = buf->cloneOne();
+  extensionBuf->trimEnd(record.payloadBytes);
+  auto extensions = decodeExtensions(folly::io::Cursor(extensionBuf.get()));
+  if (!extensions) {
+    return folly::none;
+  }
+  buf->trimStart(record.extensionBytes);
+  CachedObject cached;
+  cached.subgroup = record.subgroup;
+  cached.status = ObjectStatus(record.status);
+  cached.extensions = std::move(*extensions);
+  if (record.payloadBytes > 0) {
+    cached.payload = std::move(buf);
+  }
+  return cached;
+}
+
+folly::Optional<ObjectStatus> ShmObjectCache::status(
+    const FullTrackName& ftn,
+    uint64_t group,
+    uint64_t object) const {
+  auto hash = trackHash(ftn);
+  auto found = findRecord(hash, group, object);
+  if (!found) {
+    return folly::none;
+  }
+  auto [offset, length] = *found;
+  RecordHeader record;
+  memcpy(&record, data() + offset % config_.dataBytes, sizeof(record));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (!valid(offset, length) || record.trackHash != hash ||
+      record.group != group || record.object != object) {
+    return folly::none;
+  }
+  return ObjectStatus(record.status);
+}
+
+bool ShmObjectCache::acquireLease(
+    const FullTrackName& ftn,
+    std::chrono::milliseconds ttl) {
+  auto hash = trackHash(ftn);
+  auto now = nowNs();
+  auto expires =
+      now + std::chrono::duration_cast<std::chrono::nanoseconds>(ttl).count();
+  auto take = [&](LeaseEntry& lease) {
+    auto holder = lease.pid.load(std::memory_order_acquire);
+    if (holder == pid_) {
+      lease.expiresNs.store(expires, std::memory_order_release);
+      return true;
+    }
+    if (holder != 0 &&
+        lease.expiresNs.load(std::memory_order_acquire) > now) {
+      return false;
+    }
+    if (!lease.pid.compare_exchange_strong(
+            holder, pid_, std::memory_order_acq_rel)) {
+      return false;
+    }
+    lease.expiresNs.store(expires, std::memory_order_release);
+    return true;
+  };
+
+  // Slots are never emptied, so that probe chains stay intact.  Instead a
+  // released or expired slot is handed to the next track that needs one,
+  // after checking the rest of the chain does not already hold ftn.
+  LeaseEntry* reusable = nullptr;
+  uint64_t reusableHash = 0;
+  for (size_t i = 0; i < kLeaseSlots; i++) {
+    auto& lease = header_->leases[(hash + i) % kLeaseSlots];
+    auto leaseHash = lease.trackHash.load(std::memory_order_acquire);
+    if (leaseHash == hash) {
+      return take(lease);
+    }
+    if (leaseHash == 0) {
+      if (!reusable) {
+        reusable = &lease;
+        reusableHash = 0;
+      }
+      break;
+    }
+    if (!reusable && lease.expiresNs.load(std::memory_order_acquire) <= now) {
+      reusable = &lease;
+      reusableHash = leaseHash;
+    }
+  }
+  if (!reusable) {
+    return false;
+  }
+  // Losing the race to a different track fails this attempt; the caller
+  // retries when it next renews
+  if (!reusable->trackHash.compare_exchange_strong(
+          reusableHash, hash, std::memory_order_acq_rel)) {
+    if (reusableHash != hash) {
+      return false;
+    }
+  } else {
+    // The previous track's latest group
+    reusable->latestGroup.store(0, std::memory_order_release);
+  }
+  return take(*reusable);
+}
+
+ShmObjectCache::LeaseEntry* ShmObjectCache::findLease(uint64_t hash) const {
+  for (size_t i = 0; i < kLeaseSlots; i++) {
+    auto& lease = header_->leases[(hash + i) % kLeaseSlots];
+    auto leaseHash = lease.trackHash.load(std::memory_order_acquire);
+    if (leaseHash == 0) {
+      return nullptr;
+    }
+    if (leaseHash == hash) {
+      return &lease;
+    }
+  }
+  return nullptr;
+}
+
+void ShmObjectCache::releaseLease(const FullTrackName& ftn) {
+  auto lease = findLease(trackHash(ftn));
+  if (!lease) {
+    return;
+  }
+  auto holder = pid_;
+  if (lease->pid.compare_exchange_strong(
+          holder, 0, std::memory_order_acq_rel)) {
+    lease->expiresNs.store(0, std::memory_order_release);
+  }
+}
+
+void ShmObjectCache::setLatestGroup(const FullTrackName& ftn, uint64_t group) {
+  auto lease = findLease(trackHash(ftn));
+  if (lease && lease->pid.load(std::memory_order_acquire) == pid_) {
+    lease->latestGroup.store(group + 1, std::memory_order_release);
+  }
+}
+
+folly::Optional<uint64_t> ShmObjectCache::latestGroup(
+    const FullTrackName& ftn) const {
+  auto lease = findLease(trackHash(ftn));
+  if (!lease) {
+    return folly::none;
+  }
+  auto latest = lease->latestGroup.load(std::memory_order_acquire);
+  if (latest == 0) {
+    return folly::none;
+  }
+  return latest - 1;
+}
+
+} // namespace moxygen
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "moxygen/MoQFramer.h"
+
+#include <folly/Expected.h>
+#include <folly/Optional.h>
+#include <chrono>
+
+namespace moxygen {
+
+// Object cache in a named POSIX shared memory segment, shared by the relay
+// processes on one host.
+//
+// Objects are appended to a ring buffer and indexed by (track, group, object)
+// in an open addressed table; the subgroup is stored with the object.  Old
+// objects are overwritten as the ring wraps.  Writers from any process may
+// add objects concurrently, and readers detect entries that were overwritten
+// while they were being copied.
+//
+// The segment also holds a table of track leases, so that one process at a
+// time writes a given track.
+class ShmObjectCache {
+ public:
+  struct Config {
+    std::string name{"/moxygen-cache"};
+    // Every process opening the segment must use the same sizes
+    size_t indexSlots{1 << 16};
+    size_t dataBytes{size_t(256) << 20};
+  };
+
+  // Opens the segment, creating it if it does not exist
+  static folly::Expected<std::unique_ptr<ShmObjectCache>, std::string> open(
+      Config config);
+
+  // Removes the named segment.  Mapped instances remain usable.
+  static void remove(const std::string& name);
+
+  ~ShmObjectCache();
+  ShmObjectCache(const ShmObjectCache&) = delete;
+  ShmObjectCache& operator=(const ShmObjectCache&) = delete;
+
+  // Stores an object or object status, replacing any copy of it
+  bool put(
+      const FullTrackName& ftn,
+      uint64_t group,
+      uint64_t subgroup,
+      uint64_t object,
+      ObjectStatus status,
+      const Extensions& extensions,
+      const folly::IOBuf* payload);
+
+  struct CachedObject {
+    uint64_t subgroup{0};
+    ObjectStatus status{ObjectStatus::NORMAL};
+    Extensions extensions;
+    Payload payload;
+  };
+
+  folly::Optional<CachedObject>
+  get(const FullTrackName& ftn, uint64_t group, uint64_t object) const;
+
+  // The status of a cached object, without copying it out
+  folly::Optional<ObjectStatus>
+  status(const FullTrackName& ftn, uint64_t group, uint64_t object) const;
+
+  // Takes or renews the lease on ftn for this process.  Fails while another
+  // live process holds an unexpired lease.
+  bool acquireLease(const FullTrackName& ftn, std::chrono::milliseconds ttl);
+  void releaseLease(const FullTrackName& ftn);
+
+  // The newest group written to ftn, kept with its lease so that processes
+  // not holding the lease can find the live edge.  Only the holder sets it.
+  void setLatestGroup(const FullTrackName& ftn, uint64_t group);
+  folly::Optional<uint64_t> latestGroup(const FullTrackName& ftn) const;
+
+  // Stable across processes, never 0
+  static uint64_t trackHash(const FullTrackName& ftn);
+
+ private:
+  struct Header;
+  struct IndexEntry;
+  struct LeaseEntry;
+
+  ShmObjectCache(void* base, size_t size, Config config);
+
+  IndexEntry* indexEntry(uint64_t slot) const;
+  // The offset and length of the object's record, if it is still readable
+  folly::Optional<std::pair<uint64_t, uint64_t>>
+  findRecord(uint64_t hash, uint64_t group, uint64_t object) const;
+  LeaseEntry* findLease(uint64_t hash) const;
+  uint8_t* data() const;
+  // Whether the record at offset can still be read
+  bool valid(uint64_t offset, uint64_t length) const;
+  folly::Optional<uint64_t> reserve(uint64_t length);
+
+  void* base_;
+  size_t size_;
+  Config config_;
+  Header* header_;
+  uint64_t pid_;
+};
+
+} // namespace moxygen
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/TransportMetrics.h"
+
+#include <proxygen/lib/http/session/HTTPTransaction.h>
+#include <quic/api/QuicSocket.h>
+#include <wangle/acceptor/TransportInfo.h>
+
+namespace moxygen {
+
+TransportMetricsProvider makeQuicMetricsProvider(
+    std::weak_ptr<quic::QuicSocket> weakSock) {
+  return [weakSock =
+              std::move(weakSock)]() -> folly::Optional<TransportMetrics> {
+    auto sock = weakSock.lock();
+    if (!sock || !sock->good()) {
+      return folly::none;
+    }
+    auto info = sock->getTransportInfo();
+    TransportMetrics metrics;
+    metrics.srtt = info.srtt;
+    metrics.rttvar = info.rttvar;
+    if (info.maybeMinRtt) {
+      metrics.minRtt = *info.maybeMinRtt;
+    }
+    metrics.congestionWindow = info.congestionWindow;
+    metrics.mss = info.mss;
+    metrics.bytesInFlight = info.bytesInFlight;
+    metrics.writableBytes = info.writableBytes;
+    metrics.bytesSent = info.bytesSent;
+    metrics.bytesAcked = info.bytesAcked;
+    metrics.bytesRetransmitted = info.totalBytesRetransmitted;
+    return metrics;
+  };
+}
+
+TransportMetricsProvider makeHTTPMetricsProvider(
+    proxygen::HTTPTransaction* txn) {
+  return [txn]() -> folly::Optional<TransportMetrics> {
+    wangle::TransportInfo info;
+    if (!txn->getCurrentTransportInfo(&info)) {
+      return folly::none;
+    }
+    TransportMetrics metrics;
+    metrics.srtt = info.rtt;
+    metrics.rttvar =
+        std::chrono::microseconds(std::max<int64_t>(info.rtt_var, 0));
+    metrics.congestionWindow = std::max<int64_t>(info.cwndBytes, 0);
+    metrics.mss = std::max<int64_t>(info.mss, 0);
+    return metrics;
+  };
+}
+
+folly::Optional<TransportMetrics> TransportMetricsSampler::sample() {
+  if (!provider_) {
+    return folly::none;
+  }
+  auto metrics = provider_();
+  if (!metrics) {
+    return folly::none;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (!metrics->bytesAcked || !lastBytesAcked_) {
+    // Nothing to measure from yet
+    if (metrics->srtt.count() > 0) {
+      metrics->deliveryRate =
+          metrics->congestionWindow * 8 * 1000000 / metrics->srtt.count();
+    }
+    deliveryRate_ = metrics->deliveryRate;
+    lastBytesAcked_ = metrics->bytesAcked;
+    lastSampleTime_ = now;
+    return metrics;
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      now - lastSampleTime_);
+  if (elapsed < kMinRateInterval) {
+    // Too soon to measure, keep the last rate
+    metrics->deliveryRate = deliveryRate_;
+    return metrics;
+  }
+  if (*metrics->bytesAcked >= *lastBytesAcked_) {
+    deliveryRate_ = (*metrics->bytesAcked - *lastBytesAcked_) * 8 * 1000000 /
+        elapsed.count();
+  }
+  lastBytesAcked_ = metrics->bytesAcked;
+  lastSampleTime_ = now;
+  metrics->deliveryRate = deliveryRate_;
+  return metrics;
+}
+
+} // namespace moxygen
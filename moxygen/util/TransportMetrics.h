@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/Optional.h>
+#include <chrono>
+#include <memory>
+
+namespace quic {
+class QuicSocket;
+}
+
+namespace proxygen {
+class HTTPTransaction;
+}
+
+namespace moxygen {
+
+// Congestion and delivery state of the transport under a MoQSession.
+// Transports report different subsets, unreported fields are none.
+struct TransportMetrics {
+  std::chrono::microseconds srtt{0};
+  std::chrono::microseconds rttvar{0};
+  folly::Optional<std::chrono::microseconds> minRtt;
+  uint64_t congestionWindow{0};
+  uint64_t mss{0};
+  folly::Optional<uint64_t> bytesInFlight;
+  // Bytes the congestion controller allows to be written now
+  folly::Optional<uint64_t> writableBytes;
+  folly::Optional<uint64_t> bytesSent;
+  folly::Optional<uint64_t> bytesAcked;
+  folly::Optional<uint64_t> bytesRetransmitted;
+
+  // Estimated egress rate in bits/s.  Measured from bytesAcked between two
+  // samples when available, otherwise congestionWindow / srtt.
+  uint64_t deliveryRate{0};
+};
+
+// Reads the current metrics, or none if the transport is gone
+using TransportMetricsProvider =
+    folly::Function<folly::Optional<TransportMetrics>()>;
+
+// Provider for raw QUIC, including the QUIC session under an H3 WebTransport
+TransportMetricsProvider makeQuicMetricsProvider(
+    std::weak_ptr<quic::QuicSocket> sock);
+
+// Provider for an H3 WebTransport session, via the CONNECT transaction.  The
+// owner must clear it before the transaction is detached.
+TransportMetricsProvider makeHTTPMetricsProvider(
+    proxygen::HTTPTransaction* txn);
+
+// Fills in deliveryRate from successive samples of one provider.  Samples
+// closer together than kMinRateInterval reuse the previous rate.
+class TransportMetricsSampler {
+ public:
+  static constexpr std::chrono::milliseconds kMinRateInterval{100};
+
+  explicit TransportMetricsSampler(TransportMetricsProvider provider)
+      : provider_(std::move(provider)) {}
+
+  folly::Optional<TransportMetrics> sample();
+
+ private:
+  TransportMetricsProvider provider_;
+  folly::Optional<uint64_t> lastBytesAcked_;
+  std::chrono::steady_clock::time_point lastSampleTime_;
+  uint64_t deliveryRate_{0};
+};
+
+} // namespace moxygen
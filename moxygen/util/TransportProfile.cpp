@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "moxygen/util/TransportProfile.h"
+
+#include <fmt/format.h>
+
+namespace {
+using moxygen::TransportConfig;
+
+constexpr uint64_t kKB = 1024;
+constexpr uint64_t kMB = 1024 * kKB;
+
+TransportConfig liveConfig() {
+  TransportConfig config;
+  config.congestionControl = quic::CongestionControlType::BBR;
+  config.pacing = true;
+  config.initCwndInMss = 10;
+  config.connFlowControlWindow = 4 * kMB;
+  config.streamFlowControlWindow = 512 * kKB;
+  config.maxUniStreams = 1000;
+  config.datagramBufSize = 256;
+  return config;
+}
+
+TransportConfig fetchConfig() {
+  TransportConfig config;
+  config.congestionControl = quic::CongestionControlType::Cubic;
+  config.pacing = false;
+  config.initCwndInMss = 32;
+  config.connFlowControlWindow = 32 * kMB;
+  config.streamFlowControlWindow = 8 * kMB;
+  config.maxUniStreams = 100;
+  return config;
+}
+
+TransportConfig trunkConfig() {
+  TransportConfig config;
+  config.congestionControl = quic::CongestionControlType::BBR;
+  config.pacing = true;
+  config.initCwndInMss = 64;
+  config.connFlowControlWindow = 128 * kMB;
+  config.streamFlowControlWindow = 8 * kMB;
+  config.maxUniStreams = 10000;
+  config.datagramBufSize = 4096;
+  return config;
+}
+
+void applyValues(const TransportConfig& config, quic::TransportSettings& ts) {
+  if (config.congestionControl) {
+    ts.defaultCongestionController = *config.congestionControl;
+  }
+  if (config.initCwndInMss) {
+    ts.initCwndInMss = *config.initCwndInMss;
+  }
+  if (config.connFlowControlWindow) {
+    ts.advertisedInitialConnectionFlowControlWindow =
+        *config.connFlowControlWindow;
+  }
+  if (config.streamFlowControlWindow) {
+    ts.advertisedInitialBidiLocalStreamFlowControlWindow =
+        *config.streamFlowControlWindow;
+    ts.advertisedInitialBidiRemoteStreamFlowControlWindow =
+        *config.streamFlowControlWindow;
+    ts.advertisedInitialUniStreamFlowControlWindow =
+        *config.streamFlowControlWindow;
+  }
+  if (config.maxUniStreams) {
+    ts.advertisedInitialMaxStreamsUni = *config.maxUniStreams;
+  }
+  if (config.datagramBufSize) {
+    ts.datagramConfig.readBufSize = *config.datagramBufSize;
+    ts.datagramConfig.writeBufSize = *config.datagramBufSize;
+  }
+  if (config.pacing) {
+    ts.pacingEnabled = *config.pacing;
+  }
+}
+} // namespace
+
+namespace moxygen {
+
+const char* getTransportProfileString(TransportProfile profile) {
+  switch (profile) {
+    case TransportProfile::DEFAULT:
+      return "default";
+    case TransportProfile::LIVE:
+      return "live";
+    case TransportProfile::FETCH:
+      return "fetch";
+    case TransportProfile::TRUNK:
+      return "trunk";
+  }
+  return "unknown";
+}
+
+folly::Expected<TransportProfile, std::string> parseTransportProfile(
+    folly::StringPiece name) {
+  for (auto profile :
+       {TransportProfile::DEFAULT,
+        TransportProfile::LIVE,
+        TransportProfile::FETCH,
+        TransportProfile::TRUNK}) {
+    if (name == getTransportProfileString(profile)) {
+      return profile;
+    }
+  }
+  return folly::makeUnexpected(
+      fmt::format("Unknown transport profile '{}'", name.str()));
+}
+
+void TransportConfig::apply(quic::TransportSettings& ts) const {
+  switch (profile) {
+    case TransportProfile::DEFAULT:
+      break;
+    case TransportProfile::LIVE:
+      applyValues(liveConfig(), ts);
+      break;
+    case TransportProfile::FETCH:
+      applyValues(fetchConfig(), ts);
+      break;
+    case TransportProfile::TRUNK:
+      applyValues(trunkConfig(), ts);
+      break;
+  }
+  applyValues(*this, ts);
+}
+
+} // namespace moxygen
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Expected.h>
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <quic/state/TransportSettings.h>
+
+namespace moxygen {
+
+// Named QUIC tunings for the kinds of connections MoQ makes
+enum class TransportProfile : uint8_t {
+  // mvfst defaults
+  DEFAULT = 0,
+  // Edge viewers of live tracks: paced BBR, moderate windows and room for
+  // a stream per subgroup
+  LIVE = 1,
+  // Catch up and VOD fetches: Cubic, a large initial window and deep flow
+  // control windows to fill the path quickly
+  FETCH = 2,
+  // Relay to relay: paced BBR with the deepest windows and the most streams,
+  // carrying many tracks over one long lived connection
+  TRUNK = 3,
+};
+
+const char* getTransportProfileString(TransportProfile profile);
+
+// Accepts the names from getTransportProfileString
+folly::Expected<TransportProfile, std::string> parseTransportProfile(
+    folly::StringPiece name);
+
+// A profile plus explicit overrides of its values
+struct TransportConfig {
+  TransportProfile profile{TransportProfile::DEFAULT};
+
+  folly::Optional<quic::CongestionControlType> congestionControl;
+  folly::Optional<uint64_t> initCwndInMss;
+  folly::Optional<uint64_t> connFlowControlWindow;
+  // Applied to bidi and uni streams
+  folly::Optional<uint64_t> streamFlowControlWindow;
+  folly::Optional<uint64_t> maxUniStreams;
+  // Datagrams buffered for read and for write
+  folly::Optional<uint32_t> datagramBufSize;
+  folly::Optional<bool> pacing;
+
+  // Writes the profile, then the overrides, into ts
+  void apply(quic::TransportSettings& ts) const;
+};
+
+} // namespace moxygen